@@ -0,0 +1,322 @@
+/*
+ *	cma-alloc-bench counts the heap allocations that a single
+ *	Multi::AsyncPerform round trip costs in steady state. Both
+ *	operator new and cURL's allocator are hooked, and only the
+ *	client thread is counted, so the local server doesn't skew
+ *	it. Allocations are grouped by call site, and the program
+ *	fails if the allocations per request exceed the budget
+ *
+ *	usage: cma-alloc-bench [--requests=n] [--concurrency=n]
+ *		[--size=bytes] [--budget=allocs] [--sites=n]
+ */
+
+#include "LocalServer.h"
+
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Multi.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#define CMA_BENCH_HAS_BACKTRACE 1
+#endif
+
+namespace
+{
+	/// @brief Where an allocation came from
+	enum class Source : size_t
+	{
+		New,
+		Curl,
+		Count
+	};
+
+	/// @brief Only the thread that runs the client counts, and never
+	/// while the hooks themselves are running
+	thread_local bool t_counting = false;
+	thread_local bool t_inHook = false;
+
+	uint64_t s_counts[static_cast<size_t>(Source::Count)] = {};
+	uint64_t s_bytes[static_cast<size_t>(Source::Count)] = {};
+
+#ifdef CMA_BENCH_HAS_BACKTRACE
+	constexpr size_t s_siteDepth = 4;
+	// skip the frames of RecordSite and the hook itself
+	constexpr size_t s_skipFrames = 2;
+	constexpr size_t s_maxSites = 4096;
+
+	/// @brief A distinct call stack that allocated
+	struct Site
+	{
+		void* frames[s_siteDepth];
+		Source source;
+		uint64_t count;
+	};
+	// a fixed open-addressed table, because the hook can't allocate
+	Site s_sites[s_maxSites] = {};
+	size_t s_siteCount = 0;
+	uint64_t s_droppedSites = 0;
+#endif
+
+	/// @brief Records an allocation, if the calling thread is counting
+	/// @param source Where it came from
+	/// @param size The size of the allocation
+	void RecordAllocation(Source source, size_t size) noexcept
+	{
+		if (t_counting == false || t_inHook == true)
+			return;
+		t_inHook = true;
+		++s_counts[static_cast<size_t>(source)];
+		s_bytes[static_cast<size_t>(source)] += size;
+#ifdef CMA_BENCH_HAS_BACKTRACE
+		void* frames[s_siteDepth + s_skipFrames] = {};
+		const int depth = backtrace(frames, static_cast<int>(std::size(frames)));
+		uint64_t hash = static_cast<uint64_t>(source);
+		for (int i = s_skipFrames; i < depth; ++i)
+			hash = (hash ^ reinterpret_cast<uintptr_t>(frames[i])) * 0x100000001b3ull;
+		for (size_t probe = 0; probe < s_maxSites; ++probe)
+		{
+			auto& site = s_sites[(hash + probe) % s_maxSites];
+			if (site.count == 0)
+			{
+				std::memcpy(site.frames, frames + s_skipFrames, sizeof(site.frames));
+				site.source = source;
+				site.count = 1;
+				++s_siteCount;
+				break;
+			}
+			if (site.source == source && std::memcmp(site.frames,
+				frames + s_skipFrames, sizeof(site.frames)) == 0)
+			{
+				++site.count;
+				break;
+			}
+			if (probe + 1 == s_maxSites)
+				++s_droppedSites;
+		}
+#endif
+		t_inHook = false;
+	}
+
+	// cURL's allocator hooks
+	void* CurlMalloc(size_t size)
+	{
+		RecordAllocation(Source::Curl, size);
+		return std::malloc(size);
+	}
+	void CurlFree(void* ptr)
+	{
+		std::free(ptr);
+	}
+	void* CurlRealloc(void* ptr, size_t size)
+	{
+		RecordAllocation(Source::Curl, size);
+		return std::realloc(ptr, size);
+	}
+	char* CurlStrdup(const char* str)
+	{
+		const size_t len = std::strlen(str) + 1;
+		RecordAllocation(Source::Curl, len);
+		auto copy = static_cast<char*>(std::malloc(len));
+		if (copy != nullptr)
+			std::memcpy(copy, str, len);
+		return copy;
+	}
+	void* CurlCalloc(size_t count, size_t size)
+	{
+		RecordAllocation(Source::Curl, count * size);
+		return std::calloc(count, size);
+	}
+
+	/// @brief Allocates for operator new
+	/// @param size The size
+	/// @return The memory, or nullptr
+	void* CountedNew(size_t size) noexcept
+	{
+		RecordAllocation(Source::New, size);
+		return std::malloc(size == 0 ? 1 : size);
+	}
+
+#ifdef CMA_BENCH_HAS_BACKTRACE
+	/// @param frame The return address
+	/// @return A short, readable name for the frame
+	std::string Symbolize(void* frame)
+	{
+		Dl_info info{};
+		if (dladdr(frame, &info) == 0 || info.dli_sname == nullptr)
+		{
+			char buf[32];
+			std::snprintf(buf, sizeof(buf), "%p", frame);
+			return buf;
+		}
+		int status = 0;
+		char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+		std::string name = (status == 0 && demangled != nullptr) ? demangled : info.dli_sname;
+		std::free(demangled);
+		// template arguments make the names unreadable
+		constexpr size_t maxLen = 96;
+		if (name.size() > maxLen)
+			name = name.substr(0, maxLen - 3) + "...";
+		return name;
+	}
+#endif
+}
+
+// count every flavor of operator new. the matching deletes must
+// free with the same allocator
+void* operator new(size_t size)
+{
+	if (auto ptr = CountedNew(size); ptr != nullptr)
+		return ptr;
+	throw std::bad_alloc();
+}
+void* operator new[](size_t size)
+{
+	if (auto ptr = CountedNew(size); ptr != nullptr)
+		return ptr;
+	throw std::bad_alloc();
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedNew(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedNew(size);
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+
+int main(int argc, char** argv)
+{
+	size_t requests = 20000;
+	size_t concurrency = 8;
+	size_t bodySize = 1024;
+	double budget = -1.0;
+	size_t siteCount = 15;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string_view arg = argv[i];
+		const auto value = arg.substr(arg.find('=') + 1);
+		if (arg.starts_with("--requests="))
+			std::from_chars(value.data(), value.data() + value.size(), requests);
+		else if (arg.starts_with("--concurrency="))
+			std::from_chars(value.data(), value.data() + value.size(), concurrency);
+		else if (arg.starts_with("--size="))
+			std::from_chars(value.data(), value.data() + value.size(), bodySize);
+		else if (arg.starts_with("--budget="))
+			budget = std::strtod(std::string(value).c_str(), nullptr);
+		else if (arg.starts_with("--sites="))
+			std::from_chars(value.data(), value.data() + value.size(), siteCount);
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--requests=n] [--concurrency=n] "
+				"[--size=bytes] [--budget=allocs] [--sites=n]\n", argv[0]);
+			return 1;
+		}
+	}
+	// this must come before anything else initializes cURL
+	curl_global_init_mem(CURL_GLOBAL_ALL, &CurlMalloc, &CurlFree,
+		&CurlRealloc, &CurlStrdup, &CurlCalloc);
+#ifdef CMA_BENCH_HAS_BACKTRACE
+	// the first backtrace loads the unwinder, which allocates
+	void* warmupFrames[1];
+	backtrace(warmupFrames, 1);
+#endif
+	cma::Bench::LocalServerOptions options;
+	options.bodySize = bodySize;
+	cma::Bench::LocalServer server(options);
+	const auto url = server.GetURL();
+
+	asio::io_context ctx;
+	cma::Multi multi(ctx);
+	std::vector<cma::Easy> easies(concurrency);
+	// the first round of each connection is warmup. it opens the
+	// connections and fills cURL's caches
+	const size_t warmupRequests = concurrency * 4;
+	size_t started = 0;
+	size_t completed = 0;
+	uint64_t errors = 0;
+	std::function<void(cma::Easy&)> submit = [&](cma::Easy& easy)
+	{
+		++started;
+		multi.AsyncPerform(easy, [&](const asio::error_code& ec)
+			{
+				if (ec)
+					++errors;
+				if (++completed == warmupRequests)
+					t_counting = true;
+				if (started < warmupRequests + requests)
+					submit(easy);
+				else if (completed == warmupRequests + requests)
+					t_counting = false;
+			});
+	};
+	for (auto& easy : easies)
+	{
+		easy.SetURL(url.c_str());
+		easy.SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+		easy.SetBuffer(cma::Easy::NullBuffer{});
+		submit(easy);
+	}
+	ctx.run();
+	t_counting = false;
+
+	const auto measured = static_cast<double>(std::max<size_t>(completed - warmupRequests, 1));
+	const auto newCount = s_counts[static_cast<size_t>(Source::New)];
+	const auto curlCount = s_counts[static_cast<size_t>(Source::Curl)];
+	const double perRequest = static_cast<double>(newCount + curlCount) / measured;
+	std::printf("requests: %.0f (errors: %llu)\n", measured, static_cast<unsigned long long>(errors));
+	std::printf("operator new: %8.2f allocs/req %10.1f bytes/req\n",
+		static_cast<double>(newCount) / measured,
+		static_cast<double>(s_bytes[static_cast<size_t>(Source::New)]) / measured);
+	std::printf("curl:         %8.2f allocs/req %10.1f bytes/req\n",
+		static_cast<double>(curlCount) / measured,
+		static_cast<double>(s_bytes[static_cast<size_t>(Source::Curl)]) / measured);
+	std::printf("total:        %8.2f allocs/req\n", perRequest);
+#ifdef CMA_BENCH_HAS_BACKTRACE
+	std::vector<const Site*> sites;
+	for (const auto& site : s_sites)
+	{
+		if (site.count != 0)
+			sites.push_back(&site);
+	}
+	std::sort(sites.begin(), sites.end(), [](const Site* a, const Site* b)
+		{
+			return a->count > b->count;
+		});
+	std::printf("\ntop call sites (%zu distinct, %llu dropped):\n", s_siteCount,
+		static_cast<unsigned long long>(s_droppedSites));
+	for (size_t i = 0; i < std::min(siteCount, sites.size()); ++i)
+	{
+		std::printf("%8.2f/req [%s]\n", static_cast<double>(sites[i]->count) / measured,
+			sites[i]->source == Source::New ? "new" : "curl");
+		for (const auto frame : sites[i]->frames)
+		{
+			if (frame != nullptr)
+				std::printf("\t%s\n", Symbolize(frame).c_str());
+		}
+	}
+#endif
+	if (budget >= 0.0 && perRequest > budget)
+	{
+		std::fprintf(stderr, "FAILED: %.2f allocations per request exceeds the budget of %.2f\n",
+			perRequest, budget);
+		return 1;
+	}
+	return (errors == 0) ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,302 @@
+/*
+ *	cma-bench measures requests per second, latency percentiles
+ *	and client CPU per request of Multi::AsyncPerform against an
+ *	in-process server, across concurrency levels, body sizes and
+ *	transports. Each configuration is also run through a raw
+ *	curl_multi_poll loop as a baseline for the library's overhead,
+ *	through ThreadedMulti, whose CPU time is spent on its own
+ *	thread and so isn't counted, and through a Multi with the
+ *	SingleThreaded policy, which has no strand
+ *
+ *	usage: cma-bench [--duration=ms] [--sizes=a,b,...]
+ *		[--concurrency=a,b,...] [--transports=tcp,uds]
+ *		[--modes=multi,single,threaded,poll]
+ */
+
+#include "CpuTime.h"
+#include "Histogram.h"
+#include "LocalServer.h"
+
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Multi.h>
+#include <curl-multi-asio/ThreadedMulti.h>
+
+#include <charconv>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::chrono_literals;
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+	/// @brief Where and what to request
+	struct Target
+	{
+		std::string url;
+		std::string unixPath;
+	};
+	/// @brief The measurements of a single run
+	struct Result
+	{
+		cma::Bench::Histogram latency;
+		uint64_t errors = 0;
+		clock_type::duration elapsed{};
+		std::chrono::nanoseconds cpu{};
+	};
+
+	/// @brief Applies the options shared by both modes
+	/// @param easy The raw easy handle
+	/// @param target The target
+	void SetCommonOptions(CURL* easy, const Target& target) noexcept
+	{
+		curl_easy_setopt(easy, CURLOPT_URL, target.url.c_str());
+		curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+		if (target.unixPath.empty() == false)
+			curl_easy_setopt(easy, CURLOPT_UNIX_SOCKET_PATH, target.unixPath.c_str());
+	}
+	/// @brief Discards the response body
+	size_t DiscardCb(char*, size_t size, size_t nmemb, void*) noexcept
+	{
+		return size * nmemb;
+	}
+
+	/// @brief Runs closed-loop traffic through a multi handle
+	/// @tparam MultiType A BasicMulti or ThreadedMulti
+	/// @param target The target
+	/// @param concurrency The number of transfers in flight
+	/// @param warmup How long to run before measuring
+	/// @param duration How long to measure
+	/// @return The result
+	template<typename MultiType>
+	Result RunMulti(const Target& target, size_t concurrency,
+		clock_type::duration warmup, clock_type::duration duration)
+	{
+		struct Slot
+		{
+			cma::Easy easy;
+			clock_type::time_point start;
+		};
+		Result result;
+		asio::io_context ctx;
+		MultiType multi(ctx);
+		std::vector<Slot> slots(concurrency);
+		const auto measureStart = clock_type::now() + warmup;
+		const auto deadline = measureStart + duration;
+		std::function<void(Slot&)> submit = [&](Slot& slot)
+		{
+			slot.start = clock_type::now();
+			multi.AsyncPerform(slot.easy, [&](const asio::error_code& ec)
+				{
+					const auto now = clock_type::now();
+					if (slot.start >= measureStart && now <= deadline)
+					{
+						result.latency.Record(static_cast<uint64_t>((now - slot.start).count()));
+						if (ec)
+							++result.errors;
+					}
+					if (now < deadline)
+						submit(slot);
+				});
+		};
+		for (auto& slot : slots)
+		{
+			SetCommonOptions(slot.easy.GetNativeHandle(), target);
+			slot.easy.SetBuffer(cma::Easy::NullBuffer{});
+			submit(slot);
+		}
+		// run the warmup separately so its CPU time isn't counted
+		ctx.run_until(measureStart);
+		const auto cpuStart = cma::Bench::ThreadCpuTime();
+		ctx.run();
+		result.cpu = cma::Bench::ThreadCpuTime() - cpuStart;
+		result.elapsed = duration;
+		return result;
+	}
+	/// @brief Runs the same traffic through a hand-written
+	/// curl_multi_poll loop, which is the baseline
+	/// @param target The target
+	/// @param concurrency The number of transfers in flight
+	/// @param warmup How long to run before measuring
+	/// @param duration How long to measure
+	/// @return The result
+	Result RunRawPoll(const Target& target, size_t concurrency,
+		clock_type::duration warmup, clock_type::duration duration)
+	{
+		struct Slot
+		{
+			CURL* easy;
+			clock_type::time_point start;
+		};
+		Result result;
+		CURLM* multi = curl_multi_init();
+		std::vector<Slot> slots(concurrency);
+		const auto measureStart = clock_type::now() + warmup;
+		const auto deadline = measureStart + duration;
+		for (auto& slot : slots)
+		{
+			slot.easy = curl_easy_init();
+			SetCommonOptions(slot.easy, target);
+			curl_easy_setopt(slot.easy, CURLOPT_WRITEFUNCTION, &DiscardCb);
+			curl_easy_setopt(slot.easy, CURLOPT_PRIVATE, &slot);
+			slot.start = clock_type::now();
+			curl_multi_add_handle(multi, slot.easy);
+		}
+		bool measuring = false;
+		std::chrono::nanoseconds cpuStart{};
+		int running = 1;
+		while (running != 0)
+		{
+			curl_multi_perform(multi, &running);
+			int msgsInQueue = 0;
+			while (CURLMsg* msg = curl_multi_info_read(multi, &msgsInQueue))
+			{
+				if (msg->msg != CURLMSG_DONE)
+					continue;
+				Slot* slot = nullptr;
+				curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &slot);
+				const auto now = clock_type::now();
+				if (slot->start >= measureStart && now <= deadline)
+				{
+					result.latency.Record(static_cast<uint64_t>((now - slot->start).count()));
+					if (msg->data.result != CURLE_OK)
+						++result.errors;
+				}
+				curl_multi_remove_handle(multi, slot->easy);
+				if (now < deadline)
+				{
+					slot->start = now;
+					curl_multi_add_handle(multi, slot->easy);
+					running = 1;
+				}
+			}
+			if (measuring == false && clock_type::now() >= measureStart)
+			{
+				measuring = true;
+				cpuStart = cma::Bench::ThreadCpuTime();
+			}
+			if (running != 0)
+				curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+		}
+		result.cpu = cma::Bench::ThreadCpuTime() - cpuStart;
+		result.elapsed = duration;
+		for (auto& slot : slots)
+		{
+			curl_multi_remove_handle(multi, slot.easy);
+			curl_easy_cleanup(slot.easy);
+		}
+		curl_multi_cleanup(multi);
+		return result;
+	}
+
+	/// @brief Parses a comma-separated list of numbers
+	/// @param list The list
+	/// @return The numbers
+	std::vector<size_t> ParseList(std::string_view list)
+	{
+		std::vector<size_t> result;
+		while (list.empty() == false)
+		{
+			const auto commaPos = list.find(',');
+			const auto item = list.substr(0, commaPos);
+			size_t value = 0;
+			if (std::from_chars(item.data(), item.data() + item.size(), value).ec == std::errc())
+				result.push_back(value);
+			if (commaPos == std::string_view::npos)
+				break;
+			list.remove_prefix(commaPos + 1);
+		}
+		return result;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t durationMs = 2000;
+	std::vector<size_t> sizes = { 0, 1024, 64 * 1024, 1024 * 1024 };
+	std::vector<size_t> concurrencies = { 1, 16, 128 };
+	std::string_view transports = "tcp,uds";
+	std::string_view modes = "multi,single,threaded,poll";
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string_view arg = argv[i];
+		const auto value = arg.substr(arg.find('=') + 1);
+		if (arg.starts_with("--duration="))
+			std::from_chars(value.data(), value.data() + value.size(), durationMs);
+		else if (arg.starts_with("--sizes="))
+			sizes = ParseList(value);
+		else if (arg.starts_with("--concurrency="))
+			concurrencies = ParseList(value);
+		else if (arg.starts_with("--transports="))
+			transports = value;
+		else if (arg.starts_with("--modes="))
+			modes = value;
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--duration=ms] [--sizes=a,b,...] "
+				"[--concurrency=a,b,...] [--transports=tcp,uds] [--modes=multi,single,threaded,poll]\n", argv[0]);
+			return 1;
+		}
+	}
+	curl_global_init(CURL_GLOBAL_ALL);
+	cma::Bench::LocalServerOptions options;
+	options.unixPath = "cma-bench.sock";
+	options.threads = 2;
+	cma::Bench::LocalServer server(options);
+	const auto duration = std::chrono::milliseconds(durationMs);
+	const auto warmup = std::min<clock_type::duration>(duration / 5, 500ms);
+
+#ifdef CMA_USE_IO_URING
+	std::printf("readiness backend: io_uring\n");
+#else
+	std::printf("readiness backend: default\n");
+#endif
+	std::printf("%-8s %-5s %9s %5s %12s %10s %10s %10s %12s %7s\n", "mode", "xport",
+		"size", "conc", "req/s", "p50(us)", "p99(us)", "p999(us)", "cpu/req(us)", "errors");
+	for (const auto transport : { std::string_view("tcp"), std::string_view("uds") })
+	{
+		if (transports.find(transport) == std::string_view::npos ||
+			(transport == "uds" && server.GetUnixPath().empty()))
+			continue;
+		for (const auto size : sizes)
+		{
+			Target target{ server.GetURL("/?size=" + std::to_string(size)),
+				(transport == "uds") ? server.GetUnixPath() : std::string() };
+			for (const auto concurrency : concurrencies)
+			{
+				for (const auto mode : { std::string_view("multi"), std::string_view("single"),
+					std::string_view("threaded"), std::string_view("poll") })
+				{
+					if (modes.find(mode) == std::string_view::npos)
+						continue;
+					Result result;
+					if (mode == "multi")
+						result = RunMulti<cma::Multi>(target, concurrency, warmup, duration);
+					else if (mode == "single")
+						result = RunMulti<cma::BasicMulti<cma::SingleThreaded>>(
+							target, concurrency, warmup, duration);
+					else if (mode == "threaded")
+						result = RunMulti<cma::ThreadedMulti>(target, concurrency, warmup, duration);
+					else
+						result = RunRawPoll(target, concurrency, warmup, duration);
+					const auto count = std::max<uint64_t>(result.latency.Count(), 1);
+					std::printf("%-8s %-5s %9zu %5zu %12.0f %10.1f %10.1f %10.1f %12.2f %7llu\n",
+						mode.data(), transport.data(), size, concurrency,
+						static_cast<double>(result.latency.Count()) /
+							std::chrono::duration<double>(result.elapsed).count(),
+						result.latency.Percentile(50.0) / 1000.0,
+						result.latency.Percentile(99.0) / 1000.0,
+						result.latency.Percentile(99.9) / 1000.0,
+						static_cast<double>(result.cpu.count()) / 1000.0 / static_cast<double>(count),
+						static_cast<unsigned long long>(result.errors));
+					std::fflush(stdout);
+				}
+			}
+		}
+	}
+	curl_global_cleanup();
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef CURLMULTIASIO_BENCHMARKS_CPUTIME_H_
+#define CURLMULTIASIO_BENCHMARKS_CPUTIME_H_
+
+/// @file
+/// CPU time measurement
+/// 10/19/26
+
+// STL includes
+#include <chrono>
+#include <ctime>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN 1
+#include <Windows.h>
+#endif
+
+namespace cma
+{
+	namespace Bench
+	{
+		/// @return The CPU time consumed by the calling thread. The local
+		/// server runs on other threads, so it isn't counted
+		inline std::chrono::nanoseconds ThreadCpuTime() noexcept
+		{
+#ifdef _WIN32
+			FILETIME creation, exit, kernel, user;
+			if (GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user) == FALSE)
+				return {};
+			auto toNs = [](const FILETIME& ft)
+			{
+				return ((static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime) * 100;
+			};
+			return std::chrono::nanoseconds(toNs(kernel) + toNs(user));
+#else
+			timespec ts{};
+			clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+			return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+#endif
+		}
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+#ifndef CURLMULTIASIO_BENCHMARKS_HISTOGRAM_H_
+#define CURLMULTIASIO_BENCHMARKS_HISTOGRAM_H_
+
+/// @file
+/// Log-linear latency histogram
+/// 10/19/26
+
+// STL includes
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+
+namespace cma
+{
+	namespace Bench
+	{
+		/// @brief A fixed-size log-linear histogram in the spirit of
+		/// HdrHistogram. Every power of two is split into 128 linear
+		/// buckets, so any recorded value is reported within 1% of its
+		/// true value. Recording never allocates
+		class Histogram
+		{
+		public:
+			/// @brief Records a value
+			/// @param value The value, usually in nanoseconds
+			/// @param count The number of times to record it
+			inline void Record(uint64_t value, uint64_t count = 1) noexcept
+			{
+				m_buckets[BucketFor(value)] += count;
+				m_count += count;
+				m_sum += value * count;
+				m_min = std::min(m_min, value);
+				m_max = std::max(m_max, value);
+			}
+			/// @brief Adds all of the values of another histogram
+			/// @param other The other histogram
+			inline void Merge(const Histogram& other) noexcept
+			{
+				for (size_t i = 0; i < s_bucketCount; ++i)
+					m_buckets[i] += other.m_buckets[i];
+				m_count += other.m_count;
+				m_sum += other.m_sum;
+				m_min = std::min(m_min, other.m_min);
+				m_max = std::max(m_max, other.m_max);
+			}
+			/// @brief Removes all values
+			inline void Reset() noexcept { *this = Histogram(); }
+
+			/// @param percentile The percentile, in [0, 100]
+			/// @return The highest value at the percentile
+			inline uint64_t Percentile(double percentile) const noexcept
+			{
+				if (m_count == 0)
+					return 0;
+				const auto target = std::max<uint64_t>(1, static_cast<uint64_t>(
+					percentile / 100.0 * static_cast<double>(m_count) + 0.5));
+				uint64_t seen = 0;
+				for (size_t i = 0; i < s_bucketCount; ++i)
+				{
+					seen += m_buckets[i];
+					if (seen >= target)
+						return std::min(HighestFor(i), m_max);
+				}
+				return m_max;
+			}
+			/// @return The number of recorded values
+			inline uint64_t Count() const noexcept { return m_count; }
+			/// @return The mean of the recorded values
+			inline double Mean() const noexcept
+			{
+				return (m_count == 0) ? 0.0 :
+					static_cast<double>(m_sum) / static_cast<double>(m_count);
+			}
+			/// @return The smallest recorded value
+			inline uint64_t Min() const noexcept { return (m_count == 0) ? 0 : m_min; }
+			/// @return The largest recorded value
+			inline uint64_t Max() const noexcept { return m_max; }
+		private:
+			static constexpr size_t s_subBucketBits = 7;
+			static constexpr size_t s_subBuckets = size_t(1) << s_subBucketBits;
+			static constexpr size_t s_bucketCount = (64 - s_subBucketBits + 1) * s_subBuckets;
+
+			/// @param value The value
+			/// @return The index of the bucket that holds the value
+			static constexpr size_t BucketFor(uint64_t value) noexcept
+			{
+				// values below the sub-bucket count are exact
+				if (value < s_subBuckets)
+					return static_cast<size_t>(value);
+				const size_t shift = static_cast<size_t>(std::bit_width(value)) - s_subBucketBits - 1;
+				return (shift + 1) * s_subBuckets +
+					static_cast<size_t>((value >> shift) - s_subBuckets);
+			}
+			/// @param bucket The index of the bucket
+			/// @return The highest value that lands in the bucket
+			static constexpr uint64_t HighestFor(size_t bucket) noexcept
+			{
+				if (bucket < s_subBuckets)
+					return bucket;
+				const size_t shift = bucket / s_subBuckets - 1;
+				const uint64_t base = (s_subBuckets + bucket % s_subBuckets) << shift;
+				return base + ((uint64_t(1) << shift) - 1);
+			}
+
+			std::array<uint64_t, s_bucketCount> m_buckets{};
+			uint64_t m_count = 0;
+			uint64_t m_sum = 0;
+			uint64_t m_min = std::numeric_limits<uint64_t>::max();
+			uint64_t m_max = 0;
+		};
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,72 @@
+/*
+ *	cma-impair runs the impairment proxy on its own, in front of
+ *	any TCP server, until it is interrupted
+ *
+ *	usage: cma-impair --upstream=ip:port [--port=n] [--latency=ms]
+ *		[--jitter=ms] [--ttfb=ms] [--bandwidth=bytes/s] [--chunk=bytes]
+ *		[--reset-after=bytes] [--stall-after=bytes] [--fault-probability=p]
+ */
+
+#include "ImpairmentProxy.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+int main(int argc, char** argv)
+{
+	cma::Bench::Impairments impairments;
+	std::string upstream;
+	uint16_t port = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string_view arg = argv[i];
+		const auto value = arg.substr(arg.find('=') + 1);
+		uint64_t number = 0;
+		std::from_chars(value.data(), value.data() + value.size(), number);
+		if (arg.starts_with("--upstream="))
+			upstream = value;
+		else if (arg.starts_with("--port="))
+			port = static_cast<uint16_t>(number);
+		else if (arg.starts_with("--latency="))
+			impairments.latency = std::chrono::milliseconds(number);
+		else if (arg.starts_with("--jitter="))
+			impairments.jitter = std::chrono::milliseconds(number);
+		else if (arg.starts_with("--ttfb="))
+			impairments.firstByteDelay = std::chrono::milliseconds(number);
+		else if (arg.starts_with("--bandwidth="))
+			impairments.bandwidth = number;
+		else if (arg.starts_with("--chunk="))
+			impairments.chunkSize = static_cast<size_t>(number);
+		else if (arg.starts_with("--reset-after="))
+			impairments.resetAfterBytes = number;
+		else if (arg.starts_with("--stall-after="))
+			impairments.stallAfterBytes = number;
+		else if (arg.starts_with("--fault-probability="))
+			impairments.faultProbability = std::strtod(std::string(value).c_str(), nullptr);
+		else
+			upstream.clear();
+	}
+	const auto colonPos = upstream.rfind(':');
+	asio::error_code ec;
+	const auto address = asio::ip::make_address(upstream.substr(0, colonPos), ec);
+	if (upstream.empty() || colonPos == std::string::npos || ec)
+	{
+		std::fprintf(stderr, "usage: %s --upstream=ip:port [--port=n] [--latency=ms] "
+			"[--jitter=ms] [--ttfb=ms] [--bandwidth=bytes/s] [--chunk=bytes] "
+			"[--reset-after=bytes] [--stall-after=bytes] [--fault-probability=p]\n", argv[0]);
+		return 1;
+	}
+	cma::Bench::ImpairmentProxy proxy({ address, static_cast<uint16_t>(
+		std::atoi(upstream.c_str() + colonPos + 1)) }, impairments, port);
+	std::printf("Forwarding 127.0.0.1:%u to %s\n", proxy.GetPort(), upstream.c_str());
+	std::fflush(stdout);
+	// wait until we are interrupted
+	asio::io_context ctx;
+	asio::signal_set signals(ctx, SIGINT, SIGTERM);
+	signals.async_wait([](const asio::error_code&, int) {});
+	ctx.run();
+	return 0;
+}
\ No newline at end of file
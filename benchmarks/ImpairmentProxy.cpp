@@ -0,0 +1,247 @@
+#include "ImpairmentProxy.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <random>
+
+using cma::Bench::ImpairmentProxy;
+using cma::Bench::Impairments;
+
+struct ImpairmentProxy::State
+{
+	State(asio::io_context& ctx, asio::ip::tcp::endpoint upstream,
+		const Impairments& impairments) :
+		acceptor(ctx), upstream(std::move(upstream)), impairments(impairments) {}
+
+	asio::ip::tcp::acceptor acceptor;
+	asio::ip::tcp::endpoint upstream;
+	mutable std::mutex impairmentsMutex;
+	Impairments impairments;
+	std::atomic<uint64_t> connections = 0;
+	std::minstd_rand rng{ std::random_device{}() };
+};
+
+namespace
+{
+	using clock_type = std::chrono::steady_clock;
+
+	/// @brief A proxied connection, with one pump in each direction
+	class Connection : public std::enable_shared_from_this<Connection>
+	{
+	public:
+		Connection(asio::ip::tcp::socket client, const Impairments& impairments,
+			bool faulty, uint32_t seed) :
+			m_client(std::move(client)), m_upstream(m_client.get_executor()),
+			m_impairments(impairments), m_faulty(faulty), m_rng(seed),
+			m_downstream(m_client.get_executor()), m_upstreamPump(m_client.get_executor()) {}
+
+		/// @brief Connects to the upstream server and starts forwarding
+		/// @param upstream The upstream endpoint
+		void Start(const asio::ip::tcp::endpoint& upstream)
+		{
+			m_upstream.async_connect(upstream,
+				[self = shared_from_this()](const asio::error_code& ec)
+			{
+				if (ec)
+					return self->Close(false);
+				asio::error_code ignored;
+				self->m_client.set_option(asio::ip::tcp::no_delay(true), ignored);
+				self->m_upstream.set_option(asio::ip::tcp::no_delay(true), ignored);
+				self->Read(self->m_upstreamPump, self->m_client, self->m_upstream, false);
+				self->Read(self->m_downstream, self->m_upstream, self->m_client, true);
+			});
+		}
+	private:
+		/// @brief The state of forwarding in one direction
+		struct Pump
+		{
+			explicit Pump(const asio::any_io_executor& executor) : timer(executor) {}
+
+			std::array<char, 16 * 1024> buffer;
+			asio::steady_timer timer;
+			clock_type::time_point nextSend{};
+			uint64_t forwarded = 0;
+		};
+
+		/// @brief Reads the next chunk from one side
+		/// @param pump The direction
+		/// @param from The socket to read from
+		/// @param to The socket to write to
+		/// @param downstream Whether the data flows from the server to the client
+		void Read(Pump& pump, asio::ip::tcp::socket& from,
+			asio::ip::tcp::socket& to, bool downstream)
+		{
+			size_t maxRead = pump.buffer.size();
+			if (m_impairments.chunkSize != 0)
+				maxRead = std::min(maxRead, m_impairments.chunkSize);
+			from.async_read_some(asio::buffer(pump.buffer.data(), maxRead),
+				[self = shared_from_this(), &pump, &from, &to, downstream]
+				(const asio::error_code& ec, size_t len)
+			{
+				if (ec)
+					return self->Close(false);
+				self->Delay(pump, from, to, downstream, len);
+			});
+		}
+		/// @brief Holds a chunk back according to the impairments
+		/// @param pump The direction
+		/// @param from The socket the chunk came from
+		/// @param to The socket to write to
+		/// @param downstream Whether the data flows from the server to the client
+		/// @param len The length of the chunk
+		void Delay(Pump& pump, asio::ip::tcp::socket& from,
+			asio::ip::tcp::socket& to, bool downstream, size_t len)
+		{
+			auto sendAt = clock_type::now() + m_impairments.latency;
+			if (m_impairments.jitter.count() > 0)
+				sendAt += std::chrono::milliseconds(std::uniform_int_distribution<int64_t>(
+					0, m_impairments.jitter.count())(m_rng));
+			if (downstream == true)
+			{
+				if (pump.forwarded == 0)
+					sendAt += m_impairments.firstByteDelay;
+				// the bandwidth cap spaces the chunks out
+				if (m_impairments.bandwidth != 0)
+				{
+					sendAt = std::max(sendAt, pump.nextSend);
+					pump.nextSend = sendAt + std::chrono::duration_cast<clock_type::duration>(
+						std::chrono::duration<double>(static_cast<double>(len) /
+							static_cast<double>(m_impairments.bandwidth)));
+				}
+				// cut the chunk at the fault
+				if (m_faulty == true)
+				{
+					for (const auto limit : { m_impairments.resetAfterBytes, m_impairments.stallAfterBytes })
+					{
+						if (limit != 0 && pump.forwarded + len > limit)
+							len = static_cast<size_t>(limit - std::min(limit, pump.forwarded));
+					}
+				}
+			}
+			pump.timer.expires_at(sendAt);
+			pump.timer.async_wait([self = shared_from_this(), &pump, &from, &to, downstream, len]
+				(const asio::error_code& ec)
+			{
+				if (ec)
+					return;
+				asio::async_write(to, asio::buffer(pump.buffer.data(), len),
+					[self, &pump, &from, &to, downstream](const asio::error_code& ec, size_t len)
+				{
+					if (ec)
+						return self->Close(false);
+					pump.forwarded += len;
+					if (downstream == true && self->m_faulty == true)
+					{
+						const auto& impairments = self->m_impairments;
+						if (impairments.resetAfterBytes != 0 &&
+							pump.forwarded >= impairments.resetAfterBytes)
+							return self->Close(true);
+						// stop forwarding, but keep the sockets open. the
+						// other pump notices when the client gives up
+						if (impairments.stallAfterBytes != 0 &&
+							pump.forwarded >= impairments.stallAfterBytes)
+							return;
+					}
+					self->Read(pump, from, to, downstream);
+				});
+			});
+		}
+		/// @brief Closes both sides
+		/// @param reset Whether to reset the client instead of closing it gracefully
+		void Close(bool reset)
+		{
+			asio::error_code ignored;
+			if (reset == true)
+				m_client.set_option(asio::socket_base::linger(true, 0), ignored);
+			else
+				m_client.shutdown(asio::socket_base::shutdown_both, ignored);
+			m_client.close(ignored);
+			m_upstream.close(ignored);
+			m_downstream.timer.cancel();
+			m_upstreamPump.timer.cancel();
+		}
+
+		asio::ip::tcp::socket m_client;
+		asio::ip::tcp::socket m_upstream;
+		Impairments m_impairments;
+		bool m_faulty;
+		std::minstd_rand m_rng;
+		Pump m_downstream;
+		Pump m_upstreamPump;
+	};
+
+	/// @brief Accepts connections forever
+	/// @param state The proxy state
+	void DoAccept(std::shared_ptr<ImpairmentProxy::State> state)
+	{
+		state->acceptor.async_accept([state](const asio::error_code& ec, asio::ip::tcp::socket socket)
+			{
+				if (ec == asio::error::operation_aborted)
+					return;
+				if (!ec)
+				{
+					++state->connections;
+					Impairments impairments;
+					bool faulty = false;
+					uint32_t seed = 0;
+					{
+						std::lock_guard lock(state->impairmentsMutex);
+						impairments = state->impairments;
+						faulty = std::bernoulli_distribution(
+							std::clamp(impairments.faultProbability, 0.0, 1.0))(state->rng);
+						seed = static_cast<uint32_t>(state->rng());
+					}
+					std::make_shared<Connection>(std::move(socket), impairments,
+						faulty, seed)->Start(state->upstream);
+				}
+				DoAccept(state);
+			});
+	}
+}
+
+ImpairmentProxy::ImpairmentProxy(asio::ip::tcp::endpoint upstream,
+	Impairments impairments, uint16_t port, asio::ip::address address) :
+	m_state(std::make_shared<State>(m_ctx, std::move(upstream), impairments)),
+	m_address(std::move(address))
+{
+	const asio::ip::tcp::endpoint endpoint(m_address, port);
+	m_state->acceptor.open(endpoint.protocol());
+	m_state->acceptor.set_option(asio::socket_base::reuse_address(true));
+	m_state->acceptor.bind(endpoint);
+	m_state->acceptor.listen();
+	m_port = m_state->acceptor.local_endpoint().port();
+	DoAccept(m_state);
+	m_thread = std::thread([this] { m_ctx.run(); });
+}
+
+ImpairmentProxy::~ImpairmentProxy()
+{
+	m_ctx.stop();
+	m_thread.join();
+	asio::error_code ignored;
+	m_state->acceptor.close(ignored);
+}
+
+std::string ImpairmentProxy::GetURL(std::string_view target) const
+{
+	const auto host = m_address.is_v6() ? '[' + m_address.to_string() + ']' : m_address.to_string();
+	return "http://" + host + ':' + std::to_string(m_port) + std::string(target);
+}
+
+void ImpairmentProxy::SetImpairments(const Impairments& impairments)
+{
+	std::lock_guard lock(m_state->impairmentsMutex);
+	m_state->impairments = impairments;
+}
+
+Impairments ImpairmentProxy::GetImpairments() const
+{
+	std::lock_guard lock(m_state->impairmentsMutex);
+	return m_state->impairments;
+}
+
+uint64_t ImpairmentProxy::GetConnectionCount() const noexcept
+{
+	return m_state->connections.load();
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#ifndef CURLMULTIASIO_BENCHMARKS_IMPAIRMENTPROXY_H_
+#define CURLMULTIASIO_BENCHMARKS_IMPAIRMENTPROXY_H_
+
+/// @file
+/// Network impairment proxy
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+
+// STL includes
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace cma
+{
+	namespace Bench
+	{
+		/// @brief The conditions that the proxy imposes on each new
+		/// connection. Zero disables an impairment
+		struct Impairments
+		{
+			/// @brief The delay added to every chunk in both directions
+			std::chrono::milliseconds latency{ 0 };
+			/// @brief A random amount up to this is added to the latency
+			std::chrono::milliseconds jitter{ 0 };
+			/// @brief An extra delay before the first byte of the response,
+			/// which simulates a slow time to first byte
+			std::chrono::milliseconds firstByteDelay{ 0 };
+			/// @brief The bandwidth from the server to the client, in
+			/// bytes per second
+			uint64_t bandwidth = 0;
+			/// @brief The largest chunk forwarded at once. Small chunks
+			/// with a bandwidth cap make the body trickle in
+			size_t chunkSize = 0;
+			/// @brief The connection is reset after this many bytes from
+			/// the server have been forwarded
+			uint64_t resetAfterBytes = 0;
+			/// @brief The connection stops forwarding after this many bytes
+			/// from the server, but stays open
+			uint64_t stallAfterBytes = 0;
+			/// @brief The probability in [0, 1] that a new connection has
+			/// the reset or stall applied. Other connections only get
+			/// the latency and bandwidth impairments
+			double faultProbability = 1.0;
+		};
+
+		/// @brief ImpairmentProxy is a TCP proxy on loopback that
+		/// forwards to an upstream server, and injects latency, jitter,
+		/// bandwidth caps, resets and stalls along the way. It runs on
+		/// its own thread
+		class ImpairmentProxy
+		{
+		public:
+			/// @brief Starts listening on a loopback port
+			/// @param upstream The server to forward to
+			/// @param impairments The initial impairments
+			/// @param port The port to listen on, or 0 for an ephemeral one
+			/// @param address The address to listen on. Any of 127.0.0.0/8
+			/// works, so several proxies can pose as replicas of one host
+			ImpairmentProxy(asio::ip::tcp::endpoint upstream,
+				Impairments impairments = {}, uint16_t port = 0,
+				asio::ip::address address = asio::ip::address_v4::loopback());
+			/// @brief Stops the proxy, closing every connection
+			~ImpairmentProxy();
+			ImpairmentProxy(const ImpairmentProxy&) = delete;
+			ImpairmentProxy& operator=(const ImpairmentProxy&) = delete;
+
+			/// @return The port the proxy listens on
+			inline uint16_t GetPort() const noexcept { return m_port; }
+			/// @return The address the proxy listens on
+			inline const asio::ip::address& GetAddress() const noexcept { return m_address; }
+			/// @param target The path and query of the request
+			/// @return The URL of the target through the proxy
+			std::string GetURL(std::string_view target = "/") const;
+
+			/// @brief Changes the impairments. Only new connections are
+			/// affected, so existing ones keep their faults
+			/// @param impairments The new impairments
+			void SetImpairments(const Impairments& impairments);
+			/// @return The current impairments
+			Impairments GetImpairments() const;
+			/// @return The number of connections that have been accepted
+			uint64_t GetConnectionCount() const noexcept;
+
+			/// @brief The state shared with the connections
+			struct State;
+		private:
+			asio::io_context m_ctx;
+			std::shared_ptr<State> m_state;
+			asio::ip::address m_address;
+			uint16_t m_port = 0;
+			std::thread m_thread;
+		};
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,351 @@
+/*
+ *	cma-load is a wrk-style HTTP load generator built on
+ *	cma::Multi. In closed-loop mode it keeps a fixed number of
+ *	requests in flight. In open-loop mode it issues requests at
+ *	a constant rate no matter how slow the server is, and measures
+ *	each latency from when the request was supposed to be sent,
+ *	so a stalled server can't hide its queueing delay (coordinated
+ *	omission).
+ *
+ *	usage: cma-load [options] <url | --requests=file>
+ *		--threads=n       threads, each with its own Multi (1)
+ *		--concurrency=n   closed loop: requests in flight (10)
+ *		--rate=n          open loop: requests per second in total
+ *		--duration=s      how long to run (10)
+ *		--requests=file   request templates, see below
+ *
+ *	each line of the templates file is a request, and the
+ *	templates are used round-robin:
+ *		METHOD URL [BODY]
+ *	indented lines below a request are its headers:
+ *		POST http://localhost:8080/api {"key":"value"}
+ *			Content-Type: application/json
+ *	lines that start with '#' are comments
+ */
+
+#include "Histogram.h"
+
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Multi.h>
+
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+	/// @brief A request to send
+	struct RequestTemplate
+	{
+		std::string method = "GET";
+		std::string url;
+		std::string body;
+		std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> headers{ nullptr, curl_slist_free_all };
+	};
+	/// @brief What each thread measured
+	struct ThreadResult
+	{
+		cma::Bench::Histogram latency;
+		uint64_t completed = 0;
+		uint64_t transportErrors = 0;
+		std::map<long, uint64_t> statusCodes;
+	};
+	/// @brief The load configuration
+	struct Config
+	{
+		size_t threads = 1;
+		size_t concurrency = 10;
+		double rate = 0.0;
+		std::chrono::seconds duration{ 10 };
+	};
+
+	/// @brief Parses the request templates file
+	/// @param path The path of the file
+	/// @param templates The output templates
+	/// @return Whether or not the file could be read
+	bool ParseTemplates(const std::string& path, std::vector<RequestTemplate>& templates)
+	{
+		std::ifstream file(path);
+		if (!file)
+			return false;
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.empty() == false && line.back() == '\r')
+				line.pop_back();
+			if (line.empty() || line.front() == '#')
+				continue;
+			if (line.front() == ' ' || line.front() == '\t')
+			{
+				if (templates.empty())
+					continue;
+				const auto start = line.find_first_not_of(" \t");
+				auto& headers = templates.back().headers;
+				auto list = curl_slist_append(headers.get(), line.c_str() + start);
+				headers.release();
+				headers.reset(list);
+				continue;
+			}
+			RequestTemplate request;
+			const auto methodEnd = line.find(' ');
+			if (methodEnd == std::string::npos)
+				return false;
+			request.method = line.substr(0, methodEnd);
+			const auto urlEnd = line.find(' ', methodEnd + 1);
+			request.url = line.substr(methodEnd + 1, urlEnd - methodEnd - 1);
+			if (urlEnd != std::string::npos)
+				request.body = line.substr(urlEnd + 1);
+			templates.push_back(std::move(request));
+		}
+		return templates.empty() == false;
+	}
+
+	/// @brief Drives one thread's share of the load through its own Multi
+	class Worker
+	{
+	public:
+		Worker(const Config& config, const std::vector<RequestTemplate>& templates,
+			size_t index) :
+			m_templates(templates), m_multi(m_ctx), m_timer(m_ctx),
+			m_templateIndex(index % templates.size())
+		{
+			// split the load evenly, giving the remainder to the first threads
+			m_concurrency = config.concurrency / config.threads +
+				((index < config.concurrency % config.threads) ? 1 : 0);
+			m_start = clock_type::now();
+			m_deadline = m_start + config.duration;
+			if (config.rate > 0.0)
+			{
+				m_interval = std::chrono::duration_cast<clock_type::duration>(
+					std::chrono::duration<double>(static_cast<double>(config.threads) / config.rate));
+				// stagger the threads so their arrivals interleave
+				m_nextArrival = m_start + m_interval * index / config.threads;
+			}
+		}
+
+		/// @brief Runs the load until the deadline
+		void Run()
+		{
+			if (m_interval.count() != 0)
+				ScheduleArrivals();
+			else
+			{
+				for (size_t i = 0; i < m_concurrency; ++i)
+					Submit(clock_type::now());
+			}
+			m_ctx.run();
+		}
+
+		/// @return What this thread measured
+		inline const ThreadResult& GetResult() const noexcept { return m_result; }
+	private:
+		/// @brief An easy handle that can be reused across requests
+		struct Slot
+		{
+			cma::Easy easy;
+		};
+
+		/// @brief Issues every request that is due, then waits for the next
+		void ScheduleArrivals()
+		{
+			const auto now = clock_type::now();
+			while (m_nextArrival <= now && m_nextArrival < m_deadline)
+			{
+				Submit(m_nextArrival);
+				m_nextArrival += m_interval;
+			}
+			if (m_nextArrival >= m_deadline)
+				return;
+			m_timer.expires_at(m_nextArrival);
+			m_timer.async_wait([this](const asio::error_code& ec)
+				{
+					if (!ec)
+						ScheduleArrivals();
+				});
+		}
+		/// @brief Sends the next templated request
+		/// @param intended When the request was supposed to be sent
+		void Submit(clock_type::time_point intended)
+		{
+			std::unique_ptr<Slot> slot;
+			if (m_freeSlots.empty() == false)
+			{
+				slot = std::move(m_freeSlots.back());
+				m_freeSlots.pop_back();
+			}
+			else
+			{
+				slot = std::make_unique<Slot>();
+				slot->easy.SetBuffer(cma::Easy::NullBuffer{});
+				slot->easy.SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+			}
+			const auto& request = m_templates[m_templateIndex];
+			m_templateIndex = (m_templateIndex + 1) % m_templates.size();
+			auto& easy = slot->easy;
+			easy.SetOption(CURLoption::CURLOPT_URL, request.url.c_str());
+			easy.SetOption(CURLoption::CURLOPT_CUSTOMREQUEST, request.method.c_str());
+			easy.SetOption(CURLoption::CURLOPT_NOBODY, request.method == "HEAD" ? 1L : 0L);
+			easy.SetOption(CURLoption::CURLOPT_HTTPHEADER, request.headers.get());
+			if (request.body.empty() == false)
+			{
+				easy.SetOption(CURLoption::CURLOPT_POSTFIELDSIZE, static_cast<long>(request.body.size()));
+				easy.SetOption(CURLoption::CURLOPT_POSTFIELDS, request.body.c_str());
+			}
+			else
+				easy.SetOption(CURLoption::CURLOPT_HTTPGET, 1L);
+			m_multi.AsyncPerform(easy, [this, slot = std::move(slot), intended]
+				(const asio::error_code& ec) mutable
+			{
+				const auto now = clock_type::now();
+				if (ec)
+					++m_result.transportErrors;
+				else
+				{
+					long status = 0;
+					slot->easy.GetInfo(CURLINFO_RESPONSE_CODE, status);
+					++m_result.statusCodes[status];
+				}
+				++m_result.completed;
+				m_result.latency.Record(static_cast<uint64_t>((now - intended).count()));
+				m_freeSlots.push_back(std::move(slot));
+				// closed loop replaces every finished request
+				if (m_interval.count() == 0 && now < m_deadline)
+					Submit(now);
+			});
+		}
+
+		const std::vector<RequestTemplate>& m_templates;
+		asio::io_context m_ctx;
+		cma::Multi m_multi;
+		asio::steady_timer m_timer;
+		size_t m_templateIndex;
+		size_t m_concurrency = 0;
+		clock_type::duration m_interval{};
+		clock_type::time_point m_start;
+		clock_type::time_point m_nextArrival;
+		clock_type::time_point m_deadline;
+		std::vector<std::unique_ptr<Slot>> m_freeSlots;
+		ThreadResult m_result;
+	};
+
+	/// @brief Prints a duration in nanoseconds with a fitting unit
+	/// @param ns The duration
+	void PrintDuration(uint64_t ns)
+	{
+		if (ns < 1000)
+			std::printf("%7llu ns", static_cast<unsigned long long>(ns));
+		else if (ns < 1000 * 1000)
+			std::printf("%7.2f us", static_cast<double>(ns) / 1e3);
+		else if (ns < 1000 * 1000 * 1000)
+			std::printf("%7.2f ms", static_cast<double>(ns) / 1e6);
+		else
+			std::printf("%7.2f s ", static_cast<double>(ns) / 1e9);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Config config;
+	std::string templatesPath;
+	std::string url;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string_view arg = argv[i];
+		const auto value = arg.substr(arg.find('=') + 1);
+		size_t number = 0;
+		const bool isNumber = std::from_chars(value.data(),
+			value.data() + value.size(), number).ec == std::errc();
+		if (arg.starts_with("--threads=") && isNumber && number != 0)
+			config.threads = number;
+		else if (arg.starts_with("--concurrency=") && isNumber && number != 0)
+			config.concurrency = number;
+		else if (arg.starts_with("--rate="))
+			config.rate = std::strtod(std::string(value).c_str(), nullptr);
+		else if (arg.starts_with("--duration=") && isNumber)
+			config.duration = std::chrono::seconds(number);
+		else if (arg.starts_with("--requests="))
+			templatesPath = value;
+		else if (arg.starts_with("--") == false && url.empty())
+			url = arg;
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--threads=n] [--concurrency=n] [--rate=n] "
+				"[--duration=s] <url | --requests=file>\n", argv[0]);
+			return 1;
+		}
+	}
+	std::vector<RequestTemplate> templates;
+	if (templatesPath.empty() == false)
+	{
+		if (ParseTemplates(templatesPath, templates) == false)
+		{
+			std::fprintf(stderr, "Failed to read request templates from %s\n", templatesPath.c_str());
+			return 1;
+		}
+	}
+	else if (url.empty() == false)
+		templates.emplace_back().url = url;
+	else
+	{
+		std::fprintf(stderr, "No URL or request templates given\n");
+		return 1;
+	}
+	config.threads = std::min(config.threads, (config.rate > 0.0) ?
+		config.threads : config.concurrency);
+
+	curl_global_init(CURL_GLOBAL_ALL);
+	if (config.rate > 0.0)
+		std::printf("Open loop at %.0f req/s for %llds on %zu thread(s)\n", config.rate,
+			static_cast<long long>(config.duration.count()), config.threads);
+	else
+		std::printf("Closed loop with %zu connection(s) for %llds on %zu thread(s)\n",
+			config.concurrency, static_cast<long long>(config.duration.count()), config.threads);
+	std::vector<std::unique_ptr<Worker>> workers;
+	for (size_t i = 0; i < config.threads; ++i)
+		workers.push_back(std::make_unique<Worker>(config, templates, i));
+	const auto start = clock_type::now();
+	std::vector<std::thread> threads;
+	for (auto& worker : workers)
+		threads.emplace_back([&worker] { worker->Run(); });
+	for (auto& thread : threads)
+		thread.join();
+	const auto elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+
+	ThreadResult total;
+	for (const auto& worker : workers)
+	{
+		const auto& result = worker->GetResult();
+		total.latency.Merge(result.latency);
+		total.completed += result.completed;
+		total.transportErrors += result.transportErrors;
+		for (const auto& [status, count] : result.statusCodes)
+			total.statusCodes[status] += count;
+	}
+	std::printf("\n  Latency     mean ");
+	PrintDuration(static_cast<uint64_t>(total.latency.Mean()));
+	std::printf("   max ");
+	PrintDuration(total.latency.Max());
+	std::printf("\n  Latency Distribution\n");
+	for (const double percentile : { 50.0, 75.0, 90.0, 99.0, 99.9, 99.99 })
+	{
+		std::printf("  %7.3f%% ", percentile);
+		PrintDuration(total.latency.Percentile(percentile));
+		std::printf("\n");
+	}
+	std::printf("\n  %llu requests in %.2fs\n", static_cast<unsigned long long>(total.completed), elapsed);
+	std::printf("  Requests/sec: %.2f\n", static_cast<double>(total.completed) / elapsed);
+	for (const auto& [status, count] : total.statusCodes)
+		std::printf("  HTTP %ld: %llu\n", status, static_cast<unsigned long long>(count));
+	if (total.transportErrors != 0)
+		std::printf("  Transport errors: %llu\n", static_cast<unsigned long long>(total.transportErrors));
+	curl_global_cleanup();
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,601 @@
+#include "LocalServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef CMA_DECODE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef CMA_DECODE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+using cma::Bench::LocalServer;
+
+namespace
+{
+	/// @brief Finds a query parameter in a request target
+	/// @param target The request target
+	/// @param key The parameter key, including the '='
+	/// @return The value, or an empty view if the key is missing
+	std::string_view QueryValue(std::string_view target, std::string_view key) noexcept
+	{
+		const auto queryPos = target.find('?');
+		if (queryPos == std::string_view::npos)
+			return {};
+		auto query = target.substr(queryPos + 1);
+		while (query.empty() == false)
+		{
+			const auto ampPos = query.find('&');
+			const auto param = query.substr(0, ampPos);
+			if (param.starts_with(key))
+				return param.substr(key.size());
+			if (ampPos == std::string_view::npos)
+				break;
+			query.remove_prefix(ampPos + 1);
+		}
+		return {};
+	}
+	/// @brief Finds a numeric query parameter in a request target
+	/// @param target The request target
+	/// @param key The parameter key, including the '='
+	/// @param out The output value. Left untouched if the key is missing
+	void ParseQuery(std::string_view target, std::string_view key, size_t& out) noexcept
+	{
+		const auto value = QueryValue(target, key);
+		std::from_chars(value.data(), value.data() + value.size(), out);
+	}
+	/// @brief Finds a header value in a request head, case-insensitively
+	/// @param head The request head
+	/// @param name The header name, including the ':'
+	/// @return The trimmed value, or an empty view
+	std::string_view FindHeader(std::string_view head, std::string_view name) noexcept
+	{
+		size_t lineStart = head.find("\r\n");
+		while (lineStart != std::string_view::npos && lineStart + 2 < head.size())
+		{
+			lineStart += 2;
+			const auto lineEnd = head.find("\r\n", lineStart);
+			const auto line = head.substr(lineStart, lineEnd - lineStart);
+			if (line.size() >= name.size() && std::equal(name.begin(), name.end(),
+				line.begin(), [](char a, char b) { return std::tolower(a) == std::tolower(b); }))
+			{
+				auto value = line.substr(name.size());
+				while (value.empty() == false && value.front() == ' ')
+					value.remove_prefix(1);
+				return value;
+			}
+			lineStart = lineEnd;
+		}
+		return {};
+	}
+	/// @param size The size of the text
+	/// @return Random words, which compress about as well as text does
+	std::string MakeText(size_t size)
+	{
+		std::string text(size, ' ');
+		uint32_t seed = 1;
+		for (auto& c : text)
+		{
+			seed = seed * 1103515245 + 12345;
+			if (const uint32_t letter = (seed >> 16) % 32; letter < 26)
+				c = static_cast<char>('a' + letter);
+		}
+		return text;
+	}
+#ifdef CMA_DECODE_ZLIB
+	/// @brief Compresses a body with zlib
+	/// @param body The body
+	/// @param windowBits 15 for the zlib wrapper, 15 + 16 for gzip, or
+	/// -15 for raw deflate
+	/// @return The compressed body
+	std::string Deflate(std::string_view body, int windowBits)
+	{
+		z_stream stream{};
+		deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY);
+		std::string out(deflateBound(&stream, static_cast<uLong>(body.size())), '\0');
+		stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+		stream.avail_in = static_cast<uInt>(body.size());
+		stream.next_out = reinterpret_cast<Bytef*>(out.data());
+		stream.avail_out = static_cast<uInt>(out.size());
+		deflate(&stream, Z_FINISH);
+		out.resize(stream.total_out);
+		deflateEnd(&stream);
+		return out;
+	}
+#endif
+	/// @brief Encodes a body the way a request asked for
+	/// @param body The body
+	/// @param name identity, gzip, gzip2 for two gzip members, deflate,
+	/// rawdeflate for deflate without its zlib wrapper, br, corrupt for
+	/// gzip that doesn't inflate, or compress, which is sent as is
+	/// @param encoding The Content-Encoding, left empty if the body isn't
+	/// encoded or the codec wasn't built in
+	/// @return The encoded body
+	std::string Encode(std::string body, std::string_view name, std::string& encoding)
+	{
+		encoding.clear();
+		if (name == "compress")
+			encoding = name;
+#ifdef CMA_DECODE_ZLIB
+		else if (name == "gzip" || name == "corrupt")
+		{
+			encoding = "gzip";
+			body = Deflate(body, 15 + 16);
+			// past the gzip header, so only inflating notices
+			for (size_t i = 10; name == "corrupt" && i + 8 < body.size(); i += 7)
+				body[i] ^= 0x55;
+		}
+		else if (name == "gzip2")
+		{
+			encoding = "gzip";
+			const size_t half = body.size() / 2;
+			body = Deflate(std::string_view(body).substr(0, half), 15 + 16) +
+				Deflate(std::string_view(body).substr(half), 15 + 16);
+		}
+		else if (name == "deflate" || name == "rawdeflate")
+		{
+			encoding = "deflate";
+			body = Deflate(body, (name == "deflate") ? 15 : -15);
+		}
+#endif
+#ifdef CMA_DECODE_BROTLI
+		else if (name == "br")
+		{
+			encoding = name;
+			std::string out(BrotliEncoderMaxCompressedSize(body.size()), '\0');
+			size_t size = out.size();
+			BrotliEncoderCompress(5, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, body.size(),
+				reinterpret_cast<const uint8_t*>(body.data()), &size, reinterpret_cast<uint8_t*>(out.data()));
+			out.resize(size);
+			body = std::move(out);
+		}
+#endif
+		return body;
+	}
+	/// @brief Computes the Sec-WebSocket-Accept of a handshake, which is
+	/// the base64 of the SHA-1 of the key and a fixed GUID
+	/// @param key The Sec-WebSocket-Key
+	/// @return The Sec-WebSocket-Accept
+	std::string WebSocketAccept(std::string_view key)
+	{
+		std::string message(key);
+		message += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+		// pad to a whole number of 64 byte blocks, ending in the bit length
+		const uint64_t bits = message.size() * 8;
+		message += static_cast<char>(0x80);
+		while (message.size() % 64 != 56)
+			message += '\0';
+		for (int shift = 56; shift >= 0; shift -= 8)
+			message += static_cast<char>(bits >> shift);
+		uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+		const auto rotl = [](uint32_t value, int bits) { return (value << bits) | (value >> (32 - bits)); };
+		for (size_t block = 0; block < message.size(); block += 64)
+		{
+			uint32_t w[80];
+			for (size_t i = 0; i < 16; ++i)
+			{
+				const auto* bytes = reinterpret_cast<const unsigned char*>(message.data() + block + i * 4);
+				w[i] = (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) |
+					(uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+			}
+			for (size_t i = 16; i < 80; ++i)
+				w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+			uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+			for (size_t i = 0; i < 80; ++i)
+			{
+				uint32_t f = 0, k = 0;
+				if (i < 20)
+					f = (b & c) | (~b & d), k = 0x5A827999;
+				else if (i < 40)
+					f = b ^ c ^ d, k = 0x6ED9EBA1;
+				else if (i < 60)
+					f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+				else
+					f = b ^ c ^ d, k = 0xCA62C1D6;
+				const uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+				e = d;
+				d = c;
+				c = rotl(b, 30);
+				b = a;
+				a = temp;
+			}
+			h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e;
+		}
+		unsigned char digest[20];
+		for (size_t i = 0; i < 20; ++i)
+			digest[i] = static_cast<unsigned char>(h[i / 4] >> (24 - (i % 4) * 8));
+		constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		std::string accept;
+		for (size_t i = 0; i < sizeof(digest); i += 3)
+		{
+			const uint32_t triple = (uint32_t(digest[i]) << 16) | (uint32_t(digest[i + 1]) << 8) |
+				((i + 2 < sizeof(digest)) ? digest[i + 2] : 0);
+			accept += alphabet[(triple >> 18) & 63];
+			accept += alphabet[(triple >> 12) & 63];
+			accept += alphabet[(triple >> 6) & 63];
+			accept += (i + 2 < sizeof(digest)) ? alphabet[triple & 63] : '=';
+		}
+		return accept;
+	}
+}
+
+/// @brief The state shared between the server and its sessions, which
+/// may outlive the server object until their handlers are destroyed
+struct LocalServer::State
+{
+	static constexpr size_t s_chunkSize = 64 * 1024;
+
+	State(asio::io_context& ctx, const LocalServerOptions& options) :
+		options(options), chunk(s_chunkSize, 'x'), tcpAcceptor(ctx)
+#ifdef CMA_BENCH_HAS_UDS
+		, unixAcceptor(ctx)
+#endif
+	{}
+
+	LocalServerOptions options;
+	std::string chunk;
+	std::atomic<uint64_t> requests = 0;
+	asio::ip::tcp::acceptor tcpAcceptor;
+#ifdef CMA_BENCH_HAS_UDS
+	asio::local::stream_protocol::acceptor unixAcceptor;
+#endif
+};
+
+namespace
+{
+	/// @brief A single keep-alive connection
+	/// @tparam Socket The socket type
+	template<typename Socket>
+	class Session : public std::enable_shared_from_this<Session<Socket>>
+	{
+	public:
+		Session(Socket socket, std::shared_ptr<LocalServer::State> state) :
+			m_socket(std::move(socket)), m_timer(m_socket.get_executor()),
+			m_state(std::move(state)) {}
+
+		void Start() { DoRead(); }
+	private:
+		void DoRead()
+		{
+			asio::async_read_until(m_socket, asio::dynamic_buffer(m_buffer), "\r\n\r\n",
+				[self = this->shared_from_this()](const asio::error_code& ec, size_t headLen)
+			{
+				if (ec)
+					return;
+				self->OnHead(headLen);
+			});
+		}
+		void OnHead(size_t headLen)
+		{
+			const std::string_view head(m_buffer.data(), headLen);
+			const auto target = head.substr(head.find(' ') + 1,
+				head.find(' ', head.find(' ') + 1) - head.find(' ') - 1);
+			// a WebSocket upgrade turns the connection into an echo
+			if (const auto key = FindHeader(head, "sec-websocket-key:"); key.empty() == false)
+				return OnUpgrade(key, headLen);
+			// an event stream, which resumes after the Last-Event-ID
+			size_t events = 0;
+			ParseQuery(target, "events=", events);
+			if (events != 0)
+				return OnEvents(head, target, events);
+			m_bodySize = m_state->options.bodySize;
+			size_t delay = static_cast<size_t>(m_state->options.delay.count());
+			ParseQuery(target, "size=", m_bodySize);
+			ParseQuery(target, "delay=", delay);
+			// caching headers, for the response cache
+			m_maxAge = SIZE_MAX;
+			m_etag = 0;
+			ParseQuery(target, "maxage=", m_maxAge);
+			ParseQuery(target, "etag=", m_etag);
+			// redirects, for the redirect cache
+			m_redirect = 0;
+			ParseQuery(target, "redirect=", m_redirect);
+			if (m_redirect != 0)
+			{
+				const auto paramPos = target.find("redirect=");
+				const auto paramEnd = target.find('&', paramPos);
+				m_location = std::string(target.substr(0, paramPos)) + std::string((paramEnd ==
+					std::string_view::npos) ? std::string_view{} : target.substr(paramEnd + 1));
+			}
+			// encoded bodies, for the decoding sink
+			const auto encoding = QueryValue(target, "encoding=");
+			m_encoded.clear();
+			m_encoding.clear();
+			if (encoding.empty() == false)
+				m_encoded = Encode(MakeText(m_bodySize), encoding, m_encoding);
+			m_notModified = m_etag != 0 &&
+				FindHeader(head, "if-none-match:") == '"' + std::to_string(m_etag) + '"';
+			m_keepAlive = FindHeader(head, "connection:") != "close";
+			// skip over any request body
+			size_t contentLength = 0;
+			const auto lengthStr = FindHeader(head, "content-length:");
+			std::from_chars(lengthStr.data(), lengthStr.data() + lengthStr.size(), contentLength);
+			const size_t total = headLen + contentLength;
+			auto respond = [self = this->shared_from_this(), total, delay]
+			{
+				self->m_buffer.erase(0, total);
+				if (delay == 0)
+					return self->DoWrite();
+				self->m_timer.expires_after(std::chrono::milliseconds(delay));
+				self->m_timer.async_wait([self](const asio::error_code& ec)
+					{
+						if (!ec)
+							self->DoWrite();
+					});
+			};
+			if (m_buffer.size() >= total)
+				return respond();
+			asio::async_read(m_socket, asio::dynamic_buffer(m_buffer),
+				asio::transfer_exactly(total - m_buffer.size()),
+				[respond](const asio::error_code& ec, size_t)
+				{
+					if (!ec)
+						respond();
+				});
+		}
+		void DoWrite()
+		{
+			char extra[192] = "";
+			if (m_maxAge != SIZE_MAX)
+				std::snprintf(extra, sizeof(extra), "Cache-Control: max-age=%zu\r\n", m_maxAge);
+			if (m_etag != 0)
+				std::snprintf(extra + std::strlen(extra), sizeof(extra) - std::strlen(extra),
+					"ETag: \"%zu\"\r\n", m_etag);
+			if (m_encoding.empty() == false)
+				std::snprintf(extra + std::strlen(extra), sizeof(extra) - std::strlen(extra),
+					"Content-Encoding: %.16s\r\n", m_encoding.c_str());
+			const bool encoded = m_encoded.empty() == false;
+			const size_t bodySize = (m_notModified || m_redirect != 0) ? 0 :
+				(encoded ? m_encoded.size() : m_bodySize);
+			char status[32] = "200 OK";
+			if (m_notModified == true)
+				std::snprintf(status, sizeof(status), "304 Not Modified");
+			else if (m_redirect != 0)
+			{
+				std::snprintf(status, sizeof(status), "%zu Redirect", m_redirect);
+				std::snprintf(extra + std::strlen(extra), sizeof(extra) - std::strlen(extra),
+					"Location: %.64s\r\n", m_location.c_str());
+			}
+			char header[256];
+			m_header.assign(header, std::snprintf(header, sizeof(header),
+				"HTTP/1.1 %s\r\nContent-Length: %zu\r\n"
+				"Content-Type: application/octet-stream\r\n%s%s\r\n",
+				status, bodySize, extra, m_keepAlive ? "" : "Connection: close\r\n"));
+			m_buffers.clear();
+			m_buffers.emplace_back(asio::buffer(m_header));
+			if (encoded == true && bodySize != 0)
+				m_buffers.emplace_back(asio::buffer(m_encoded));
+			for (size_t remaining = encoded ? 0 : bodySize; remaining != 0;)
+			{
+				const size_t len = std::min(remaining, m_state->chunk.size());
+				m_buffers.emplace_back(asio::buffer(m_state->chunk.data(), len));
+				remaining -= len;
+			}
+			asio::async_write(m_socket, m_buffers,
+				[self = this->shared_from_this()](const asio::error_code& ec, size_t)
+			{
+				if (ec)
+					return;
+				++self->m_state->requests;
+				if (self->m_keepAlive == false)
+				{
+					asio::error_code ignored;
+					self->m_socket.shutdown(asio::socket_base::shutdown_both, ignored);
+					return;
+				}
+				// there may already be a pipelined request buffered
+				if (self->m_buffer.find("\r\n\r\n") != std::string::npos)
+					return self->OnHead(self->m_buffer.find("\r\n\r\n") + 4);
+				self->DoRead();
+			});
+		}
+
+		void OnEvents(std::string_view head, std::string_view target, size_t events)
+		{
+			size_t total = SIZE_MAX;
+			size_t lastId = 0;
+			ParseQuery(target, "total=", total);
+			const auto lastIdStr = FindHeader(head, "last-event-id:");
+			std::from_chars(lastIdStr.data(), lastIdStr.data() + lastIdStr.size(), lastId);
+			if (lastId >= total)
+				m_header = "HTTP/1.1 204 No Content\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+			else
+			{
+				// a short retry, a comment, and events that mix line endings
+				// and multi-line data
+				m_header = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+					"Cache-Control: no-cache\r\nConnection: close\r\n\r\nretry: 20\n: stream\n\n";
+				for (size_t id = lastId + 1; id <= std::min(lastId + events, total); ++id)
+				{
+					const auto idStr = std::to_string(id);
+					if (id % 2 == 0)
+						m_header += "event: tick\r\ndata: " + idStr + "\r\ndata: even\r\nid: " + idStr + "\r\n\r\n";
+					else
+						m_header += "id: " + idStr + "\ndata: " + idStr + "\n\n";
+				}
+			}
+			asio::async_write(m_socket, asio::buffer(m_header),
+				[self = this->shared_from_this()](const asio::error_code& ec, size_t)
+			{
+				if (ec)
+					return;
+				++self->m_state->requests;
+				asio::error_code ignored;
+				self->m_socket.shutdown(asio::socket_base::shutdown_both, ignored);
+			});
+		}
+		void OnUpgrade(std::string_view key, size_t headLen)
+		{
+			m_header = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+				"Connection: Upgrade\r\nSec-WebSocket-Accept: " + WebSocketAccept(key) + "\r\n\r\n";
+			m_buffer.erase(0, headLen);
+			asio::async_write(m_socket, asio::buffer(m_header),
+				[self = this->shared_from_this()](const asio::error_code& ec, size_t)
+			{
+				if (!ec)
+					self->DoEcho();
+			});
+		}
+		void DoEcho()
+		{
+			// echo each frame once all of it is buffered
+			const auto* data = reinterpret_cast<const unsigned char*>(m_buffer.data());
+			const size_t size = m_buffer.size();
+			uint64_t length = (size >= 2) ? (data[1] & 0x7F) : 0;
+			size_t pos = 2;
+			if (length == 126)
+			{
+				length = (size >= 4) ? (uint64_t(data[2]) << 8) | data[3] : 0;
+				pos = 4;
+			}
+			else if (length == 127)
+			{
+				length = 0;
+				for (size_t i = 0; i < 8 && size >= 10; ++i)
+					length = (length << 8) | data[2 + i];
+				pos = 10;
+			}
+			const bool masked = size >= 2 && (data[1] & 0x80) != 0;
+			if (size < 2 || size < pos + (masked ? 4 : 0) + length)
+			{
+				asio::async_read(m_socket, asio::dynamic_buffer(m_buffer), asio::transfer_at_least(1),
+					[self = this->shared_from_this()](const asio::error_code& ec, size_t)
+				{
+					if (!ec)
+						self->DoEcho();
+				});
+				return;
+			}
+			const bool close = (data[0] & 0x0F) == 0x8;
+			// server frames are sent unmasked, with the same opcode
+			m_header.assign(1, static_cast<char>(data[0]));
+			if (length < 126)
+				m_header += static_cast<char>(length);
+			else if (length < 65536)
+			{
+				m_header += static_cast<char>(126);
+				m_header += static_cast<char>(length >> 8);
+				m_header += static_cast<char>(length);
+			}
+			else
+			{
+				m_header += static_cast<char>(127);
+				for (int shift = 56; shift >= 0; shift -= 8)
+					m_header += static_cast<char>(length >> shift);
+			}
+			const unsigned char* mask = data + pos;
+			pos += masked ? 4 : 0;
+			const size_t start = m_header.size();
+			m_header.append(m_buffer, pos, length);
+			for (size_t i = 0; masked == true && i < length; ++i)
+				m_header[start + i] ^= mask[i % 4];
+			m_buffer.erase(0, pos + length);
+			asio::async_write(m_socket, asio::buffer(m_header),
+				[self = this->shared_from_this(), close](const asio::error_code& ec, size_t)
+			{
+				if (ec)
+					return;
+				++self->m_state->requests;
+				if (close == false)
+					return self->DoEcho();
+				asio::error_code ignored;
+				self->m_socket.shutdown(asio::socket_base::shutdown_both, ignored);
+			});
+		}
+
+		Socket m_socket;
+		asio::steady_timer m_timer;
+		std::shared_ptr<LocalServer::State> m_state;
+		std::string m_buffer;
+		std::string m_header;
+		std::vector<asio::const_buffer> m_buffers;
+		size_t m_bodySize = 0;
+		size_t m_maxAge = SIZE_MAX;
+		size_t m_etag = 0;
+		size_t m_redirect = 0;
+		std::string m_location;
+		std::string m_encoded;
+		std::string m_encoding;
+		bool m_notModified = false;
+		bool m_keepAlive = true;
+	};
+
+	/// @brief Accepts connections forever
+	/// @tparam Acceptor The acceptor type
+	template<typename Acceptor>
+	void DoAccept(Acceptor& acceptor, std::shared_ptr<LocalServer::State> state)
+	{
+		acceptor.async_accept([&acceptor, state](const asio::error_code& ec, auto socket)
+			{
+				if (ec == asio::error::operation_aborted)
+					return;
+				if (!ec)
+				{
+					if constexpr (std::is_same_v<decltype(socket), asio::ip::tcp::socket>)
+						socket.set_option(asio::ip::tcp::no_delay(true));
+					std::make_shared<Session<decltype(socket)>>(
+						std::move(socket), state)->Start();
+				}
+				DoAccept(acceptor, state);
+			});
+	}
+}
+
+LocalServer::LocalServer(LocalServerOptions options) :
+	m_options(std::move(options)),
+	m_state(std::make_shared<State>(m_ctx, m_options))
+{
+	const asio::ip::tcp::endpoint endpoint(asio::ip::address_v4::loopback(), 0);
+	m_state->tcpAcceptor.open(endpoint.protocol());
+	m_state->tcpAcceptor.set_option(asio::socket_base::reuse_address(true));
+	m_state->tcpAcceptor.bind(endpoint);
+	m_state->tcpAcceptor.listen();
+	m_port = m_state->tcpAcceptor.local_endpoint().port();
+	DoAccept(m_state->tcpAcceptor, m_state);
+#ifdef CMA_BENCH_HAS_UDS
+	if (m_options.unixPath.empty() == false)
+	{
+		std::remove(m_options.unixPath.c_str());
+		const asio::local::stream_protocol::endpoint unixEndpoint(m_options.unixPath);
+		m_state->unixAcceptor.open(unixEndpoint.protocol());
+		m_state->unixAcceptor.bind(unixEndpoint);
+		m_state->unixAcceptor.listen();
+		DoAccept(m_state->unixAcceptor, m_state);
+	}
+#else
+	m_options.unixPath.clear();
+#endif
+	for (size_t i = 0; i < std::max<size_t>(m_options.threads, 1); ++i)
+		m_threads.emplace_back([this] { m_ctx.run(); });
+}
+
+LocalServer::~LocalServer()
+{
+	m_ctx.stop();
+	for (auto& thread : m_threads)
+		thread.join();
+	asio::error_code ignored;
+	m_state->tcpAcceptor.close(ignored);
+#ifdef CMA_BENCH_HAS_UDS
+	m_state->unixAcceptor.close(ignored);
+	if (m_options.unixPath.empty() == false)
+		std::remove(m_options.unixPath.c_str());
+#endif
+}
+
+std::string LocalServer::GetURL(std::string_view target) const
+{
+	return "http://127.0.0.1:" + std::to_string(m_port) + std::string(target);
+}
+
+uint64_t LocalServer::GetRequestCount() const noexcept
+{
+	return m_state->requests.load();
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef CURLMULTIASIO_BENCHMARKS_LOCALSERVER_H_
+#define CURLMULTIASIO_BENCHMARKS_LOCALSERVER_H_
+
+/// @file
+/// Local HTTP/1.1 stand-in server
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+
+// STL includes
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS) || defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+#define CMA_BENCH_HAS_UDS 1
+#endif
+
+namespace cma
+{
+	namespace Bench
+	{
+		/// @brief The default behavior of the local server. Each request
+		/// can override the body size and delay with the query parameters
+		/// size=<bytes> and delay=<milliseconds>, and ask for caching
+		/// headers with maxage=<seconds> and etag=<number>. A request whose
+		/// If-None-Match matches its etag gets a 304. redirect=<status>
+		/// answers with that status, and a Location of the same target
+		/// without the redirect parameter. A WebSocket handshake turns the
+		/// connection into one that echoes every frame back. events=<count>
+		/// answers with an event stream of that many events, numbered from
+		/// after the Last-Event-ID, and then closes the connection. Once
+		/// total=<count> events have been sent, it answers 204 instead.
+		/// encoding=<name> answers with a body of random words encoded with
+		/// identity, gzip, gzip2 for two gzip members, deflate, rawdeflate
+		/// for deflate without its zlib wrapper, br, corrupt for gzip that
+		/// doesn't inflate, or compress, which is labelled but not encoded.
+		/// The codecs come from CMA_DECODE_ZLIB and CMA_DECODE_BROTLI, and
+		/// one that wasn't built in sends the words unencoded
+		struct LocalServerOptions
+		{
+			/// @brief The size of each response body
+			size_t bodySize = 1024;
+			/// @brief How long to wait before sending each response
+			std::chrono::milliseconds delay{ 0 };
+			/// @brief The path of the unix domain socket to listen on
+			/// as well as loopback. Empty to only listen on loopback
+			std::string unixPath;
+			/// @brief The number of threads serving requests
+			size_t threads = 1;
+		};
+
+		/// @brief LocalServer is a minimal keep-alive HTTP/1.1 server
+		/// that runs on its own threads. It answers every request with
+		/// a body of the configured size, so it measures the client and
+		/// not the server
+		class LocalServer
+		{
+		public:
+			/// @brief Starts listening on an ephemeral loopback port, and
+			/// the unix domain socket if there is one
+			/// @param options The server options
+			explicit LocalServer(LocalServerOptions options = {});
+			/// @brief Stops the server and joins its threads
+			~LocalServer();
+			LocalServer(const LocalServer&) = delete;
+			LocalServer& operator=(const LocalServer&) = delete;
+
+			/// @return The loopback port
+			inline uint16_t GetPort() const noexcept { return m_port; }
+			/// @return The unix domain socket path, or an empty string
+			inline const std::string& GetUnixPath() const noexcept { return m_options.unixPath; }
+			/// @param target The path and query of the request
+			/// @return The loopback URL of the target
+			std::string GetURL(std::string_view target = "/") const;
+			/// @return The number of requests that have been answered
+			uint64_t GetRequestCount() const noexcept;
+
+			/// @brief The state shared with the connections, which
+			/// may briefly outlive the server
+			struct State;
+		private:
+			LocalServerOptions m_options;
+			asio::io_context m_ctx;
+			std::shared_ptr<State> m_state;
+			uint16_t m_port = 0;
+			std::vector<std::thread> m_threads;
+		};
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,100 @@
+/*
+ *	cma-policy-bench measures what each of BasicMulti's threading
+ *	policies costs per event. It drives the same two paths that a
+ *	multi handle uses, a socket readiness wait and a posted handler,
+ *	with the handlers wrapped by each policy, on a single thread
+ *
+ *	usage: cma-policy-bench [--events=n]
+ */
+
+#include "CpuTime.h"
+
+#include <curl-multi-asio/ThreadingPolicy.h>
+
+#include <charconv>
+#include <cstdio>
+#include <functional>
+#include <string_view>
+
+namespace
+{
+	/// @brief Re-arms a readiness wait on a socket that stays readable,
+	/// so every iteration is one trip through the reactor
+	/// @tparam ThreadingPolicy The threading policy
+	/// @param events The number of events
+	/// @return The CPU time per event
+	template<typename ThreadingPolicy>
+	double RunSocketWaits(uint64_t events)
+	{
+		asio::io_context ctx;
+		const auto serializer = ThreadingPolicy::MakeSerializer(ctx.get_executor());
+		asio::ip::tcp::acceptor acceptor(ctx, { asio::ip::address_v4::loopback(), 0 });
+		asio::ip::tcp::socket reader(ctx);
+		asio::ip::tcp::socket writer(ctx);
+		reader.connect(acceptor.local_endpoint());
+		acceptor.accept(writer);
+		const char byte = 0;
+		asio::write(writer, asio::buffer(&byte, 1));
+		uint64_t remaining = events;
+		std::function<void(const asio::error_code&)> wait = [&](const asio::error_code& ec)
+		{
+			if (ec || --remaining == 0)
+				return;
+			reader.async_wait(asio::socket_base::wait_read,
+				ThreadingPolicy::Wrap(serializer, std::ref(wait)));
+		};
+		reader.async_wait(asio::socket_base::wait_read,
+			ThreadingPolicy::Wrap(serializer, std::ref(wait)));
+		const auto cpuStart = cma::Bench::ThreadCpuTime();
+		ctx.run();
+		const auto cpu = cma::Bench::ThreadCpuTime() - cpuStart;
+		return static_cast<double>(cpu.count()) / static_cast<double>(events);
+	}
+	/// @brief Posts a chain of handlers, like a submission waking the
+	/// multi handle
+	/// @tparam ThreadingPolicy The threading policy
+	/// @param events The number of events
+	/// @return The CPU time per event
+	template<typename ThreadingPolicy>
+	double RunPosts(uint64_t events)
+	{
+		asio::io_context ctx;
+		const auto serializer = ThreadingPolicy::MakeSerializer(ctx.get_executor());
+		uint64_t remaining = events;
+		std::function<void()> post = [&]
+		{
+			if (--remaining == 0)
+				return;
+			asio::post(ctx, ThreadingPolicy::Wrap(serializer, std::ref(post)));
+		};
+		asio::post(ctx, ThreadingPolicy::Wrap(serializer, std::ref(post)));
+		const auto cpuStart = cma::Bench::ThreadCpuTime();
+		ctx.run();
+		const auto cpu = cma::Bench::ThreadCpuTime() - cpuStart;
+		return static_cast<double>(cpu.count()) / static_cast<double>(events);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t events = 1000000;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string_view arg = argv[i];
+		if (arg.starts_with("--events="))
+			std::from_chars(arg.data() + 9, arg.data() + arg.size(), events);
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--events=n]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (events == 0)
+		events = 1;
+	std::printf("%-16s %14s %14s\n", "policy", "wait(ns/ev)", "post(ns/ev)");
+	std::printf("%-16s %14.1f %14.1f\n", "ThreadSafe",
+		RunSocketWaits<cma::ThreadSafe>(events), RunPosts<cma::ThreadSafe>(events));
+	std::printf("%-16s %14.1f %14.1f\n", "SingleThreaded",
+		RunSocketWaits<cma::SingleThreaded>(events), RunPosts<cma::SingleThreaded>(events));
+	return 0;
+}
\ No newline at end of file
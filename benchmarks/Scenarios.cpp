@@ -0,0 +1,1305 @@
+/*
+ *	cma-scenarios puts the impairment proxy between a Multi and
+ *	the local server, and checks how Multi's timer and socket
+ *	handling cope with slow time to first byte, trickling bodies,
+ *	resets and stalls, and how quickly a Multi that has seen those
+ *	faults recovers once the network is healthy again. It exits
+ *	with a failure if any scenario misbehaves
+ *
+ *	usage: cma-scenarios [scenario...]
+ */
+
+#include "Histogram.h"
+#include "ImpairmentProxy.h"
+#include "LocalServer.h"
+
+#include <curl-multi-asio/CircuitBreaker.h>
+#include <curl-multi-asio/DecodingSink.h>
+#include <curl-multi-asio/DnsCache.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/EndpointSelector.h>
+#include <curl-multi-asio/EventSource.h>
+#include <curl-multi-asio/JsonTokenizer.h>
+#include <curl-multi-asio/MemoryBudget.h>
+#include <curl-multi-asio/Multi.h>
+#include <curl-multi-asio/NdjsonSplitter.h>
+#include <curl-multi-asio/RedirectCache.h>
+#include <curl-multi-asio/ResponseCache.h>
+#include <curl-multi-asio/Share.h>
+#include <curl-multi-asio/SingleFlight.h>
+#include <curl-multi-asio/TransferGroup.h>
+#include <curl-multi-asio/WebSocket.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+	/// @brief The outcome of a single transfer
+	struct Outcome
+	{
+		asio::error_code ec;
+		clock_type::duration elapsed;
+	};
+
+	/// @brief Everything a scenario needs. The same Multi is used by
+	/// every scenario, so faults can leave state behind for the next
+	class Harness
+	{
+	public:
+		Harness() :
+			m_proxy(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), m_server.GetPort())),
+			m_multi(m_ctx) {}
+
+		/// @return The server behind the proxy
+		inline cma::Bench::LocalServer& GetServer() noexcept { return m_server; }
+		/// @return The proxy
+		inline cma::Bench::ImpairmentProxy& GetProxy() noexcept { return m_proxy; }
+		/// @return The multi handle
+		inline cma::Multi& GetMulti() noexcept { return m_multi; }
+		/// @return The context the multi handle runs on
+		inline asio::io_context& GetContext() noexcept { return m_ctx; }
+		/// @brief Runs the multi handle until a condition holds
+		/// @param done The condition
+		/// @param timeout The longest to wait
+		void RunUntil(const std::function<bool()>& done, clock_type::duration timeout)
+		{
+			const auto deadline = clock_type::now() + timeout;
+			m_ctx.restart();
+			while (done() == false && clock_type::now() < deadline)
+				m_ctx.run_one_for(10ms);
+		}
+
+		/// @brief Runs transfers concurrently through the proxy on a
+		/// fresh connection each, and waits for all of them
+		/// @param count The number of transfers
+		/// @param bodySize The size of each response body
+		/// @param configure Sets any extra options on each easy handle
+		/// @return The outcome of each transfer
+		std::vector<Outcome> Run(size_t count, size_t bodySize,
+			const std::function<void(cma::Easy&)>& configure = {})
+		{
+			const auto url = m_proxy.GetURL("/?size=" + std::to_string(bodySize));
+			std::vector<cma::Easy> easies(count);
+			std::vector<Outcome> outcomes(count);
+			size_t remaining = count;
+			const auto start = clock_type::now();
+			for (size_t i = 0; i < count; ++i)
+			{
+				auto& easy = easies[i];
+				easy.SetURL(url.c_str());
+				easy.SetBuffer(cma::Easy::NullBuffer{});
+				easy.SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+				// impairments only apply to new connections
+				easy.SetOption(CURLoption::CURLOPT_FRESH_CONNECT, 1L);
+				if (configure)
+					configure(easy);
+				m_multi.AsyncPerform(easy, [&, i](const asio::error_code& ec)
+					{
+						outcomes[i] = { ec, clock_type::now() - start };
+						--remaining;
+					});
+			}
+			// the multi's timer may still be armed after the last
+			// transfer, so only run until they are all done
+			m_ctx.restart();
+			while (remaining != 0 && m_ctx.run_one_for(10s) != 0);
+			if (remaining != 0)
+			{
+				// a transfer hung. abort the rest so their handlers
+				// don't outlive this frame
+				asio::error_code ignored;
+				m_multi.Cancel(ignored);
+				while (remaining != 0 && m_ctx.run_one() != 0);
+			}
+			return outcomes;
+		}
+	private:
+		cma::Bench::LocalServer m_server;
+		cma::Bench::ImpairmentProxy m_proxy;
+		asio::io_context m_ctx;
+		cma::Multi m_multi;
+	};
+
+	/// @brief A named check
+	struct Scenario
+	{
+		const char* name;
+		std::function<bool(Harness&, std::string&)> run;
+	};
+
+	/// @param duration The duration
+	/// @return The duration in milliseconds
+	double Ms(clock_type::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+	/// @param outcomes The outcomes
+	/// @return The number of failed transfers
+	size_t Failures(const std::vector<Outcome>& outcomes)
+	{
+		return static_cast<size_t>(std::count_if(outcomes.begin(), outcomes.end(),
+			[](const Outcome& outcome) { return static_cast<bool>(outcome.ec); }));
+	}
+
+	const Scenario s_scenarios[] = {
+		{ "baseline", [](Harness& harness, std::string& detail)
+		{
+			harness.GetProxy().SetImpairments({});
+			const auto outcomes = harness.Run(20, 1024);
+			detail = std::to_string(Failures(outcomes)) + " failed, last after " +
+				std::to_string(Ms(outcomes.back().elapsed)) + "ms";
+			return Failures(outcomes) == 0;
+		} },
+		{ "slow-ttfb", [](Harness& harness, std::string& detail)
+		{
+			cma::Bench::Impairments impairments;
+			impairments.firstByteDelay = 300ms;
+			harness.GetProxy().SetImpairments(impairments);
+			const auto outcome = harness.Run(1, 1024).front();
+			detail = outcome.ec.message() + " after " + std::to_string(Ms(outcome.elapsed)) + "ms";
+			return !outcome.ec && outcome.elapsed >= 300ms && outcome.elapsed < 800ms;
+		} },
+		{ "latency-jitter", [](Harness& harness, std::string& detail)
+		{
+			cma::Bench::Impairments impairments;
+			impairments.latency = 20ms;
+			impairments.jitter = 20ms;
+			harness.GetProxy().SetImpairments(impairments);
+			const auto outcomes = harness.Run(10, 1024);
+			const auto slowest = std::max_element(outcomes.begin(), outcomes.end(),
+				[](const auto& a, const auto& b) { return a.elapsed < b.elapsed; })->elapsed;
+			detail = std::to_string(Failures(outcomes)) + " failed, slowest " +
+				std::to_string(Ms(slowest)) + "ms";
+			// the request and the response are each delayed
+			return Failures(outcomes) == 0 && slowest >= 40ms && slowest < 500ms;
+		} },
+		{ "trickle", [](Harness& harness, std::string& detail)
+		{
+			cma::Bench::Impairments impairments;
+			impairments.bandwidth = 512 * 1024;
+			impairments.chunkSize = 4096;
+			harness.GetProxy().SetImpairments(impairments);
+			const auto outcome = harness.Run(1, 256 * 1024).front();
+			detail = outcome.ec.message() + " after " + std::to_string(Ms(outcome.elapsed)) + "ms";
+			return !outcome.ec && outcome.elapsed >= 400ms && outcome.elapsed < 2s;
+		} },
+		{ "reset", [](Harness& harness, std::string& detail)
+		{
+			cma::Bench::Impairments impairments;
+			impairments.resetAfterBytes = 1000;
+			harness.GetProxy().SetImpairments(impairments);
+			const auto outcome = harness.Run(1, 64 * 1024).front();
+			detail = outcome.ec.message() + " after " + std::to_string(Ms(outcome.elapsed)) + "ms";
+			// the reset must surface right away, not at some timeout
+			return outcome.ec && outcome.elapsed < 500ms;
+		} },
+		{ "stall-timeout", [](Harness& harness, std::string& detail)
+		{
+			cma::Bench::Impairments impairments;
+			impairments.stallAfterBytes = 1000;
+			harness.GetProxy().SetImpairments(impairments);
+			const auto outcome = harness.Run(1, 64 * 1024, [](cma::Easy& easy)
+				{
+					easy.SetOption(CURLoption::CURLOPT_TIMEOUT_MS, 500L);
+				}).front();
+			detail = outcome.ec.message() + " after " + std::to_string(Ms(outcome.elapsed)) + "ms";
+			// only the multi's timer can end this transfer
+			return outcome.ec == make_error_code(CURLE_OPERATION_TIMEDOUT) &&
+				outcome.elapsed >= 500ms && outcome.elapsed < 1s;
+		} },
+		{ "stall-low-speed", [](Harness& harness, std::string& detail)
+		{
+			cma::Bench::Impairments impairments;
+			impairments.stallAfterBytes = 1000;
+			harness.GetProxy().SetImpairments(impairments);
+			const auto outcome = harness.Run(1, 64 * 1024, [](cma::Easy& easy)
+				{
+					easy.SetOption(CURLoption::CURLOPT_LOW_SPEED_LIMIT, 1L);
+					easy.SetOption(CURLoption::CURLOPT_LOW_SPEED_TIME, 1L);
+				}).front();
+			detail = outcome.ec.message() + " after " + std::to_string(Ms(outcome.elapsed)) + "ms";
+			// cURL averages the speed over a few seconds before giving
+			// up, and the curl tool takes just as long, so be lenient
+			return outcome.ec == make_error_code(CURLE_OPERATION_TIMEDOUT) &&
+				outcome.elapsed >= 1s && outcome.elapsed < 10s;
+		} },
+		{ "partial-faults", [](Harness& harness, std::string& detail)
+		{
+			cma::Bench::Impairments impairments;
+			impairments.resetAfterBytes = 1000;
+			impairments.faultProbability = 0.3;
+			harness.GetProxy().SetImpairments(impairments);
+			const auto start = clock_type::now();
+			const auto outcomes = harness.Run(50, 16 * 1024);
+			const auto elapsed = clock_type::now() - start;
+			detail = std::to_string(Failures(outcomes)) + "/50 reset, all done after " +
+				std::to_string(Ms(elapsed)) + "ms";
+			// the healthy transfers must not be held up by the broken ones
+			return Failures(outcomes) < outcomes.size() && elapsed < 2s;
+		} },
+		{ "recovery", [](Harness& harness, std::string& detail)
+		{
+			// leave a stalled transfer behind, then heal the network
+			cma::Bench::Impairments impairments;
+			impairments.stallAfterBytes = 1000;
+			harness.GetProxy().SetImpairments(impairments);
+			harness.Run(4, 64 * 1024, [](cma::Easy& easy)
+				{
+					easy.SetOption(CURLoption::CURLOPT_TIMEOUT_MS, 200L);
+				});
+			harness.GetProxy().SetImpairments({});
+			const auto start = clock_type::now();
+			const auto first = harness.Run(1, 1024).front();
+			const auto recovery = clock_type::now() - start;
+			cma::Bench::Histogram latency;
+			size_t failures = first.ec ? 1 : 0;
+			for (size_t i = 0; i < 20; ++i)
+			{
+				const auto outcome = harness.Run(1, 1024).front();
+				latency.Record(static_cast<uint64_t>(outcome.elapsed.count()));
+				failures += outcome.ec ? 1 : 0;
+			}
+			detail = "first success after " + std::to_string(Ms(recovery)) + "ms, p50 " +
+				std::to_string(latency.Percentile(50.0) / 1e6) + "ms, " +
+				std::to_string(failures) + " failed";
+			return failures == 0 && recovery < 100ms;
+		} },
+		{ "dns-cache", [](Harness& harness, std::string& detail)
+		{
+			// a stub resolver answers for a made up host after a delay
+			harness.GetProxy().SetImpairments({});
+			size_t lookups = 0;
+			auto executor = harness.GetMulti().GetExecutor();
+			cma::DnsCacheOptions options;
+			options.ttl = 1s;
+			options.refreshAhead = 0.25;
+			options.popularity = 1;
+			cma::DnsCache cache([&](const std::string& host, cma::DnsCache::ResolveHandler handler)
+				{
+					++lookups;
+					auto timer = std::make_shared<asio::steady_timer>(executor, 20ms);
+					timer->async_wait([timer, host, handler = std::move(handler)](const asio::error_code&)
+						{
+							if (host == "stub.test")
+								handler({}, { asio::ip::address_v4::loopback() }, 0s);
+							else
+								handler(asio::error::host_not_found, {}, 0s);
+						});
+				}, options);
+			harness.GetMulti().SetDnsCache(&cache);
+			const auto local = harness.GetProxy().GetURL("/?size=1024");
+			const auto url = "http://stub.test" + local.substr(local.rfind(':'));
+			const auto configure = [&url](cma::Easy& easy)
+			{
+				easy.SetURL(url.c_str());
+			};
+			// a burst for a cold name shares one lookup
+			auto outcomes = harness.Run(20, 1024, configure);
+			const size_t coldLookups = lookups;
+			// once it is due, a hot name is refreshed behind the transfers
+			std::this_thread::sleep_for(300ms);
+			const auto hot = harness.Run(5, 1024, configure);
+			outcomes.insert(outcomes.end(), hot.begin(), hot.end());
+			// the refresh finishes on the executor
+			harness.Run(1, 1024, configure);
+			const size_t hotLookups = lookups;
+			const auto stats = cache.GetStats();
+			// a transfer canceled while it waits on DNS is aborted, and its
+			// handle is left alone once the lookup finishes
+			cache.Clear();
+			auto waiting = std::make_unique<cma::Easy>();
+			configure(*waiting);
+			asio::error_code waitingEc;
+			bool waitingDone = false;
+			harness.GetMulti().AsyncPerform(*waiting, [&](const asio::error_code& ec)
+				{
+					waitingEc = ec;
+					waitingDone = true;
+				});
+			const bool canceled = harness.GetMulti().Cancel(*waiting);
+			waiting.reset();
+			harness.RunUntil([&] { return waitingDone; }, 1s);
+			// let the lookup finish against the freed handle
+			harness.RunUntil([] { return false; }, 50ms);
+			harness.GetMulti().SetDnsCache(nullptr);
+			detail = std::to_string(coldLookups) + " lookup for 20 cold, " +
+				std::to_string(stats.refreshes) + " refresh, " +
+				std::to_string(stats.misses) + " misses, " +
+				std::to_string(Failures(outcomes)) + " failed" +
+				(canceled == true ? "" : ", cancel missed a lookup");
+			return coldLookups == 1 && hotLookups == 2 && stats.refreshes == 1 &&
+				stats.misses == 20 && Failures(outcomes) == 0 && canceled == true &&
+				waitingEc == asio::error::operation_aborted;
+		} },
+		{ "prewarm", [](Harness& harness, std::string& detail)
+		{
+			auto& proxy = harness.GetProxy();
+			proxy.SetImpairments({});
+			// the earlier scenarios left connections to 127.0.0.1 behind, so
+			// this one goes through another name for the proxy
+			const auto origin = "http://localhost:" + std::to_string(proxy.GetPort());
+			const std::vector<std::string> origins = { origin };
+			const auto url = origin + "/?size=1024";
+			// reusing connections is the point, so nothing here is fresh
+			const auto reuse = [&url](cma::Easy& easy)
+			{
+				easy.SetURL(url.c_str());
+				easy.SetOption(CURLoption::CURLOPT_FRESH_CONNECT, 0L);
+			};
+			// by default the cache shrinks with the number of transfers
+			harness.GetMulti().SetOption(CURLMoption::CURLMOPT_MAXCONNECTS, 64L);
+			const auto before = proxy.GetConnectionCount();
+			bool done = false;
+			size_t connected = 0;
+			asio::error_code prewarmEc;
+			harness.GetMulti().AsyncPrewarm(origins, 4, [&](const asio::error_code& ec, size_t count)
+				{
+					prewarmEc = ec;
+					connected = count;
+					done = true;
+				});
+			harness.RunUntil([&] { return done; }, 5s);
+			const auto warmed = proxy.GetConnectionCount() - before;
+			// a burst as wide as the prewarm opens nothing new
+			auto outcomes = harness.Run(4, 1024, reuse);
+			const auto afterBurst = proxy.GetConnectionCount() - before;
+			// keeping six warm only opens the two that are missing
+			harness.GetMulti().KeepWarm(origins, 6, 50ms);
+			harness.RunUntil([] { return false; }, 300ms);
+			harness.GetMulti().StopKeepWarm();
+			harness.RunUntil([] { return false; }, 50ms);
+			const auto burst = harness.Run(4, 1024, reuse);
+			outcomes.insert(outcomes.end(), burst.begin(), burst.end());
+			const auto total = proxy.GetConnectionCount() - before;
+			harness.GetMulti().SetOption(CURLMoption::CURLMOPT_MAXCONNECTS, 0L);
+			detail = std::to_string(connected) + " prewarmed, " + std::to_string(afterBurst - warmed) +
+				" opened by the burst, " + std::to_string(total - afterBurst) + " by keep warm, " +
+				std::to_string(Failures(outcomes)) + " failed";
+			return !prewarmEc && connected == 4 && warmed == 4 && afterBurst == warmed &&
+				total == afterBurst + 2 && Failures(outcomes) == 0;
+		} },
+		{ "endpoint-selection", [](Harness& harness, std::string& detail)
+		{
+			// two more replicas of the proxy, on its port at other loopback
+			// addresses. the last one is slow to answer
+			auto& proxy = harness.GetProxy();
+			proxy.SetImpairments({});
+			const asio::ip::tcp::endpoint upstream(proxy.GetAddress(), proxy.GetPort());
+			cma::Bench::ImpairmentProxy fast(upstream, {}, proxy.GetPort(),
+				asio::ip::make_address("127.0.0.2"));
+			cma::Bench::Impairments impairments;
+			impairments.firstByteDelay = 30ms;
+			cma::Bench::ImpairmentProxy slow(upstream, impairments, proxy.GetPort(),
+				asio::ip::make_address("127.0.0.3"));
+			cma::DnsCache cache([&](const std::string&, cma::DnsCache::ResolveHandler handler)
+				{
+					handler({}, { proxy.GetAddress(), fast.GetAddress(), slow.GetAddress() }, 0s);
+				});
+			cma::EndpointSelector selector;
+			harness.GetMulti().SetDnsCache(&cache);
+			harness.GetMulti().SetEndpointSelector(&selector);
+			const auto url = "http://replicas.test:" + std::to_string(proxy.GetPort()) + "/?size=1024";
+			const auto configure = [&url](cma::Easy& easy)
+			{
+				easy.SetURL(url.c_str());
+			};
+			// a few rounds measure every replica
+			std::vector<Outcome> outcomes;
+			for (size_t i = 0; i < 5; ++i)
+			{
+				const auto round = harness.Run(6, 1024, configure);
+				outcomes.insert(outcomes.end(), round.begin(), round.end());
+			}
+			// then the slow one is ejected, and gets nothing
+			const auto slowBefore = slow.GetConnectionCount();
+			const auto burst = harness.Run(30, 1024, configure);
+			outcomes.insert(outcomes.end(), burst.begin(), burst.end());
+			const auto slowAfter = slow.GetConnectionCount() - slowBefore;
+			harness.GetMulti().SetEndpointSelector(nullptr);
+			harness.GetMulti().SetDnsCache(nullptr);
+			bool ejected = false;
+			for (const auto& endpoint : selector.GetStats())
+				if (endpoint.address == slow.GetAddress())
+					ejected = endpoint.ejected;
+			detail = std::string(ejected ? "slow replica ejected, " : "slow replica kept, ") +
+				std::to_string(slowAfter) + "/30 sent to it after, " +
+				std::to_string(Failures(outcomes)) + " failed";
+			return ejected == true && slowAfter == 0 && Failures(outcomes) == 0;
+		} },
+		{ "response-cache", [](Harness& harness, std::string& detail)
+		{
+			auto& proxy = harness.GetProxy();
+			proxy.SetImpairments({});
+			const auto diskPath = (std::filesystem::temp_directory_path() /
+				"cma-scenarios-cache").string();
+			std::error_code ignored;
+			std::filesystem::remove_all(diskPath, ignored);
+			cma::ResponseCacheOptions options;
+			options.diskPath = diskPath;
+			// one is fresh for a minute, the other must be revalidated each time
+			const auto fresh = proxy.GetURL("/?size=4096&maxage=60&etag=7");
+			const auto revalidated = proxy.GetURL("/?size=4096&maxage=0&etag=9");
+			size_t failed = 0;
+			const auto fetch = [&](cma::ResponseCache& cache, const std::string& url)
+			{
+				cma::Easy easy;
+				easy.SetURL(url.c_str());
+				easy.SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+				cma::CachedResponse response;
+				bool done = false;
+				cache.AsyncFetch(harness.GetMulti(), easy,
+					[&](const asio::error_code& ec, cma::CachedResponse result)
+					{
+						failed += (ec || result.status != 200 || result.body == nullptr ||
+							result.body->size() != 4096) ? 1 : 0;
+						response = std::move(result);
+						done = true;
+					});
+				harness.RunUntil([&] { return done; }, 5s);
+				return response;
+			};
+			cma::ResponseCacheStats stats;
+			bool shared = false;
+			{
+				cma::ResponseCache cache(options);
+				const auto first = fetch(cache, fresh);
+				const auto hit = fetch(cache, fresh);
+				const auto stale = fetch(cache, revalidated);
+				const auto confirmed = fetch(cache, revalidated);
+				// neither a hit nor a 304 copies the body
+				shared = first.body != nullptr && hit.fromCache == true &&
+					hit.body == first.body && confirmed.revalidated == true &&
+					confirmed.body == stale.body;
+				stats = cache.GetStats();
+			}
+			// a new cache maps the fresh response back from disk
+			cma::ResponseCache restarted(options);
+			const auto mapped = fetch(restarted, fresh);
+			const auto diskHits = restarted.GetStats().diskHits;
+			std::filesystem::remove_all(diskPath, ignored);
+			detail = std::to_string(stats.hits) + " hit, " + std::to_string(stats.revalidations) +
+				" revalidated, " + std::to_string(stats.misses) + " misses, " +
+				std::to_string(diskHits) + " from disk after restart, " +
+				std::to_string(failed) + " failed";
+			return shared == true && stats.hits == 1 && stats.revalidations == 1 &&
+				stats.misses == 2 && stats.stores == 2 && mapped.fromCache == true &&
+				diskHits == 1 && failed == 0;
+		} },
+		{ "single-flight", [](Harness& harness, std::string& detail)
+		{
+			auto& proxy = harness.GetProxy();
+			proxy.SetImpairments({});
+			cma::SingleFlight group;
+			struct Request
+			{
+				cma::Easy easy;
+				asio::error_code ec;
+				cma::FlightResponse response;
+				bool done = false;
+			};
+			const auto start = [&](std::vector<Request>& requests, const std::string& url)
+			{
+				for (auto& request : requests)
+				{
+					request.easy.SetURL(url.c_str());
+					request.easy.SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+					group.AsyncFetch(harness.GetMulti(), "GET", request.easy,
+						[&request](const asio::error_code& ec, cma::FlightResponse response)
+						{
+							request.ec = ec;
+							request.response = std::move(response);
+							request.done = true;
+						});
+				}
+			};
+			const auto finished = [](const std::vector<Request>& requests)
+			{
+				return std::all_of(requests.begin(), requests.end(),
+					[](const Request& request) { return request.done; });
+			};
+			// a stampede on one key is a single transfer, with one body
+			const auto before = harness.GetServer().GetRequestCount();
+			std::vector<Request> stampede(50);
+			start(stampede, proxy.GetURL("/?size=2048&delay=50"));
+			harness.RunUntil([&] { return finished(stampede); }, 5s);
+			// the server counts a request once its write completes, which
+			// may be after the response arrived
+			harness.RunUntil([&] { return harness.GetServer().GetRequestCount() != before; }, 1s);
+			const auto sent = harness.GetServer().GetRequestCount() - before;
+			const auto& body = stampede.front().response.body;
+			const bool shared = body != nullptr && body->size() == 2048 &&
+				std::all_of(stampede.begin(), stampede.end(), [&](const Request& request)
+				{
+					return !request.ec && request.response.body == body &&
+						request.response.joined == (&request != &stampede.front());
+				});
+			// the leader going away leaves the others the response
+			std::vector<Request> leaderGone(3);
+			start(leaderGone, proxy.GetURL("/?size=2048&delay=100"));
+			group.Cancel(leaderGone.front().easy);
+			harness.RunUntil([&] { return finished(leaderGone); }, 5s);
+			const bool survived = leaderGone[0].ec == asio::error::operation_aborted &&
+				!leaderGone[1].ec && !leaderGone[2].ec &&
+				leaderGone[1].response.body != nullptr && leaderGone[1].response.body->size() == 2048;
+			// and everyone going away aborts the transfer
+			std::vector<Request> allGone(2);
+			start(allGone, proxy.GetURL("/?size=2048&delay=5000"));
+			for (auto& request : allGone)
+				group.Cancel(request.easy);
+			// the progress callback runs at least once a second
+			harness.RunUntil([&] { return group.GetStats().aborted != 0; }, 3s);
+			const auto stats = group.GetStats();
+			const bool aborted = finished(allGone) && stats.inFlight == 0 && stats.aborted == 1;
+			detail = std::to_string(sent) + " sent for 50, " + std::to_string(stats.joined) +
+				" joined, " + std::to_string(stats.abandoned) + " abandoned" +
+				(survived ? "" : ", lost the leader's flight") + (aborted ? "" : ", not aborted");
+			return sent == 1 && shared == true && survived == true && aborted == true &&
+				stats.flights == 3 && stats.joined == 49 + 2 + 1 && stats.abandoned == 3;
+		} },
+		{ "circuit-breaker", [](Harness& harness, std::string& detail)
+		{
+			auto& proxy = harness.GetProxy();
+			cma::CircuitBreakerOptions options;
+			options.windowSize = 10;
+			options.minimumRequests = 5;
+			options.openDuration = 300ms;
+			cma::CircuitBreaker breaker(options);
+			harness.GetMulti().SetCircuitBreaker(&breaker);
+			const auto origin = cma::CircuitBreaker::GetOrigin(proxy.GetURL());
+			const auto refused = [](const std::vector<Outcome>& outcomes)
+			{
+				return std::all_of(outcomes.begin(), outcomes.end(), [](const Outcome& outcome)
+					{
+						return outcome.ec == cma::Errc::CircuitOpen && outcome.elapsed < 50ms;
+					});
+			};
+			// a backend that resets every connection opens the circuit
+			cma::Bench::Impairments impairments;
+			impairments.resetAfterBytes = 1;
+			proxy.SetImpairments(impairments);
+			harness.Run(5, 1024);
+			const bool opened = breaker.GetState(origin) == cma::CircuitState::Open;
+			// and then nothing reaches it, even once it is healthy again
+			const bool failedFast = refused(harness.Run(20, 1024));
+			proxy.SetImpairments({});
+			const bool stillOpen = refused(harness.Run(3, 1024));
+			// until a probe finds it healthy after the open duration
+			harness.RunUntil([] { return false; }, options.openDuration + 50ms);
+			const auto probe = harness.Run(1, 1024).front();
+			const bool closed = !probe.ec && breaker.GetState(origin) == cma::CircuitState::Closed;
+			const auto after = harness.Run(10, 1024);
+			const bool healthy = std::none_of(after.begin(), after.end(),
+				[](const Outcome& outcome) { return static_cast<bool>(outcome.ec); });
+			harness.GetMulti().SetCircuitBreaker(nullptr);
+			const auto stats = breaker.GetStats();
+			const auto rejected = stats.empty() ? 0 : stats.front().rejected;
+			// circuits beyond the cap push out the least recently used
+			options.maxCircuits = 2;
+			cma::CircuitBreaker capped(options);
+			cma::Easy easy;
+			for (const char* url : { "http://a.test/", "http://b.test/", "http://a.test/", "http://c.test/" })
+			{
+				capped.Allow(easy.GetNativeHandle(), url);
+				capped.Release(easy.GetNativeHandle());
+			}
+			const auto cappedStats = capped.GetStats();
+			const bool bounded = cappedStats.size() == 2 && std::none_of(cappedStats.begin(), cappedStats.end(),
+				[](const cma::CircuitStats& circuit) { return circuit.origin == "http://b.test:80"; });
+			detail = std::to_string(rejected) + " refused" + (opened ? "" : ", never opened") +
+				(failedFast ? "" : ", reached the backend") + (stillOpen ? "" : ", closed early") +
+				(closed ? "" : ", probe didn't close it") + (healthy ? "" : ", failed after closing") +
+				(bounded ? "" : ", circuits not capped");
+			return opened == true && failedFast == true && stillOpen == true &&
+				closed == true && healthy == true && bounded == true && rejected == 23;
+		} },
+		{ "redirect-cache", [](Harness& harness, std::string& detail)
+		{
+			auto& proxy = harness.GetProxy();
+			auto& server = harness.GetServer();
+			proxy.SetImpairments({});
+			cma::RedirectCache cache;
+			harness.GetMulti().SetRedirectCache(&cache);
+			// the transfers' own header callback still sees every response
+			size_t statusLines = 0;
+			const auto countStatus = [](char* buffer, size_t size, size_t nitems, void* userdata)
+			{
+				if (std::string_view(buffer, size * nitems).starts_with("HTTP/") == true)
+					++*static_cast<size_t*>(userdata);
+				return size * nitems;
+			};
+			// performs a request, and counts the requests that reached the server
+			bool restored = true;
+			const auto fetch = [&](const std::string& target, bool follow, uint64_t expected, bool post = false)
+			{
+				const auto url = proxy.GetURL(target);
+				cma::Easy easy;
+				easy.SetURL(url.c_str());
+				easy.SetBuffer(cma::Easy::NullBuffer{});
+				easy.SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+				easy.SetOption(CURLoption::CURLOPT_HEADERFUNCTION,
+					static_cast<curl_write_callback>(countStatus));
+				easy.SetOption(CURLoption::CURLOPT_HEADERDATA, &statusLines);
+				easy.SetOption(CURLoption::CURLOPT_FOLLOWLOCATION, follow ? 1L : 0L);
+				if (post == true)
+					easy.SetPOSTData(std::string("posted"));
+				const auto before = server.GetRequestCount();
+				bool done = false;
+				asio::error_code result;
+				harness.GetMulti().AsyncPerform(easy, [&](const asio::error_code& ec)
+					{
+						result = ec;
+						done = true;
+					});
+				harness.RunUntil([&] { return done; }, 5s);
+				// the server counts a request once its write completes
+				harness.RunUntil([&] { return server.GetRequestCount() - before >= expected; }, 1s);
+				long status = 0;
+				easy.GetInfo(CURLINFO_RESPONSE_CODE, status);
+				// a rewritten handle gets its own URL back
+				restored &= easy.GetURL() == url;
+				return std::make_pair((result || done == false) ? 0L : status,
+					server.GetRequestCount() - before);
+			};
+			// a 301 is learned, and the next request goes straight to its target
+			const auto learned = fetch("/?redirect=301&size=1024", true, 2);
+			const auto skipped = fetch("/?redirect=301&size=1024", true, 1);
+			// but not for a request that doesn't follow redirects, or
+			// isn't safe to send elsewhere
+			const auto unfollowed = fetch("/?redirect=301&size=1024", false, 1);
+			const auto posted = fetch("/?redirect=301&size=1024", true, 2, true);
+			// a 302 is only temporary
+			fetch("/?redirect=302&size=2048", true, 2);
+			statusLines = 0;
+			const auto temporary = fetch("/?redirect=302&size=2048", true, 2);
+			const size_t seen = statusLines;
+			// and a 308 that isn't followed isn't learned
+			const auto unlearned = fetch("/?redirect=308&size=512", false, 1);
+			const auto followed = fetch("/?redirect=308&size=512", true, 2);
+			const auto cached = fetch("/?redirect=308&size=512", true, 1);
+			harness.GetMulti().SetRedirectCache(nullptr);
+			const auto stats = cache.GetStats();
+			detail = std::to_string(learned.second) + " then " + std::to_string(skipped.second) +
+				" requests for a 301, " + std::to_string(unfollowed.first) + " unfollowed, " +
+				std::to_string(posted.second) + " for a POST, " + std::to_string(temporary.second) + " for a 302, " +
+				std::to_string(stats.hits) + " hits, " + std::to_string(stats.misses) + " misses, " +
+				std::to_string(seen) + " status lines passed on for the 302" + (restored ? "" : ", URL not restored");
+			return seen == 2 && restored == true && learned == std::make_pair(200L, uint64_t(2)) &&
+				skipped == std::make_pair(200L, uint64_t(1)) && unfollowed == std::make_pair(301L, uint64_t(1)) &&
+				posted == std::make_pair(200L, uint64_t(2)) && temporary == std::make_pair(200L, uint64_t(2)) &&
+				unlearned == std::make_pair(308L, uint64_t(1)) && followed == std::make_pair(200L, uint64_t(2)) &&
+				cached == std::make_pair(200L, uint64_t(1)) && stats.hits == 2 && stats.misses == 4 &&
+				stats.learned == 2 && stats.entries == 2;
+		} },
+		{ "websocket", [](Harness& harness, std::string& detail)
+		{
+			const auto* info = curl_version_info(CURLVERSION_NOW);
+			bool supported = false;
+			for (auto protocol = info->protocols; *protocol != nullptr; ++protocol)
+				supported |= std::string_view(*protocol) == "ws";
+			if (supported == false)
+			{
+				detail = "skipped, libcurl " + std::string(info->version) + " has no WebSocket support";
+				return true;
+			}
+			auto url = harness.GetServer().GetURL("/echo");
+			url.replace(0, 4, "ws");
+			cma::WebSocket ws(harness.GetMulti());
+			ws.GetEasy().SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+			asio::error_code connectEc = asio::error::would_block;
+			ws.AsyncConnect(url, [&](const asio::error_code& ec) { connectEc = ec; });
+			harness.RunUntil([&] { return connectEc != asio::error::would_block; }, 5s);
+			if (connectEc)
+			{
+				detail = "connect failed: " + connectEc.message();
+				return false;
+			}
+			// sends a message, and reads its echo through a buffer smaller
+			// than the message, so larger ones arrive across several reads
+			std::vector<char> buffer(16 * 1024);
+			size_t reads = 0;
+			const auto echo = [&](const std::string& message, cma::WebSocketOpcode opcode)
+			{
+				bool written = false;
+				ws.AsyncWrite(asio::buffer(message), opcode, [&](const asio::error_code& ec, size_t)
+					{
+						written = !ec;
+					});
+				std::string received;
+				bool done = false;
+				bool failed = false;
+				std::function<void()> read = [&]
+				{
+					ws.AsyncRead(asio::buffer(buffer), [&](const asio::error_code& ec, size_t bytes,
+						cma::WebSocketFrame frame)
+						{
+							++reads;
+							received.append(buffer.data(), bytes);
+							if (ec)
+								failed = true;
+							else if (frame.IsMessageEnd() == true)
+								done = true;
+							else
+								read();
+						});
+				};
+				read();
+				harness.RunUntil([&] { return (done || failed) && written; }, 5s);
+				return written == true && done == true && received == message;
+			};
+			const bool text = echo("hello", cma::WebSocketOpcode::Text);
+			std::string large(256 * 1024, '\0');
+			for (size_t i = 0; i < large.size(); ++i)
+				large[i] = static_cast<char>(i * 31);
+			const size_t readsBefore = reads;
+			const bool binary = echo(large, cma::WebSocketOpcode::Binary);
+			const size_t largeReads = reads - readsBefore;
+			// ordinary transfers share the multi handle in the meantime
+			const auto outcomes = harness.Run(4, 1024);
+			const bool again = echo("again", cma::WebSocketOpcode::Text);
+			// closing aborts a read that is waiting
+			asio::error_code pendingEc;
+			bool aborted = false;
+			ws.AsyncRead(asio::buffer(buffer), [&](const asio::error_code& ec, size_t, cma::WebSocketFrame)
+				{
+					pendingEc = ec;
+					aborted = true;
+				});
+			harness.RunUntil([] { return false; }, 20ms);
+			ws.Close();
+			harness.RunUntil([&] { return aborted; }, 2s);
+			detail = "256KiB echoed in " + std::to_string(largeReads) + " reads, close aborted the read with \"" +
+				pendingEc.message() + "\"";
+			return text == true && binary == true && again == true && Failures(outcomes) == 0 &&
+				largeReads >= large.size() / buffer.size() && aborted == true && pendingEc;
+		} },
+		{ "event-source", [](Harness& harness, std::string& detail)
+		{
+			// follows a stream until it ends, and returns its events
+			const auto follow = [&](const std::string& target, std::vector<std::string>& events,
+				size_t& connections, size_t stopAfter = SIZE_MAX)
+			{
+				cma::EventSource source(harness.GetMulti(), [&](const cma::ServerSentEvent& event)
+					{
+						events.push_back(std::string(event.type) + "|" + std::string(event.data) +
+							"|" + std::string(event.id));
+						return true;
+					});
+				source.GetEasy().SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+				source.Start(harness.GetServer().GetURL(target));
+				asio::error_code result = asio::error::would_block;
+				source.AsyncWait([&](const asio::error_code& ec) { result = ec; });
+				harness.RunUntil([&] { return result != asio::error::would_block || events.size() >= stopAfter; }, 5s);
+				if (result == asio::error::would_block)
+				{
+					source.Stop();
+					harness.RunUntil([&] { return result != asio::error::would_block; }, 1s);
+				}
+				connections = source.GetConnections();
+				return result;
+			};
+			// seven events, three per connection, resumed with Last-Event-ID
+			// until the server answers 204
+			std::vector<std::string> events;
+			size_t connections = 0;
+			const auto ended = follow("/stream?events=3&total=7", events, connections);
+			bool ordered = events.size() == 7;
+			for (size_t i = 0; i < events.size(); ++i)
+			{
+				const auto id = std::to_string(i + 1);
+				ordered &= events[i] == (((i + 1) % 2 == 0) ? "tick|" + id + "\neven|" + id : "message|" + id + "|" + id);
+			}
+			// a response that isn't an event stream isn't retried
+			std::vector<std::string> none;
+			size_t refusedConnections = 0;
+			const auto refused = follow("/?size=64", none, refusedConnections);
+			// and stopping aborts an endless one
+			std::vector<std::string> endless;
+			size_t endlessConnections = 0;
+			const auto stopped = follow("/stream?events=2", endless, endlessConnections, 5);
+			detail = std::to_string(events.size()) + " events over " + std::to_string(connections) +
+				" connections, refused with \"" + refused.message() + "\", stopped with \"" + stopped.message() + "\"";
+			return !ended && ordered == true && connections == 4 &&
+				refused == cma::Errc::NotEventStream && refusedConnections == 1 && none.empty() == true &&
+				stopped == asio::error::operation_aborted && endless.size() >= 5;
+		} },
+		{ "memory-budget", [](Harness& harness, std::string& detail)
+		{
+			constexpr size_t bodySize = 1 << 20;
+			// every connection is capped, so the bodies arrive side by side
+			auto& proxy = harness.GetProxy();
+			cma::Bench::Impairments impairments;
+			impairments.bandwidth = 16 << 20;
+			impairments.chunkSize = 64 << 10;
+			proxy.SetImpairments(impairments);
+			// performs a burst of transfers into strings, freeing each body
+			// either as its transfer finishes or only once they all have
+			const auto burst = [&](cma::MemoryBudget& budget, size_t count, bool freeEach)
+			{
+				harness.GetMulti().SetMemoryBudget(&budget);
+				std::vector<cma::Easy> easies(count);
+				std::vector<std::string> bodies(count);
+				size_t done = 0;
+				size_t complete = 0;
+				for (size_t i = 0; i < count; ++i)
+				{
+					easies[i].SetURL(proxy.GetURL("/?size=" + std::to_string(bodySize)).c_str());
+					easies[i].SetBuffer(bodies[i]);
+					easies[i].SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+					harness.GetMulti().AsyncPerform(easies[i], [&, i](const asio::error_code& ec)
+						{
+							++done;
+							complete += (!ec && bodies[i].size() == bodySize);
+							if (freeEach == true)
+							{
+								std::string().swap(bodies[i]);
+								budget.Free(easies[i]);
+							}
+						});
+				}
+				harness.RunUntil([&] { return done == count; }, 10s);
+				for (auto& easy : easies)
+					budget.Free(easy);
+				harness.GetMulti().SetMemoryBudget(nullptr);
+				return complete;
+			};
+			// bodies freed as they arrive stay within the budget, give or
+			// take one let past it, and the rest of the burst waits its turn
+			cma::MemoryBudget budget({ .limit = 2 * bodySize });
+			const size_t fair = burst(budget, 16, true);
+			const auto stats = budget.GetStats();
+			// bodies held until the end can't all fit, but still finish
+			cma::MemoryBudget small({ .limit = 2 * bodySize });
+			const size_t held = burst(small, 6, false);
+			const auto heldStats = small.GetStats();
+			proxy.SetImpairments({});
+			// a body over its limit is aborted, with or without a length
+			cma::MemoryBudget limits;
+			harness.GetMulti().SetMemoryBudget(&limits);
+			const auto limited = [&](const std::string& target)
+			{
+				cma::Easy easy;
+				std::string body;
+				easy.SetURL(harness.GetServer().GetURL(target).c_str());
+				easy.SetBuffer(body);
+				easy.SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+				easy.SetMaxBodySize(1000);
+				asio::error_code result = asio::error::would_block;
+				harness.GetMulti().AsyncPerform(easy, [&](const asio::error_code& ec) { result = ec; });
+				harness.RunUntil([&] { return result != asio::error::would_block; }, 5s);
+				limits.Free(easy);
+				return std::make_pair(result, body.size());
+			};
+			const auto sized = limited("/?size=" + std::to_string(bodySize));
+			const auto streamed = limited("/stream?events=200");
+			// a body that nobody frees is given back with its handle, and
+			// one moved into a response is given back as it moves
+			size_t charged = 0;
+			{
+				cma::Easy easy;
+				std::string body;
+				easy.SetURL(harness.GetServer().GetURL("/?size=4096").c_str());
+				easy.SetBuffer(body);
+				easy.SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+				harness.GetMulti().AsyncPerform(easy, [](const asio::error_code&) {});
+				cma::SingleFlight group;
+				bool landed = false;
+				group.AsyncFetch(harness.GetMulti(), "GET", easy,
+					[&](const asio::error_code&, cma::FlightResponse) { landed = true; });
+				harness.RunUntil([&] { return landed == true; }, 5s);
+				harness.RunUntil([&] { return limits.GetHeld(easy) != 0; }, 5s);
+				charged = limits.GetHeld(easy);
+			}
+			const auto leaked = limits.GetStats().used;
+			harness.GetMulti().SetMemoryBudget(nullptr);
+			const asio::error_code tooLarge = CURLE_FILESIZE_EXCEEDED;
+			detail = std::to_string(fair) + "/16 with a peak of " + std::to_string(stats.peak >> 10) + "KiB and " +
+				std::to_string(stats.pauses) + " pauses, " + std::to_string(held) + "/6 held with " +
+				std::to_string(heldStats.overdrafts) + " overdrafts, limits hit at " + std::to_string(sized.second) +
+				" and " + std::to_string(streamed.second) + " bytes, " +
+				std::to_string(leaked) + " bytes left charged";
+			return charged != 0 && leaked == 0 && fair == 16 && stats.peak <= 3 * bodySize && stats.pauses != 0 && stats.used == 0 &&
+				held == 6 && heldStats.overdrafts != 0 && heldStats.used == 0 &&
+				sized == std::make_pair(tooLarge, size_t(0)) && streamed.first == tooLarge &&
+				streamed.second <= 1000;
+		} },
+		{ "transfer-group", [](Harness& harness, std::string& detail)
+		{
+			auto& proxy = harness.GetProxy();
+			proxy.SetImpairments({});
+			struct GroupOutcome
+			{
+				asio::error_code ec;
+				std::vector<cma::TransferResult> results;
+				clock_type::duration elapsed{};
+				bool done = false;
+			};
+			const auto run = [&](const std::vector<std::string>& urls, cma::TransferGroupOptions options)
+			{
+				std::vector<cma::Easy> easies(urls.size());
+				GroupOutcome outcome;
+				const auto start = clock_type::now();
+				{
+					cma::TransferGroup group(harness.GetMulti(), options);
+					for (size_t i = 0; i < urls.size(); ++i)
+					{
+						easies[i].SetURL(urls[i].c_str());
+						easies[i].SetBuffer(cma::Easy::NullBuffer{});
+						easies[i].SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+						group.Add(easies[i]);
+					}
+					group.AsyncWait([&](const asio::error_code& ec, std::vector<cma::TransferResult> results)
+						{
+							outcome = { ec, std::move(results), clock_type::now() - start, true };
+						});
+					harness.RunUntil([&] { return outcome.done; }, 5s);
+				}
+				// let the canceled transfers unwind before their handles go
+				harness.RunUntil([] { return false; }, 20ms);
+				return outcome;
+			};
+			const auto count = [](const GroupOutcome& outcome, bool finished)
+			{
+				return std::count_if(outcome.results.begin(), outcome.results.end(),
+					[finished](const cma::TransferResult& result) { return result.finished == finished; });
+			};
+			// three of ten, where the stragglers would take seconds
+			std::vector<std::string> urls;
+			for (size_t i = 0; i < 10; ++i)
+				urls.push_back(proxy.GetURL("/?size=1024&delay=" + std::to_string(i < 3 ? 20 : 3000)));
+			const auto quorum = run(urls, { 3, 0ms });
+			const bool quorumMet = quorum.done && !quorum.ec && quorum.elapsed < 1s &&
+				count(quorum, true) == 3 && count(quorum, false) == 7;
+			// a deadline gives up on all of them
+			const auto deadline = run({ urls[5], urls[6] }, { 0, 200ms });
+			const bool timedOut = deadline.done && deadline.ec == asio::error::timed_out &&
+				deadline.elapsed < 1s && count(deadline, false) == 2;
+			// and one failure is enough to give up on all of them
+			const auto failFast = run({ urls[5], "http://127.0.0.1:1/" }, {});
+			const bool failed = failFast.done && failFast.ec && failFast.elapsed < 1s &&
+				failFast.results[1].finished == true && failFast.results[0].finished == false;
+			const auto ms = [](clock_type::duration elapsed)
+			{
+				return std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) + "ms";
+			};
+			detail = "3 of 10 in " + ms(quorum.elapsed) + ", deadline in " + ms(deadline.elapsed) +
+				", failed fast in " + ms(failFast.elapsed);
+			return quorumMet == true && timedOut == true && failed == true;
+		} },
+		{ "decoding", [](Harness& harness, std::string& detail)
+		{
+			auto& proxy = harness.GetProxy();
+			proxy.SetImpairments({});
+			cma::DecoderPool pool(2);
+			struct Decoded
+			{
+				asio::error_code ec;
+				std::string body;
+				cma::ContentEncoding encoding = cma::ContentEncoding::Identity;
+				cma::error_code error;
+				uint64_t offloaded = 0;
+			};
+			// fetches a body of random words in an encoding, decoding chunks
+			// of a few KiB on the pool if there is one
+			const auto fetch = [&](const std::string& encoding, cma::DecoderPool* decoders)
+			{
+				cma::Easy easy;
+				easy.SetURL(proxy.GetURL("/?size=262144&encoding=" + encoding).c_str());
+				easy.SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+				Decoded decoded;
+				bool done = false;
+				cma::DecodingSink sink(harness.GetMulti(), easy, decoded.body, decoders, { 4096 });
+				harness.GetMulti().AsyncPerform(easy, [&](const asio::error_code& ec)
+					{
+						decoded.ec = ec;
+						done = true;
+					});
+				harness.RunUntil([&] { return done; }, 5s);
+				if (done == false)
+				{
+					harness.GetMulti().Cancel(easy);
+					harness.RunUntil([&] { return done; }, 1s);
+				}
+				decoded.encoding = sink.GetEncoding();
+				decoded.error = sink.GetError();
+				decoded.offloaded = sink.GetOffloadedChunks();
+				return decoded;
+			};
+			const auto reference = fetch("identity", nullptr);
+			bool identity = !reference.ec && reference.body.size() == 262144 && reference.offloaded == 0;
+			// every codec that was built in gives the same words, whether
+			// the chunks were decoded in place or paused and decoded on the pool
+			std::vector<std::pair<std::string, cma::ContentEncoding>> codecs{ { "identity", cma::ContentEncoding::Identity } };
+#ifdef CMA_DECODE_ZLIB
+			codecs.insert(codecs.end(), { { "gzip", cma::ContentEncoding::Gzip }, { "gzip2", cma::ContentEncoding::Gzip },
+				{ "deflate", cma::ContentEncoding::Deflate }, { "rawdeflate", cma::ContentEncoding::Deflate } });
+#endif
+#ifdef CMA_DECODE_BROTLI
+			codecs.emplace_back("br", cma::ContentEncoding::Brotli);
+#endif
+			size_t decodedCount = 0;
+			for (const auto& [name, encoding] : codecs)
+			{
+				const auto inPlace = fetch(name, nullptr);
+				const auto offloaded = fetch(name, &pool);
+				decodedCount += !inPlace.ec && inPlace.body == reference.body && inPlace.encoding == encoding &&
+					inPlace.offloaded == 0 && !offloaded.ec && offloaded.body == reference.body &&
+					offloaded.encoding == encoding && offloaded.offloaded > 1;
+			}
+			// and a body that can't be decoded fails the transfer, either way
+			std::vector<std::string> undecodable{ "compress" };
+#ifdef CMA_DECODE_ZLIB
+			undecodable.emplace_back("corrupt");
+#endif
+			size_t failedCount = 0;
+			for (const auto& name : undecodable)
+			{
+				for (auto* decoders : { static_cast<cma::DecoderPool*>(nullptr), &pool })
+				{
+					const auto failed = fetch(name, decoders);
+					failedCount += failed.ec && failed.error == cma::Errc::DecodingFailed;
+				}
+			}
+			detail = std::to_string(decodedCount) + "/" + std::to_string(codecs.size()) + " codecs decoded, " +
+				std::to_string(failedCount) + "/" + std::to_string(undecodable.size() * 2) + " undecodable failed, " +
+				"accepting \"" + std::string(cma::DecodingSink::GetAcceptEncoding()) + "\"" +
+				(identity ? "" : ", identity body wrong");
+			return identity == true && decodedCount == codecs.size() && failedCount == undecodable.size() * 2;
+		} },
+		{ "share-persistence", [](Harness& harness, std::string& detail)
+		{
+			const auto path = (std::filesystem::temp_directory_path() / "cma-scenarios-share").string();
+			const auto clean = [&]
+			{
+				std::error_code ignored;
+				for (const char* suffix : { "", ".hsts", ".altsvc", ".tmp" })
+					std::filesystem::remove(path + suffix, ignored);
+			};
+			const auto read = [](const std::string& file)
+			{
+				std::ifstream in(file, std::ios::binary);
+				return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			};
+			const auto write = [](const std::string& file, std::string_view contents)
+			{
+				std::ofstream(file, std::ios::binary | std::ios::trunc).write(contents.data(),
+					static_cast<std::streamsize>(contents.size()));
+			};
+			// fetches a host through the share, and tells whether HSTS turned
+			// it into a request for https. nothing listens on the port, so
+			// either way it fails right away
+			const auto upgraded = [&](cma::Share& share, const std::string& host)
+			{
+				cma::Easy easy;
+				easy.SetURL(("http://" + host + ":1/").c_str());
+				easy.AddResolveStr((host + ":1:127.0.0.1").c_str());
+				easy.SetBuffer(cma::Easy::NullBuffer{});
+				easy.SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+				harness.GetMulti().SetShare(&share);
+				bool done = false;
+				harness.GetMulti().AsyncPerform(easy, [&](const asio::error_code&) { done = true; });
+				harness.RunUntil([&] { return done; }, 5s);
+				if (done == false)
+				{
+					harness.GetMulti().Cancel(easy);
+					harness.RunUntil([&] { return done; }, 1s);
+				}
+				harness.GetMulti().SetShare(nullptr);
+				const char* url = nullptr;
+				easy.GetInfo(CURLINFO_EFFECTIVE_URL, url);
+				return url != nullptr && std::string_view(url).starts_with("https://");
+			};
+			clean();
+			// an HSTS entry in cURL's own format is loaded, and saved again
+			write(path + ".hsts", "hsts.test \"20991231 00:00:00\"\n");
+			bool roundTrip = false;
+			{
+				cma::Share share({ path });
+				roundTrip = upgraded(share, "hsts.test") && !upgraded(share, "plain.test") && !share.Save() &&
+					read(path).starts_with("CMAS1") && read(path + ".hsts").find("hsts.test") != std::string::npos;
+			}
+			// a fresh share gets it back from disk
+			{
+				cma::Share share({ path });
+				roundTrip &= upgraded(share, "hsts.test") && !upgraded(share, "plain.test") &&
+					share.GetSessionCount() == 0;
+			}
+			// a truncated or corrupt session file loads nothing, doesn't
+			// take HSTS with it, and is replaced by the next save
+			size_t recovered = 0;
+			for (const std::string_view contents : { std::string_view("CMAS1\x10\x00" "abc", 10),
+				std::string_view("CMAS0garbage"), std::string_view("CM") })
+			{
+				write(path, contents);
+				{
+					cma::Share share({ path });
+					recovered += share.GetSessionCount() == 0 && upgraded(share, "hsts.test") &&
+						!upgraded(share, "plain.test");
+				}
+				recovered += read(path) == "CMAS1";
+			}
+			// and an interval save writes the file while the share lives
+			clean();
+			bool saved = false;
+			{
+				cma::Share share(harness.GetContext().get_executor(), { path, 1s });
+				harness.RunUntil([&] { return std::filesystem::exists(path); }, 3s);
+				saved = std::filesystem::exists(path) == true && std::filesystem::exists(path + ".hsts") == true;
+			}
+			clean();
+			detail = std::string(roundTrip ? "HSTS round-tripped" : "HSTS lost") + ", " +
+				std::to_string(recovered) + "/6 recovered from bad files" + (saved ? "" : ", interval save missing");
+			return roundTrip == true && recovered == 6 && saved == true;
+		} },
+		{ "json-tokenizer", [](Harness&, std::string& detail)
+		{
+			using Tokens = std::vector<std::pair<cma::JsonToken, std::string>>;
+			// tokenizes a document in chunks of a size, or whole
+			const auto tokenize = [](std::string_view document, size_t chunkSize,
+				size_t maxTokenSize = 1 << 20, size_t maxDepth = 512)
+			{
+				Tokens tokens;
+				cma::JsonTokenizer tokenizer([&](cma::JsonToken token, std::string_view text)
+					{
+						tokens.emplace_back(token, text);
+						return true;
+					}, maxTokenSize, maxDepth);
+				bool valid = true;
+				for (size_t i = 0; i < document.size() && valid == true; i += chunkSize)
+					valid = tokenizer.Consume(document.substr(i, chunkSize));
+				valid = valid == true && tokenizer.Finish() == true;
+				return std::make_pair(valid ? std::move(tokens) : Tokens{}, tokenizer.GetOffset());
+			};
+			// strings whose quotes and escapes, and runs of whitespace, fall
+			// on every position of a 16 byte block
+			std::string document = "[";
+			Tokens expected{ { cma::JsonToken::ArrayBegin, "[" } };
+			for (size_t i = 0; i < 40; ++i)
+			{
+				const std::string text = std::string(i, 'x') + "\\\"" + std::string(i % 7, 'y') +
+					"\\\\" + std::string(i % 3, 'z') + "\\u00e9";
+				document += std::string(i, (i % 2 == 0) ? ' ' : '\n') + "{\"k" + std::to_string(i) +
+					"\":\"" + text + "\",\r\n\t\"n\":[-1.5e3,true,false,null]}" + ((i != 39) ? "," : "");
+				expected.insert(expected.end(), { { cma::JsonToken::ObjectBegin, "{" },
+					{ cma::JsonToken::Key, "k" + std::to_string(i) }, { cma::JsonToken::String, text },
+					{ cma::JsonToken::Key, "n" }, { cma::JsonToken::ArrayBegin, "[" },
+					{ cma::JsonToken::Number, "-1.5e3" }, { cma::JsonToken::True, "true" },
+					{ cma::JsonToken::False, "false" }, { cma::JsonToken::Null, "null" },
+					{ cma::JsonToken::ArrayEnd, "]" }, { cma::JsonToken::ObjectEnd, "}" } });
+			}
+			// a number that ends the body only ends with Finish
+			document += "] 42";
+			expected.insert(expected.end(), { { cma::JsonToken::ArrayEnd, "]" }, { cma::JsonToken::Number, "42" } });
+			// a chunk shorter than a block is only ever scanned a byte at a
+			// time, so whole and byte by byte compare SSE2 to the plain path
+			bool consistent = tokenize(document, document.size()).first == expected;
+			for (const size_t chunkSize : { 1, 2, 7, 15, 16, 17, 33 })
+				consistent &= tokenize(document, chunkSize).first == expected;
+			// the limits hold whether or not a token is split across chunks
+			bool limited = true;
+			for (const size_t chunkSize : { 1, 5, 64 })
+			{
+				limited &= tokenize("[\"12345678\",12345678]", chunkSize, 8).first.size() == 4 &&
+					tokenize("[\"123456789\"]", chunkSize, 8).first.empty() == true &&
+					tokenize("[123456789]", chunkSize, 8).first.empty() == true &&
+					tokenize("[[[1]]]", chunkSize, 1 << 20, 3).first.size() == 7 &&
+					tokenize("[[[[1]]]]", chunkSize, 1 << 20, 3) == std::make_pair(Tokens{}, uint64_t(3));
+			}
+			// and malformed documents stop where they went wrong
+			const auto malformed = { std::make_pair("{\"a\" 1}", uint64_t(5)), std::make_pair("[1,2}", uint64_t(4)),
+				std::make_pair("{1:2}", uint64_t(1)), std::make_pair("[tru]", uint64_t(1)),
+				std::make_pair("[1.]", uint64_t(1)), std::make_pair("{\"a\":[1,2]", uint64_t(10)) };
+			size_t rejected = 0;
+			for (const auto& [text, offset] : malformed)
+				rejected += tokenize(text, 64) == std::make_pair(Tokens{}, offset);
+			// a handler that refuses a token stops the tokenizer
+			cma::JsonTokenizer refusing([](cma::JsonToken token, std::string_view)
+				{
+					return token != cma::JsonToken::Number;
+				});
+			const bool refused = refusing.Consume("[\"a\",1,2]") == false && refusing.Failed() == true &&
+				refusing.Consume("]") == false;
+			detail = std::to_string(expected.size()) + " tokens" + (consistent ? "" : ", differ by chunk size") +
+				(limited ? "" : ", limits not enforced") + ", " + std::to_string(rejected) + "/" +
+				std::to_string(malformed.size()) + " malformed rejected" + (refused ? "" : ", refusal ignored");
+			return consistent == true && limited == true && rejected == malformed.size() && refused == true;
+		} },
+		{ "ndjson-splitter", [](Harness&, std::string& detail)
+		{
+			// splits a body in chunks of a size
+			const auto split = [](std::string_view body, size_t chunkSize, size_t maxRecordSize = 1 << 20)
+			{
+				std::vector<std::string> records;
+				cma::NdjsonSplitter splitter([&](std::string_view record)
+					{
+						records.emplace_back(record);
+						return true;
+					}, maxRecordSize);
+				bool valid = true;
+				for (size_t i = 0; i < body.size() && valid == true; i += chunkSize)
+					valid = splitter.Consume(body.substr(i, chunkSize));
+				valid = valid == true && splitter.Finish() == true;
+				return std::make_pair(valid, records);
+			};
+			// CRLF and LF line ends, empty lines, and a last record without
+			// a newline, with every line end split across chunks somewhere
+			const std::string body = "{\"a\":1}\r\n{\"b\":2}\n\n\r\n{\"c\":\"\\r\"}\r\n[3]";
+			const std::vector<std::string> expected{ "{\"a\":1}", "{\"b\":2}", "{\"c\":\"\\r\"}", "[3]" };
+			bool consistent = true;
+			for (const size_t chunkSize : std::initializer_list<size_t>{ 1, 2, 3, 8, 9, body.size() })
+				consistent &= split(body, chunkSize) == std::make_pair(true, expected);
+			// a record longer than the limit stops the splitter, whether it
+			// came whole or in pieces
+			bool limited = true;
+			for (const size_t chunkSize : { 1, 4, 64 })
+			{
+				limited &= split("12345678\n1234\n", chunkSize, 8).second.size() == 2 &&
+					split("1234\n123456789\n", chunkSize, 8) == std::make_pair(false, std::vector<std::string>{ "1234" }) &&
+					split("123456789", chunkSize, 8).first == false;
+			}
+			// a handler that refuses a record stops the splitter
+			size_t delivered = 0;
+			cma::NdjsonSplitter refusing([&](std::string_view)
+				{
+					return ++delivered < 2;
+				});
+			const bool refused = refusing.Consume("1\n2\n3\n") == false && refusing.Failed() == true &&
+				delivered == 2 && refusing.GetRecords() == 2;
+			detail = std::to_string(expected.size()) + " records" + (consistent ? "" : ", differ by chunk size") +
+				(limited ? "" : ", limit not enforced") + (refused ? "" : ", refusal ignored");
+			return consistent == true && limited == true && refused == true;
+		} },
+	};
+}
+
+int main(int argc, char** argv)
+{
+	Harness harness;
+	bool passed = true;
+	for (const auto& scenario : s_scenarios)
+	{
+		// run only the named scenarios, if any were named
+		if (argc > 1 && std::find_if(argv + 1, argv + argc, [&](const char* arg)
+			{
+				return std::string_view(arg) == scenario.name;
+			}) == argv + argc)
+			continue;
+		std::string detail;
+		const bool result = scenario.run(harness, detail);
+		passed &= result;
+		std::printf("[%s] %-16s %s\n", result ? "PASS" : "FAIL", scenario.name, detail.c_str());
+		std::fflush(stdout);
+	}
+	return passed ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+# - Find brotli
+# Find the brotli decoder includes and library
+# This module defines
+#  BROTLI_INCLUDE_DIR, where to find brotli/decode.h, etc.
+#  BROTLI_FOUND, If false, do not try to use brotli.
+# also defined, but not for general use are
+# BROTLI_LIBRARY, where to find the brotli decoder library.
+
+find_path(BROTLI_INCLUDE_DIR brotli/decode.h)
+
+find_library(BROTLI_LIBRARY
+  NAMES brotlidec
+  )
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(BROTLI
+    REQUIRED_VARS BROTLI_LIBRARY BROTLI_INCLUDE_DIR)
+
+mark_as_advanced(
+  BROTLI_LIBRARY
+  BROTLI_INCLUDE_DIR
+  )
\ No newline at end of file
@@ -0,0 +1,22 @@
+# - Find liburing
+# Find the liburing includes and library
+# This module defines
+#  LIBURING_INCLUDE_DIR, where to find liburing.h, etc.
+#  LIBURING_FOUND, If false, do not try to use liburing.
+# also defined, but not for general use are
+# LIBURING_LIBRARY, where to find the liburing library.
+
+find_path(LIBURING_INCLUDE_DIR liburing.h)
+
+find_library(LIBURING_LIBRARY
+  NAMES uring
+  )
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LIBURING
+    REQUIRED_VARS LIBURING_LIBRARY LIBURING_INCLUDE_DIR)
+
+mark_as_advanced(
+  LIBURING_LIBRARY
+  LIBURING_INCLUDE_DIR
+  )
\ No newline at end of file
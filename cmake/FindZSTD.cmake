@@ -0,0 +1,22 @@
+# - Find zstd
+# Find the zstd includes and library
+# This module defines
+#  ZSTD_INCLUDE_DIR, where to find zstd.h, etc.
+#  ZSTD_FOUND, If false, do not try to use zstd.
+# also defined, but not for general use are
+# ZSTD_LIBRARY, where to find the zstd library.
+
+find_path(ZSTD_INCLUDE_DIR zstd.h)
+
+find_library(ZSTD_LIBRARY
+  NAMES zstd
+  )
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(ZSTD
+    REQUIRED_VARS ZSTD_LIBRARY ZSTD_INCLUDE_DIR)
+
+mark_as_advanced(
+  ZSTD_LIBRARY
+  ZSTD_INCLUDE_DIR
+  )
\ No newline at end of file
@@ -0,0 +1,39 @@
+/*
+ *	Example11 shows ThreadedMulti, which runs cURL on
+ *	its own thread and posts completions back to the
+ *	handler's executor. It has the same interface as
+ *	Multi, so switching between the two is a one-line change
+ */
+
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/ThreadedMulti.h>
+
+#include <iostream>
+#include <thread>
+
+int main()
+{
+	asio::io_context ctx;
+	// cURL's sockets are polled on the multi's own thread, so
+	// the io_context only ever runs our completion handlers. if
+	// ctx was busy with CPU work, socket events wouldn't have to
+	// wait behind it
+	cma::ThreadedMulti multi(ctx);
+	cma::Easy easy;
+	easy.SetURL("http://www.example.com/");
+	easy.SetBuffer(cma::Easy::NullBuffer{});
+	// the handler is posted to ctx, because that's its associated
+	// executor. binding it to a strand would post it there instead
+	multi.AsyncPerform(easy, [](const asio::error_code& ec)
+		{
+			if (ec)
+				std::cerr << "Error: " << ec.message() << " (" << ec << ")\n";
+			else
+				std::cout << "Completed easy perform on thread " <<
+					std::this_thread::get_id() << '\n';
+		});
+	std::cout << "Running handlers on thread " << std::this_thread::get_id() << '\n';
+	// the pending operation keeps ctx from running out of work
+	ctx.run();
+	return 0;
+}
\ No newline at end of file
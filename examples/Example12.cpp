@@ -0,0 +1,53 @@
+/*
+ *	Example12 shows ShardedMulti. Every transfer is routed
+ *	to the first shard, but it can only run a few at once,
+ *	so the idle shards steal the rest before they start.
+ *	The per-shard metrics show where each transfer ran
+ */
+
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/ShardedMulti.h>
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+int main()
+{
+	constexpr size_t shardCount = 4;
+	constexpr size_t transferCount = 32;
+	// one io_context per thread, each with its own multi handle
+	std::vector<asio::io_context> contexts(shardCount);
+	std::vector<asio::any_io_executor> executors;
+	for (auto& ctx : contexts)
+		executors.emplace_back(ctx.get_executor());
+	cma::ShardedMulti sharded(executors, 4);
+	std::vector<cma::Easy> easies(transferCount);
+	std::atomic_size_t failed = 0;
+	for (auto& easy : easies)
+	{
+		easy.SetURL("http://www.example.com/");
+		easy.SetBuffer(cma::Easy::NullBuffer{});
+		// route the whole burst to shard 0
+		sharded.AsyncPerform(0, easy, [&](const asio::error_code& ec)
+			{
+				if (ec)
+					++failed;
+			});
+	}
+	// each shard's pending transfers keep its io_context running
+	std::vector<std::thread> threads;
+	for (auto& ctx : contexts)
+		threads.emplace_back([&ctx] { ctx.run(); });
+	for (auto& thread : threads)
+		thread.join();
+	std::cout << "Failed transfers: " << failed << '\n';
+	for (size_t i = 0; i < sharded.GetShardCount(); ++i)
+	{
+		const auto metrics = sharded.GetMetrics(i);
+		std::cout << "Shard " << i << ": submitted " << metrics.submitted <<
+			", started " << metrics.started << ", stolen " << metrics.stolen <<
+			", stolen from " << metrics.stolenFrom << '\n';
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,185 @@
+#ifndef CURLMULTIASIO_CIRCUITBREAKER_H_
+#define CURLMULTIASIO_CIRCUITBREAKER_H_
+
+/// @file
+/// Per-host circuit breaking
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+
+// STL includes
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cma
+{
+	/// @brief The state of a host's circuit
+	enum class CircuitState
+	{
+		/// @brief Transfers run, and their outcomes are counted
+		Closed,
+		/// @brief Transfers are refused until the open duration has passed
+		Open,
+		/// @brief A few probe transfers run to see if the host is back
+		HalfOpen
+	};
+
+	/// @brief When a CircuitBreaker opens and closes
+	struct CircuitBreakerOptions
+	{
+		/// @brief How many of the latest transfers to a host the rates are
+		/// taken over
+		size_t windowSize = 20;
+		/// @brief How many transfers must be in the window before it can open
+		size_t minimumRequests = 10;
+		/// @brief The share of failed transfers in the window that opens it
+		double failureRate = 0.5;
+		/// @brief Transfers that take at least this long are slow, or zero
+		/// to ignore latency
+		std::chrono::milliseconds slowCallDuration{ 0 };
+		/// @brief The share of slow transfers in the window that opens it
+		double slowCallRate = 0.8;
+		/// @brief How long an open circuit refuses transfers before probing
+		std::chrono::milliseconds openDuration{ 5000 };
+		/// @brief How many probes run at once while half-open, and how many
+		/// must succeed to close the circuit
+		size_t halfOpenProbes = 1;
+		/// @brief Whether a 5xx response counts as a failure
+		bool failOnServerError = true;
+		/// @brief The most origins kept. The least recently used one is
+		/// dropped to make room
+		size_t maxCircuits = 1024;
+	};
+
+	/// @brief A snapshot of a host's circuit
+	struct CircuitStats
+	{
+		/// @brief The origin, such as https://example.com:443
+		std::string origin;
+		/// @brief The state
+		CircuitState state = CircuitState::Closed;
+		/// @brief The share of failed transfers in the window
+		double failureRate = 0.0;
+		/// @brief The share of slow transfers in the window
+		double slowCallRate = 0.0;
+		/// @brief The transfers in the window
+		size_t samples = 0;
+		/// @brief Transfers refused since the circuit was created
+		uint64_t rejected = 0;
+		/// @brief How many times the circuit has opened
+		uint64_t opened = 0;
+	};
+
+	/// @brief CircuitBreaker keeps a circuit per origin, and refuses
+	/// transfers to origins that keep failing or are too slow, so that they
+	/// fail right away instead of holding a socket until the connect timeout.
+	/// The least recently used circuit is dropped once there are
+	/// CircuitBreakerOptions::maxCircuits of them. A circuit opens once too many of the latest transfers failed or were
+	/// slow, refuses everything for a while, then lets a few probes through
+	/// and closes again once they succeed. Failures are connection and
+	/// timeout errors, and 5xx responses. Errors that say nothing about the
+	/// host, like a write callback aborting, aren't counted either way. It is
+	/// attached to a Multi, which completes refused transfers with
+	/// Errc::CircuitOpen. It can be used from any thread
+	class CircuitBreaker
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		/// @brief Creates a circuit breaker
+		/// @param options The options
+		explicit CircuitBreaker(CircuitBreakerOptions options = {});
+		CircuitBreaker(const CircuitBreaker&) = delete;
+		CircuitBreaker& operator=(const CircuitBreaker&) = delete;
+
+		/// @brief Decides whether a transfer may run, and remembers it until
+		/// it is recorded or released if it may. Transfers whose URL has no
+		/// origin are always allowed
+		/// @param easy The easy handle of the transfer
+		/// @param url The URL
+		/// @return Whether it may run
+		bool Allow(CURL* easy, const std::string& url);
+		/// @brief Counts a finished transfer against its origin
+		/// @param easy The easy handle of the transfer
+		/// @param result The result of the transfer
+		void Record(CURL* easy, CURLcode result) noexcept;
+		/// @brief Forgets a transfer that was aborted without a result
+		/// @param easy The easy handle of the transfer
+		void Release(CURL* easy) noexcept;
+
+		/// @param origin The origin, such as https://example.com:443
+		/// @return The state of its circuit
+		CircuitState GetState(const std::string& origin) const;
+		/// @return A snapshot of every circuit
+		std::vector<CircuitStats> GetStats() const;
+		/// @return The options
+		inline const CircuitBreakerOptions& GetOptions() const noexcept { return m_options; }
+
+		/// @param url The URL
+		/// @return Its scheme, host and port, or nothing if it can't be parsed
+		static std::string GetOrigin(const std::string& url);
+	private:
+		// the outcome of a transfer in the window
+		static constexpr uint8_t Failed = 1;
+		static constexpr uint8_t Slow = 2;
+
+		/// @brief The circuit of an origin
+		struct Circuit
+		{
+			CircuitState state = CircuitState::Closed;
+			// the outcomes of the latest transfers, oldest first from next
+			std::vector<uint8_t> window;
+			size_t next = 0;
+			size_t failures = 0;
+			size_t slow = 0;
+			clock::time_point openedAt;
+			// probes running and succeeded while half-open
+			size_t probes = 0;
+			size_t probeSuccesses = 0;
+			uint64_t rejected = 0;
+			uint64_t opened = 0;
+			std::list<std::string>::iterator lru;
+		};
+		/// @brief A transfer that was allowed
+		struct Transfer
+		{
+			std::string origin;
+			bool probe = false;
+		};
+
+		/// @brief Opens a circuit. Must hold the mutex
+		/// @param circuit The circuit
+		/// @param now The current time
+		static void Open(Circuit& circuit, clock::time_point now) noexcept;
+		/// @brief Closes a circuit, and starts a new window. Must hold the mutex
+		/// @param circuit The circuit
+		static void Close(Circuit& circuit) noexcept;
+		/// @brief Adds an outcome to a closed circuit's window, and opens it
+		/// if the rates are too high. Must hold the mutex
+		/// @param circuit The circuit
+		/// @param outcome The outcome
+		/// @param now The current time
+		void Count(Circuit& circuit, uint8_t outcome, clock::time_point now) noexcept;
+		/// @brief Forgets a transfer, and gives back its probe. Must hold
+		/// the mutex
+		/// @param easy The easy handle of the transfer
+		/// @param transfer The transfer, if it was known
+		/// @return Whether it was known
+		bool Forget(CURL* easy, Transfer& transfer) noexcept;
+
+		CircuitBreakerOptions m_options;
+		mutable std::mutex m_mutex;
+		std::unordered_map<std::string, Circuit> m_circuits;
+		// least recently used first
+		std::list<std::string> m_lru;
+		std::unordered_map<CURL*, Transfer> m_transfers;
+	};
+}
+
+#endif
\ No newline at end of file
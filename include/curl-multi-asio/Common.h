@@ -14,6 +14,13 @@ using namespace boost;
 #else
 #include <asio.hpp>
 #endif
+// the io_uring backend only exists since asio 1.21 (boost 1.78)
+#ifdef CMA_USE_IO_URING
+#if (defined(CMA_USE_BOOST) && BOOST_ASIO_VERSION < 102100) || \
+	(!defined(CMA_USE_BOOST) && ASIO_VERSION < 102100)
+#error "CMA_USE_IO_URING requires asio 1.21 or boost 1.78 or newer"
+#endif
+#endif
 // curl includes
 #include <curl/curl.h>
 
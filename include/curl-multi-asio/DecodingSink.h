@@ -0,0 +1,150 @@
+#ifndef CURLMULTIASIO_DECODINGSINK_H_
+#define CURLMULTIASIO_DECODINGSINK_H_
+
+/// @file
+/// Streaming decoding of compressed response bodies
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Error.h>
+
+// STL includes
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace cma
+{
+	/// @brief The Content-Encoding of a response
+	enum class ContentEncoding
+	{
+		Identity,
+		Gzip,
+		Deflate,
+		Zstd,
+		Brotli
+	};
+
+	/// @brief DecoderPool runs the decoding of large chunks off the threads
+	/// that run the multi handles. It can be shared by any number of sinks
+	class DecoderPool
+	{
+	public:
+		/// @brief Starts the worker threads
+		/// @param threads The number of threads
+		explicit DecoderPool(size_t threads = std::max(1u, std::thread::hardware_concurrency() / 2)) :
+			m_pool(threads) {}
+		/// @brief Waits for the chunks that are being decoded
+		~DecoderPool() noexcept { m_pool.join(); }
+		DecoderPool(const DecoderPool&) = delete;
+		DecoderPool& operator=(const DecoderPool&) = delete;
+
+		/// @return The executor of the worker threads
+		inline asio::thread_pool::executor_type GetExecutor() noexcept { return m_pool.get_executor(); }
+	private:
+		asio::thread_pool m_pool;
+	};
+
+	/// @brief How a DecodingSink decodes
+	struct DecodingSinkOptions
+	{
+		/// @brief Chunks of at least this many compressed bytes are decoded
+		/// on the pool, if the sink has one. cURL writes at most
+		/// CURL_MAX_WRITE_SIZE bytes at once, so by default every full
+		/// chunk is, and the small tail of a body is decoded in place
+		size_t offloadThreshold = CURL_MAX_WRITE_SIZE;
+	};
+
+	/// @brief DecodingSink is the body sink of a transfer whose response may
+	/// be compressed. It asks for every encoding it was built with through
+	/// Accept-Encoding, turns off cURL's own decoding, and decodes gzip,
+	/// deflate, zstd and brotli as the body arrives, handing the decoded
+	/// bytes to a consumer. Large chunks are decoded on a DecoderPool while
+	/// the transfer is paused with CURL_WRITEFUNC_PAUSE, so inflating them
+	/// doesn't stall every other transfer on the multi handle. Which codecs
+	/// are built in is decided by CMA_DECODE_ZLIB, CMA_DECODE_ZSTD and
+	/// CMA_DECODE_BROTLI. A failure aborts the transfer with
+	/// CURLE_WRITE_ERROR, and GetError tells why. The sink must outlive
+	/// the transfer, and is only used by it
+	class DecodingSink
+	{
+	public:
+		/// @brief Receives decoded bytes, on the multi handle's thread or on
+		/// the pool, but never on two threads at once
+		using Consumer = std::function<void(std::string_view)>;
+
+		/// @brief Attaches a sink to an easy handle
+		/// @tparam Performer The multi handle type, which resumes paused transfers
+		/// @param multi The multi handle that performs the transfer
+		/// @param easy The easy handle
+		/// @param consumer Receives the decoded bytes
+		/// @param pool The pool that decodes large chunks, or nullptr to
+		/// decode everything on the multi handle's thread
+		/// @param options The options
+		template<typename Performer>
+			requires requires(Performer& performer, const Easy& easy) { performer.Unpause(easy); }
+		DecodingSink(Performer& multi, Easy& easy, Consumer consumer,
+			DecoderPool* pool = nullptr, DecodingSinkOptions options = {}) :
+			DecodingSink(easy, std::move(consumer), [&multi, &easy] { multi.Unpause(easy); },
+				pool, options) {}
+		/// @brief Attaches a sink that appends to a string
+		/// @tparam Performer The multi handle type, which resumes paused transfers
+		/// @param multi The multi handle that performs the transfer
+		/// @param easy The easy handle
+		/// @param body The string the decoded body is appended to
+		/// @param pool The pool that decodes large chunks, or nullptr to
+		/// decode everything on the multi handle's thread
+		/// @param options The options
+		template<typename Performer>
+			requires requires(Performer& performer, const Easy& easy) { performer.Unpause(easy); }
+		DecodingSink(Performer& multi, Easy& easy, std::string& body,
+			DecoderPool* pool = nullptr, DecodingSinkOptions options = {}) :
+			DecodingSink(multi, easy, [&body](std::string_view decoded) { body.append(decoded); },
+				pool, options) {}
+		/// @brief Waits for a chunk that is being decoded on the pool
+		~DecodingSink() noexcept;
+		DecodingSink(const DecodingSink&) = delete;
+		DecodingSink& operator=(const DecodingSink&) = delete;
+
+		/// @return The encoding of the response, once its body started
+		ContentEncoding GetEncoding() const noexcept;
+		/// @return Why decoding failed, if it did
+		error_code GetError() const noexcept;
+		/// @return The number of decoded bytes so far
+		uint64_t GetDecodedBytes() const noexcept;
+		/// @return The number of chunks that were decoded on the pool
+		uint64_t GetOffloadedChunks() const noexcept;
+
+		/// @return The Accept-Encoding value the sink asks for, listing
+		/// the encodings it was built with. Before cURL 7.84 only those with
+		/// a magic number are listed, since the header can't be read
+		static std::string_view GetAcceptEncoding() noexcept;
+	private:
+		struct State;
+
+		/// @brief Attaches a sink to an easy handle
+		/// @param easy The easy handle
+		/// @param consumer Receives the decoded bytes
+		/// @param unpause Resumes the transfer after a chunk was decoded
+		/// on the pool
+		/// @param pool The pool, or nullptr
+		/// @param options The options
+		DecodingSink(Easy& easy, Consumer consumer, std::function<void()> unpause,
+			DecoderPool* pool, DecodingSinkOptions options);
+		/// @brief Decodes chunks of the body. For a description of
+		/// arguments, check cURL documentation for CURLOPT_WRITEFUNCTION
+		/// @return The number of bytes taken, or CURL_WRITEFUNC_PAUSE
+		static size_t WriteCb(char* ptr, size_t size, size_t nmemb, State* userdata) noexcept;
+
+		// shared with the chunk being decoded on the pool
+		std::shared_ptr<State> m_state;
+	};
+}
+
+#endif
\ No newline at end of file
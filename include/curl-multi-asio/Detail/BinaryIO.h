@@ -0,0 +1,72 @@
+#ifndef CURLMULTIASIO_DETAIL_BINARYIO_H_
+#define CURLMULTIASIO_DETAIL_BINARYIO_H_
+
+/// @file
+/// Reading and writing the files that caches are persisted to
+/// 10/19/26
+
+// STL includes
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace cma
+{
+	namespace Detail
+	{
+		// the files never leave the machine that wrote them, so values
+		// are in native byte order
+
+		/// @brief Appends a value
+		/// @param out The output
+		/// @param value The value
+		template<typename T>
+		void WriteValue(std::string& out, T value)
+		{
+			out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+		}
+		/// @brief Appends bytes, prefixed with their size
+		/// @tparam Size The type of the size
+		/// @param out The output
+		/// @param data The bytes
+		/// @param size The number of bytes
+		template<typename Size>
+		void WriteBytes(std::string& out, const void* data, size_t size)
+		{
+			WriteValue(out, static_cast<Size>(size));
+			if (size != 0)
+				out.append(static_cast<const char*>(data), size);
+		}
+		/// @brief Consumes a value
+		/// @param in The input
+		/// @param value The value
+		/// @return Whether there was enough input
+		template<typename T>
+		bool ReadValue(std::string_view& in, T& value)
+		{
+			if (in.size() < sizeof(value))
+				return false;
+			std::memcpy(&value, in.data(), sizeof(value));
+			in.remove_prefix(sizeof(value));
+			return true;
+		}
+		/// @brief Consumes bytes, prefixed with their size. The bytes point
+		/// into the input
+		/// @tparam Size The type of the size
+		/// @param in The input
+		/// @param bytes The bytes
+		/// @return Whether there was enough input
+		template<typename Size>
+		bool ReadBytes(std::string_view& in, std::string_view& bytes)
+		{
+			Size size = 0;
+			if (ReadValue(in, size) == false || in.size() < size)
+				return false;
+			bytes = in.substr(0, size);
+			in.remove_prefix(size);
+			return true;
+		}
+	}
+}
+
+#endif
\ No newline at end of file
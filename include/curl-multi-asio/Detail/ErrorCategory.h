@@ -51,6 +51,21 @@ namespace cma
 				return s_instance;
 			}
 		};
+		/// @brief A category for the library's own errors
+		struct ErrcCategory : error_category
+		{
+			const char* name() const noexcept override
+			{
+				return "cma";
+			}
+			/// @brief Defined in Error.h, once Errc is
+			std::string message(int ev) const override;
+			static const ErrcCategory& Instance() noexcept
+			{
+				static const ErrcCategory s_instance;
+				return s_instance;
+			}
+		};
 	}
 }
 
@@ -0,0 +1,107 @@
+#ifndef CURLMULTIASIO_DETAIL_MPSCQUEUE_H_
+#define CURLMULTIASIO_DETAIL_MPSCQUEUE_H_
+
+/// @file
+/// Intrusive multi-producer single-consumer queue
+/// 10/19/26
+
+// STL includes
+#include <atomic>
+#include <concepts>
+
+namespace cma
+{
+	namespace Detail
+	{
+		/// @brief The link that a type needs to be queued in an MpscQueue
+		class MpscNode
+		{
+		public:
+			/// @return The next node in a batch taken by PopAll
+			inline MpscNode* GetMpscNext() const noexcept { return m_mpscNext; }
+		private:
+			template<typename T>
+			friend class MpscQueue;
+
+			MpscNode* m_mpscNext = nullptr;
+		};
+
+		/// @brief A lock-free intrusive queue that any number of threads
+		/// can push to, and a single consumer drains in batches. Pushing
+		/// never allocates, and draining takes the whole queue with a single
+		/// atomic exchange, so there is no ABA problem
+		/// @tparam T The node type
+		template<typename T>
+		class MpscQueue
+		{
+			static_assert(std::derived_from<T, MpscNode>,
+				"MpscQueue nodes must derive from MpscNode");
+		public:
+			MpscQueue() = default;
+			MpscQueue(const MpscQueue&) = delete;
+			MpscQueue& operator=(const MpscQueue&) = delete;
+			/// @brief Takes the other queue's nodes. Neither queue may be
+			/// in use by another thread
+			/// @param other The other queue
+			MpscQueue(MpscQueue&& other) noexcept :
+				m_head(other.m_head.exchange(nullptr, std::memory_order_relaxed)) {}
+			/// @brief Takes the other queue's nodes. Neither queue may be
+			/// in use by another thread, and this queue must be empty
+			/// @param other The other queue
+			/// @return This queue
+			MpscQueue& operator=(MpscQueue&& other) noexcept
+			{
+				m_head.store(other.m_head.exchange(nullptr,
+					std::memory_order_relaxed), std::memory_order_relaxed);
+				return *this;
+			}
+
+			/// @brief Pushes a node. The queue does not own it
+			/// @param node The node
+			/// @return Whether the queue was empty before the push, which
+			/// means the consumer needs to be woken up
+			inline bool Push(T* node) noexcept
+			{
+				MpscNode* head = m_head.load(std::memory_order_relaxed);
+				do
+				{
+					node->m_mpscNext = head;
+				} while (m_head.compare_exchange_weak(head, node,
+					std::memory_order_release, std::memory_order_relaxed) == false);
+				return head == nullptr;
+			}
+			/// @brief Takes every queued node. Only the consumer may call this
+			/// @return The oldest node, linked to the rest in the order they
+			/// were pushed. Use Next to walk them
+			inline T* PopAll() noexcept
+			{
+				MpscNode* head = m_head.exchange(nullptr, std::memory_order_acquire);
+				// the nodes are linked newest first, so reverse them
+				MpscNode* oldest = nullptr;
+				while (head != nullptr)
+				{
+					MpscNode* next = head->m_mpscNext;
+					head->m_mpscNext = oldest;
+					oldest = head;
+					head = next;
+				}
+				return static_cast<T*>(oldest);
+			}
+			/// @param node A node taken by PopAll
+			/// @return The next node in the batch, or nullptr
+			static inline T* Next(T* node) noexcept
+			{
+				return static_cast<T*>(node->GetMpscNext());
+			}
+			/// @return Whether or not the queue is empty right now
+			inline bool Empty() const noexcept
+			{
+				return m_head.load(std::memory_order_acquire) == nullptr;
+			}
+		private:
+			std::atomic<MpscNode*> m_head = nullptr;
+		};
+	}
+}
+
+#endif
\ No newline at end of file
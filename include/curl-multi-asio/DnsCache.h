@@ -0,0 +1,214 @@
+#ifndef CURLMULTIASIO_DNSCACHE_H_
+#define CURLMULTIASIO_DNSCACHE_H_
+
+/// @file
+/// Asynchronous DNS cache
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/EndpointSelector.h>
+#include <curl-multi-asio/Error.h>
+
+// STL includes
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cma
+{
+	/// @brief How a DnsCache keeps its answers
+	struct DnsCacheOptions
+	{
+		/// @brief How long an answer is used, if the resolver doesn't say
+		std::chrono::seconds ttl{ 60 };
+		/// @brief How long a failed lookup is remembered
+		std::chrono::seconds negativeTtl{ 5 };
+		/// @brief The fraction of the TTL after which a popular name is
+		/// refreshed in the background
+		double refreshAhead = 0.75;
+		/// @brief How many times a name must be used since its last
+		/// lookup to be refreshed in the background
+		uint32_t popularity = 2;
+		/// @brief The most names that are kept
+		size_t maxEntries = 4096;
+	};
+
+	/// @brief Counters of a DnsCache's activity
+	struct DnsCacheStats
+	{
+		/// @brief Lookups answered from the cache
+		uint64_t hits = 0;
+		/// @brief Lookups that had to wait for the resolver
+		uint64_t misses = 0;
+		/// @brief Background refreshes of popular names
+		uint64_t refreshes = 0;
+		/// @brief Resolver calls that failed
+		uint64_t failures = 0;
+	};
+
+	/// @brief DnsCache resolves host names off the transfer's path, and
+	/// keeps the answers with a TTL. Names that are in use are refreshed
+	/// in the background before they expire, so a request for a hot host
+	/// never waits on DNS. The answers are handed to cURL through
+	/// CURLOPT_RESOLVE. By default names are resolved with asio's resolver,
+	/// which uses a single background thread instead of one per lookup,
+	/// but any resolver, such as c-ares or a stub for testing, can be
+	/// plugged in. It can be used from any thread
+	class DnsCache
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+		using address_list = std::vector<asio::ip::address>;
+		/// @brief Called by a resolver with its answer, and the TTL of the
+		/// answer or zero if it doesn't know it
+		using ResolveHandler = std::function<void(const error_code&,
+			address_list, std::chrono::seconds)>;
+		/// @brief A resolver. It must call the handler exactly once
+		using ResolveFunction = std::function<void(const std::string&, ResolveHandler)>;
+		/// @brief Called once a lookup that Prepare waited on is done, with
+		/// the function that pins the easy handle. It must call it before
+		/// the handle is performed, and must not once the handle may be gone
+		using ReadyHandler = std::function<void(const std::function<void()>&)>;
+
+		/// @brief Creates a cache that resolves with asio's resolver
+		/// @param executor The executor for lookups
+		/// @param options The options
+		explicit DnsCache(const asio::any_io_executor& executor,
+			DnsCacheOptions options = {});
+		/// @brief Creates a cache that resolves with a custom resolver
+		/// @param resolver The resolver
+		/// @param options The options
+		explicit DnsCache(ResolveFunction resolver, DnsCacheOptions options = {});
+		/// @brief Calls every pending lookup with asio::error::operation_aborted
+		~DnsCache() noexcept;
+		DnsCache(const DnsCache&) = delete;
+		DnsCache& operator=(const DnsCache&) = delete;
+
+		/// @brief Resolves a host name, from the cache if possible. A handler
+		/// without an associated executor is run by the system executor. The
+		/// completion token signature is void(error_code, address_list)
+		/// @tparam CompletionToken The completion token type
+		/// @param host The host name
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncResolve(std::string host, CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler, std::string host)
+			{
+				auto executor = asio::get_associated_executor(handler);
+				auto work = std::make_shared<asio::executor_work_guard<decltype(executor)>>(executor);
+				// the waiter must be copyable, so the handler is kept on the heap
+				auto shared = std::make_shared<std::decay_t<decltype(handler)>>(std::move(handler));
+				Waiter waiter = [shared, work](const Answer& answer)
+				{
+					// a hit is answered by the initiation, so always post
+					asio::post(work->get_executor(), [shared, ec = answer.error,
+						addresses = answer.addresses]() mutable
+						{
+							(*shared)(ec, std::move(addresses));
+						});
+					work->reset();
+				};
+				if (const auto answer = Lookup(host, waiter); answer != nullptr)
+					waiter(*answer);
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code, address_list)>(initiation, token, std::move(host));
+		}
+		/// @brief Pins the host of an easy handle's URL to the cached
+		/// addresses through CURLOPT_RESOLVE, replacing the handle's other
+		/// entries. On a miss, the host is resolved first. Hosts that are IP
+		/// addresses, or that fail to resolve, are left to cURL. With a
+		/// selector, a host with several addresses is pinned to the one it
+		/// chooses through CURLOPT_CONNECT_TO
+		/// @param easy The easy handle, with its URL set
+		/// @param ready Called once the lookup is done, if the easy handle
+		/// wasn't ready right away. It may be called from the resolver's
+		/// thread
+		/// @param selector The endpoint selector, or nullptr to leave the
+		/// choice to cURL
+		/// @return Whether the easy handle was ready right away, in which
+		/// case ready is not called
+		bool Prepare(Easy& easy, ReadyHandler ready,
+			EndpointSelector* selector = nullptr);
+
+		/// @brief Forgets every answer. Pending lookups still complete
+		void Clear() noexcept;
+		/// @return The counters
+		DnsCacheStats GetStats() const noexcept;
+		/// @return The options
+		inline const DnsCacheOptions& GetOptions() const noexcept { return m_state->options; }
+	private:
+		/// @brief The result of a lookup, shared by everything that uses it
+		struct Answer
+		{
+			error_code error;
+			address_list addresses;
+			// the addresses, formatted for CURLOPT_RESOLVE
+			std::string resolveList;
+		};
+		using Waiter = std::function<void(const Answer&)>;
+		/// @brief A cached answer, and the lookups waiting on the next one
+		struct Entry
+		{
+			std::shared_ptr<const Answer> answer;
+			clock::time_point expiresAt;
+			clock::time_point refreshAt;
+			// uses since the last lookup
+			uint32_t uses = 0;
+			bool resolving = false;
+			std::vector<Waiter> waiters;
+		};
+		/// @brief Everything the resolver's handlers touch. They hold on to
+		/// it, so that a lookup can finish after the cache is destroyed
+		struct State
+		{
+			explicit State(DnsCacheOptions options) noexcept : options(options) {}
+
+			const DnsCacheOptions options;
+			std::mutex mutex;
+			std::unordered_map<std::string, Entry> entries;
+			DnsCacheStats stats;
+			// cleared under the mutex by the destructor
+			bool alive = true;
+		};
+
+		/// @brief Answers from the cache, or queues the waiter and resolves.
+		/// Starts a background refresh if a hit is due for one
+		/// @param host The host name
+		/// @param waiter Called with the answer on a miss. It is left alone
+		/// on a hit
+		/// @return The answer on a hit, otherwise nullptr
+		std::shared_ptr<const Answer> Lookup(const std::string& host, Waiter& waiter);
+		/// @brief Calls the resolver for a name
+		/// @param host The host name
+		void Resolve(const std::string& host);
+		/// @brief Stores an answer and wakes up everything waiting on it,
+		/// unless the cache is gone
+		/// @param state The state of the cache
+		/// @param host The host name
+		/// @param ec The error
+		/// @param addresses The addresses
+		/// @param ttl The TTL, or zero for the default
+		static void OnResolved(State& state, const std::string& host, const error_code& ec,
+			address_list addresses, std::chrono::seconds ttl);
+		/// @brief Makes room for a new name. Must hold the mutex
+		void Evict() noexcept;
+		/// @brief The default resolver, which uses asio's resolver
+		/// @param executor The executor for lookups
+		/// @return The resolver
+		static ResolveFunction MakeAsioResolver(const asio::any_io_executor& executor);
+
+		ResolveFunction m_resolver;
+		std::shared_ptr<State> m_state;
+	};
+}
+
+#endif
\ No newline at end of file
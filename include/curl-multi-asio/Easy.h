@@ -14,10 +14,14 @@
 #include <tl/expected.hpp>
 
 // STL includes
+#include <algorithm>
 #include <initializer_list>
 #include <memory>
 #include <ostream>
 #include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 
 /// @brief This concept detects any type, such as std::string,
@@ -39,10 +43,27 @@ concept DataIterator = requires(T a)
 /// @brief This concept detects whether or not a type is an ostream.
 template<typename T>
 concept IsOstream = std::is_base_of_v<std::ostream, T>;
+/// @brief This concept detects a body consumer, such as a streaming
+/// parser, which is handed each chunk of the body as it arrives and
+/// returns false to abort the transfer
+template<typename T>
+concept BodyConsumer = requires(T a, std::string_view chunk)
+{
+	{ a.Consume(chunk) } -> std::convertible_to<bool>;
+};
+/// @brief This concept detects a pointer to a write callback, whatever
+/// its data pointer points to
+template<typename T>
+concept WriteCallback = std::is_pointer_v<T> && std::is_function_v<std::remove_pointer_t<T>> &&
+	requires(T f, char* ptr, size_t n)
+{
+	{ f(ptr, n, n, nullptr) } -> std::same_as<size_t>;
+};
 
 namespace cma
 {
-	class Multi;
+	template<typename ThreadingPolicy>
+	class BasicMulti;
 
 	/// @brief Easy is a wrapper around an easy CURL handle
 	class Easy
@@ -55,6 +76,20 @@ namespace cma
 		};
 		struct DefaultBuffer {};
 		struct NullBuffer {};
+		/// @brief Where the body of a transfer goes, as set by SetBuffer
+		/// or the CURLOPT_WRITEFUNCTION and CURLOPT_WRITEDATA options, or
+		/// where its headers go, as set by CURLOPT_HEADERFUNCTION and
+		/// CURLOPT_HEADERDATA
+		struct Sink
+		{
+			/// @brief The write callback, or nullptr for cURL's default
+			curl_write_callback function = nullptr;
+			/// @brief The data passed to the write callback
+			void* data = nullptr;
+			/// @brief Whether or not the sink keeps the body, such as a
+			/// string or a stream, rather than consuming it as it arrives
+			bool buffered = false;
+		};
 
 		/// @brief Creates an easy CURL handle by curl_easy_init.
 		Easy() noexcept;
@@ -95,6 +130,22 @@ namespace cma
 		bool AddHeader(std::pair<std::string_view, std::string_view> header) noexcept;
 		/// @brief Clears the custom headers from the cURL request
 		inline void ClearHeaders() noexcept { m_headerList.reset(); }
+		/// @return The custom headers, or nullptr if there are none
+		inline curl_slist* GetHeaderList() const noexcept { return m_headerList.get(); }
+		/// @brief Adds a CURLOPT_RESOLVE entry, which pins a host and port
+		/// to a list of addresses
+		/// @param resolveStr The entry, in the form [+]host:port:addr[,addr]...
+		/// @return The success of the operation
+		bool AddResolveStr(const char* resolveStr) noexcept;
+		/// @brief Clears the CURLOPT_RESOLVE entries
+		void ClearResolve() noexcept;
+		/// @brief Adds a CURLOPT_CONNECT_TO entry, which connects to another
+		/// host and port in place of the URL's
+		/// @param connectToStr The entry, in the form host:port:connect-to-host:connect-to-port
+		/// @return The success of the operation
+		bool AddConnectToStr(const char* connectToStr) noexcept;
+		/// @brief Clears the CURLOPT_CONNECT_TO entries
+		void ClearConnectTo() noexcept;
 
 		/// @brief Gets info from the easy handle
 		/// @tparam T The data type
@@ -125,22 +176,58 @@ namespace cma
 			// no copy elision here. move it into the expected
 			return std::move(inst);
 		}
-		/// @brief Sets a buffer that either accepts appending strings
-		/// or is an ostream. The buffer must stay in scope until the
-		/// call to Perform, otherwise the call will result in undefied behavior
+		/// @brief Sets a buffer that either accepts appending strings,
+		/// is an ostream, or consumes the body chunk by chunk. The buffer
+		/// must stay in scope until the call to Perform, otherwise the call
+		/// will result in undefied behavior
 		/// @param buffer The buffer
 		/// @return The resulting error
 		template<typename T>
 		error_code SetBuffer(T& buffer) noexcept requires
-			AcceptsCharacters<T> || IsOstream<T>
+			AcceptsCharacters<T> || IsOstream<T> || BodyConsumer<T>
 		{
 			// set the buffer first in case it fails, to avoid potential
 			// calls with a null buffer
 			if (const auto err = SetOption(CURLoption::CURLOPT_WRITEDATA,
 				&buffer); err)
 				return err;
-			return SetOption(CURLoption::CURLOPT_WRITEFUNCTION, WriteCb<T>);
+			if (const auto err = SetOption(CURLoption::CURLOPT_WRITEFUNCTION, WriteCb<T>); err)
+				return err;
+			m_sink.buffered = AcceptsCharacters<T> || IsOstream<T>;
+			return {};
+		}
+		/// @return Where the body of a transfer goes
+		inline const Sink& GetSink() const noexcept { return m_sink; }
+		/// @return Where the response headers of a transfer go
+		inline const Sink& GetHeaderSink() const noexcept { return m_headerSink; }
+		/// @brief Limits the size of the response body. A Content-Length
+		/// over the limit fails the transfer with CURLE_FILESIZE_EXCEEDED
+		/// before any of the body arrives. On a multi handle with a
+		/// MemoryBudget, so does a body without one as soon as it grows past
+		/// the limit, which cURL itself only checks since 8.4
+		/// @param maxBodySize The most bytes of body, or -1 for no limit
+		/// @return The resulting error
+		inline error_code SetMaxBodySize(curl_off_t maxBodySize) noexcept
+		{
+			// cURL takes 0 as no limit
+			if (const auto res = SetOption(CURLoption::CURLOPT_MAXFILESIZE_LARGE,
+				std::max<curl_off_t>(maxBodySize, 0)); res)
+				return res;
+			m_maxBodySize = maxBodySize;
+			return {};
 		}
+		/// @return The most bytes of response body, or -1 for no limit
+		inline curl_off_t GetMaxBodySize() const noexcept { return m_maxBodySize; }
+		/// @brief Ties a MemoryBudget's charge to the easy handle, so that
+		/// it is given back once the handle is destroyed or assigned over.
+		/// Copies don't share it
+		/// @param charge Gives the charge back once the last owner lets go
+		inline void SetCharge(std::shared_ptr<void> charge) noexcept { m_charge = std::move(charge); }
+		/// @return The MemoryBudget's charge, or nullptr if there is none
+		inline const std::shared_ptr<void>& GetCharge() const noexcept { return m_charge; }
+		/// @brief Gives the MemoryBudget's charge back, such as once the
+		/// body was moved out of the buffer it was charged for
+		inline void ReleaseCharge() noexcept { m_charge.reset(); }
 		/// @brief Sets an option on the easy handle
 		/// @tparam T The value type
 		/// @param option The option
@@ -149,8 +236,21 @@ namespace cma
 		template<typename T>
 		inline error_code SetOption(CURLoption option, T&& value) noexcept
 		{
+			// the sinks are remembered, so that they can be wrapped
+			if (option == CURLoption::CURLOPT_WRITEFUNCTION || option == CURLoption::CURLOPT_WRITEDATA ||
+				option == CURLoption::CURLOPT_HEADERFUNCTION || option == CURLoption::CURLOPT_HEADERDATA)
+				RememberSink(option, value);
 			// weird GCC bug where forward thinks its return value is ignored
-			return curl_easy_setopt(GetNativeHandle(), option, static_cast<T&&>(value));
+			const error_code res = curl_easy_setopt(GetNativeHandle(), option, static_cast<T&&>(value));
+			// cURL only reports the URL once a transfer has started, so it is
+			// remembered however it was set
+			if (option == CURLoption::CURLOPT_URL && !res)
+				RememberURL(value);
+			// as is the method and whether redirects are followed, which
+			// decide whether a cached redirect may stand in for one
+			else if (!res)
+				RememberRequest(option, value);
+			return res;
 		}
 		/// @brief Sets post data to the data, and sets method to POST. 
 		/// Per cURL docs, it also sets the data type in the header to
@@ -230,9 +330,121 @@ namespace cma
 				urlEncodedParams.begin(), urlEncodedParams.end())).c_str());
 		}
 
+		/// @return The URL last set through SetURL or CURLOPT_URL
+		inline const std::string& GetURL() const noexcept { return m_url; }
+		/// @return The method the request is sent with, as set through
+		/// CURLOPT_CUSTOMREQUEST, CURLOPT_POST, CURLOPT_UPLOAD, CURLOPT_NOBODY
+		/// and the like
+		inline std::string_view GetMethod() const noexcept
+		{
+			return (m_customMethod.empty() == false) ? std::string_view(m_customMethod) : m_method;
+		}
+		/// @return Whether CURLOPT_FOLLOWLOCATION is on
+		inline bool GetFollowLocation() const noexcept { return m_followLocation; }
+
 		/// @return Whether or not the handle is valid
 		inline operator bool() const noexcept { return m_nativeHandle != nullptr; }
 	private:
+		/// @brief Remembers the write or header callback, or its data
+		/// @tparam T The value type
+		/// @param option CURLOPT_WRITEFUNCTION, CURLOPT_WRITEDATA,
+		/// CURLOPT_HEADERFUNCTION or CURLOPT_HEADERDATA
+		/// @param value The value
+		template<typename T>
+		void RememberSink(CURLoption option, const T& value) noexcept
+		{
+			using Value = std::decay_t<T>;
+			constexpr bool isFunction = std::is_pointer_v<Value> &&
+				std::is_function_v<std::remove_pointer_t<Value>>;
+			auto& sink = (option == CURLoption::CURLOPT_HEADERFUNCTION ||
+				option == CURLoption::CURLOPT_HEADERDATA) ? m_headerSink : m_sink;
+			if (option == CURLoption::CURLOPT_WRITEFUNCTION ||
+				option == CURLoption::CURLOPT_HEADERFUNCTION)
+			{
+				// SetBuffer says whether the new sink keeps the body
+				sink.buffered = false;
+				// only a callback of the right shape can be called as one.
+				// the cast just changes what its data pointer points to
+				if constexpr (WriteCallback<Value> == true)
+					sink.function = reinterpret_cast<curl_write_callback>(value);
+				else
+					sink.function = nullptr;
+			}
+			else if constexpr (std::is_pointer_v<Value> == true && isFunction == false)
+				sink.data = const_cast<void*>(static_cast<const void*>(value));
+			else
+				sink.data = nullptr;
+		}
+
+		/// @brief Remembers the URL set through CURLOPT_URL
+		/// @tparam T The value type
+		/// @param value The value
+		template<typename T>
+		void RememberURL(const T& value) noexcept
+		{
+			if constexpr (std::is_convertible_v<const T&, const char*> == true)
+			{
+				const char* url = value;
+				m_url = (url != nullptr) ? url : "";
+			}
+			else
+				m_url.clear();
+		}
+
+		/// @brief Remembers the options that pick the method, and
+		/// CURLOPT_FOLLOWLOCATION. Any other option is ignored
+		/// @tparam T The value type
+		/// @param option The option
+		/// @param value The value
+		template<typename T>
+		void RememberRequest(CURLoption option, const T& value) noexcept
+		{
+			using Value = std::decay_t<T>;
+			if (option == CURLoption::CURLOPT_CUSTOMREQUEST)
+			{
+				if constexpr (std::is_convertible_v<const T&, const char*> == true)
+				{
+					const char* method = value;
+					m_customMethod = (method != nullptr) ? method : "";
+				}
+				else
+					m_customMethod.clear();
+			}
+			else if (option == CURLoption::CURLOPT_POSTFIELDS ||
+				option == CURLoption::CURLOPT_COPYPOSTFIELDS ||
+				option == CURLoption::CURLOPT_MIMEPOST)
+				m_method = "POST";
+			else if constexpr (std::is_integral_v<Value> == true)
+			{
+				const bool on = value != 0;
+				switch (option)
+				{
+				case CURLoption::CURLOPT_FOLLOWLOCATION:
+					m_followLocation = on;
+					break;
+				case CURLoption::CURLOPT_POST:
+					m_method = on ? "POST" : "GET";
+					break;
+				case CURLoption::CURLOPT_UPLOAD:
+					m_method = on ? "PUT" : "GET";
+					break;
+				case CURLoption::CURLOPT_NOBODY:
+					// cURL only goes back to GET if the request was a HEAD
+					if (on == true)
+						m_method = "HEAD";
+					else if (m_method == std::string_view("HEAD"))
+						m_method = "GET";
+					break;
+				case CURLoption::CURLOPT_HTTPGET:
+					if (on == true)
+						m_method = "GET";
+					break;
+				default:
+					break;
+				}
+			}
+		}
+
 		/// @brief URL-encodes key-value pairs
 		/// @param begin The starting iterator of the data
 		/// @param end The ending iterator of the data
@@ -257,7 +469,7 @@ namespace cma
 		/// CURLOPT_WRITEFUNCTION
 		/// @return The numver of bytes taken care of
 		template<IsOstream T>
-		static size_t WriteCb(char* ptr, size_t size, size_t nmemb, std::ostream* buffer) noexcept
+		static size_t WriteCb(char* ptr, size_t, size_t nmemb, std::ostream* buffer) noexcept
 		{
 			buffer->write(ptr, nmemb);
 			return nmemb;
@@ -267,7 +479,7 @@ namespace cma
 		/// CURLOPT_WRITEFUNCTION
 		/// @return The number of bytes taken care of
 		template<AcceptsCharacters T>
-		static size_t WriteCb(char* ptr, size_t size, size_t nmemb, T* buffer) noexcept
+		static size_t WriteCb(char* ptr, size_t, size_t nmemb, T* buffer) noexcept
 		{
 			const size_t oldSize = buffer->size();
 			// allocate space for the new data
@@ -275,12 +487,30 @@ namespace cma
 			std::copy(ptr, ptr + nmemb, &buffer->data()[oldSize]);
 			return nmemb;
 		}
+		/// @brief The write callback for body consumers. A consumer that
+		/// refuses a chunk, or throws, aborts the transfer with
+		/// CURLE_WRITE_ERROR. For a description of each argument, check
+		/// cURL docs for CURLOPT_WRITEFUNCTION
+		/// @return The number of bytes taken care of
+		template<BodyConsumer T>
+		static size_t WriteCb(char* ptr, size_t, size_t nmemb, T* buffer) noexcept
+			requires(AcceptsCharacters<T> == false)
+		{
+			try
+			{
+				return (buffer->Consume(std::string_view(ptr, nmemb)) == true) ? nmemb : 0;
+			}
+			catch (...)
+			{
+				return 0;
+			}
+		}
 		/// @brief The write callback for null buffers. For a 
 		/// description of each argument, check cURL docs for
 		/// CURLOPT_WRITEFUNCTION
 		/// @return The number of bytes taken care of
 		template<typename T>
-		static size_t WriteCb(char* ptr, size_t size, size_t nmemb, T* buffer) requires(std::is_same_v<T, NullBuffer>)
+		static size_t WriteCb(char*, size_t, size_t nmemb, T*) requires(std::is_same_v<T, NullBuffer>)
 		{
 			return nmemb;
 		}
@@ -290,7 +520,18 @@ namespace cma
 #endif
 		std::unique_ptr<CURL, decltype(&curl_easy_cleanup)> m_nativeHandle;
 		std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> m_headerList;
+		std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> m_resolveList;
+		std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> m_connectToList;
 		std::string m_postData;
+		std::string m_url;
+		const char* m_method = "GET";
+		std::string m_customMethod;
+		bool m_followLocation = false;
+		Sink m_sink;
+		Sink m_headerSink;
+		curl_off_t m_maxBodySize = -1;
+		// released before the handle it names
+		std::shared_ptr<void> m_charge;
 	};
 }
 
@@ -0,0 +1,141 @@
+#ifndef CURLMULTIASIO_ENDPOINTSELECTOR_H_
+#define CURLMULTIASIO_ENDPOINTSELECTOR_H_
+
+/// @file
+/// Latency-aware endpoint selection
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+
+// STL includes
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cma
+{
+	/// @brief How an EndpointSelector weighs and ejects endpoints
+	struct EndpointSelectorOptions
+	{
+		/// @brief The weight of each new sample in the moving averages
+		double alpha = 0.3;
+		/// @brief How many times slower than the median of its host an
+		/// endpoint must be to be ejected
+		double outlierFactor = 3.0;
+		/// @brief Endpoints faster than this are never ejected for latency,
+		/// so noise on a fast network doesn't eject anything
+		std::chrono::microseconds minOutlierLatency{ 5000 };
+		/// @brief How many failures in a row eject an endpoint
+		uint32_t failuresToEject = 3;
+		/// @brief How long an ejected endpoint is left alone
+		std::chrono::seconds cooldown{ 10 };
+	};
+
+	/// @brief A snapshot of what is known about an endpoint
+	struct EndpointStats
+	{
+		/// @brief The address
+		asio::ip::address address;
+		/// @brief The host it was last chosen for
+		std::string host;
+		/// @brief The moving average of the time to connect
+		std::chrono::microseconds connectTime{ 0 };
+		/// @brief The moving average of the time from connecting to the first byte
+		std::chrono::microseconds firstByteTime{ 0 };
+		/// @brief Transfers that have been measured since the endpoint was
+		/// last ejected
+		uint64_t samples = 0;
+		/// @brief Transfers that are running on the endpoint
+		uint32_t inFlight = 0;
+		/// @brief Whether it is cooling down
+		bool ejected = false;
+	};
+
+	/// @brief EndpointSelector balances the transfers to a host over its
+	/// addresses, instead of letting cURL try them in order. It keeps a
+	/// moving average of each address's connect time and time to first
+	/// byte, picks between two random addresses by their latency and load,
+	/// and ejects addresses that keep failing or are much slower than their
+	/// peers for a cooldown. It is attached to a Multi along with a DnsCache,
+	/// which supplies the addresses, and the chosen address is pinned
+	/// through CURLOPT_CONNECT_TO. It can be used from any thread
+	class EndpointSelector
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		/// @brief Creates a selector
+		/// @param options The options
+		explicit EndpointSelector(EndpointSelectorOptions options = {});
+		EndpointSelector(const EndpointSelector&) = delete;
+		EndpointSelector& operator=(const EndpointSelector&) = delete;
+
+		/// @brief Chooses an address for a transfer, and remembers it until
+		/// the transfer is recorded or released
+		/// @param easy The easy handle of the transfer
+		/// @param host The host name
+		/// @param addresses The host's addresses
+		/// @return The address, or nothing if there is no choice to make
+		std::optional<asio::ip::address> Select(CURL* easy, const std::string& host,
+			const std::vector<asio::ip::address>& addresses);
+		/// @brief Measures a finished transfer against the address it was
+		/// pinned to, or the one it connected to if it wasn't pinned
+		/// @param easy The easy handle of the transfer
+		/// @param result The result of the transfer
+		void Record(CURL* easy, CURLcode result) noexcept;
+		/// @brief Forgets a transfer that was aborted without a result
+		/// @param easy The easy handle of the transfer
+		void Release(CURL* easy) noexcept;
+
+		/// @return A snapshot of every endpoint
+		std::vector<EndpointStats> GetStats() const;
+		/// @return The options
+		inline const EndpointSelectorOptions& GetOptions() const noexcept { return m_options; }
+	private:
+		/// @brief What is known about an address
+		struct Endpoint
+		{
+			std::string host;
+			double connectTime = 0.0;
+			double firstByteTime = 0.0;
+			uint64_t samples = 0;
+			uint32_t inFlight = 0;
+			uint32_t failures = 0;
+			clock::time_point ejectedUntil;
+		};
+
+		/// @param endpoint The endpoint
+		/// @return The cost of sending another transfer to it. Endpoints
+		/// without samples cost nothing, so that they get measured
+		static double Cost(const Endpoint& endpoint) noexcept;
+		/// @brief Ejects the endpoints of a host that are much slower than
+		/// the median of its measured endpoints. Must hold the mutex
+		/// @param host The host name
+		/// @param now The current time
+		void EjectOutliers(const std::string& host, clock::time_point now) noexcept;
+		/// @brief Takes an endpoint out of rotation for the cooldown. Must
+		/// hold the mutex
+		/// @param endpoint The endpoint
+		/// @param now The current time
+		void Eject(Endpoint& endpoint, clock::time_point now) noexcept;
+		/// @brief Takes the pin of a transfer off its endpoint. Must hold
+		/// the mutex
+		/// @param easy The easy handle of the transfer
+		/// @return The address it was pinned to, if any
+		std::optional<asio::ip::address> Unpin(CURL* easy) noexcept;
+
+		EndpointSelectorOptions m_options;
+		mutable std::mutex m_mutex;
+		std::unordered_map<std::string, Endpoint> m_endpoints;
+		// the address each running transfer was pinned to
+		std::unordered_map<CURL*, asio::ip::address> m_pins;
+		std::minstd_rand m_random;
+	};
+}
+
+#endif
\ No newline at end of file
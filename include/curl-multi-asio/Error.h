@@ -9,8 +9,41 @@
 #include <curl-multi-asio/Detail/ErrorCategory.h>
 
 // STL includes
+#include <string>
 #include <string_view>
 
+namespace cma
+{
+	/// @brief Errors of the library itself, rather than of cURL
+	enum class Errc
+	{
+		/// @brief The request was refused without touching the network,
+		/// because the circuit breaker for its host is open
+		CircuitOpen = 1,
+		/// @brief The response body couldn't be decoded, or came in an
+		/// encoding that wasn't asked for
+		DecodingFailed = 2,
+		/// @brief A Server-Sent Events stream was answered with something
+		/// other than a text/event-stream
+		NotEventStream = 3
+	};
+
+	inline std::string Detail::ErrcCategory::message(int ev) const
+	{
+		switch (static_cast<Errc>(ev))
+		{
+		case Errc::CircuitOpen:
+			return "Circuit breaker is open";
+		case Errc::DecodingFailed:
+			return "Content decoding failed";
+		case Errc::NotEventStream:
+			return "Response is not an event stream";
+		default:
+			return "Unknown error";
+		}
+	}
+}
+
 // register the error codes
 #ifdef CMA_USE_BOOST
 namespace boost
@@ -25,6 +58,8 @@ namespace std
 	struct is_error_code_enum<CURLcode> : std::true_type {};
 	template<>
 	struct is_error_code_enum<CURLMcode> : std::true_type {};
+	template<>
+	struct is_error_code_enum<cma::Errc> : std::true_type {};
 #ifdef CMA_USE_BOOST
 	}
 }
@@ -39,6 +74,14 @@ namespace cma
 #else
 	using error_code = asio::error_code;
 #endif
+
+	/// @brief Makes an error code from an Errc
+	/// @param code The Errc
+	/// @return The error code
+	inline error_code make_error_code(Errc code) noexcept
+	{
+		return { static_cast<int>(code), Detail::ErrcCategory::Instance() };
+	}
 }
 
 /// @brief Makes an error code from a CURLcode
@@ -0,0 +1,288 @@
+#ifndef CURLMULTIASIO_EVENTSOURCE_H_
+#define CURLMULTIASIO_EVENTSOURCE_H_
+
+/// @file
+/// Server-Sent Events streams
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/Multi.h>
+
+// STL includes
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cma
+{
+	/// @brief An event of a text/event-stream. The views are only valid
+	/// while the handler runs
+	struct ServerSentEvent
+	{
+		/// @brief The event field, or "message" if there was none
+		std::string_view type;
+		/// @brief The data fields, joined by newlines
+		std::string_view data;
+		/// @brief The last event ID the stream set, this event's or an
+		/// earlier one's
+		std::string_view id;
+	};
+
+	/// @brief EventStreamParser frames a text/event-stream as it arrives.
+	/// Chunks are appended to a buffer that is scanned once, from where the
+	/// last scan stopped, and the fields of an event are handed over as
+	/// views of it. Only an event with several data lines is copied, to
+	/// join them. The buffer compacts in place rather than wrapping, so
+	/// every field stays contiguous, and only the event being framed is
+	/// ever kept. It is a body consumer, so it can be passed to
+	/// Easy::SetBuffer
+	class EventStreamParser
+	{
+	public:
+		/// @brief Receives an event. Returning false stops the parser, and
+		/// aborts the transfer
+		using Handler = std::function<bool(const ServerSentEvent& event)>;
+
+		/// @brief Creates a parser
+		/// @param handler Receives the events
+		/// @param maxEventSize The largest event accepted, in bytes of the stream
+		explicit EventStreamParser(Handler handler, size_t maxEventSize = 1 << 20);
+
+		/// @brief Frames the next chunk of the stream
+		/// @param chunk The chunk
+		/// @return Whether or not the parser is still going
+		bool Consume(std::string_view chunk);
+		/// @brief Drops a partly framed event, as a stream that ends does,
+		/// but keeps the last event ID and retry
+		void Reset() noexcept;
+
+		/// @return Whether or not the parser stopped, because an event was
+		/// too large or the handler refused one
+		inline bool Failed() const noexcept { return m_failed; }
+		/// @return The last event ID the stream set
+		inline const std::string& GetLastEventId() const noexcept { return m_lastEventId; }
+		/// @param id The last event ID, such as one persisted by an earlier run
+		inline void SetLastEventId(std::string id) { m_lastEventId = std::move(id); }
+		/// @return The reconnection time the stream asked for, or zero
+		inline std::chrono::milliseconds GetRetry() const noexcept { return m_retry; }
+		/// @return The number of events handed over
+		inline uint64_t GetEvents() const noexcept { return m_events; }
+	private:
+		/// @brief Where a field's value lies in the buffer
+		struct Span
+		{
+			size_t offset = 0;
+			size_t length = 0;
+		};
+
+		/// @brief Handles a line of the stream
+		/// @param begin Where the line starts in the buffer
+		/// @param end Where it ends, before its line break
+		/// @return Whether or not the parser is still going
+		bool OnLine(size_t begin, size_t end);
+		/// @brief Hands over the event that a blank line ended
+		/// @return Whether or not the parser is still going
+		bool Dispatch();
+		/// @param span The span
+		/// @return The view of a span
+		inline std::string_view View(Span span) const noexcept
+		{
+			return std::string_view(m_buffer.data() + span.offset, span.length);
+		}
+
+		Handler m_handler;
+		size_t m_maxEventSize;
+		std::vector<char> m_buffer;
+		// the start of the event being framed, the start of the line being
+		// framed, and the end of the stream so far
+		size_t m_eventStart = 0;
+		size_t m_lineStart = 0;
+		size_t m_end = 0;
+		// the fields of the event being framed
+		Span m_type;
+		Span m_data;
+		size_t m_dataLines = 0;
+		// several data lines are joined here
+		std::string m_joined;
+		std::string m_lastEventId;
+		std::chrono::milliseconds m_retry{ 0 };
+		uint64_t m_events = 0;
+		// a line ended in a carriage return, so a newline that follows
+		// belongs to it
+		bool m_skipNewline = false;
+		bool m_failed = false;
+	};
+
+	/// @brief How an EventSource reconnects
+	struct EventSourceOptions
+	{
+		/// @brief How long to wait before reconnecting, until the stream
+		/// asks for another time with a retry field
+		std::chrono::milliseconds retry{ 3000 };
+		/// @brief The longest wait between reconnections. The wait doubles
+		/// for each connection in a row that ends without an event
+		std::chrono::milliseconds maxRetry{ 60000 };
+		/// @brief The most reconnections in a row without an event, before
+		/// the source gives up
+		size_t maxReconnects = SIZE_MAX;
+		/// @brief The largest event accepted, in bytes of the stream
+		size_t maxEventSize = 1 << 20;
+	};
+
+	/// @brief BasicEventSource follows a Server-Sent Events stream on a
+	/// multi handle. It performs a GET that accepts text/event-stream, and
+	/// frames the body as it arrives with an EventStreamParser, handing
+	/// each event to a handler. When the stream ends or the connection
+	/// fails, it reconnects after the retry time, sending the last event ID
+	/// in Last-Event-ID so the server can pick up where it left off. A 204,
+	/// an HTTP error or a response that isn't an event stream ends it for
+	/// good. The source must be used from one thread at a time, and the
+	/// multi handle must outlive it
+	/// @tparam ThreadingPolicy The threading policy of the multi handle
+	template<typename ThreadingPolicy>
+	class BasicEventSource
+	{
+	private:
+		using Waiter = std::function<void(const error_code&)>;
+		/// @brief The state shared with the transfer and the reconnection
+		/// timer, which may outlive the source
+		struct State
+		{
+			State(BasicMulti<ThreadingPolicy>& multi, EventSourceOptions options,
+				EventStreamParser::Handler handler) :
+				multi(multi), options(options), timer(multi.GetExecutor()),
+				parser([this, handler = std::move(handler)](const ServerSentEvent& event)
+				{
+					if (handler(event) == true)
+						return true;
+					ended = true;
+					return false;
+				}, options.maxEventSize),
+				headers(nullptr, curl_slist_free_all) {}
+
+			BasicMulti<ThreadingPolicy>& multi;
+			EventSourceOptions options;
+			Easy easy;
+			asio::steady_timer timer;
+			// only touched by the transfer
+			EventStreamParser parser;
+			std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> headers;
+			uint64_t eventsBefore = 0;
+			bool accepted = false;
+			// the handler ended the stream
+			bool ended = false;
+			error_code rejection;
+			std::mutex mutex;
+			// guarded by the mutex
+			size_t reconnects = 0;
+			size_t connections = 0;
+			bool started = false;
+			bool done = false;
+			error_code result;
+			Waiter waiter;
+		};
+	public:
+		/// @brief Creates a source that isn't connected yet
+		/// @param multi The multi handle that performs the stream
+		/// @param handler Receives the events on the multi handle's thread.
+		/// It must not block, and returning false ends the stream
+		/// @param options How the source reconnects
+		BasicEventSource(BasicMulti<ThreadingPolicy>& multi, EventStreamParser::Handler handler,
+			EventSourceOptions options = {});
+		/// @brief Ends the stream, and calls a waiting handler with
+		/// asio::error::operation_aborted
+		~BasicEventSource() noexcept;
+		BasicEventSource(const BasicEventSource&) = delete;
+		BasicEventSource& operator=(const BasicEventSource&) = delete;
+
+		/// @return The easy handle, to set options such as headers,
+		/// timeouts or TLS before starting
+		inline Easy& GetEasy() noexcept { return m_state->easy; }
+
+		/// @brief Connects, and keeps reconnecting until the stream ends
+		/// for good. It can only be called once
+		/// @param url The URL of the stream
+		/// @param lastEventId The ID to resume after, if any
+		void Start(const std::string& url, std::string lastEventId = {});
+		/// @brief Ends the stream, and aborts the connection or the wait
+		/// for the next one
+		void Stop();
+		/// @brief Waits for the stream to end for good. The completion
+		/// token signature is void(error_code), with no error if the handler
+		/// ended it or the server answered 204, asio::error::operation_aborted
+		/// if it was stopped, Errc::NotEventStream or the HTTP error if the
+		/// server refused it, or the last error once maxReconnects ran out
+		/// @tparam CompletionToken The completion token type
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncWait(CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler)
+			{
+				auto executor = asio::get_associated_executor(handler, m_state->multi.GetExecutor());
+				auto work = std::make_shared<asio::executor_work_guard<decltype(executor)>>(executor);
+				// the waiter must be copyable, so the handler is kept on the heap
+				auto shared = std::make_shared<std::decay_t<decltype(handler)>>(std::move(handler));
+				Wait([shared, work](const error_code& ec)
+					{
+						asio::post(work->get_executor(), [shared, ec]
+							{
+								(*shared)(ec);
+							});
+						work->reset();
+					});
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code)>(initiation, token);
+		}
+
+		/// @return The number of connections made so far
+		size_t GetConnections() const noexcept;
+	private:
+		/// @brief Calls a waiter once the stream ends for good
+		/// @param waiter The waiter
+		void Wait(Waiter waiter);
+		/// @brief Starts a connection unless the source was stopped. It runs
+		/// serialized with the multi handle, so Stop's cancel either finds
+		/// the transfer or comes first
+		/// @param state The state
+		static void Connect(const std::shared_ptr<State>& state);
+		/// @brief Reconnects after a connection ended, or ends the stream
+		/// @param state The state
+		/// @param ec The result of the connection
+		static void OnDone(const std::shared_ptr<State>& state, const error_code& ec);
+		/// @brief Ends the stream. Must hold the mutex, which it releases
+		/// @param state The state
+		/// @param lock The lock on the state's mutex
+		/// @param ec The result
+		static void Finish(const std::shared_ptr<State>& state,
+			std::unique_lock<std::mutex>& lock, error_code ec);
+		/// @brief Checks whether a response is an event stream
+		/// @param easy The easy handle of the connection
+		/// @return Nothing if it is, Errc::NotEventStream, or the HTTP error
+		static error_code Inspect(CURL* easy) noexcept;
+		/// @brief Checks the response, and frames the body. For a description
+		/// of arguments, check cURL documentation for CURLOPT_WRITEFUNCTION
+		/// @return The number of bytes taken
+		static size_t WriteCb(char* ptr, size_t size, size_t nmemb, State* userdata) noexcept;
+
+		std::shared_ptr<State> m_state;
+	};
+
+	extern template class BasicEventSource<ThreadSafe>;
+	extern template class BasicEventSource<SingleThreaded>;
+
+	/// @brief EventSource is a Server-Sent Events stream on a Multi
+	using EventSource = BasicEventSource<ThreadSafe>;
+}
+
+#endif
\ No newline at end of file
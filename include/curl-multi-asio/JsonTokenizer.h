@@ -0,0 +1,151 @@
+#ifndef CURLMULTIASIO_JSONTOKENIZER_H_
+#define CURLMULTIASIO_JSONTOKENIZER_H_
+
+/// @file
+/// Incremental tokenizing of JSON bodies
+/// 10/19/26
+
+// STL includes
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cma
+{
+	/// @brief The kind of a JSON token
+	enum class JsonToken
+	{
+		ObjectBegin,
+		ObjectEnd,
+		ArrayBegin,
+		ArrayEnd,
+		Key,
+		String,
+		Number,
+		True,
+		False,
+		Null
+	};
+
+	/// @brief JsonTokenizer turns a JSON body into a stream of tokens as it
+	/// arrives, without building a document, so a large response can be
+	/// acted upon before it is complete. It checks the structure of the
+	/// document: brackets match, keys are strings followed by colons, and
+	/// values are separated by commas. Strings are handed over raw, without
+	/// their quotes and with their escapes left in, and numbers are handed
+	/// over as text. Tokens that lie whole inside a chunk are handed over
+	/// in place, and the scan for the end of a string looks at 16 bytes at
+	/// a time where SSE2 is available. Several top-level values may follow
+	/// each other. It is a body consumer, so it can be passed to
+	/// Easy::SetBuffer
+	class JsonTokenizer
+	{
+	public:
+		/// @brief Receives a token, whose text is only valid during the
+		/// call. Returning false stops the tokenizer, and aborts the transfer
+		using Handler = std::function<bool(JsonToken token, std::string_view text)>;
+
+		/// @brief Creates a tokenizer
+		/// @param handler Receives the tokens
+		/// @param maxTokenSize The largest string or number accepted
+		/// @param maxDepth The deepest nesting of objects and arrays accepted
+		explicit JsonTokenizer(Handler handler, size_t maxTokenSize = 1 << 20, size_t maxDepth = 512);
+
+		/// @brief Tokenizes the next chunk of the body
+		/// @param chunk The chunk
+		/// @return Whether or not the tokenizer is still going
+		bool Consume(std::string_view chunk);
+		/// @brief Hands over a number that ends the body, and checks that
+		/// nothing was left open
+		/// @return Whether or not the whole body was valid
+		bool Finish();
+		/// @brief Drops all state, so another body can be tokenized
+		void Reset() noexcept;
+
+		/// @return Whether or not the tokenizer stopped, because the body
+		/// was malformed or the handler refused a token
+		inline bool Failed() const noexcept { return m_failed; }
+		/// @return The number of bytes consumed, which is where the
+		/// tokenizer stopped if it failed
+		inline uint64_t GetOffset() const noexcept { return m_offset; }
+		/// @return The number of objects and arrays open
+		inline size_t GetDepth() const noexcept { return m_stack.size(); }
+	private:
+		/// @brief What the tokenizer expects next
+		enum class Expect : uint8_t
+		{
+			Value,
+			// right after [
+			ValueOrEnd,
+			// right after {
+			KeyOrEnd,
+			Key,
+			Colon,
+			CommaOrEnd
+		};
+		/// @brief The kind of token that is split across chunks
+		enum class Partial : uint8_t
+		{
+			None,
+			String,
+			Number,
+			Literal
+		};
+
+		/// @brief Continues the token split across chunks
+		/// @param p The start of the chunk
+		/// @param end The end of the chunk
+		/// @return Where the token ended, or nullptr if the tokenizer stopped
+		const char* Resume(const char* p, const char* end);
+		/// @brief Reads a string, after its opening quote
+		/// @return Where the string ended, or nullptr if the tokenizer stopped
+		const char* ReadString(const char* p, const char* end);
+		/// @brief Reads a number or a literal
+		/// @return Where it ended, or nullptr if the tokenizer stopped
+		const char* ReadScalar(const char* p, const char* end, Partial kind);
+		/// @brief Finds the closing quote of a string, skipping escapes
+		/// @return The closing quote, or end if the string goes on
+		const char* FindStringEnd(const char* p, const char* end) noexcept;
+		/// @brief Hands over a finished string
+		/// @return Whether or not the tokenizer is still going
+		bool EmitString(std::string_view text);
+		/// @brief Hands over a finished number or literal
+		/// @return Whether or not the tokenizer is still going
+		bool EmitScalar(Partial kind, std::string_view text);
+		/// @brief Opens an object or an array
+		/// @return Whether or not the tokenizer is still going
+		bool Open(char bracket);
+		/// @brief Closes an object or an array
+		/// @return Whether or not the tokenizer is still going
+		bool Close(char bracket);
+		/// @brief Hands a token to the handler, and moves on past a value
+		/// @return Whether or not the tokenizer is still going
+		bool Emit(JsonToken token, std::string_view text);
+		/// @brief Appends to the token split across chunks
+		/// @return Whether or not it still fits
+		bool Buffer(const char* p, const char* end);
+		/// @brief Stops the tokenizer
+		/// @return false
+		bool Fail() noexcept;
+
+		Handler m_handler;
+		size_t m_maxTokenSize;
+		size_t m_maxDepth;
+		// the open brackets
+		std::vector<char> m_stack;
+		// the start of a token split across chunks
+		std::string m_token;
+		uint64_t m_offset = 0;
+		Expect m_expect = Expect::Value;
+		Partial m_partial = Partial::None;
+		// whether the string being read is a key
+		bool m_key = false;
+		// whether the last chunk ended in the middle of an escape
+		bool m_escape = false;
+		bool m_failed = false;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,172 @@
+#ifndef CURLMULTIASIO_MEMORYBUDGET_H_
+#define CURLMULTIASIO_MEMORYBUDGET_H_
+
+/// @file
+/// A budget for the response bodies buffered by a multi handle
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+
+// STL includes
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace cma
+{
+	/// @brief How much a MemoryBudget lets transfers buffer
+	struct MemoryBudgetOptions
+	{
+		/// @brief The most bytes of response bodies held at once
+		size_t limit = 256 << 20;
+	};
+
+	/// @brief Counters of a MemoryBudget's activity
+	struct MemoryBudgetStats
+	{
+		/// @brief Bytes held right now
+		size_t used = 0;
+		/// @brief The most bytes held at once
+		size_t peak = 0;
+		/// @brief Times a transfer was paused for lack of room
+		uint64_t pauses = 0;
+		/// @brief Times a paused transfer was resumed
+		uint64_t resumes = 0;
+		/// @brief Times a transfer was let past the limit, because every
+		/// other transfer was paused too
+		uint64_t overdrafts = 0;
+		/// @brief Transfers aborted for a body larger than their limit
+		uint64_t tooLarge = 0;
+		/// @brief Transfers paused right now
+		size_t waiting = 0;
+	};
+
+	/// @brief MemoryBudget bounds the response bodies that the transfers of
+	/// a multi handle hold. It wraps the write callback of each transfer,
+	/// and charges every byte handed to a sink that keeps the body, such as
+	/// a string or a stream, to the easy handle. A write that doesn't fit
+	/// pauses its transfer with CURL_WRITEFUNC_PAUSE, which stops reading
+	/// from its socket, and queues it. As bodies are freed, the transfers
+	/// that waited longest are resumed first, one at a time while there is
+	/// room, so a burst of large responses is taken in turns instead of all
+	/// at once. Bodies that are consumed as they arrive, such as by a body
+	/// consumer, aren't charged. The charge of a handle lasts past its
+	/// transfer, since the body is still held, until Free is called or the
+	/// easy handle is destroyed. When
+	/// every transfer holding the budget is paused, the one that waited
+	/// longest is let past the limit until it finishes, so a caller that
+	/// only frees bodies once they are all done can't deadlock. It also
+	/// enforces Easy::SetMaxBodySize on bodies without a Content-Length. It
+	/// is attached to a Multi, and can be used from any thread
+	class MemoryBudget
+	{
+	public:
+		/// @brief Creates a memory budget
+		/// @param options The options
+		explicit MemoryBudget(MemoryBudgetOptions options = {});
+		/// @brief Cuts the easy handles still charged loose from the budget
+		~MemoryBudget() noexcept;
+		MemoryBudget(const MemoryBudget&) = delete;
+		MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+		/// @brief Starts charging a transfer, by wrapping its write
+		/// callback. Transfers with cURL's default write callback aren't
+		/// charged
+		/// @param easy The easy handle of the transfer
+		/// @param resume Resumes the transfer once it was paused, from any thread
+		void Prepare(Easy& easy, std::function<void()> resume);
+		/// @brief Stops watching a finished transfer, and restores its write
+		/// callback. Its charge is kept until it is freed
+		/// @param easy The easy handle of the transfer
+		/// @param result The result of the transfer
+		/// @return The result, or CURLE_FILESIZE_EXCEEDED if its body was
+		/// aborted for being too large
+		CURLcode Record(CURL* easy, CURLcode result) noexcept;
+		/// @brief Stops watching a transfer that was aborted
+		/// @param easy The easy handle of the transfer
+		void Release(CURL* easy) noexcept;
+		/// @brief Gives back memory that a consumer let go of, such as once
+		/// it took the body out of the buffer, and resumes paused transfers
+		/// @param easy The easy handle that was charged
+		/// @param bytes The bytes to give back, all of them by default
+		void Free(const Easy& easy, size_t bytes = SIZE_MAX) noexcept;
+
+		/// @param easy The easy handle
+		/// @return The bytes charged to an easy handle
+		size_t GetHeld(const Easy& easy) const noexcept;
+		/// @return The counters
+		MemoryBudgetStats GetStats() const noexcept;
+		/// @return The options
+		inline const MemoryBudgetOptions& GetOptions() const noexcept { return m_options; }
+	private:
+		/// @brief A transfer being watched. Only its write callback touches
+		/// the sink and the count of bytes received
+		struct Watch
+		{
+			MemoryBudget* budget = nullptr;
+			CURL* easy = nullptr;
+			Easy::Sink sink;
+			curl_off_t maxBodySize = -1;
+			curl_off_t received = 0;
+			std::function<void()> resume;
+			// guarded by the budget's mutex
+			size_t wanted = 0;
+			bool waiting = false;
+			bool granted = false;
+			bool overdraft = false;
+			bool tooLarge = false;
+		};
+
+		/// @brief Lets the charges handed to easy handles reach the budget,
+		/// until it is destroyed
+		struct Link
+		{
+			std::mutex mutex;
+			// cleared under the mutex by the destructor
+			MemoryBudget* budget = nullptr;
+		};
+
+		/// @brief Gives back memory charged to an easy handle
+		/// @param easy The easy handle that was charged
+		/// @param bytes The bytes to give back
+		void Free(CURL* easy, size_t bytes) noexcept;
+		/// @brief Stops watching a transfer, and restores its write callback
+		/// @param easy The easy handle of the transfer
+		/// @return The watch, if it was watched
+		std::unique_ptr<Watch> Unwatch(CURL* easy) noexcept;
+		/// @brief Charges a write to its transfer, or queues the transfer
+		/// if it doesn't fit or isn't its turn. Must hold the mutex
+		/// @param watch The transfer
+		/// @param bytes The size of the write
+		/// @return Whether or not the write was charged
+		bool Charge(Watch& watch, size_t bytes) noexcept;
+		/// @brief Resumes the transfer that waited longest if its write
+		/// fits, or lets it past the limit if every transfer is paused.
+		/// Must hold the mutex
+		void Wake() noexcept;
+		/// @brief Enforces the body limit, charges the write, and passes it
+		/// on to the sink. For a description of arguments, check cURL
+		/// documentation for CURLOPT_WRITEFUNCTION
+		/// @return The number of bytes taken, or CURL_WRITEFUNC_PAUSE
+		static size_t WriteCb(char* ptr, size_t size, size_t nmemb, Watch* userdata) noexcept;
+
+		MemoryBudgetOptions m_options;
+		mutable std::mutex m_mutex;
+		std::unordered_map<CURL*, std::unique_ptr<Watch>> m_watches;
+		// the bytes charged to each easy handle
+		std::unordered_map<CURL*, size_t> m_held;
+		// paused transfers, the one that waited longest first
+		std::deque<Watch*> m_waiting;
+		// resumed transfers that haven't written yet
+		size_t m_granted = 0;
+		MemoryBudgetStats m_stats;
+		std::shared_ptr<Link> m_link = std::make_shared<Link>();
+	};
+}
+
+#endif
\ No newline at end of file
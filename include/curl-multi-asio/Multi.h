@@ -6,15 +6,30 @@
 /// 6/21/21 11:45
 
 // curl-multi-asio includes
+#include <curl-multi-asio/CircuitBreaker.h>
 #include <curl-multi-asio/Common.h>
 #include <curl-multi-asio/Detail/Lifetime.h>
+#include <curl-multi-asio/Detail/MpscQueue.h>
+#include <curl-multi-asio/DnsCache.h>
 #include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/EndpointSelector.h>
+#include <curl-multi-asio/MemoryBudget.h>
+#include <curl-multi-asio/RedirectCache.h>
 #include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/Share.h>
+#include <curl-multi-asio/ThreadingPolicy.h>
+#include <curl-multi-asio/Tracer.h>
 
 // STL includes
 #include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 template<typename T>
 concept HasExecutor = requires(T a)
@@ -24,26 +39,27 @@ concept HasExecutor = requires(T a)
 
 namespace cma
 {
-	/// @brief Multi is a multi handle, which tracks and executes
-	/// all curl_multi calls
-	class Multi
+	namespace Detail
 	{
-	private:
 		/// @brief These handlers store all of the handler data including
 		/// the raw socket, and the handler itself. They also handle
-		/// unregistration
-		class PerformHandlerBase
+		/// unregistration. Until they reach the strand, they are queued
+		/// in the submission queue
+		class PerformHandlerBase : public MpscNode
 		{
 		public:
-			PerformHandlerBase(CURL* easyHandle, CURLM* multiHandle) noexcept :
-				m_easyHandle(easyHandle), m_multiHandle(multiHandle) {}
+			PerformHandlerBase(CURL* easyHandle, CURLM* multiHandle,
+				Tracer* tracer, uint64_t traceId) noexcept :
+				m_easyHandle(easyHandle), m_multiHandle(multiHandle),
+				m_tracer(tracer), m_traceId(traceId) {}
 			virtual ~PerformHandlerBase() = default;
 
-			/// @brief Completes the perform, and calls the handler. Must
-			/// set handled status
+			/// @brief Completes the perform, and calls the handler through
+			/// its associated executor. Must set handled status
 			/// @param ec The error code
-			/// @param e The curl error
-			virtual void Complete(error_code ec) noexcept = 0;
+			/// @param defer Whether the handler must not be called inline,
+			/// such as when the caller may be the handler itself
+			virtual void Complete(error_code ec, bool defer) noexcept = 0;
 
 			/// @return The underlying easy handle
 			inline CURL* GetEasyHandle() const noexcept { return m_easyHandle; }
@@ -51,38 +67,113 @@ namespace cma
 			inline CURLM* GetMultiHandle() const noexcept { return m_multiHandle; }
 			/// @return If the handler was considered handled
 			inline bool Handled() const noexcept { return m_handled; }
+			/// @brief Records a phase of the transfer that happened now, if
+			/// it is being traced. The clock is only read if it is
+			/// @param phase The phase
+			inline void Trace(TracePhase phase) noexcept
+			{
+				if (m_traceId != 0)
+					m_tracer->Record(m_traceId, phase, Tracer::clock::now());
+			}
+			/// @brief Records a phase of the transfer if it is being traced
+			/// @param phase The phase
+			/// @param time The time that the phase happened
+			inline void Trace(TracePhase phase, Tracer::clock::time_point time) noexcept
+			{
+				if (m_traceId != 0)
+					m_tracer->Record(m_traceId, phase, time);
+			}
+			/// @return Whether or not the transfer is being traced
+			inline bool Traced() const noexcept { return m_traceId != 0; }
+			/// @return The time that the easy handle was added to the multi handle
+			inline Tracer::clock::time_point GetAddTime() const noexcept { return m_addTime; }
+			/// @param addTime The time that the easy handle was added to the multi handle
+			inline void SetAddTime(Tracer::clock::time_point addTime) noexcept { m_addTime = addTime; }
+			/// @return Whether or not the easy handle stays in the multi
+			/// handle once it succeeds, which keeps its connection alive
+			inline bool KeepsConnection() const noexcept { return m_keepConnection; }
+			/// @param keepConnection Whether or not the easy handle stays
+			/// in the multi handle once it succeeds
+			inline void SetKeepConnection(bool keepConnection) noexcept { m_keepConnection = keepConnection; }
 		protected:
 			/// @param handled If the handle was considered handled
 			inline void SetHandled(bool handled) noexcept { m_handled = handled; }
 		private:
 			CURL* m_easyHandle;
 			CURL* m_multiHandle;
+			Tracer* m_tracer;
+			uint64_t m_traceId;
+			Tracer::clock::time_point m_addTime;
 			bool m_handled = false;
+			bool m_keepConnection = false;
 		};
+
 		template<typename Handler>
 		class PerformHandler : public PerformHandlerBase
 		{
 		public:
-			PerformHandler(CURL* easyHandle, CURLM* multiHandle, Handler& handler) noexcept :
-				PerformHandlerBase(easyHandle, multiHandle), m_handler(std::move(handler)) {}
+			using executor_type = asio::associated_executor_t<Handler, asio::any_io_executor>;
+
+			PerformHandler(CURL* easyHandle, CURLM* multiHandle, Tracer* tracer,
+				uint64_t traceId, Handler& handler, const asio::any_io_executor& executor) noexcept :
+				PerformHandlerBase(easyHandle, multiHandle, tracer, traceId),
+				m_handler(std::move(handler)),
+				m_work(asio::get_associated_executor(m_handler, executor)) {}
 			~PerformHandler() noexcept
 			{
 				// abort if we haven't been handled
 				if (Handled() == false)
-					Complete(asio::error::operation_aborted);
+					Complete(asio::error::operation_aborted, true);
 			}
 
-			void Complete(asio::error_code ec) noexcept
+			void Complete(asio::error_code ec, bool defer) noexcept override
 			{
 				if (Handled() == true)
 					return;
-				// remove the handler from the multi handle
-				curl_multi_remove_handle(GetMultiHandle(), GetEasyHandle());
-				m_handler(ec);
 				SetHandled(true);
+				// remove the handler from the multi handle, unless it opened
+				// a connection that removing it would close
+				if (GetMultiHandle() != nullptr && (ec || KeepsConnection() == false))
+					curl_multi_remove_handle(GetMultiHandle(), GetEasyHandle());
+				Trace(TracePhase::HandlerInvoke);
+				// the handler runs inline if we are already on its executor,
+				// which saves callers a hop back into their own strands
+				auto executor = m_work.get_executor();
+				auto function = [handler = std::move(m_handler), ec]() mutable
+				{
+					handler(ec);
+				};
+				if (defer == true)
+					asio::post(executor, std::move(function));
+				else
+					asio::dispatch(executor, std::move(function));
+				// the handler's executor may be waiting on nothing but
+				// this operation, so the work is only released now
+				m_work.reset();
 			}
 		private:
 			Handler m_handler;
+			asio::executor_work_guard<executor_type> m_work;
+		};
+	}
+
+	/// @brief BasicMulti is a multi handle, which tracks and executes
+	/// all curl_multi calls. The threading policy decides how access to
+	/// cURL is serialized, see ThreadSafe and SingleThreaded
+	/// @tparam ThreadingPolicy The threading policy
+	template<typename ThreadingPolicy>
+	class BasicMulti
+	{
+	private:
+		using PerformHandlerBase = Detail::PerformHandlerBase;
+		template<typename Handler>
+		using PerformHandler = Detail::PerformHandler<Handler>;
+		/// @brief A socket that cURL opened through us
+		struct EasySocket
+		{
+			asio::generic::stream_protocol::socket socket;
+			// the last action cURL asked for
+			int last = CURL_POLL_NONE;
 		};
 	public:
 		/// @brief Creates the handle and if necessary, initializes cURL.
@@ -92,7 +183,7 @@ namespace cma
 		/// If you would rather manage the lifetime yourself, an interface
 		/// is provided in cma::Detail::Lifetime.
 		/// @param executor The executor type
-		Multi(const asio::any_io_executor& executor) noexcept;
+		BasicMulti(const asio::any_io_executor& executor) noexcept;
 		/// @brief Creates the handle and if necessary, initializes cURL.
 		/// If CMA_MANAGE_CURL is specified when the library is built,
 		/// cURL's lifetime is managed by the total instances of Multi,
@@ -102,22 +193,28 @@ namespace cma
 		/// @tparam ExecutionContext The execution context type
 		/// @param ctx The execution context
 		template<HasExecutor ExecutionContext>
-		explicit Multi(ExecutionContext& ctx)
-			: Multi(ctx.get_executor()) {}
+		explicit BasicMulti(ExecutionContext& ctx)
+			: BasicMulti(ctx.get_executor()) {}
 		/// @brief Cancels any outstanding operations, and destroys handles.
 		/// If CMA_MANAGE_CURL is specified when the library is built and
 		/// this is the only instance of Multi, curl_global_cleanup will be called
-		~Multi() noexcept { asio::error_code ignored; Cancel(ignored); }
+		~BasicMulti() noexcept
+		{
+			asio::error_code ignored;
+			Cancel(ignored);
+			if (m_alive != nullptr)
+				*m_alive = false;
+		}
 		// we don't allow copies, because multi handles can't be duplicated.
 		// there's not even a reason to do so, multi handles don't really hold
 		// much of a state themselves besides stuff that shouldn't be duplicated
-		Multi(const Multi&) = delete;
-		Multi& operator=(const Multi&) = delete;
+		BasicMulti(const BasicMulti&) = delete;
+		BasicMulti& operator=(const BasicMulti&) = delete;
 		/// @brief The other multi instance ends up in an invalid state
-		Multi(Multi&& other) = default;
+		BasicMulti(BasicMulti&& other) = default;
 		/// @brief The other multi instance ends up in an invalid state
 		/// @return This multi handle
-		Multi& operator=(Multi&& other) = default;
+		BasicMulti& operator=(BasicMulti&& other) = default;
 
 		/// @return The associated executor
 		inline asio::any_io_executor& GetExecutor() noexcept { return m_executor; }
@@ -129,10 +226,15 @@ namespace cma
 
 		/// @brief Launches an asynchronous perform operation, and notifies
 		/// the completion token either on error or success. This can be called
-		/// from multiple threads at once. Once the operation is initiated,
-		/// it is the responsibility of the caller to ensure that the easy handle
-		/// stays in scope until the handler is called. The completon token
-		/// signature is void(error_code)
+		/// from multiple threads at once without locking. Submissions are
+		/// queued, and the strand adds each batch of them at once. With the
+		/// SingleThreaded policy, it must be called from the thread running
+		/// the executor, and the handle is added right away. Once the
+		/// operation is initiated, it is the responsibility of the caller to
+		/// ensure that the easy handle stays in scope until the handler is
+		/// called. The handler is called through its associated executor,
+		/// and the operation counts as outstanding work on it until then.
+		/// The completon token signature is void(error_code)
 		/// @tparam CompletionToken The completion token type
 		/// @param easyHandle The easy handle to perform the action on
 		/// @param token The completion token
@@ -142,35 +244,71 @@ namespace cma
 		{
 			auto initiation = [this](auto&& handler, Easy& easy)
 			{
-				// do this in a strand so that curl can't be accessed concurrently
-				asio::post(m_executor, asio::bind_executor(m_strand,
-					[this, handler = std::move(handler), &easy]() mutable
-				{
-					// set the open and close socket functions. this allows
-					// us to make them asio sockets for async functionality
-					easy.SetOption(CURLoption::CURLOPT_OPENSOCKETFUNCTION, &Multi::OpenSocketCb);
-					easy.SetOption(CURLoption::CURLOPT_OPENSOCKETDATA, this);
-					easy.SetOption(CURLoption::CURLOPT_CLOSESOCKETFUNCTION, &Multi::CloseSocketCb);
-					easy.SetOption(CURLoption::CURLOPT_CLOSESOCKETDATA, this);
-					// store the handler
-					auto performHandler = std::make_unique<PerformHandler<
-						typename std::decay_t<decltype(handler)>>>(
-							easy.GetNativeHandle(), GetNativeHandle(), handler);
-					// track the socket and initiate the transfer. if this fails
-					if (auto res = curl_multi_add_handle(GetNativeHandle(),
-						easy.GetNativeHandle()); res != CURLM_OK)
-						return performHandler->Complete(res);
-					// track the handler
-					m_easyHandlerMap.emplace(easy.GetNativeHandle(), std::move(performHandler));
-				}));
+				Initiate(std::move(handler), easy, false);
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code)>(initiation, token, std::ref(easyHandle));
+		}
+		/// @brief Launches an asynchronous perform operation for a transfer
+		/// that sets CURLOPT_CONNECT_ONLY, such as a WebSocket upgrade. It
+		/// works like AsyncPerform, except that once the transfer succeeds
+		/// its easy handle stays in the multi handle, since removing it
+		/// would close the connection. The connection can then be used with
+		/// curl_easy_send, curl_easy_recv or curl_ws_send and curl_ws_recv
+		/// from functions run by Execute, waited on by WaitConnection, and
+		/// closed by Disconnect. The completion token signature is
+		/// void(error_code)
+		/// @tparam CompletionToken The completion token type
+		/// @param easyHandle The easy handle to connect with
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncConnect(Easy& easyHandle, CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler, Easy& easy)
+			{
+				Initiate(std::move(handler), easy, true);
 			};
 			return asio::async_initiate<CompletionToken,
 				void(error_code)>(initiation, token, std::ref(easyHandle));
 		}
-		/// @brief Cancels all outstanding asynchronous operations,
-		/// and calls handlers with asio::error::operation_aborted.
-		/// The easy handles must stay in scope until their handlers
-		/// have been called.
+		/// @brief Runs a function serialized with every other call into
+		/// cURL on this handle, inline if that is already the case. It can
+		/// be called from any thread. The function is dropped if the multi
+		/// handle is destroyed first
+		/// @tparam Function The function type
+		/// @param function The function
+		template<typename Function>
+		void Execute(Function&& function)
+		{
+			asio::dispatch(m_executor, Serialized([alive = m_alive,
+				function = std::forward<Function>(function)]() mutable
+				{
+					if (*alive == true)
+						function();
+				}));
+		}
+		/// @brief Waits for the connection of an easy handle that was
+		/// connected by AsyncConnect to become readable or writable. It must
+		/// be called from a function run by Execute, and the handler runs
+		/// serialized too. Closing the connection aborts the wait
+		/// @param easy The easy handle
+		/// @param type The condition to wait for
+		/// @param handler Called with the result of the wait, or
+		/// asio::error::not_connected if there is no connection
+		void WaitConnection(const Easy& easy, asio::socket_base::wait_type type,
+			std::function<void(const error_code&)> handler);
+		/// @brief Closes the connection of an easy handle that was connected
+		/// by AsyncConnect, by removing it from the multi handle. It must be
+		/// called from a function run by Execute, and aborts the waits on
+		/// the connection
+		/// @param easy The easy handle
+		/// @return Whether or not the easy handle had a connection
+		bool Disconnect(const Easy& easy) noexcept;
+		/// @brief Cancels all outstanding asynchronous operations, including
+		/// those that are still queued, and calls handlers with
+		/// asio::error::operation_aborted. The easy handles must stay in
+		/// scope until their handlers have been called.
 		/// @param ec The error code output
 		/// @param error The error to send to all open handlers
 		/// @return The number of asynchronous operations canceled
@@ -184,6 +322,158 @@ namespace cma
 		/// @param error Te error to send to all open handlers
 		/// @return Whether or not the handler was canceled
 		bool Cancel(const Easy& easy, CURLMcode error = CURLMcode::CURLM_OK) noexcept;
+		/// @brief Cancels several outstanding asynchronous operations in one
+		/// pass in the strand, instead of one Cancel per handle. Queued
+		/// submissions are added first, so they are canceled too, along
+		/// with transfers still waiting on DNS. The handlers are
+		/// called with asio::error::operation_aborted, inline if they are
+		/// already on their executor. It can be called from any thread, and
+		/// the easy handles must stay in scope until their handlers have
+		/// been called
+		/// @param easyHandles The native handles of the easy handles
+		void Cancel(std::vector<CURL*> easyHandles);
+		/// @brief Resumes a transfer whose write callback paused it with
+		/// CURL_WRITEFUNC_PAUSE. It is posted to the strand, so it can be
+		/// called from any thread, including the write callback's own
+		/// @param easy The easy handle
+		void Unpause(const Easy& easy);
+
+		/// @brief Opens connections to each origin ahead of time, so that
+		/// the first real requests don't pay for DNS, TCP and TLS. Each
+		/// connection is opened by a HEAD request, because cURL never reuses
+		/// connections made with CURLOPT_CONNECT_ONLY, and is then left in
+		/// the multi handle's connection cache. Transfers only reuse them if
+		/// their TLS options match, see SetPrewarmPrototype. The cache holds
+		/// four connections per added easy handle by default, so a large
+		/// prewarm may need CURLMOPT_MAXCONNECTS. The completion token
+		/// signature is void(error_code, size_t), with the first error and
+		/// the number of connections that were opened
+		/// @tparam CompletionToken The completion token type
+		/// @param origins The origins, such as https://example.com:8443
+		/// @param connectionsPerHost The connections to open to each origin
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncPrewarm(std::vector<std::string> origins, size_t connectionsPerHost,
+			CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler, std::vector<std::string> origins,
+				size_t connectionsPerHost)
+			{
+				auto executor = asio::get_associated_executor(handler, m_executor);
+				auto work = std::make_shared<asio::executor_work_guard<decltype(executor)>>(executor);
+				// the callback must be copyable, so the handler is kept on the heap
+				auto shared = std::make_shared<std::decay_t<decltype(handler)>>(std::move(handler));
+				StartPrewarm(origins, connectionsPerHost, [shared, work]
+					(const error_code& ec, size_t connected)
+					{
+						asio::post(work->get_executor(), [shared, ec, connected]
+							{
+								(*shared)(ec, connected);
+							});
+						work->reset();
+					});
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code, size_t)>(initiation, token, std::move(origins), connectionsPerHost);
+		}
+		/// @brief Keeps at least a number of connections to each origin
+		/// open, by prewarming them again on an interval. Idle connections
+		/// are reused by the prewarm, which keeps them from aging out, and
+		/// new ones are only opened to make up for those cURL has closed.
+		/// It replaces the previous call
+		/// @param origins The origins, such as https://example.com:8443
+		/// @param minConnections The connections to keep open to each origin
+		/// @param interval How often to check
+		void KeepWarm(std::vector<std::string> origins, size_t minConnections,
+			std::chrono::milliseconds interval);
+		/// @brief Stops keeping connections warm. Connections that are open
+		/// stay in the connection cache
+		void StopKeepWarm();
+		/// @brief Sets the options that prewarm transfers are created with.
+		/// They must match the TLS and proxy options of the transfers that
+		/// should reuse the connections. It should not be changed while a
+		/// prewarm is running
+		/// @param prototype Sets the options on each prewarm easy handle
+		inline void SetPrewarmPrototype(std::function<void(Easy&)> prototype)
+		{
+			m_prewarmPrototype = std::move(prototype);
+		}
+
+		/// @brief Sets the tracer that records the lifecycle of sampled
+		/// transfers. It must outlive the multi handle, and should not be
+		/// changed while operations are outstanding
+		/// @param tracer The tracer, or nullptr to disable tracing
+		inline void SetTracer(Tracer* tracer) noexcept { m_tracer = tracer; }
+		/// @return The tracer, or nullptr if tracing is disabled
+		inline Tracer* GetTracer() const noexcept { return m_tracer; }
+		/// @brief Sets the share that every transfer is attached to, so that
+		/// DNS, TLS sessions and HSTS are shared and persisted. It must
+		/// outlive the multi handle and every easy handle performed on it,
+		/// and should not be changed while operations are outstanding
+		/// @param share The share, or nullptr to not attach one
+		inline void SetShare(Share* share) noexcept { m_share = share; }
+		/// @return The share, or nullptr if there is none
+		inline Share* GetShare() const noexcept { return m_share; }
+		/// @brief Sets the DNS cache that resolves hosts before their
+		/// transfers are added. A transfer whose host isn't cached waits for
+		/// the lookup before it is submitted. The cache must outlive the
+		/// multi handle, and should not be changed while operations are
+		/// outstanding
+		/// @param dnsCache The DNS cache, or nullptr to leave DNS to cURL
+		inline void SetDnsCache(DnsCache* dnsCache) noexcept { m_dnsCache = dnsCache; }
+		/// @return The DNS cache, or nullptr if DNS is left to cURL
+		inline DnsCache* GetDnsCache() const noexcept { return m_dnsCache; }
+		/// @brief Sets the endpoint selector that spreads transfers over the
+		/// addresses of their host, and measures every finished transfer.
+		/// It needs a DNS cache for the addresses. It must outlive the multi
+		/// handle, and should not be changed while operations are outstanding
+		/// @param endpointSelector The endpoint selector, or nullptr to
+		/// leave the choice to cURL
+		inline void SetEndpointSelector(EndpointSelector* endpointSelector) noexcept
+		{
+			m_endpointSelector = endpointSelector;
+		}
+		/// @return The endpoint selector, or nullptr if the choice is left to cURL
+		inline EndpointSelector* GetEndpointSelector() const noexcept { return m_endpointSelector; }
+		/// @brief Sets the circuit breaker that refuses transfers to hosts
+		/// that keep failing, and counts every finished transfer. Refused
+		/// transfers complete with Errc::CircuitOpen. It must outlive the
+		/// multi handle, and should not be changed while operations are
+		/// outstanding
+		/// @param circuitBreaker The circuit breaker, or nullptr to run every transfer
+		inline void SetCircuitBreaker(CircuitBreaker* circuitBreaker) noexcept
+		{
+			m_circuitBreaker = circuitBreaker;
+		}
+		/// @return The circuit breaker, or nullptr if every transfer runs
+		inline CircuitBreaker* GetCircuitBreaker() const noexcept { return m_circuitBreaker; }
+		/// @brief Sets the redirect cache that learns permanent redirects,
+		/// and rewrites the URL of later transfers to their target before
+		/// they are added. It wraps CURLOPT_HEADERFUNCTION on every
+		/// transfer while it runs. It must outlive the multi handle, and
+		/// should not be changed while operations are outstanding
+		/// @param redirectCache The redirect cache, or nullptr to leave
+		/// redirects to cURL
+		inline void SetRedirectCache(RedirectCache* redirectCache) noexcept
+		{
+			m_redirectCache = redirectCache;
+		}
+		/// @return The redirect cache, or nullptr if redirects are left to cURL
+		inline RedirectCache* GetRedirectCache() const noexcept { return m_redirectCache; }
+		/// @brief Sets the memory budget that bounds the response bodies
+		/// transfers buffer, pausing them while it is used up. It takes over
+		/// CURLOPT_WRITEFUNCTION on every transfer while it runs. It must
+		/// outlive the multi handle, and should not be changed while
+		/// operations are outstanding
+		/// @param memoryBudget The memory budget, or nullptr to buffer
+		/// without bound
+		inline void SetMemoryBudget(MemoryBudget* memoryBudget) noexcept
+		{
+			m_memoryBudget = memoryBudget;
+		}
+		/// @return The memory budget, or nullptr if buffering is unbounded
+		inline MemoryBudget* GetMemoryBudget() const noexcept { return m_memoryBudget; }
 
 		/// @brief Sets a multi option
 		/// @tparam T The option value type
@@ -197,28 +487,160 @@ namespace cma
 			return curl_multi_setopt(GetNativeHandle(), option, static_cast<T&&>(val));
 		}
 	private:
+		/// @brief Starts a transfer, for AsyncPerform and AsyncConnect
+		/// @tparam Handler The handler type
+		/// @param handler The handler
+		/// @param easy The easy handle
+		/// @param keepConnection Whether or not the easy handle stays in the
+		/// multi handle once it succeeds
+		template<typename Handler>
+		void Initiate(Handler handler, Easy& easy, bool keepConnection)
+		{
+			// the cached redirects are followed first, so the rest of
+			// the path sees the host the transfer really goes to
+			if (m_redirectCache != nullptr)
+				m_redirectCache->Prepare(easy);
+			// an open circuit fails the transfer before it costs a lookup,
+			// a socket or a trip through the strand
+			if (m_circuitBreaker != nullptr && m_circuitBreaker->Allow(
+				easy.GetNativeHandle(), easy.GetURL()) == false)
+			{
+				// the redirect cache already watches the headers
+				if (m_redirectCache != nullptr)
+					m_redirectCache->Release(easy.GetNativeHandle());
+				PerformHandler<Handler>(easy.GetNativeHandle(), nullptr, nullptr, 0,
+					handler, m_executor).Complete(Errc::CircuitOpen, true);
+				return;
+			}
+			if (m_share != nullptr)
+				m_share->Attach(easy);
+			// the budget pauses the transfer through its write callback,
+			// and resumes it through the strand
+			if (m_memoryBudget != nullptr)
+				m_memoryBudget->Prepare(easy, [this, &easy]
+					{
+						Unpause(easy);
+					});
+			// decide whether or not to trace it before it is queued
+			const uint64_t traceId = (m_tracer != nullptr) ? m_tracer->Sample() : 0;
+			if (traceId != 0)
+				m_tracer->Record(traceId, TracePhase::Submit);
+			// the handler is allocated here instead of on the strand,
+			// so concurrent callers only contend on a single atomic
+			auto performHandler = std::make_unique<PerformHandler<Handler>>(
+					easy.GetNativeHandle(), GetNativeHandle(), m_tracer, traceId,
+					handler, m_executor).release();
+			performHandler->SetKeepConnection(keepConnection);
+			if (m_dnsCache == nullptr)
+				return Submit(performHandler);
+			// it is tracked before the lookup starts, since the lookup may
+			// finish on another thread before Prepare returns
+			const auto easyHandle = easy.GetNativeHandle();
+			{
+				std::lock_guard lock(m_lookups->mutex);
+				m_lookups->handlers.emplace(easyHandle, performHandler);
+			}
+			if (m_dnsCache->Prepare(easy, [this, lookups = m_lookups,
+				executor = m_executor, easyHandle](const std::function<void()>& pin)
+				{
+					Resume(this, lookups, executor, easyHandle, pin);
+				}, m_endpointSelector) == true)
+			{
+				// a cancel may have beaten us to it
+				if (auto handler = TakeLookup(*m_lookups, easyHandle); handler != nullptr)
+					Submit(handler.release());
+			}
+		}
 		/// @brief Closes a socket, and then we can free the socket. For a
 		/// description of arguments, check cURL documentation for
 		/// CURLOPT_CLOSESOCKETFUNCTION
 		/// @return 0 on success, CURL_BADSOCKET on failure
-		static int CloseSocketCb(Multi* clientp, curl_socket_t item) noexcept;
+		static int CloseSocketCb(BasicMulti* clientp, curl_socket_t item) noexcept;
 		/// @brief Opens an asio socket for an address. For a description
 		/// of arguments, check cURL documentation for CURLOPT_OPENSOCKETFUNCTION
 		/// @return The socket
-		static curl_socket_t OpenSocketCb(Multi* clientp, curlsocktype purpose,
+		static curl_socket_t OpenSocketCb(BasicMulti* clientp, curlsocktype purpose,
 			curl_sockaddr* address) noexcept;
 		/// @brief The socket callback called by cURL when a socket should
 		/// read, write, or be destroyed. For a description of arguments,
 		/// check cURL documentation for CURLMOPT_SOCKETFUNCTION
 		/// @return 0 on success
 		static int SocketCallback(CURL* easy, curl_socket_t s, int what,
-			Multi* userp, int* socketp) noexcept;
+			BasicMulti* userp, int* socketp) noexcept;
 		/// @brief The timer callback called by cURL when a timer should be set.
 		/// For a description on arguments, check cURL documentation for
 		/// CURLMOPT_TIMERFUNCTION
 		/// @return 0 on success, 1 on failure
-		static int TimerCallback(CURLM* multi, long timeout_ms, Multi* userp) noexcept;
+		static int TimerCallback(CURLM* multi, long timeout_ms, BasicMulti* userp) noexcept;
 
+		/// @brief Queues a submission, and wakes the strand if it is the
+		/// first of a batch. With the SingleThreaded policy, it is added
+		/// right away instead
+		/// @param handler The handler, which is taken ownership of
+		void Submit(PerformHandlerBase* handler);
+		/// @brief Transfers waiting on a DNS lookup, by easy handle. The
+		/// lookups hold on to it, since they may finish after the multi
+		/// handle is gone. Whoever takes a handler out owns it
+		struct PendingLookups
+		{
+			std::mutex mutex;
+			std::unordered_map<CURL*, PerformHandlerBase*> handlers;
+		};
+		/// @brief Pins a transfer and submits it once its DNS lookup is
+		/// done, unless it was canceled in the meantime. It is static
+		/// because the multi handle may be gone by then, in which case its
+		/// destructor canceled the transfer
+		/// @param multi The multi handle
+		/// @param lookups The transfers waiting on DNS
+		/// @param executor The multi handle's executor
+		/// @param easyHandle The easy handle of the transfer
+		/// @param pin Pins the easy handle to the lookup's answer
+		static void Resume(BasicMulti* multi, std::shared_ptr<PendingLookups> lookups,
+			asio::any_io_executor executor, CURL* easyHandle,
+			const std::function<void()>& pin);
+		/// @brief Takes a transfer out of the ones waiting on DNS
+		/// @param lookups The transfers waiting on DNS
+		/// @param easyHandle The easy handle of the transfer
+		/// @return The handler, or nullptr if it isn't waiting
+		static std::unique_ptr<PerformHandlerBase> TakeLookup(PendingLookups& lookups,
+			CURL* easyHandle) noexcept;
+		/// @brief Adds every queued submission to the multi handle. Must
+		/// be called in the strand
+		void DrainSubmissions() noexcept;
+		/// @brief Adds a submission to the multi handle. Must be called
+		/// in the strand
+		/// @param performHandler The handler
+		/// @return The error, if the handle couldn't be added
+		CURLMcode AddSubmission(std::unique_ptr<PerformHandlerBase>& performHandler) noexcept;
+		/// @brief Wraps a handler so that it runs serialized with every
+		/// other call into cURL
+		/// @tparam Handler The handler type
+		/// @param handler The handler
+		/// @return The wrapped handler
+		template<typename Handler>
+		inline auto Serialized(Handler&& handler) const
+		{
+			return ThreadingPolicy::Wrap(m_serializer, std::forward<Handler>(handler));
+		}
+		/// @brief Runs a HEAD request for each connection to each origin
+		/// @param origins The origins
+		/// @param connectionsPerHost The connections to open to each origin
+		/// @param handler Called on the multi handle's executor with the first
+		/// error and the number of connections opened, once they all finish
+		void StartPrewarm(const std::vector<std::string>& origins, size_t connectionsPerHost,
+			std::function<void(const error_code&, size_t)> handler);
+		/// @brief Waits for the next keep warm interval, then prewarms and
+		/// waits again. Must be called in the strand
+		void ArmKeepWarm();
+		/// @brief Tells the endpoint selector, the circuit breaker, the
+		/// redirect cache and the memory budget that a transfer ended
+		/// without a result, so its endpoint isn't left loaded
+		/// @param handler The handler of the transfer
+		void Release(PerformHandlerBase& handler) noexcept;
+		/// @brief Records the connect, first byte and done phases of a
+		/// traced transfer that just finished
+		/// @param handler The handler of the transfer
+		static void TraceDone(PerformHandlerBase& handler) noexcept;
 		/// @brief Checks the handle for completed handles and calls any
 		/// completion handlers for finished transfers, before removing them
 		void CheckTransfers() noexcept;
@@ -227,18 +649,44 @@ namespace cma
 		/// @param s The socket
 		/// @param what The type of event
 		void EventCallback(const asio::error_code& ec, curl_socket_t s,
-			int what, int* last) noexcept;
+			int what) noexcept;
 		asio::any_io_executor m_executor;
 #ifdef CMA_MANAGE_CURL
 		Detail::Lifetime s_lifetime;
 #endif
+		// submissions that haven't reached the strand yet
+		Detail::MpscQueue<PerformHandlerBase> m_submissions;
 		// when the handlers are destructed, their curl handle must be untracked
 		std::unordered_map<CURL*, std::unique_ptr<PerformHandlerBase>> m_easyHandlerMap;
-		std::unordered_map<curl_socket_t, asio::ip::tcp::socket> m_easySocketMap;
+		std::shared_ptr<PendingLookups> m_lookups = std::make_shared<PendingLookups>();
+		std::unordered_map<curl_socket_t, EasySocket> m_easySocketMap;
+		// easy handles kept in the multi handle by AsyncConnect
+		std::unordered_set<CURL*> m_connections;
 		asio::system_timer m_timer;
-		asio::strand<asio::any_io_executor> m_strand;
+		asio::steady_timer m_keepWarmTimer;
+		// only touched in the strand
+		std::vector<std::string> m_keepWarmOrigins;
+		size_t m_keepWarmConnections = 0;
+		std::chrono::milliseconds m_keepWarmInterval{ 0 };
+		std::function<void(Easy&)> m_prewarmPrototype;
+		typename ThreadingPolicy::serializer_type m_serializer;
+		Tracer* m_tracer = nullptr;
+		Share* m_share = nullptr;
+		DnsCache* m_dnsCache = nullptr;
+		EndpointSelector* m_endpointSelector = nullptr;
+		CircuitBreaker* m_circuitBreaker = nullptr;
+		RedirectCache* m_redirectCache = nullptr;
+		MemoryBudget* m_memoryBudget = nullptr;
+		// lets DNS lookups that finish after destruction abort their transfers
+		std::shared_ptr<std::atomic_bool> m_alive = std::make_shared<std::atomic_bool>(true);
 		std::unique_ptr<CURLM, decltype(&curl_multi_cleanup)> m_nativeHandle;
 	};
+
+	extern template class BasicMulti<ThreadSafe>;
+	extern template class BasicMulti<SingleThreaded>;
+
+	/// @brief Multi is a multi handle that can be used from any thread
+	using Multi = BasicMulti<ThreadSafe>;
 }
 
 #endif
\ No newline at end of file
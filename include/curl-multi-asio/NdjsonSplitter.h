@@ -0,0 +1,66 @@
+#ifndef CURLMULTIASIO_NDJSONSPLITTER_H_
+#define CURLMULTIASIO_NDJSONSPLITTER_H_
+
+/// @file
+/// Streaming splitting of newline-delimited records
+/// 10/19/26
+
+// STL includes
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace cma
+{
+	/// @brief NdjsonSplitter splits a body of newline-delimited records,
+	/// such as NDJSON or JSON Lines, as it arrives, and hands each record
+	/// to a handler. Records that lie whole inside a chunk are handed over
+	/// in place, and only a record split across chunks is copied. Trailing
+	/// carriage returns are dropped, and empty lines are skipped. It is a
+	/// body consumer, so it can be passed to Easy::SetBuffer
+	class NdjsonSplitter
+	{
+	public:
+		/// @brief Receives a record, which is only valid during the call.
+		/// Returning false stops the splitter, and aborts the transfer
+		using Handler = std::function<bool(std::string_view record)>;
+
+		/// @brief Creates a splitter
+		/// @param handler Receives the records
+		/// @param maxRecordSize The largest record accepted. A longer one
+		/// stops the splitter instead of buffering without bound
+		explicit NdjsonSplitter(Handler handler, size_t maxRecordSize = 1 << 20);
+
+		/// @brief Splits the next chunk of the body
+		/// @param chunk The chunk
+		/// @return Whether or not the splitter is still going
+		bool Consume(std::string_view chunk);
+		/// @brief Hands over the last record, if the body didn't end in
+		/// a newline
+		/// @return Whether or not the whole body was split
+		bool Finish();
+		/// @brief Drops any partial record, so another body can be split
+		void Reset() noexcept;
+
+		/// @return Whether or not the splitter stopped, because a record
+		/// was too long or the handler refused one
+		inline bool Failed() const noexcept { return m_failed; }
+		/// @return The number of records handed over
+		inline uint64_t GetRecords() const noexcept { return m_records; }
+	private:
+		/// @brief Hands a record to the handler
+		/// @param record The record, without its newline
+		/// @return Whether or not the splitter is still going
+		bool Deliver(std::string_view record);
+
+		Handler m_handler;
+		size_t m_maxRecordSize;
+		// the start of a record split across chunks
+		std::string m_pending;
+		uint64_t m_records = 0;
+		bool m_failed = false;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,174 @@
+#ifndef CURLMULTIASIO_REDIRECTCACHE_H_
+#define CURLMULTIASIO_REDIRECTCACHE_H_
+
+/// @file
+/// Caching of permanent redirects
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+
+// STL includes
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cma
+{
+	/// @brief How many redirects a RedirectCache keeps, and for how long
+	struct RedirectCacheOptions
+	{
+		/// @brief The most redirects kept. The least recently used one is
+		/// dropped to make room
+		size_t maxEntries = 1024;
+		/// @brief How long a redirect is kept after it was last seen
+		std::chrono::seconds ttl{ 3600 };
+		/// @brief The most cached redirects followed for one URL, which
+		/// also stops loops
+		size_t maxHops = 8;
+	};
+
+	/// @brief Counters of a RedirectCache's activity
+	struct RedirectCacheStats
+	{
+		/// @brief Transfers whose URL was rewritten
+		uint64_t hits = 0;
+		/// @brief Transfers that could have been rewritten, but whose URL
+		/// had no cached redirect
+		uint64_t misses = 0;
+		/// @brief Redirects learned, or seen again
+		uint64_t learned = 0;
+		/// @brief Redirects dropped for room or because they expired
+		uint64_t evictions = 0;
+		/// @brief Redirects kept right now
+		size_t entries = 0;
+	};
+
+	/// @brief RedirectCache learns the 301 and 308 redirects that GET and
+	/// HEAD transfers following redirects are answered with, and rewrites the
+	/// URL of later such transfers to the final target before they are added,
+	/// so they skip the round trip. Only redirects that stay on the same
+	/// scheme, host and port are learned, since cURL drops credentials and
+	/// custom headers on its way to another host. It watches each transfer's
+	/// response headers through CURLOPT_HEADERFUNCTION, passes them on to the
+	/// transfer's own header callback, and gives the handle its own URL back
+	/// once the transfer is done. It is attached to a Multi, and can be used
+	/// from any thread
+	class RedirectCache
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		/// @brief Creates a redirect cache
+		/// @param options The options
+		explicit RedirectCache(RedirectCacheOptions options = {});
+		RedirectCache(const RedirectCache&) = delete;
+		RedirectCache& operator=(const RedirectCache&) = delete;
+
+		/// @param url The URL
+		/// @return Where the cached redirects of a URL end up, if it has any
+		std::optional<std::string> Lookup(const std::string& url);
+		/// @brief Rewrites a transfer's URL if it has cached redirects and
+		/// follows redirects with GET or HEAD, and starts watching its response headers by wrapping its header
+		/// callback
+		/// @param easy The easy handle of the transfer
+		void Prepare(Easy& easy);
+		/// @brief Learns the permanent redirects a finished transfer got,
+		/// and stops watching it and restores its URL
+		/// @param easy The easy handle of the transfer
+		/// @param result The result of the transfer
+		void Record(CURL* easy, CURLcode result) noexcept;
+		/// @brief Stops watching a transfer that was aborted, and restores
+		/// its URL
+		/// @param easy The easy handle of the transfer
+		void Release(CURL* easy) noexcept;
+		/// @brief Forgets a URL's redirect
+		/// @param url The URL
+		void Erase(const std::string& url);
+		/// @brief Forgets every redirect
+		void Clear();
+
+		/// @return The counters
+		RedirectCacheStats GetStats() const noexcept;
+		/// @return The options
+		inline const RedirectCacheOptions& GetOptions() const noexcept { return m_options; }
+	private:
+		/// @brief A cached redirect
+		struct Entry
+		{
+			std::string target;
+			clock::time_point expiresAt;
+			std::list<std::string>::iterator lru;
+		};
+		/// @brief A response to a transfer, one per redirect it followed
+		struct Hop
+		{
+			long status = 0;
+			std::string location;
+		};
+		/// @brief A transfer being watched. Only its header callback
+		/// touches it while it runs
+		struct Watch
+		{
+			std::string url;
+			std::vector<Hop> hops;
+			// the transfer's own header callback, restored once it's done
+			Easy::Sink sink;
+			// what the headers are passed on to, which is the write
+			// callback if only CURLOPT_HEADERDATA was set
+			curl_write_callback forward = nullptr;
+			// whether it follows redirects with GET or HEAD
+			bool learn = false;
+			// the handle and its URL, if the URL was rewritten
+			Easy* easy = nullptr;
+			std::string original;
+		};
+
+		/// @brief Follows the cached redirects of a URL. Must hold the mutex
+		/// @param url The URL
+		/// @param now The current time
+		/// @return The final target, if the URL has any
+		std::optional<std::string> Resolve(const std::string& url, clock::time_point now);
+		/// @brief Adds or refreshes a redirect. Must hold the mutex
+		/// @param url The URL
+		/// @param target Where it redirects to
+		/// @param now The current time
+		void Store(const std::string& url, std::string target, clock::time_point now);
+		/// @brief Stops watching a transfer, and restores its header callback
+		/// and URL
+		/// @param easy The easy handle of the transfer
+		/// @return The watch, if it was watched
+		std::unique_ptr<Watch> Unwatch(CURL* easy) noexcept;
+		/// @brief Resolves a Location header against the URL it came from
+		/// @param base The URL of the response
+		/// @param location The Location header
+		/// @return The absolute URL, or nothing if it can't be resolved
+		static std::string Join(const std::string& base, const std::string& location);
+		/// @param url The URL
+		/// @return The scheme, host and port of a URL, or nothing if it
+		/// can't be parsed
+		static std::string Origin(const std::string& url);
+		/// @brief Collects the status line and Location of each response,
+		/// and passes the header on. For a description of arguments, check
+		/// cURL documentation for CURLOPT_HEADERFUNCTION
+		/// @return The number of bytes taken
+		static size_t HeaderCb(char* buffer, size_t size, size_t nitems, Watch* userdata) noexcept;
+
+		RedirectCacheOptions m_options;
+		mutable std::mutex m_mutex;
+		std::unordered_map<std::string, Entry> m_entries;
+		// least recently used first
+		std::list<std::string> m_lru;
+		std::unordered_map<CURL*, std::unique_ptr<Watch>> m_watches;
+		RedirectCacheStats m_stats;
+	};
+}
+
+#endif
\ No newline at end of file
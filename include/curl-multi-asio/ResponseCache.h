@@ -0,0 +1,274 @@
+#ifndef CURLMULTIASIO_RESPONSECACHE_H_
+#define CURLMULTIASIO_RESPONSECACHE_H_
+
+/// @file
+/// HTTP response cache, with conditional revalidation
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Error.h>
+
+// STL includes
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cma
+{
+	/// @brief How a ResponseCache keeps its responses
+	struct ResponseCacheOptions
+	{
+		/// @brief The most bytes of bodies kept in memory, over every shard
+		size_t maxBytes = 64 * 1024 * 1024;
+		/// @brief How many independently locked shards the cache is split
+		/// into. Each gets an even part of maxBytes
+		size_t shards = 16;
+		/// @brief Bodies larger than this are passed through, not stored
+		size_t maxEntryBytes = 4 * 1024 * 1024;
+		/// @brief A directory for the on-disk tier, whose entries are memory
+		/// mapped and survive restarts. Empty keeps everything in memory
+		std::string diskPath;
+		/// @brief The most bytes kept in the on-disk tier
+		size_t maxDiskBytes = 256 * 1024 * 1024;
+	};
+
+	/// @brief Counters of a ResponseCache's activity
+	struct ResponseCacheStats
+	{
+		/// @brief Fetches answered without touching the network
+		uint64_t hits = 0;
+		/// @brief Fetches answered from the on-disk tier, also counted as
+		/// hits or revalidations
+		uint64_t diskHits = 0;
+		/// @brief Fetches that sent a conditional request and got a 304
+		uint64_t revalidations = 0;
+		/// @brief Fetches that transferred a body
+		uint64_t misses = 0;
+		/// @brief Responses stored
+		uint64_t stores = 0;
+		/// @brief Responses evicted from memory to make room
+		uint64_t evictions = 0;
+		/// @brief Bytes of bodies in memory
+		size_t bytes = 0;
+	};
+
+	/// @brief A response body that is shared instead of copied. Bodies in
+	/// memory and bodies mapped from disk look the same, and each stays
+	/// valid for as long as a pointer to it is held
+	using ResponseBody = std::shared_ptr<const std::string_view>;
+	/// @brief Wraps a transferred body without copying it
+	/// @param data The body
+	/// @return The body, which owns its data
+	ResponseBody MakeResponseBody(std::string data);
+
+	/// @brief The result of a fetch through a ResponseCache
+	struct CachedResponse
+	{
+		/// @brief The HTTP status. A 304 to a conditional request made by the
+		/// cache is reported as the 200 it revalidated
+		long status = 0;
+		/// @brief The body
+		ResponseBody body;
+		/// @brief Whether it was answered without touching the network
+		bool fromCache = false;
+		/// @brief Whether the cached body was confirmed by a 304
+		bool revalidated = false;
+	};
+
+	/// @brief ResponseCache sits in front of AsyncPerform, and keeps GET
+	/// responses in a sharded LRU bounded by bytes. It honors Cache-Control
+	/// and Expires for freshness, and revalidates stale responses with
+	/// If-None-Match and If-Modified-Since, so a 304 hands back the cached
+	/// body without transferring or copying it. Responses without a freshness
+	/// lifetime but with a validator are stored and revalidated every time.
+	/// Responses are keyed by URL alone, so requests for a URL are assumed to
+	/// send the same headers, and no-store responses and responses that Vary
+	/// on everything are never stored. An optional on-disk tier keeps entries
+	/// across restarts, and maps them back into memory instead of reading
+	/// them. It can be used from any thread, and from several Multi instances
+	/// at once
+	class ResponseCache
+	{
+	public:
+		using clock = std::chrono::system_clock;
+
+		/// @brief Creates a cache, and opens the on-disk tier if there is one
+		/// @param options The options
+		explicit ResponseCache(ResponseCacheOptions options = {});
+		/// @brief Destroys the cache. Fetches in flight still complete, but
+		/// aren't stored
+		~ResponseCache() noexcept;
+		ResponseCache(const ResponseCache&) = delete;
+		ResponseCache& operator=(const ResponseCache&) = delete;
+
+		/// @brief Fetches the URL of an easy handle through the cache. A fresh
+		/// response is answered right away, a stale one is revalidated, and
+		/// anything else is performed on the multi handle and stored if it is
+		/// cacheable. The cache takes over the easy handle's write callback,
+		/// since the body is delivered in the response, and adds its
+		/// conditional headers only for the duration of the transfer. Only
+		/// use it for GET requests. The easy handle must stay in scope until
+		/// the handler is called. The completion token signature is
+		/// void(error_code, CachedResponse)
+		/// @tparam Performer A Multi, ThreadedMulti or ShardedMulti
+		/// @tparam CompletionToken The completion token type
+		/// @param multi The multi handle to perform on
+		/// @param easyHandle The easy handle, with its URL set. One without a
+		/// URL fails with CURLE_URL_MALFORMAT, since it has no key
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename Performer, typename CompletionToken>
+		auto AsyncFetch(Performer& multi, Easy& easyHandle, CompletionToken&& token)
+		{
+			auto initiation = [this, &multi](auto&& handler, Easy& easy)
+			{
+				asio::any_io_executor fallback = asio::system_executor();
+				if constexpr (requires { multi.GetExecutor(); })
+					fallback = multi.GetExecutor();
+				auto executor = asio::get_associated_executor(handler, fallback);
+				if (easy.GetURL().empty() == true)
+				{
+					asio::post(executor, [handler = std::move(handler)]() mutable
+						{
+							handler(error_code(CURLE_URL_MALFORMAT), CachedResponse{});
+						});
+					return;
+				}
+				auto fetch = Begin(easy);
+				if (fetch->response.fromCache == true)
+				{
+					asio::post(executor, [handler = std::move(handler),
+						response = std::move(fetch->response)]() mutable
+						{
+							handler(error_code{}, std::move(response));
+						});
+					return;
+				}
+				multi.AsyncPerform(easy, asio::bind_executor(executor,
+					[this, alive = m_alive, &easy, fetch = std::move(fetch),
+					handler = std::move(handler)](const error_code& ec) mutable
+					{
+						// a destroyed cache can't store anything, but the
+						// transfer still happened
+						const auto res = Finish(easy, *fetch, ec, *alive);
+						handler(res, std::move(fetch->response));
+					}));
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code, CachedResponse)>(initiation, token, std::ref(easyHandle));
+		}
+
+		/// @brief Looks up a response without fetching or revalidating it
+		/// @param url The URL
+		/// @return The body, if a fresh response is cached
+		ResponseBody Find(const std::string& url);
+		/// @brief Forgets a URL, in memory and on disk
+		/// @param url The URL
+		void Erase(const std::string& url);
+		/// @brief Forgets every response in memory. The on-disk tier is kept
+		void Clear() noexcept;
+		/// @return The counters
+		ResponseCacheStats GetStats() const noexcept;
+		/// @return The options
+		inline const ResponseCacheOptions& GetOptions() const noexcept { return m_options; }
+	private:
+		/// @brief A stored response, shared by everything that uses it
+		struct Entry
+		{
+			ResponseBody body;
+			clock::time_point expiresAt;
+			// how long it is fresh for, which a 304 that doesn't say renews
+			std::chrono::seconds lifetime{ 0 };
+			std::string etag;
+			std::string lastModified;
+		};
+		/// @brief An independently locked LRU
+		struct Shard
+		{
+			std::mutex mutex;
+			// most recently used first
+			std::list<std::pair<std::string, std::shared_ptr<const Entry>>> lru;
+			std::unordered_map<std::string_view, decltype(lru)::iterator> index;
+			size_t bytes = 0;
+			ResponseCacheStats stats;
+		};
+		/// @brief The state of one fetch
+		struct Fetch
+		{
+			std::string url;
+			// the entry being revalidated, kept alive in case it is evicted
+			// while the request is in flight
+			std::shared_ptr<const Entry> stale;
+			bool fromDisk = false;
+			std::string body;
+			std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> headers{
+				nullptr, curl_slist_free_all };
+			CachedResponse response;
+		};
+
+		/// @brief Answers a fetch from the cache, or prepares the easy handle
+		/// to perform it
+		/// @param easy The easy handle
+		/// @return The fetch. Its response is from the cache if it is fresh
+		std::shared_ptr<Fetch> Begin(Easy& easy);
+		/// @brief Completes a performed fetch, storing or refreshing the entry
+		/// @param easy The easy handle
+		/// @param fetch The fetch
+		/// @param ec The result of the transfer
+		/// @param alive Whether the cache still exists
+		/// @return The result of the fetch
+		error_code Finish(Easy& easy, Fetch& fetch, error_code ec, bool alive);
+		/// @param url The URL
+		/// @return The shard that holds it
+		Shard& GetShard(const std::string& url) noexcept;
+		/// @brief Looks a URL up in memory, then on disk
+		/// @param url The URL
+		/// @param fromDisk Set if it came from disk
+		/// @return The entry, or nullptr
+		std::shared_ptr<const Entry> Lookup(const std::string& url, bool& fromDisk);
+		/// @brief Stores an entry in memory, and on disk if there is a tier
+		/// @param url The URL
+		/// @param entry The entry
+		/// @param persist Whether to write it to disk
+		void Store(const std::string& url, std::shared_ptr<const Entry> entry, bool persist);
+		/// @brief Makes room in a shard. Must hold its mutex
+		/// @param shard The shard
+		/// @param incoming The size of the entry that needs room
+		void Evict(Shard& shard, size_t incoming) noexcept;
+
+		/// @param url The URL
+		/// @return The path of its file in the on-disk tier
+		std::string GetDiskFile(const std::string& url) const;
+		/// @brief Maps an entry back from the on-disk tier
+		/// @param url The URL
+		/// @return The entry, or nullptr
+		std::shared_ptr<const Entry> LoadFromDisk(const std::string& url) const;
+		/// @brief Writes an entry to the on-disk tier
+		/// @param url The URL
+		/// @param entry The entry
+		void SaveToDisk(const std::string& url, const Entry& entry);
+		/// @brief Removes the oldest files until the tier fits, plus room
+		/// for another file
+		/// @param incoming The size of the file that needs room
+		void TrimDisk(size_t incoming);
+
+		ResponseCacheOptions m_options;
+		std::vector<std::unique_ptr<Shard>> m_shards;
+		// guards the on-disk tier's size
+		std::mutex m_diskMutex;
+		size_t m_diskBytes = 0;
+		// names the files being written, so that writers never collide
+		std::atomic<uint64_t> m_tempCounter = 0;
+		std::shared_ptr<std::atomic_bool> m_alive = std::make_shared<std::atomic_bool>(true);
+	};
+}
+
+#endif
\ No newline at end of file
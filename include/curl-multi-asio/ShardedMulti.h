@@ -0,0 +1,216 @@
+#ifndef CURLMULTIASIO_SHARDEDMULTI_H_
+#define CURLMULTIASIO_SHARDEDMULTI_H_
+
+/// @file
+/// Multi handles sharded across executors, with work stealing
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/Multi.h>
+
+// STL includes
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cma
+{
+	/// @brief A snapshot of a shard's load
+	struct ShardMetrics
+	{
+		/// @brief Transfers waiting in the shard's deque
+		size_t queued = 0;
+		/// @brief Transfers running on the shard's multi handle
+		size_t inFlight = 0;
+		/// @brief Transfers routed to the shard
+		uint64_t submitted = 0;
+		/// @brief Transfers the shard started, including stolen ones
+		uint64_t started = 0;
+		/// @brief Transfers the shard finished
+		uint64_t completed = 0;
+		/// @brief Transfers the shard took from other shards
+		uint64_t stolen = 0;
+		/// @brief Transfers other shards took from this one
+		uint64_t stolenFrom = 0;
+	};
+
+	/// @brief ShardedMulti spreads transfers over several Multi instances,
+	/// usually one per thread. Each shard runs at most a fixed number of
+	/// transfers, and the rest wait in the shard's deque. A shard with spare
+	/// capacity and nothing queued steals transfers that haven't started
+	/// from the back of the other shards' deques. Transfers that have been
+	/// added to a multi handle never move, because cURL can't migrate them
+	class ShardedMulti
+	{
+	private:
+		struct Shard;
+		/// @brief A transfer that has been submitted, but not started
+		class TransferBase
+		{
+		public:
+			explicit TransferBase(Easy& easy) noexcept : m_easy(easy) {}
+			virtual ~TransferBase() = default;
+
+			/// @brief Starts the transfer on a shard
+			/// @param sharded The sharded multi
+			/// @param shard The shard
+			virtual void Start(ShardedMulti& sharded, Shard& shard) = 0;
+			/// @brief Posts the handler with an error without starting
+			/// @param ec The error code
+			/// @param executor The executor to use if the handler has none
+			virtual void Abort(error_code ec, const asio::any_io_executor& executor) noexcept = 0;
+		protected:
+			Easy& m_easy;
+		};
+		/// @brief A multi handle, its deque and its counters
+		struct Shard
+		{
+			Shard(const asio::any_io_executor& executor, size_t index) :
+				multi(executor), index(index) {}
+
+			Multi multi;
+			size_t index;
+			std::mutex mutex;
+			// guarded by the mutex
+			std::deque<std::unique_ptr<TransferBase>> queue;
+			size_t inFlight = 0;
+			// only ever read as a snapshot
+			std::atomic<uint64_t> submitted = 0;
+			std::atomic<uint64_t> started = 0;
+			std::atomic<uint64_t> completed = 0;
+			std::atomic<uint64_t> stolen = 0;
+			std::atomic<uint64_t> stolenFrom = 0;
+		};
+		template<typename Handler>
+		class Transfer : public TransferBase
+		{
+		public:
+			Transfer(Easy& easy, Handler& handler) :
+				TransferBase(easy), m_handler(std::move(handler)) {}
+
+			void Start(ShardedMulti& sharded, Shard& shard) override
+			{
+				// the multi completes through the handler's executor, so
+				// the wrapper is bound to it
+				auto executor = asio::get_associated_executor(m_handler, shard.multi.GetExecutor());
+				shard.multi.AsyncPerform(m_easy, asio::bind_executor(executor,
+					[&sharded, &shard, alive = sharded.m_alive,
+					handler = std::move(m_handler)](const error_code& ec) mutable
+					{
+						// completions that were aborted by the destructor
+						// must not touch the shards
+						if (*alive == false)
+							return handler(ec);
+						sharded.Finish(shard);
+						handler(ec);
+						sharded.Pump(shard);
+					}));
+			}
+			void Abort(error_code ec, const asio::any_io_executor& executor) noexcept override
+			{
+				asio::post(asio::get_associated_executor(m_handler, executor),
+					[handler = std::move(m_handler), ec]() mutable
+					{
+						handler(ec);
+					});
+			}
+		private:
+			Handler m_handler;
+		};
+	public:
+		/// @brief Creates a shard with a multi handle on each executor
+		/// @param executors The executors, one for each shard
+		/// @param maxInFlight The maximum number of transfers running on
+		/// each shard at once
+		ShardedMulti(const std::vector<asio::any_io_executor>& executors,
+			size_t maxInFlight);
+		/// @brief Aborts the transfers that haven't started, and cancels
+		/// every shard's multi handle
+		~ShardedMulti() noexcept;
+		ShardedMulti(const ShardedMulti&) = delete;
+		ShardedMulti& operator=(const ShardedMulti&) = delete;
+
+		/// @return The number of shards
+		inline size_t GetShardCount() const noexcept { return m_shards.size(); }
+		/// @param shard The shard index
+		/// @return The shard's multi handle, for setting options
+		inline Multi& GetMulti(size_t shard) noexcept { return m_shards[shard]->multi; }
+		/// @return The maximum number of transfers running on each shard
+		inline size_t GetMaxInFlight() const noexcept { return m_maxInFlight; }
+
+		/// @brief Launches an asynchronous perform operation on the next
+		/// shard in turn. It may be stolen by another shard before it
+		/// starts. The easy handle must stay in scope until the handler is
+		/// called. The completion token signature is void(error_code)
+		/// @tparam CompletionToken The completion token type
+		/// @param easyHandle The easy handle to perform the action on
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncPerform(Easy& easyHandle, CompletionToken&& token)
+		{
+			return AsyncPerform(m_nextShard.fetch_add(1, std::memory_order_relaxed) %
+				m_shards.size(), easyHandle, std::forward<CompletionToken>(token));
+		}
+		/// @brief Launches an asynchronous perform operation on a chosen
+		/// shard, such as the one owned by the calling thread. It may be
+		/// stolen by another shard before it starts. The easy handle must
+		/// stay in scope until the handler is called. The completion token
+		/// signature is void(error_code)
+		/// @tparam CompletionToken The completion token type
+		/// @param shard The shard index
+		/// @param easyHandle The easy handle to perform the action on
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncPerform(size_t shard, Easy& easyHandle, CompletionToken&& token)
+		{
+			auto initiation = [this, shard](auto&& handler, Easy& easy)
+			{
+				Submit(*m_shards[shard % m_shards.size()],
+					std::make_unique<Transfer<std::decay_t<decltype(handler)>>>(easy, handler));
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code)>(initiation, token, std::ref(easyHandle));
+		}
+		/// @brief Aborts the transfers that haven't started, and cancels the
+		/// running ones on every shard. Handlers are called with
+		/// asio::error::operation_aborted
+		/// @param ec The error code output
+		/// @return The number of operations canceled
+		size_t Cancel(asio::error_code& ec) noexcept;
+
+		/// @param shard The shard index
+		/// @return A snapshot of the shard's load
+		ShardMetrics GetMetrics(size_t shard) const noexcept;
+	private:
+		/// @brief Queues a transfer on its shard, and starts as many
+		/// transfers as there is capacity for
+		/// @param shard The shard
+		/// @param transfer The transfer
+		void Submit(Shard& shard, std::unique_ptr<TransferBase> transfer);
+		/// @brief Starts transfers on a shard until it is full, or until
+		/// there is nothing left to take from any shard
+		/// @param shard The shard
+		void Pump(Shard& shard);
+		/// @brief Takes a transfer from the back of another shard's deque
+		/// @param thief The shard that wants work
+		/// @return The transfer, or nullptr if every deque is empty
+		std::unique_ptr<TransferBase> Steal(Shard& thief);
+		/// @brief Releases a shard's capacity once a transfer finishes
+		/// @param shard The shard
+		void Finish(Shard& shard) noexcept;
+
+		std::vector<std::unique_ptr<Shard>> m_shards;
+		size_t m_maxInFlight;
+		std::shared_ptr<std::atomic_bool> m_alive = std::make_shared<std::atomic_bool>(true);
+		std::atomic<size_t> m_nextShard = 0;
+	};
+}
+
+#endif
\ No newline at end of file
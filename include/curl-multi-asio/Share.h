@@ -0,0 +1,134 @@
+#ifndef CURLMULTIASIO_SHARE_H_
+#define CURLMULTIASIO_SHARE_H_
+
+/// @file
+/// cURL Share Handle, with persistence
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Detail/Lifetime.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Error.h>
+
+// STL includes
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace cma
+{
+	/// @brief Where and how often a Share persists its caches
+	struct ShareOptions
+	{
+		/// @brief The file that TLS sessions are saved to. HSTS and Alt-Svc
+		/// are kept in cURL's own formats next to it, in path.hsts and
+		/// path.altsvc. Empty keeps everything in memory
+		std::string path;
+		/// @brief How often to save, or zero to only save on destruction.
+		/// It needs an executor
+		std::chrono::seconds saveInterval{ 0 };
+	};
+
+	/// @brief Share is a wrapper around a CURLSH handle that shares DNS,
+	/// TLS sessions and HSTS between easy handles, and persists them to
+	/// disk so that a restarted process doesn't start with cold caches.
+	/// Everything is loaded at construction and saved on destruction, and
+	/// on an interval if an executor is given. TLS sessions can only be
+	/// saved if cURL is 8.12 or newer and built with SSLS-EXPORT. The share
+	/// must outlive every easy handle attached to it
+	class Share
+	{
+	public:
+		/// @brief Creates the share, and loads the caches
+		/// @param options The options
+		explicit Share(ShareOptions options = {}) noexcept;
+		/// @brief Creates the share, loads the caches, and saves them on
+		/// an interval
+		/// @param executor The executor for the save timer
+		/// @param options The options
+		Share(const asio::any_io_executor& executor, ShareOptions options) noexcept;
+		/// @brief Saves the caches, and destroys the share
+		~Share() noexcept;
+		Share(const Share&) = delete;
+		Share& operator=(const Share&) = delete;
+
+		/// @return The native handle
+		inline CURLSH* GetNativeHandle() const noexcept { return m_nativeHandle.get(); }
+		/// @return The options
+		inline const ShareOptions& GetOptions() const noexcept { return m_options; }
+		/// @return Whether or not the handle is valid
+		inline operator bool() const noexcept { return m_nativeHandle != nullptr; }
+
+		/// @brief Attaches an easy handle to the share, and turns on HSTS.
+		/// It is cheap enough to call before every transfer, which is what
+		/// Multi does with a share set
+		/// @param easy The easy handle
+		/// @return The resulting error
+		error_code Attach(Easy& easy) noexcept;
+		/// @brief Gives an easy handle the persisted Alt-Svc cache. cURL
+		/// can't share Alt-Svc, so each easy handle reads the file when
+		/// this is called and writes it back when it is destroyed. Call it
+		/// once per easy handle, not once per transfer
+		/// @param easy The easy handle
+		/// @return The resulting error
+		error_code AttachAltSvc(Easy& easy) noexcept;
+		/// @brief Writes the caches to disk
+		/// @return The resulting error. TLS sessions that can't be exported
+		/// are skipped without an error
+		error_code Save() noexcept;
+		/// @return The number of TLS sessions in the last save or load
+		inline size_t GetSessionCount() const noexcept { return m_sessionCount; }
+	private:
+		/// @brief Locks shared data. For a description of arguments, check
+		/// cURL documentation for CURLSHOPT_LOCKFUNC
+		static void LockCb(CURL* handle, curl_lock_data data,
+			curl_lock_access access, Share* userp) noexcept;
+		/// @brief Unlocks shared data. For a description of arguments,
+		/// check cURL documentation for CURLSHOPT_UNLOCKFUNC
+		static void UnlockCb(CURL* handle, curl_lock_data data, Share* userp) noexcept;
+		/// @brief Creates the handle that HSTS is loaded and saved through,
+		/// and that TLS sessions are imported and exported through
+		/// @return The easy handle
+		std::unique_ptr<Easy> MakeExporter() noexcept;
+		/// @brief Reads HSTS from disk into the share
+		void LoadHsts() noexcept;
+		/// @brief Reads the TLS sessions from disk into the share
+		/// @return The resulting error
+		error_code LoadSessions() noexcept;
+		/// @brief Writes the TLS sessions in the share to disk
+		/// @return The resulting error
+		error_code SaveSessions() noexcept;
+		/// @brief Waits for the next save. Must hold the save guard's mutex
+		void ArmSave();
+
+		/// @brief Shared with the save timer's handler, which holds the
+		/// mutex while it saves and waits again, so that the destructor
+		/// can't run in between
+		struct SaveGuard
+		{
+			std::mutex mutex;
+			// cleared under the mutex by the destructor
+			bool alive = true;
+		};
+
+#ifdef CMA_MANAGE_CURL
+		Detail::Lifetime m_lifeTime;
+#endif
+		ShareOptions m_options;
+		std::array<std::mutex, CURL_LOCK_DATA_LAST> m_locks;
+		std::unique_ptr<CURLSH, decltype(&curl_share_cleanup)> m_nativeHandle;
+		// saves are serialized, since they replace the exporter
+		std::mutex m_saveMutex;
+		std::unique_ptr<Easy> m_exporter;
+		std::atomic<size_t> m_sessionCount = 0;
+		std::optional<asio::steady_timer> m_saveTimer;
+		std::shared_ptr<SaveGuard> m_saveGuard = std::make_shared<SaveGuard>();
+	};
+}
+
+#endif
\ No newline at end of file
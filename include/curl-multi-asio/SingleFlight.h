@@ -0,0 +1,219 @@
+#ifndef CURLMULTIASIO_SINGLEFLIGHT_H_
+#define CURLMULTIASIO_SINGLEFLIGHT_H_
+
+/// @file
+/// Coalescing of identical concurrent requests
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/ResponseCache.h>
+
+// STL includes
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cma
+{
+	/// @brief What makes two requests identical to a SingleFlight
+	struct SingleFlightOptions
+	{
+		/// @brief The request headers that are part of the key, compared
+		/// without case. Requests that differ in any other header are still
+		/// coalesced
+		std::vector<std::string> keyHeaders{ "Accept", "Accept-Encoding",
+			"Accept-Language", "Authorization", "Cookie" };
+	};
+
+	/// @brief Counters of a SingleFlight's activity
+	struct SingleFlightStats
+	{
+		/// @brief Transfers started
+		uint64_t flights = 0;
+		/// @brief Requests that joined a transfer that was already running
+		uint64_t joined = 0;
+		/// @brief Requests canceled before their transfer finished
+		uint64_t abandoned = 0;
+		/// @brief Transfers aborted because every request was canceled
+		uint64_t aborted = 0;
+		/// @brief Transfers running right now
+		size_t inFlight = 0;
+	};
+
+	/// @brief The result of a request through a SingleFlight
+	struct FlightResponse
+	{
+		/// @brief The HTTP status
+		long status = 0;
+		/// @brief The body, the same one for every request in the flight
+		ResponseBody body;
+		/// @brief Whether the request joined a transfer that another
+		/// request started
+		bool joined = false;
+	};
+
+	/// @brief SingleFlight coalesces identical requests that are made while
+	/// one of them is in flight. The first request of a key starts the
+	/// transfer, the rest attach to it, and all of them complete with the
+	/// same immutable body. A key is the method, the URL and the key
+	/// headers, so only coalesce requests that are safe to share, such as
+	/// GETs. The transfer runs on a copy of the first request's easy handle,
+	/// so a request that is canceled only detaches itself, and the transfer
+	/// is aborted once no request is waiting for it. It can be used from any
+	/// thread, and from several Multi instances at once
+	class SingleFlight
+	{
+	public:
+		/// @brief Creates a single-flight group
+		/// @param options The options
+		explicit SingleFlight(SingleFlightOptions options = {});
+		/// @brief Calls every waiting request with
+		/// asio::error::operation_aborted. Transfers in flight still run to
+		/// the end, but nobody hears about them
+		~SingleFlight() noexcept;
+		SingleFlight(const SingleFlight&) = delete;
+		SingleFlight& operator=(const SingleFlight&) = delete;
+
+		/// @brief Performs a request, or joins the identical one in flight.
+		/// The easy handle is only read, never performed, and its body is
+		/// delivered in the response. The transfer's progress callback belongs
+		/// to the group. It must stay in scope until the handler
+		/// is called, since it names the request to Cancel. The completion
+		/// token signature is void(error_code, FlightResponse)
+		/// @tparam Performer A Multi, ThreadedMulti or ShardedMulti
+		/// @tparam CompletionToken The completion token type
+		/// @param multi The multi handle that starts the transfer, if this
+		/// request is the first of its key
+		/// @param method The method, which is part of the key. cURL can't
+		/// report it before the transfer, so it is named here
+		/// @param easyHandle The easy handle, with its URL set. One without a
+		/// URL fails with CURLE_URL_MALFORMAT, since it has no key
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename Performer, typename CompletionToken>
+		auto AsyncFetch(Performer& multi, std::string_view method, Easy& easyHandle,
+			CompletionToken&& token)
+		{
+			auto initiation = [this, &multi](auto&& handler, std::string key, Easy& easy)
+			{
+				asio::any_io_executor fallback = asio::system_executor();
+				if constexpr (requires { multi.GetExecutor(); })
+					fallback = multi.GetExecutor();
+				auto executor = asio::get_associated_executor(handler, fallback);
+				auto work = std::make_shared<asio::executor_work_guard<decltype(executor)>>(executor);
+				// the waiter must be copyable, so the handler is kept on the heap
+				auto shared = std::make_shared<std::decay_t<decltype(handler)>>(std::move(handler));
+				Waiter waiter = [shared, work](const error_code& ec, const FlightResponse& response)
+				{
+					// waiters are called with the group's mutex released,
+					// but maybe on another request's thread, so always post
+					asio::post(work->get_executor(), [shared, ec, response]() mutable
+						{
+							(*shared)(ec, std::move(response));
+						});
+					work->reset();
+				};
+				// requests without a URL would all share one key
+				if (easy.GetURL().empty() == true)
+				{
+					waiter(CURLE_URL_MALFORMAT, FlightResponse{});
+					return;
+				}
+				auto flight = Join(std::move(key), easy, std::move(waiter));
+				if (flight == nullptr)
+					return;
+				// the transfer belongs to the flight, not to the request
+				// that started it, so it completes on the multi's executor
+				multi.AsyncPerform(*flight->easy, [state = m_state,
+					flight](const error_code& ec)
+					{
+						Land(*state, *flight, ec);
+					});
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code, FlightResponse)>(initiation, token,
+					MakeKey(method, easyHandle), std::ref(easyHandle));
+		}
+		/// @brief Detaches a request from its flight, and calls its handler
+		/// with asio::error::operation_aborted. If it was the last request
+		/// waiting, the transfer is aborted from its progress callback, which
+		/// cURL calls at least once a second, so it works the same on every
+		/// kind of multi handle and from any thread
+		/// @param easy The request's easy handle
+		/// @return Whether the request was waiting
+		bool Cancel(const Easy& easy);
+
+		/// @return The counters
+		SingleFlightStats GetStats() const noexcept;
+		/// @return The options
+		inline const SingleFlightOptions& GetOptions() const noexcept { return m_options; }
+	private:
+		using Waiter = std::function<void(const error_code&, const FlightResponse&)>;
+		/// @brief A request waiting on a flight
+		struct Member
+		{
+			const Easy* easy;
+			Waiter waiter;
+			bool leader;
+		};
+		/// @brief A transfer, and the requests waiting on it
+		struct Flight
+		{
+			std::string key;
+			std::unique_ptr<Easy> easy;
+			std::string body;
+			// set once no request is waiting, read by the progress callback
+			std::atomic_bool abandoned = false;
+			// guarded by the group's mutex
+			std::vector<Member> members;
+		};
+		/// @brief Everything a finished transfer touches. Transfers hold on
+		/// to it, so that they can finish after the group is destroyed
+		struct State
+		{
+			std::mutex mutex;
+			std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+			// the flight each waiting request is attached to
+			std::unordered_map<const Easy*, std::shared_ptr<Flight>> members;
+			SingleFlightStats stats;
+			// cleared under the mutex by the destructor
+			bool alive = true;
+		};
+
+		/// @param method The method
+		/// @param easy The easy handle
+		/// @return The key of the request
+		std::string MakeKey(std::string_view method, const Easy& easy) const;
+		/// @brief Attaches a request to the flight of its key, or starts one
+		/// @param key The key
+		/// @param easy The request's easy handle
+		/// @param waiter Called with the result
+		/// @return The new flight, which the caller must start, or nullptr
+		/// if the request joined one that is running
+		std::shared_ptr<Flight> Join(std::string key, const Easy& easy, Waiter waiter);
+		/// @brief Completes every request waiting on a finished flight,
+		/// unless the group is gone
+		/// @param state The state of the group
+		/// @param flight The flight
+		/// @param ec The result of the transfer
+		static void Land(State& state, Flight& flight, const error_code& ec);
+		/// @brief Aborts abandoned flights. For a description of arguments,
+		/// check cURL documentation for CURLOPT_XFERINFOFUNCTION
+		/// @return Non-zero to abort the transfer
+		static int ProgressCb(Flight* clientp, curl_off_t dltotal, curl_off_t dlnow,
+			curl_off_t ultotal, curl_off_t ulnow) noexcept;
+
+		SingleFlightOptions m_options;
+		std::shared_ptr<State> m_state = std::make_shared<State>();
+	};
+}
+
+#endif
\ No newline at end of file
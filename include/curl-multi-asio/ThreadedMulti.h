@@ -0,0 +1,194 @@
+#ifndef CURLMULTIASIO_THREADEDMULTI_H_
+#define CURLMULTIASIO_THREADEDMULTI_H_
+
+/// @file
+/// cURL multi handle driven by a dedicated thread
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Detail/Lifetime.h>
+#include <curl-multi-asio/Detail/MpscQueue.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/Multi.h>
+
+// STL includes
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+namespace cma
+{
+	/// @brief ThreadedMulti is a multi handle that runs cURL's event loop
+	/// on its own thread with curl_multi_poll, instead of through an
+	/// executor. Socket events are never queued behind other work on the
+	/// caller's executors, which helps when those are busy with CPU work.
+	/// Submissions reach the thread through a lock-free queue, and each
+	/// completion is posted to the handler's associated executor. It has
+	/// the same AsyncPerform interface as Multi, so either can be chosen
+	/// per deployment
+	class ThreadedMulti
+	{
+	private:
+		/// @brief What a queued operation asks the thread to do
+		enum class Command
+		{
+			Perform,
+			Cancel,
+			CancelAll
+		};
+		/// @brief A queued command and, for performs, the handler
+		class OperationBase : public Detail::MpscNode
+		{
+		public:
+			OperationBase(Command command, CURL* easyHandle) noexcept :
+				m_command(command), m_easyHandle(easyHandle) {}
+			virtual ~OperationBase() = default;
+
+			/// @brief Posts the handler to its associated executor
+			/// @param ec The error code
+			virtual void Complete(error_code) noexcept {}
+
+			/// @return The command
+			inline Command GetCommand() const noexcept { return m_command; }
+			/// @return The underlying easy handle
+			inline CURL* GetEasyHandle() const noexcept { return m_easyHandle; }
+		private:
+			Command m_command;
+			CURL* m_easyHandle;
+		};
+		template<typename Handler>
+		class PerformOperation : public OperationBase
+		{
+		public:
+			using executor_type = asio::associated_executor_t<Handler, asio::any_io_executor>;
+
+			PerformOperation(CURL* easyHandle, Handler& handler,
+				const asio::any_io_executor& executor) :
+				OperationBase(Command::Perform, easyHandle), m_handler(std::move(handler)),
+				m_work(asio::get_associated_executor(m_handler, executor)) {}
+
+			void Complete(error_code ec) noexcept override
+			{
+				// the handler's executor may be waiting on nothing but this
+				// operation, so keep it busy until the handler is posted
+				auto executor = m_work.get_executor();
+				asio::post(executor, [handler = std::move(m_handler), ec]() mutable
+					{
+						handler(ec);
+					});
+				m_work.reset();
+			}
+		private:
+			Handler m_handler;
+			asio::executor_work_guard<executor_type> m_work;
+		};
+	public:
+		/// @brief Creates the handle and starts its thread. Handlers without
+		/// an associated executor are called on the executor
+		/// @param executor The default executor for completions
+		ThreadedMulti(const asio::any_io_executor& executor);
+		/// @brief Creates the handle and starts its thread. Handlers without
+		/// an associated executor are called on the context's executor
+		/// @tparam ExecutionContext The execution context type
+		/// @param ctx The execution context
+		template<HasExecutor ExecutionContext>
+		explicit ThreadedMulti(ExecutionContext& ctx)
+			: ThreadedMulti(ctx.get_executor()) {}
+		/// @brief Stops the thread, and calls every outstanding handler
+		/// with asio::error::operation_aborted
+		~ThreadedMulti() noexcept;
+		ThreadedMulti(const ThreadedMulti&) = delete;
+		ThreadedMulti& operator=(const ThreadedMulti&) = delete;
+
+		/// @return The default executor for completions
+		inline asio::any_io_executor& GetExecutor() noexcept { return m_executor; }
+		/// @return The native handle
+		inline CURLM* GetNativeHandle() const noexcept { return m_nativeHandle.get(); }
+
+		/// @return Whether or not the handle is valid
+		inline operator bool() const noexcept { return m_nativeHandle != nullptr; }
+
+		/// @brief Launches an asynchronous perform operation, and notifies
+		/// the completion token either on error or success. This can be called
+		/// from multiple threads at once, and never blocks. Once the operation
+		/// is initiated, it is the responsibility of the caller to ensure that
+		/// the easy handle stays in scope until the handler is called. The
+		/// completion token signature is void(error_code)
+		/// @tparam CompletionToken The completion token type
+		/// @param easyHandle The easy handle to perform the action on
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncPerform(Easy& easyHandle, CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler, Easy& easy)
+			{
+				++m_outstanding;
+				Submit(new PerformOperation<std::decay_t<decltype(handler)>>(
+					easy.GetNativeHandle(), handler, m_executor));
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code)>(initiation, token, std::ref(easyHandle));
+		}
+		/// @brief Cancels all outstanding asynchronous operations,
+		/// and calls handlers with asio::error::operation_aborted. The
+		/// cancellation happens on the multi's thread, after every
+		/// operation that was already submitted has been seen
+		/// @param ec The error code output
+		/// @param error Unused, kept for parity with Multi
+		/// @return The number of operations that were outstanding
+		size_t Cancel(asio::error_code& ec,
+			CURLMcode error = CURLMcode::CURLM_OK) noexcept;
+		/// @brief Cancels the outstanding asynchronous operation, and calls
+		/// the handler with asio::error::operation_aborted. The easy handle
+		/// must stay in scope until its handler has been called
+		/// @param easy The easy handle
+		/// @param error Unused, kept for parity with Multi
+		/// @return Whether or not the cancellation was queued
+		bool Cancel(const Easy& easy, CURLMcode error = CURLMcode::CURLM_OK) noexcept;
+
+		/// @brief Sets a multi option. The thread is already using the handle,
+		/// so this is only safe before the first call to AsyncPerform
+		/// @tparam T The option value type
+		/// @param option The option
+		/// @param val The value
+		/// @return The resulting error
+		template<typename T>
+		inline error_code SetOption(CURLMoption option, T&& val) noexcept
+		{
+			return curl_multi_setopt(GetNativeHandle(), option, static_cast<T&&>(val));
+		}
+	private:
+		/// @brief Queues an operation and wakes up the thread
+		/// @param operation The operation, which the thread takes ownership of
+		void Submit(OperationBase* operation) noexcept;
+		/// @brief The thread's event loop
+		void Run() noexcept;
+		/// @brief Applies every queued operation
+		void DrainSubmissions() noexcept;
+		/// @brief Completes the transfers that cURL finished
+		void CheckTransfers() noexcept;
+		/// @brief Removes a transfer and completes its handler
+		/// @param easy The easy handle
+		/// @param ec The error code for the handler
+		/// @return Whether or not there was such a transfer
+		bool Finish(CURL* easy, error_code ec) noexcept;
+
+		asio::any_io_executor m_executor;
+#ifdef CMA_MANAGE_CURL
+		Detail::Lifetime s_lifetime;
+#endif
+		std::unique_ptr<CURLM, decltype(&curl_multi_cleanup)> m_nativeHandle;
+		Detail::MpscQueue<OperationBase> m_submissions;
+		std::atomic_size_t m_outstanding = 0;
+		std::atomic_bool m_stopping = false;
+		// only touched by the thread
+		std::unordered_map<CURL*, std::unique_ptr<OperationBase>> m_easyHandlerMap;
+		std::thread m_thread;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef CURLMULTIASIO_THREADINGPOLICY_H_
+#define CURLMULTIASIO_THREADINGPOLICY_H_
+
+/// @file
+/// Threading policies for BasicMulti
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+
+// STL includes
+#include <type_traits>
+#include <utility>
+
+namespace cma
+{
+	/// @brief The default policy. Every call into cURL is serialized by a
+	/// strand, so operations can be started from any thread, and the
+	/// executor can be run by many threads at once
+	struct ThreadSafe
+	{
+		/// @brief What serializes access to the multi handle
+		using serializer_type = asio::strand<asio::any_io_executor>;
+		/// @brief Whether submissions are added on the calling thread,
+		/// instead of being queued for the serializer
+		static constexpr bool InlineSubmission = false;
+
+		/// @param executor The multi handle's executor
+		/// @return A new strand on the executor
+		static inline serializer_type MakeSerializer(const asio::any_io_executor& executor)
+		{
+			return asio::make_strand(executor);
+		}
+		/// @brief Binds a handler to the strand
+		/// @tparam Handler The handler type
+		/// @param serializer The strand
+		/// @param handler The handler
+		/// @return The bound handler
+		template<typename Handler>
+		static inline auto Wrap(const serializer_type& serializer, Handler&& handler)
+		{
+			return asio::bind_executor(serializer, std::forward<Handler>(handler));
+		}
+	};
+
+	/// @brief A policy for a multi handle that is only ever used from the
+	/// single thread running its executor, such as with one io_context per
+	/// thread. There is no strand, handlers are left unwrapped, and
+	/// submissions are added inline
+	struct SingleThreaded
+	{
+		/// @brief There is nothing to serialize, so this is only the executor
+		using serializer_type = asio::any_io_executor;
+		/// @brief Whether submissions are added on the calling thread,
+		/// instead of being queued for the serializer
+		static constexpr bool InlineSubmission = true;
+
+		/// @param executor The multi handle's executor
+		/// @return The executor
+		static inline serializer_type MakeSerializer(const asio::any_io_executor& executor)
+		{
+			return executor;
+		}
+		/// @brief Returns the handler as it is
+		/// @tparam Handler The handler type
+		/// @param handler The handler
+		/// @return The handler
+		template<typename Handler>
+		static inline std::decay_t<Handler> Wrap(const serializer_type&, Handler&& handler)
+		{
+			return std::forward<Handler>(handler);
+		}
+	};
+}
+
+#endif
\ No newline at end of file
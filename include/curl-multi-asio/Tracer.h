@@ -0,0 +1,130 @@
+#ifndef CURLMULTIASIO_TRACER_H_
+#define CURLMULTIASIO_TRACER_H_
+
+/// @file
+/// Transfer lifecycle tracer
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+
+// STL includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace cma
+{
+	/// @brief The phases of a transfer's lifecycle, in the order
+	/// that they happen
+	enum class TracePhase : uint8_t
+	{
+		/// @brief AsyncPerform was called
+		Submit,
+		/// @brief The submission started running on the strand
+		StrandPost,
+		/// @brief curl_multi_add_handle returned
+		AddHandle,
+		/// @brief The connection was established
+		Connect,
+		/// @brief The first byte of the response was received
+		FirstByte,
+		/// @brief cURL reported the transfer as done
+		Done,
+		/// @brief The completion handler is about to be invoked
+		HandlerInvoke
+	};
+
+	/// @brief Tracer records the lifecycle phases of sampled transfers
+	/// into per-thread ring buffers, which can be dumped as Chrome Trace
+	/// Event JSON and viewed in Perfetto or chrome://tracing. Recording
+	/// an event is wait-free, and unsampled transfers cost a single
+	/// random number, so it can stay enabled in production with a
+	/// low sample rate
+	class Tracer
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		/// @brief Creates a tracer
+		/// @param sampleRate The fraction of transfers to trace, in [0, 1]
+		/// @param eventsPerThread The capacity of each thread's ring buffer.
+		/// Once it is full, the oldest events are overwritten
+		explicit Tracer(double sampleRate = 1.0,
+			size_t eventsPerThread = 1 << 16);
+		Tracer(const Tracer&) = delete;
+		Tracer& operator=(const Tracer&) = delete;
+
+		/// @return The fraction of transfers that are traced
+		inline double GetSampleRate() const noexcept
+		{
+			return m_sampleRate.load(std::memory_order_relaxed);
+		}
+		/// @param sampleRate The fraction of transfers to trace, in [0, 1]
+		inline void SetSampleRate(double sampleRate) noexcept
+		{
+			m_sampleRate.store(sampleRate, std::memory_order_relaxed);
+		}
+
+		/// @brief Decides whether or not to trace a new transfer
+		/// @return The trace ID of the transfer, or 0 if it is not sampled
+		uint64_t Sample() noexcept;
+		/// @brief Records a phase of a sampled transfer on the calling
+		/// thread's ring buffer
+		/// @param id The trace ID returned by Sample
+		/// @param phase The phase
+		/// @param time The time that the phase happened
+		void Record(uint64_t id, TracePhase phase,
+			clock::time_point time = clock::now()) noexcept;
+
+		/// @brief Writes every recorded event as Chrome Trace Event JSON.
+		/// Each transfer becomes an async track with one span per phase.
+		/// This can be called while events are being recorded
+		/// @param os The output stream
+		void WriteChromeTrace(std::ostream& os) const;
+		/// @brief Discards all recorded events. This can be called while
+		/// events are being recorded
+		void Clear() noexcept;
+	private:
+		/// @brief A single event. The fields are atomic so that a dump
+		/// can run concurrently with the writer
+		struct Event
+		{
+			std::atomic<uint64_t> id{ 0 };
+			std::atomic<int64_t> time{ 0 };
+			std::atomic<uint8_t> phase{ 0 };
+		};
+		/// @brief A single-writer ring of events owned by one thread
+		struct Ring
+		{
+			Ring(size_t capacity, uint32_t threadId) :
+				events(capacity), threadId(threadId) {}
+
+			std::vector<Event> events;
+			std::atomic<uint64_t> head{ 0 };
+			// the events before it were cleared. only the writer moves the
+			// head, so clearing never races with an event being written
+			std::atomic<uint64_t> floor{ 0 };
+			uint32_t threadId;
+		};
+
+		/// @return The calling thread's ring, creating it if needed
+		Ring* GetRing() noexcept;
+
+		std::atomic<double> m_sampleRate;
+		size_t m_eventsPerThread;
+		// unique per tracer so that thread-local caches never see
+		// a recycled address as the same tracer
+		uint64_t m_instanceId;
+		std::atomic<uint64_t> m_nextId{ 1 };
+		mutable std::mutex m_ringMutex;
+		std::vector<std::unique_ptr<Ring>> m_rings;
+		clock::time_point m_epoch;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,166 @@
+#ifndef CURLMULTIASIO_TRANSFERGROUP_H_
+#define CURLMULTIASIO_TRANSFERGROUP_H_
+
+/// @file
+/// Transfers that complete together, with quorums and deadlines
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/Multi.h>
+
+// STL includes
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cma
+{
+	/// @brief When a TransferGroup completes
+	struct TransferGroupOptions
+	{
+		/// @brief How many transfers must succeed, or zero for all of them.
+		/// One completes on the first success
+		size_t quorum = 0;
+		/// @brief How long after the group is created it gives up on the
+		/// transfers that are left, or zero to wait for as long as it takes
+		std::chrono::milliseconds deadline{ 0 };
+	};
+
+	/// @brief What happened to a transfer in a TransferGroup
+	struct TransferResult
+	{
+		/// @brief The easy handle
+		Easy* easy = nullptr;
+		/// @brief The result of the transfer, or asio::error::operation_aborted
+		/// if the group canceled it
+		error_code ec;
+		/// @brief Whether it finished before the group completed
+		bool finished = false;
+	};
+
+	/// @brief BasicTransferGroup performs a set of transfers on a multi
+	/// handle, and completes once enough of them have succeeded: all of
+	/// them, any one, or a quorum of them, or once its deadline passes.
+	/// Whatever is still running at that point is canceled in a single pass
+	/// in the multi handle's strand, so stragglers give back their sockets
+	/// right away. A group also completes early, with the error of the last
+	/// failure, once too many transfers have failed for the quorum to be
+	/// reached. Groups are cheap, and meant to be used once. It can be used
+	/// from any thread that the multi handle can
+	/// @tparam ThreadingPolicy The threading policy of the multi handle
+	template<typename ThreadingPolicy>
+	class BasicTransferGroup
+	{
+	private:
+		using Waiter = std::function<void(const error_code&, std::vector<TransferResult>)>;
+		/// @brief The state shared with the transfers and the deadline,
+		/// which may outlive the group
+		struct State
+		{
+			explicit State(BasicMulti<ThreadingPolicy>& multi) :
+				multi(multi), timer(multi.GetExecutor()) {}
+
+			BasicMulti<ThreadingPolicy>& multi;
+			TransferGroupOptions options;
+			asio::steady_timer timer;
+			std::mutex mutex;
+			// guarded by the mutex
+			std::vector<TransferResult> results;
+			size_t succeeded = 0;
+			size_t failed = 0;
+			error_code lastError;
+			bool sealed = false;
+			bool expired = false;
+			bool done = false;
+			Waiter waiter;
+		};
+	public:
+		/// @brief Creates a group, and starts its deadline if it has one
+		/// @param multi The multi handle that performs the transfers. It
+		/// must outlive the group's transfers
+		/// @param options When the group completes
+		explicit BasicTransferGroup(BasicMulti<ThreadingPolicy>& multi,
+			TransferGroupOptions options = {});
+		/// @brief Cancels the transfers that are still running, and calls
+		/// a waiting handler with asio::error::operation_aborted
+		~BasicTransferGroup() noexcept;
+		BasicTransferGroup(const BasicTransferGroup&) = delete;
+		BasicTransferGroup& operator=(const BasicTransferGroup&) = delete;
+
+		/// @brief Starts a transfer as part of the group. Every transfer
+		/// must be added before AsyncWait. The easy handle must stay in
+		/// scope until the group has completed and the transfer has been
+		/// canceled, or until the group is destroyed
+		/// @param easy The easy handle
+		void Add(Easy& easy);
+		/// @brief Waits for the group to complete. It can only be called
+		/// once, and no transfers can be added after it. The completion
+		/// token signature is void(error_code, std::vector<TransferResult>),
+		/// with no error if the quorum was reached, asio::error::timed_out
+		/// if the deadline passed first, or the error of the last failure if
+		/// the quorum can no longer be reached. The results are in the order
+		/// the transfers were added
+		/// @tparam CompletionToken The completion token type
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncWait(CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler)
+			{
+				auto executor = asio::get_associated_executor(handler, m_state->multi.GetExecutor());
+				auto work = std::make_shared<asio::executor_work_guard<decltype(executor)>>(executor);
+				// the waiter must be copyable, so the handler is kept on the heap
+				auto shared = std::make_shared<std::decay_t<decltype(handler)>>(std::move(handler));
+				Seal([shared, work](const error_code& ec, std::vector<TransferResult> results)
+					{
+						// the group may complete inside the initiation, so
+						// always post
+						asio::post(work->get_executor(), [shared, ec,
+							results = std::move(results)]() mutable
+							{
+								(*shared)(ec, std::move(results));
+							});
+						work->reset();
+					});
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code, std::vector<TransferResult>)>(initiation, token);
+		}
+
+		/// @return The options
+		inline const TransferGroupOptions& GetOptions() const noexcept { return m_state->options; }
+	private:
+		/// @brief Stops taking transfers, and completes once the group does
+		/// @param waiter Called with the outcome
+		void Seal(Waiter waiter);
+		/// @brief Completes the group if it is time to. Must hold the mutex,
+		/// which it releases if it does
+		/// @param state The state
+		/// @param lock The lock on the state's mutex
+		static void Evaluate(const std::shared_ptr<State>& state,
+			std::unique_lock<std::mutex>& lock);
+		/// @brief Completes the group, and cancels what is still running.
+		/// Must hold the mutex, which it releases
+		/// @param state The state
+		/// @param lock The lock on the state's mutex
+		/// @param ec The outcome
+		static void Complete(const std::shared_ptr<State>& state,
+			std::unique_lock<std::mutex>& lock, error_code ec);
+
+		std::shared_ptr<State> m_state;
+	};
+
+	extern template class BasicTransferGroup<ThreadSafe>;
+	extern template class BasicTransferGroup<SingleThreaded>;
+
+	/// @brief TransferGroup is a transfer group on a Multi
+	using TransferGroup = BasicTransferGroup<ThreadSafe>;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,237 @@
+#ifndef CURLMULTIASIO_WEBSOCKET_H_
+#define CURLMULTIASIO_WEBSOCKET_H_
+
+/// @file
+/// WebSocket connections driven by a multi handle
+/// 10/19/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/Multi.h>
+
+// STL includes
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace cma
+{
+	/// @brief The kind of a WebSocket frame that is sent
+	enum class WebSocketOpcode
+	{
+		Text = CURLWS_TEXT,
+		Binary = CURLWS_BINARY,
+		Ping = CURLWS_PING,
+		Pong = CURLWS_PONG,
+		Close = CURLWS_CLOSE
+	};
+
+	/// @brief The frame that the data of a read belongs to
+	struct WebSocketFrame
+	{
+		/// @brief The CURLWS_* flags of the frame, such as CURLWS_TEXT,
+		/// CURLWS_BINARY, CURLWS_CLOSE or CURLWS_PING, and CURLWS_CONT if
+		/// more fragments of its message follow
+		int flags = 0;
+		/// @brief Where the data starts in the frame's payload
+		curl_off_t offset = 0;
+		/// @brief How much of the frame's payload is left to read
+		curl_off_t bytesLeft = 0;
+
+		/// @return Whether or not the data ends its message
+		inline bool IsMessageEnd() const noexcept
+		{
+			return bytesLeft == 0 && (flags & CURLWS_CONT) == 0;
+		}
+	};
+
+	/// @brief BasicWebSocket is a WebSocket client connection on a multi
+	/// handle. The handshake is an AsyncConnect transfer with
+	/// CURLOPT_CONNECT_ONLY set to 2, so it shares the multi handle's DNS
+	/// cache, share, tracer and circuit breaker with every other transfer.
+	/// Afterwards, frames are read and written by curl_ws_recv and
+	/// curl_ws_send in the multi handle's strand, which waits on the same
+	/// socket the multi handle opened. Reads go straight into the caller's
+	/// buffer, which can be reused for the next read, and a frame larger
+	/// than the buffer is handed over across several reads. At most one
+	/// read and one write may be outstanding at a time. libcurl must be
+	/// built with WebSocket support, otherwise connecting fails with
+	/// CURLE_UNSUPPORTED_PROTOCOL. The multi handle must outlive the
+	/// WebSocket
+	/// @tparam ThreadingPolicy The threading policy of the multi handle
+	template<typename ThreadingPolicy>
+	class BasicWebSocket
+	{
+	private:
+		using ReadHandler = std::function<void(const error_code&, size_t, WebSocketFrame)>;
+		using WriteHandler = std::function<void(const error_code&, size_t)>;
+		/// @brief The state shared with the operations, which may outlive
+		/// the WebSocket until they have been aborted
+		struct State
+		{
+			explicit State(BasicMulti<ThreadingPolicy>& multi) :
+				multi(multi) {}
+
+			BasicMulti<ThreadingPolicy>& multi;
+			Easy easy;
+			// only touched serialized with cURL
+			bool open = false;
+			bool closed = false;
+		};
+	public:
+		/// @brief Creates a WebSocket that isn't connected yet
+		/// @param multi The multi handle that drives it
+		explicit BasicWebSocket(BasicMulti<ThreadingPolicy>& multi);
+		/// @brief Closes the connection, and aborts the outstanding operations
+		~BasicWebSocket() noexcept;
+		BasicWebSocket(const BasicWebSocket&) = delete;
+		BasicWebSocket& operator=(const BasicWebSocket&) = delete;
+
+		/// @return The easy handle, to set options such as headers,
+		/// timeouts or TLS before connecting
+		inline Easy& GetEasy() noexcept { return m_state->easy; }
+
+		/// @brief Connects and performs the handshake. The completion
+		/// token signature is void(error_code)
+		/// @tparam CompletionToken The completion token type
+		/// @param url The ws:// or wss:// URL
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncConnect(const std::string& url, CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler, const std::string& url)
+			{
+				auto executor = asio::get_associated_executor(handler, m_state->multi.GetExecutor());
+				auto work = std::make_shared<asio::executor_work_guard<decltype(executor)>>(executor);
+				// the handler must be copyable, so it is kept on the heap
+				auto shared = std::make_shared<std::decay_t<decltype(handler)>>(std::move(handler));
+				m_state->easy.SetURL(url.c_str());
+				m_state->easy.SetOption(CURLoption::CURLOPT_CONNECT_ONLY, 2L);
+				m_state->multi.AsyncConnect(m_state->easy, [state = m_state, shared, work]
+					(const error_code& ec)
+					{
+						// the connection is only touched serialized with cURL
+						state->multi.Execute([state, shared, work, result = ec]() mutable
+							{
+								// closed while the handshake was running
+								if (!result && state->closed == true)
+								{
+									state->multi.Disconnect(state->easy);
+									result = asio::error::operation_aborted;
+								}
+								else if (!result)
+									state->open = true;
+								asio::post(work->get_executor(), [shared, result]
+									{
+										(*shared)(result);
+									});
+								work->reset();
+							});
+					});
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code)>(initiation, token, url);
+		}
+		/// @brief Reads the next data of a frame into a buffer, as much of
+		/// it as fits. The completion token signature is
+		/// void(error_code, size_t, WebSocketFrame), with the number of bytes
+		/// read and the frame they belong to. The buffer must stay in scope
+		/// until the handler is called
+		/// @tparam CompletionToken The completion token type
+		/// @param buffer The buffer
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncRead(asio::mutable_buffer buffer, CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler, asio::mutable_buffer buffer)
+			{
+				auto executor = asio::get_associated_executor(handler, m_state->multi.GetExecutor());
+				auto work = std::make_shared<asio::executor_work_guard<decltype(executor)>>(executor);
+				// the handler must be copyable, so it is kept on the heap
+				auto shared = std::make_shared<std::decay_t<decltype(handler)>>(std::move(handler));
+				m_state->multi.Execute([state = m_state, buffer, shared, work]
+					{
+						Read(state, buffer, [shared, work](const error_code& ec,
+							size_t read, WebSocketFrame frame)
+							{
+								asio::post(work->get_executor(), [shared, ec, read, frame]
+									{
+										(*shared)(ec, read, frame);
+									});
+								work->reset();
+							});
+					});
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code, size_t, WebSocketFrame)>(initiation, token, buffer);
+		}
+		/// @brief Writes a buffer as one whole frame. The completion token
+		/// signature is void(error_code, size_t), with the number of bytes
+		/// written. The buffer must stay in scope until the handler is called
+		/// @tparam CompletionToken The completion token type
+		/// @param buffer The buffer
+		/// @param opcode The kind of frame
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncWrite(asio::const_buffer buffer, WebSocketOpcode opcode, CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler, asio::const_buffer buffer, WebSocketOpcode opcode)
+			{
+				auto executor = asio::get_associated_executor(handler, m_state->multi.GetExecutor());
+				auto work = std::make_shared<asio::executor_work_guard<decltype(executor)>>(executor);
+				// the handler must be copyable, so it is kept on the heap
+				auto shared = std::make_shared<std::decay_t<decltype(handler)>>(std::move(handler));
+				m_state->multi.Execute([state = m_state, buffer, opcode, shared, work]
+					{
+						Write(state, buffer, 0, static_cast<unsigned int>(opcode),
+							[shared, work](const error_code& ec, size_t written)
+							{
+								asio::post(work->get_executor(), [shared, ec, written]
+									{
+										(*shared)(ec, written);
+									});
+								work->reset();
+							});
+					});
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code, size_t)>(initiation, token, buffer, opcode);
+		}
+		/// @brief Sends a close frame if the connection is open, and then
+		/// closes it. Outstanding operations complete with
+		/// asio::error::operation_aborted. It can be called from any thread
+		void Close();
+	private:
+		/// @brief Reads, or waits for the connection to become readable.
+		/// Must be called serialized with cURL
+		/// @param state The state
+		/// @param buffer The buffer
+		/// @param handler Called with the result
+		static void Read(const std::shared_ptr<State>& state, asio::mutable_buffer buffer,
+			ReadHandler handler);
+		/// @brief Writes the rest of a frame, or waits for the connection to
+		/// become writable. Must be called serialized with cURL
+		/// @param state The state
+		/// @param buffer The buffer
+		/// @param written How much of the buffer was already written
+		/// @param flags The CURLWS_* flags of the frame
+		/// @param handler Called with the result
+		static void Write(const std::shared_ptr<State>& state, asio::const_buffer buffer,
+			size_t written, unsigned int flags, WriteHandler handler);
+
+		std::shared_ptr<State> m_state;
+	};
+
+	extern template class BasicWebSocket<ThreadSafe>;
+	extern template class BasicWebSocket<SingleThreaded>;
+
+	/// @brief WebSocket is a WebSocket connection on a Multi
+	using WebSocket = BasicWebSocket<ThreadSafe>;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,235 @@
+#include <curl-multi-asio/CircuitBreaker.h>
+
+#include <memory>
+
+using cma::CircuitBreaker;
+using cma::CircuitState;
+using cma::CircuitStats;
+
+CircuitBreaker::CircuitBreaker(CircuitBreakerOptions options) :
+	m_options(options)
+{
+	if (m_options.windowSize == 0)
+		m_options.windowSize = 1;
+	if (m_options.halfOpenProbes == 0)
+		m_options.halfOpenProbes = 1;
+	if (m_options.maxCircuits == 0)
+		m_options.maxCircuits = 1;
+}
+
+bool CircuitBreaker::Allow(CURL* easy, const std::string& url)
+{
+	auto origin = GetOrigin(url);
+	if (origin.empty() == true)
+		return true;
+	const auto now = clock::now();
+	std::lock_guard lock(m_mutex);
+	// an easy handle that is reused without finishing gives its probe back
+	Transfer previous;
+	Forget(easy, previous);
+	auto circuitIt = m_circuits.find(origin);
+	if (circuitIt == m_circuits.end())
+	{
+		while (m_circuits.size() >= m_options.maxCircuits)
+		{
+			m_circuits.erase(m_lru.front());
+			m_lru.pop_front();
+		}
+		circuitIt = m_circuits.emplace(origin, Circuit{}).first;
+		circuitIt->second.lru = m_lru.insert(m_lru.end(), origin);
+	}
+	else
+	{
+		// the circuit just got used
+		m_lru.splice(m_lru.end(), m_lru, circuitIt->second.lru);
+	}
+	auto& circuit = circuitIt->second;
+	bool probe = false;
+	switch (circuit.state)
+	{
+	case CircuitState::Open:
+		if (now - circuit.openedAt < m_options.openDuration)
+		{
+			++circuit.rejected;
+			return false;
+		}
+		circuit.state = CircuitState::HalfOpen;
+		circuit.probes = 0;
+		circuit.probeSuccesses = 0;
+		[[fallthrough]];
+	case CircuitState::HalfOpen:
+		if (circuit.probes >= m_options.halfOpenProbes)
+		{
+			++circuit.rejected;
+			return false;
+		}
+		++circuit.probes;
+		probe = true;
+		break;
+	default:
+		break;
+	}
+	m_transfers[easy] = Transfer{ std::move(origin), probe };
+	return true;
+}
+
+void CircuitBreaker::Record(CURL* easy, CURLcode result) noexcept
+{
+	const auto now = clock::now();
+	uint8_t outcome = 0;
+	switch (result)
+	{
+	case CURLE_OK:
+	case CURLE_HTTP_RETURNED_ERROR:
+		break;
+	case CURLE_COULDNT_RESOLVE_HOST:
+	case CURLE_COULDNT_CONNECT:
+	case CURLE_OPERATION_TIMEDOUT:
+	case CURLE_SSL_CONNECT_ERROR:
+	case CURLE_SEND_ERROR:
+	case CURLE_RECV_ERROR:
+	case CURLE_GOT_NOTHING:
+	case CURLE_PARTIAL_FILE:
+		outcome |= Failed;
+		break;
+	default:
+		// the transfer failed for its own reasons
+		Release(easy);
+		return;
+	}
+	long status = 0;
+	if (m_options.failOnServerError == true &&
+		curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status) == CURLE_OK && status >= 500)
+		outcome |= Failed;
+	curl_off_t totalTime = 0;
+	if (m_options.slowCallDuration.count() > 0 &&
+		curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &totalTime) == CURLE_OK &&
+		std::chrono::microseconds(totalTime) >= m_options.slowCallDuration)
+		outcome |= Slow;
+	std::lock_guard lock(m_mutex);
+	Transfer transfer;
+	if (Forget(easy, transfer) == false)
+		return;
+	auto circuitIt = m_circuits.find(transfer.origin);
+	if (circuitIt == m_circuits.end())
+		return;
+	auto& circuit = circuitIt->second;
+	if (circuit.state == CircuitState::Closed)
+	{
+		Count(circuit, outcome, now);
+		return;
+	}
+	// transfers that started before the circuit opened say nothing about
+	// the host now, only probes do
+	if (circuit.state != CircuitState::HalfOpen || transfer.probe == false)
+		return;
+	if (outcome != 0)
+		Open(circuit, now);
+	else if (++circuit.probeSuccesses >= m_options.halfOpenProbes)
+		Close(circuit);
+}
+
+void CircuitBreaker::Release(CURL* easy) noexcept
+{
+	std::lock_guard lock(m_mutex);
+	Transfer transfer;
+	Forget(easy, transfer);
+}
+
+CircuitState CircuitBreaker::GetState(const std::string& origin) const
+{
+	std::lock_guard lock(m_mutex);
+	auto it = m_circuits.find(origin);
+	return (it != m_circuits.end()) ? it->second.state : CircuitState::Closed;
+}
+
+std::vector<CircuitStats> CircuitBreaker::GetStats() const
+{
+	std::lock_guard lock(m_mutex);
+	std::vector<CircuitStats> stats;
+	stats.reserve(m_circuits.size());
+	for (const auto& [origin, circuit] : m_circuits)
+	{
+		const size_t samples = circuit.window.size();
+		stats.push_back(CircuitStats{ origin, circuit.state,
+			(samples != 0) ? static_cast<double>(circuit.failures) / samples : 0.0,
+			(samples != 0) ? static_cast<double>(circuit.slow) / samples : 0.0,
+			samples, circuit.rejected, circuit.opened });
+	}
+	return stats;
+}
+
+std::string CircuitBreaker::GetOrigin(const std::string& url)
+{
+	std::unique_ptr<CURLU, decltype(&curl_url_cleanup)> parsed(curl_url(), curl_url_cleanup);
+	if (parsed == nullptr || curl_url_set(parsed.get(), CURLUPART_URL,
+		url.c_str(), CURLU_GUESS_SCHEME) != CURLUE_OK)
+		return {};
+	std::string origin;
+	const CURLUPart parts[] = { CURLUPART_SCHEME, CURLUPART_HOST, CURLUPART_PORT };
+	const char* separators[] = { "://", ":", "" };
+	for (size_t i = 0; i < std::size(parts); ++i)
+	{
+		char* part = nullptr;
+		if (curl_url_get(parsed.get(), parts[i], &part, CURLU_DEFAULT_PORT) != CURLUE_OK)
+			return {};
+		origin += part;
+		origin += separators[i];
+		curl_free(part);
+	}
+	return origin;
+}
+
+void CircuitBreaker::Open(Circuit& circuit, clock::time_point now) noexcept
+{
+	circuit.state = CircuitState::Open;
+	circuit.openedAt = now;
+	circuit.probeSuccesses = 0;
+	++circuit.opened;
+}
+
+void CircuitBreaker::Close(Circuit& circuit) noexcept
+{
+	circuit.state = CircuitState::Closed;
+	circuit.window.clear();
+	circuit.next = 0;
+	circuit.failures = 0;
+	circuit.slow = 0;
+}
+
+void CircuitBreaker::Count(Circuit& circuit, uint8_t outcome, clock::time_point now) noexcept
+{
+	if (circuit.window.size() < m_options.windowSize)
+		circuit.window.push_back(outcome);
+	else
+	{
+		// the oldest outcome makes room
+		auto& oldest = circuit.window[circuit.next];
+		circuit.failures -= (oldest & Failed) ? 1 : 0;
+		circuit.slow -= (oldest & Slow) ? 1 : 0;
+		oldest = outcome;
+		circuit.next = (circuit.next + 1) % circuit.window.size();
+	}
+	circuit.failures += (outcome & Failed) ? 1 : 0;
+	circuit.slow += (outcome & Slow) ? 1 : 0;
+	const double samples = static_cast<double>(circuit.window.size());
+	if (circuit.window.size() < m_options.minimumRequests)
+		return;
+	if (circuit.failures / samples >= m_options.failureRate ||
+		(m_options.slowCallDuration.count() > 0 && circuit.slow / samples >= m_options.slowCallRate))
+		Open(circuit, now);
+}
+
+bool CircuitBreaker::Forget(CURL* easy, Transfer& transfer) noexcept
+{
+	auto it = m_transfers.find(easy);
+	if (it == m_transfers.end())
+		return false;
+	transfer = std::move(it->second);
+	m_transfers.erase(it);
+	if (transfer.probe == true)
+		if (auto circuitIt = m_circuits.find(transfer.origin); circuitIt != m_circuits.end() &&
+			circuitIt->second.probes != 0)
+			--circuitIt->second.probes;
+	return true;
+}
\ No newline at end of file
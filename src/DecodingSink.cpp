@@ -0,0 +1,393 @@
+#include <curl-multi-asio/DecodingSink.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <mutex>
+
+#ifdef CMA_DECODE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef CMA_DECODE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef CMA_DECODE_BROTLI
+#include <brotli/decode.h>
+#endif
+
+using cma::ContentEncoding;
+using cma::DecodingSink;
+
+namespace
+{
+	// the decoded bytes are handed over this many at a time
+	constexpr size_t OutputChunk = 64 * 1024;
+
+	/// @brief Decodes one encoding, a chunk at a time
+	class Decoder
+	{
+	public:
+		virtual ~Decoder() = default;
+		/// @brief Decodes a chunk
+		/// @param in The encoded bytes
+		/// @param out Receives the decoded bytes
+		/// @return Whether the chunk could be decoded
+		virtual bool Decode(std::string_view in, const DecodingSink::Consumer& out) = 0;
+	};
+
+	/// @brief Passes an unencoded body through
+	class IdentityDecoder : public Decoder
+	{
+	public:
+		bool Decode(std::string_view in, const DecodingSink::Consumer& out) override
+		{
+			out(in);
+			return true;
+		}
+	};
+
+#ifdef CMA_DECODE_ZLIB
+	/// @brief Inflates gzip, and deflate with or without its zlib wrapper
+	class ZlibDecoder : public Decoder
+	{
+	public:
+		ZlibDecoder() noexcept
+		{
+			// 32 detects a gzip or zlib header
+			m_ok = inflateInit2(&m_stream, 15 + 32) == Z_OK;
+		}
+		~ZlibDecoder() noexcept { inflateEnd(&m_stream); }
+
+		bool Decode(std::string_view in, const DecodingSink::Consumer& out) override
+		{
+			m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+			m_stream.avail_in = static_cast<uInt>(in.size());
+			while (m_ok == true)
+			{
+				m_stream.next_out = reinterpret_cast<Bytef*>(m_buffer);
+				m_stream.avail_out = sizeof(m_buffer);
+				const int res = inflate(&m_stream, Z_NO_FLUSH);
+				// some servers send deflate without the zlib wrapper
+				if (res == Z_DATA_ERROR && m_stream.total_out == 0 && m_raw == false)
+				{
+					m_raw = true;
+					m_ok = inflateReset2(&m_stream, -15) == Z_OK;
+					m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+					m_stream.avail_in = static_cast<uInt>(in.size());
+					continue;
+				}
+				if (res != Z_OK && res != Z_STREAM_END && res != Z_BUF_ERROR)
+					return m_ok = false;
+				if (const size_t len = sizeof(m_buffer) - m_stream.avail_out; len != 0)
+					out({ m_buffer, len });
+				// gzip bodies may be several members in a row
+				if (res == Z_STREAM_END && m_stream.avail_in != 0)
+					m_ok = inflateReset(&m_stream) == Z_OK;
+				// a full output buffer may leave data inside zlib, even once
+				// the input is used up
+				else if (res != Z_OK || (m_stream.avail_in == 0 && m_stream.avail_out != 0))
+					break;
+			}
+			return m_ok;
+		}
+	private:
+		z_stream m_stream{};
+		char m_buffer[OutputChunk];
+		bool m_ok = false;
+		bool m_raw = false;
+	};
+#endif
+
+#ifdef CMA_DECODE_ZSTD
+	/// @brief Decompresses zstd frames
+	class ZstdDecoder : public Decoder
+	{
+	public:
+		ZstdDecoder() noexcept : m_stream(ZSTD_createDStream()) {}
+		~ZstdDecoder() noexcept { ZSTD_freeDStream(m_stream); }
+
+		bool Decode(std::string_view in, const DecodingSink::Consumer& out) override
+		{
+			if (m_stream == nullptr)
+				return false;
+			ZSTD_inBuffer input{ in.data(), in.size(), 0 };
+			// a full output buffer may leave data inside the decoder, even
+			// once the input is used up
+			bool full = true;
+			while (input.pos < input.size || full == true)
+			{
+				ZSTD_outBuffer output{ m_buffer, sizeof(m_buffer), 0 };
+				if (ZSTD_isError(ZSTD_decompressStream(m_stream, &output, &input)) != 0)
+					return false;
+				if (output.pos != 0)
+					out({ m_buffer, output.pos });
+				full = output.pos == output.size;
+			}
+			return true;
+		}
+	private:
+		ZSTD_DStream* m_stream;
+		char m_buffer[OutputChunk];
+	};
+#endif
+
+#ifdef CMA_DECODE_BROTLI
+	/// @brief Decompresses brotli
+	class BrotliDecoder : public Decoder
+	{
+	public:
+		BrotliDecoder() noexcept :
+			m_state(BrotliDecoderCreateInstance(nullptr, nullptr, nullptr)) {}
+		~BrotliDecoder() noexcept { BrotliDecoderDestroyInstance(m_state); }
+
+		bool Decode(std::string_view in, const DecodingSink::Consumer& out) override
+		{
+			if (m_state == nullptr)
+				return false;
+			size_t availableIn = in.size();
+			auto nextIn = reinterpret_cast<const uint8_t*>(in.data());
+			for (;;)
+			{
+				size_t availableOut = sizeof(m_buffer);
+				auto nextOut = reinterpret_cast<uint8_t*>(m_buffer);
+				const auto res = BrotliDecoderDecompressStream(m_state, &availableIn, &nextIn,
+					&availableOut, &nextOut, nullptr);
+				if (res == BROTLI_DECODER_RESULT_ERROR)
+					return false;
+				if (const size_t len = sizeof(m_buffer) - availableOut; len != 0)
+					out({ m_buffer, len });
+				if (res != BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT)
+					return true;
+			}
+		}
+	private:
+		BrotliDecoderState* m_state;
+		char m_buffer[OutputChunk];
+	};
+#endif
+
+	/// @brief Finds the encoding of a response
+	/// @param easy The easy handle, whose headers have arrived
+	/// @param body The start of the body
+	/// @param encoding The encoding
+	/// @return Whether it is an encoding that was asked for
+	bool DetectEncoding(CURL* easy, std::string_view body, ContentEncoding& encoding) noexcept
+	{
+#if LIBCURL_VERSION_NUM >= 0x075400
+		static_cast<void>(body);
+		curl_header* header = nullptr;
+		if (curl_easy_header(easy, "Content-Encoding", 0, CURLH_HEADER, -1, &header) != CURLHE_OK)
+		{
+			encoding = ContentEncoding::Identity;
+			return true;
+		}
+		std::string value(header->value);
+		std::transform(value.begin(), value.end(), value.begin(), [](char c)
+			{
+				return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+			});
+		if (value == "identity")
+			encoding = ContentEncoding::Identity;
+		else if (value == "gzip" || value == "x-gzip")
+			encoding = ContentEncoding::Gzip;
+		else if (value == "deflate")
+			encoding = ContentEncoding::Deflate;
+		else if (value == "zstd")
+			encoding = ContentEncoding::Zstd;
+		else if (value == "br")
+			encoding = ContentEncoding::Brotli;
+		else
+			return false;
+		return true;
+#else
+		// without the header API the magic numbers are all there is, and
+		// brotli has none
+		static_cast<void>(easy);
+		if (body.starts_with("\x1f\x8b"))
+			encoding = ContentEncoding::Gzip;
+		else if (body.starts_with("\x28\xb5\x2f\xfd"))
+			encoding = ContentEncoding::Zstd;
+		else
+			encoding = ContentEncoding::Identity;
+		return true;
+#endif
+	}
+
+	/// @param encoding The encoding
+	/// @return A decoder for it, or nullptr if it wasn't built in
+	std::unique_ptr<Decoder> MakeDecoder(ContentEncoding encoding)
+	{
+		switch (encoding)
+		{
+		case ContentEncoding::Identity:
+			return std::make_unique<IdentityDecoder>();
+#ifdef CMA_DECODE_ZLIB
+		case ContentEncoding::Gzip:
+		case ContentEncoding::Deflate:
+			return std::make_unique<ZlibDecoder>();
+#endif
+#ifdef CMA_DECODE_ZSTD
+		case ContentEncoding::Zstd:
+			return std::make_unique<ZstdDecoder>();
+#endif
+#ifdef CMA_DECODE_BROTLI
+		case ContentEncoding::Brotli:
+			return std::make_unique<BrotliDecoder>();
+#endif
+		default:
+			return nullptr;
+		}
+	}
+}
+
+struct DecodingSink::State : std::enable_shared_from_this<DecodingSink::State>
+{
+	CURL* easy = nullptr;
+	Consumer consumer;
+	std::function<void()> unpause;
+	DecoderPool* pool = nullptr;
+	DecodingSinkOptions options;
+	// only touched by one thread at a time, since the transfer is paused
+	// while a chunk is decoded on the pool
+	std::unique_ptr<Decoder> decoder;
+	ContentEncoding encoding = ContentEncoding::Identity;
+	// bytes that cURL writes again after a pause, but were already decoded
+	size_t skip = 0;
+	// held while decoding on the pool, so the sink can't go away underneath
+	mutable std::mutex mutex;
+	bool detached = false;
+	error_code error;
+	std::atomic<uint64_t> decodedBytes = 0;
+	std::atomic<uint64_t> offloadedChunks = 0;
+
+	/// @brief Decodes a chunk, and remembers the error if it can't be
+	/// @param in The encoded bytes
+	/// @return Whether it could be decoded
+	bool Decode(std::string_view in)
+	{
+		try
+		{
+			if (decoder->Decode(in, [this](std::string_view decoded)
+				{
+					decodedBytes += decoded.size();
+					consumer(decoded);
+				}) == true)
+				return true;
+		}
+		catch (...) {}
+		error = Errc::DecodingFailed;
+		return false;
+	}
+};
+
+DecodingSink::DecodingSink(Easy& easy, Consumer consumer, std::function<void()> unpause,
+	DecoderPool* pool, DecodingSinkOptions options) :
+	m_state(std::make_shared<State>())
+{
+	m_state->easy = easy.GetNativeHandle();
+	m_state->consumer = std::move(consumer);
+	m_state->unpause = std::move(unpause);
+	m_state->pool = pool;
+	m_state->options = options;
+	// cURL would decode on the multi handle's thread, and only what it was
+	// built with, so it is asked to pass the body through untouched
+	easy.SetOption(CURLoption::CURLOPT_HTTP_CONTENT_DECODING, 0L);
+	easy.AddHeader({ "Accept-Encoding", GetAcceptEncoding() });
+	easy.SetOption(CURLoption::CURLOPT_WRITEDATA, m_state.get());
+	easy.SetOption(CURLoption::CURLOPT_WRITEFUNCTION, &DecodingSink::WriteCb);
+}
+
+DecodingSink::~DecodingSink() noexcept
+{
+	std::lock_guard lock(m_state->mutex);
+	m_state->detached = true;
+}
+
+ContentEncoding DecodingSink::GetEncoding() const noexcept
+{
+	std::lock_guard lock(m_state->mutex);
+	return m_state->encoding;
+}
+
+cma::error_code DecodingSink::GetError() const noexcept
+{
+	std::lock_guard lock(m_state->mutex);
+	return m_state->error;
+}
+
+uint64_t DecodingSink::GetDecodedBytes() const noexcept
+{
+	return m_state->decodedBytes;
+}
+
+uint64_t DecodingSink::GetOffloadedChunks() const noexcept
+{
+	return m_state->offloadedChunks;
+}
+
+std::string_view DecodingSink::GetAcceptEncoding() noexcept
+{
+	// without the header API, only the encodings with a magic number can
+	// be told apart, so brotli and deflate aren't asked for
+	static constexpr std::string_view s_acceptEncoding =
+#ifdef CMA_DECODE_ZSTD
+		"zstd, "
+#endif
+#if defined(CMA_DECODE_BROTLI) && LIBCURL_VERSION_NUM >= 0x075400
+		"br, "
+#endif
+#ifdef CMA_DECODE_ZLIB
+#if LIBCURL_VERSION_NUM >= 0x075400
+		"gzip, deflate, "
+#else
+		"gzip, "
+#endif
+#endif
+		"identity";
+	return s_acceptEncoding;
+}
+
+size_t DecodingSink::WriteCb(char* ptr, size_t, size_t nmemb, State* userdata) noexcept
+{
+	std::string_view in(ptr, nmemb);
+	// a chunk that was decoded on the pool comes again once unpaused
+	const size_t skipped = std::min(userdata->skip, in.size());
+	userdata->skip -= skipped;
+	in.remove_prefix(skipped);
+	// nothing else decodes while the transfer is running, so this is
+	// only ever contended by the getters
+	std::lock_guard lock(userdata->mutex);
+	if (userdata->error)
+		return 0;
+	if (in.empty() == true)
+		return nmemb;
+	if (userdata->decoder == nullptr)
+	{
+		if (DetectEncoding(userdata->easy, in, userdata->encoding) == false ||
+			(userdata->decoder = MakeDecoder(userdata->encoding)) == nullptr)
+		{
+			userdata->error = Errc::DecodingFailed;
+			return 0;
+		}
+	}
+	// the bytes that were skipped must not come again, so only a whole
+	// fresh chunk can be paused on
+	if (userdata->pool != nullptr && skipped == 0 &&
+		in.size() >= userdata->options.offloadThreshold)
+	{
+		userdata->skip = nmemb;
+		++userdata->offloadedChunks;
+		asio::post(userdata->pool->GetExecutor(), [state = userdata->shared_from_this(),
+			chunk = std::string(in)]
+			{
+				std::lock_guard lock(state->mutex);
+				if (state->detached == true)
+					return;
+				state->Decode(chunk);
+				// on failure too, so the transfer sees the error
+				state->unpause();
+			});
+		return CURL_WRITEFUNC_PAUSE;
+	}
+	return (userdata->Decode(in) == true) ? nmemb : 0;
+}
\ No newline at end of file
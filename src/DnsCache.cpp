@@ -0,0 +1,260 @@
+#include <curl-multi-asio/DnsCache.h>
+
+#include <algorithm>
+
+using cma::DnsCache;
+using cma::DnsCacheStats;
+
+DnsCache::DnsCache(const asio::any_io_executor& executor, DnsCacheOptions options) :
+	DnsCache(MakeAsioResolver(executor), options) {}
+
+DnsCache::DnsCache(ResolveFunction resolver, DnsCacheOptions options) :
+	m_resolver(std::move(resolver)), m_state(std::make_shared<State>(options)) {}
+
+DnsCache::~DnsCache() noexcept
+{
+	std::vector<Waiter> waiters;
+	{
+		std::lock_guard lock(m_state->mutex);
+		m_state->alive = false;
+		for (auto& [host, entry] : m_state->entries)
+			std::move(entry.waiters.begin(), entry.waiters.end(),
+				std::back_inserter(waiters));
+	}
+	const Answer aborted{ asio::error::operation_aborted, {}, {} };
+	for (auto& waiter : waiters)
+		waiter(aborted);
+}
+
+bool DnsCache::Prepare(Easy& easy, ReadyHandler ready,
+	EndpointSelector* selector)
+{
+	std::unique_ptr<CURLU, decltype(&curl_url_cleanup)> url(curl_url(), curl_url_cleanup);
+	if (url == nullptr || curl_url_set(url.get(), CURLUPART_URL,
+		easy.GetURL().c_str(), CURLU_GUESS_SCHEME) != CURLUE_OK)
+		return true;
+	char* hostPart = nullptr;
+	char* portPart = nullptr;
+	if (curl_url_get(url.get(), CURLUPART_HOST, &hostPart, 0) != CURLUE_OK)
+		return true;
+	std::string host(hostPart);
+	curl_free(hostPart);
+	if (curl_url_get(url.get(), CURLUPART_PORT, &portPart, CURLU_DEFAULT_PORT) != CURLUE_OK)
+		return true;
+	std::string port(portPart);
+	curl_free(portPart);
+	// IPv6 hosts come in brackets, and addresses don't need resolving
+	error_code ec;
+	asio::ip::make_address(host.front() == '[' ?
+		host.substr(1, host.size() - 2) : host, ec);
+	if (!ec)
+		return true;
+	auto inject = [&easy, host, port, selector](const Answer& answer)
+	{
+		// a failed lookup is left to cURL, which reports the error itself
+		if (answer.error)
+			return;
+		easy.ClearConnectTo();
+		if (selector != nullptr)
+		{
+			if (const auto address = selector->Select(easy.GetNativeHandle(),
+				host, answer.addresses); address.has_value() == true)
+			{
+				const auto connectHost = address->is_v6() ?
+					'[' + address->to_string() + ']' : address->to_string();
+				easy.AddConnectToStr((host + ':' + port + ':' + connectHost + ':' + port).c_str());
+			}
+		}
+		easy.ClearResolve();
+#if LIBCURL_VERSION_NUM >= 0x074b00
+		// the + lets cURL's own DNS cache time the entry out
+		easy.AddResolveStr(('+' + host + ':' + port + ':' + answer.resolveList).c_str());
+#else
+		easy.AddResolveStr((host + ':' + port + ':' + answer.resolveList).c_str());
+#endif
+	};
+	// the transfer may have been canceled while it waited, so the handle
+	// is only touched if ready still wants it
+	Waiter waiter = [inject, ready = std::move(ready)](const Answer& answer)
+	{
+		ready([&]
+			{
+				inject(answer);
+			});
+	};
+	if (const auto answer = Lookup(host, waiter); answer != nullptr)
+	{
+		inject(*answer);
+		return true;
+	}
+	return false;
+}
+
+void DnsCache::Clear() noexcept
+{
+	std::lock_guard lock(m_state->mutex);
+	// entries with lookups in progress are kept, so their waiters complete
+	for (auto it = m_state->entries.begin(); it != m_state->entries.end();)
+	{
+		if (it->second.resolving == false)
+			it = m_state->entries.erase(it);
+		else
+		{
+			it->second.answer.reset();
+			++it;
+		}
+	}
+}
+
+DnsCacheStats DnsCache::GetStats() const noexcept
+{
+	std::lock_guard lock(m_state->mutex);
+	return m_state->stats;
+}
+
+std::shared_ptr<const DnsCache::Answer> DnsCache::Lookup(const std::string& host,
+	Waiter& waiter)
+{
+	const auto now = clock::now();
+	std::shared_ptr<const Answer> answer;
+	bool resolve = false;
+	{
+		std::lock_guard lock(m_state->mutex);
+		auto it = m_state->entries.find(host);
+		if (it == m_state->entries.end())
+		{
+			Evict();
+			it = m_state->entries.emplace(host, Entry{}).first;
+		}
+		auto& entry = it->second;
+		if (entry.answer != nullptr && now < entry.expiresAt)
+		{
+			++m_state->stats.hits;
+			++entry.uses;
+			answer = entry.answer;
+			// refresh names that are in use before they expire, so that
+			// they never have to wait
+			if (!answer->error && entry.resolving == false &&
+				now >= entry.refreshAt && entry.uses >= m_state->options.popularity)
+			{
+				++m_state->stats.refreshes;
+				entry.resolving = resolve = true;
+			}
+		}
+		else
+		{
+			++m_state->stats.misses;
+			entry.waiters.emplace_back(std::move(waiter));
+			if (entry.resolving == false)
+				entry.resolving = resolve = true;
+		}
+	}
+	if (resolve == true)
+		Resolve(host);
+	return answer;
+}
+
+void DnsCache::Resolve(const std::string& host)
+{
+	m_resolver(host, [state = m_state, host](const error_code& ec,
+		address_list addresses, std::chrono::seconds ttl)
+		{
+			OnResolved(*state, host, ec, std::move(addresses), ttl);
+		});
+}
+
+void DnsCache::OnResolved(State& state, const std::string& host, const error_code& ec,
+	address_list addresses, std::chrono::seconds ttl)
+{
+	const auto now = clock::now();
+	std::vector<Waiter> waiters;
+	std::shared_ptr<const Answer> answer;
+	{
+		std::lock_guard lock(state.mutex);
+		if (state.alive == false)
+			return;
+		auto it = state.entries.find(host);
+		if (it == state.entries.end())
+			return;
+		auto& entry = it->second;
+		entry.resolving = false;
+		waiters.swap(entry.waiters);
+		if (ec || addresses.empty() == true)
+		{
+			++state.stats.failures;
+			// a failed refresh keeps the old answer until it expires
+			if (entry.answer == nullptr || entry.answer->error ||
+				now >= entry.expiresAt)
+			{
+				entry.answer = std::make_shared<const Answer>(Answer{
+					ec ? ec : error_code(asio::error::host_not_found), {}, {} });
+				entry.expiresAt = now + state.options.negativeTtl;
+			}
+			entry.refreshAt = entry.expiresAt;
+		}
+		else
+		{
+			std::string resolveList;
+			for (const auto& address : addresses)
+			{
+				if (resolveList.empty() == false)
+					resolveList += ',';
+				if (address.is_v6() == true)
+					resolveList += '[' + address.to_string() + ']';
+				else
+					resolveList += address.to_string();
+			}
+			if (ttl.count() <= 0)
+				ttl = state.options.ttl;
+			entry.answer = std::make_shared<const Answer>(Answer{
+				{}, std::move(addresses), std::move(resolveList) });
+			entry.expiresAt = now + ttl;
+			entry.refreshAt = now + std::chrono::duration_cast<clock::duration>(
+				ttl * state.options.refreshAhead);
+		}
+		entry.uses = 0;
+		answer = entry.answer;
+	}
+	for (auto& waiter : waiters)
+		waiter(*answer);
+}
+
+void DnsCache::Evict() noexcept
+{
+	if (m_state->entries.size() < m_state->options.maxEntries || m_state->entries.empty() == true)
+		return;
+	// drop the answer that expires first, unless something waits on it
+	auto victim = m_state->entries.end();
+	for (auto it = m_state->entries.begin(); it != m_state->entries.end(); ++it)
+	{
+		if (it->second.resolving == true)
+			continue;
+		if (victim == m_state->entries.end() || it->second.expiresAt < victim->second.expiresAt)
+			victim = it;
+	}
+	if (victim != m_state->entries.end())
+		m_state->entries.erase(victim);
+}
+
+DnsCache::ResolveFunction DnsCache::MakeAsioResolver(const asio::any_io_executor& executor)
+{
+	return [executor](const std::string& host, ResolveHandler handler)
+	{
+		// resolvers can't be shared between threads, but they are cheap.
+		// every one of them uses the same background thread
+		auto resolver = std::make_shared<asio::ip::tcp::resolver>(executor);
+		resolver->async_resolve(host, "", [resolver, handler = std::move(handler)]
+			(const error_code& ec, const asio::ip::tcp::resolver::results_type& results)
+			{
+				address_list addresses;
+				for (const auto& result : results)
+				{
+					const auto address = result.endpoint().address();
+					if (std::find(addresses.begin(), addresses.end(), address) == addresses.end())
+						addresses.push_back(address);
+				}
+				// getaddrinfo doesn't report TTLs
+				handler(ec, std::move(addresses), std::chrono::seconds(0));
+			});
+	};
+}
\ No newline at end of file
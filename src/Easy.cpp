@@ -4,24 +4,67 @@ using cma::Easy;
 
 Easy::Easy() noexcept : 
 	m_nativeHandle(curl_easy_init(), curl_easy_cleanup),
-	m_headerList(nullptr, curl_slist_free_all) {}
+	m_headerList(nullptr, curl_slist_free_all),
+	m_resolveList(nullptr, curl_slist_free_all),
+	m_connectToList(nullptr, curl_slist_free_all) {}
 
 // just duplicate the raw handle
 Easy::Easy(const Easy& other) noexcept :
 	m_nativeHandle(curl_easy_duphandle(other.GetNativeHandle()), curl_easy_cleanup),
-	m_headerList(nullptr, curl_slist_free_all) 
+	m_headerList(nullptr, curl_slist_free_all),
+	m_resolveList(nullptr, curl_slist_free_all),
+	m_connectToList(nullptr, curl_slist_free_all),
+	m_url(other.m_url),
+	m_method(other.m_method),
+	m_customMethod(other.m_customMethod),
+	m_followLocation(other.m_followLocation),
+	m_sink(other.m_sink),
+	m_headerSink(other.m_headerSink),
+	m_maxBodySize(other.m_maxBodySize)
 {
 	// add each header manually
 	for (auto node = other.m_headerList.get(); node != nullptr;
 		node = node->next)
 		AddHeaderStr(node->data);
+	for (auto node = other.m_resolveList.get(); node != nullptr;
+		node = node->next)
+		AddResolveStr(node->data);
+	for (auto node = other.m_connectToList.get(); node != nullptr;
+		node = node->next)
+		AddConnectToStr(node->data);
 }
 
 Easy& Easy::operator=(const Easy& other) noexcept
 {
 	if (this == &other)
 		return *this;
+	// the charge belongs to the handle that is about to go away
+	m_charge.reset();
 	m_nativeHandle.reset(curl_easy_duphandle(other.GetNativeHandle()));
+	m_url = other.m_url;
+	m_method = other.m_method;
+	m_customMethod = other.m_customMethod;
+	m_followLocation = other.m_followLocation;
+	m_sink = other.m_sink;
+	m_headerSink = other.m_headerSink;
+	m_maxBodySize = other.m_maxBodySize;
+	// the duplicate points at the other handle's lists, so it gets
+	// lists of its own, as with the copy constructor
+	m_headerList.reset();
+	m_resolveList.reset();
+	m_connectToList.reset();
+	SetOption(CURLoption::CURLOPT_HTTPHEADER, nullptr);
+	SetOption(CURLoption::CURLOPT_RESOLVE, nullptr);
+	SetOption(CURLoption::CURLOPT_CONNECT_TO, nullptr);
+	for (auto node = other.m_headerList.get(); node != nullptr;
+		node = node->next)
+		AddHeaderStr(node->data);
+	for (auto node = other.m_resolveList.get(); node != nullptr;
+		node = node->next)
+		AddResolveStr(node->data);
+	for (auto node = other.m_connectToList.get(); node != nullptr;
+		node = node->next)
+		AddConnectToStr(node->data);
 	return *this;
 }
 
@@ -40,6 +83,45 @@ bool Easy::AddHeaderStr(const char* headerStr) noexcept
 	return true;
 }
 
+bool Easy::AddResolveStr(const char* resolveStr) noexcept
+{
+	const auto result = curl_slist_append(m_resolveList.get(), resolveStr);
+	if (result == nullptr)
+		return false;
+	m_resolveList.release();
+	m_resolveList.reset(result);
+	if (const auto res = SetOption(CURLoption::CURLOPT_RESOLVE,
+		m_resolveList.get()); res)
+		return false;
+	return true;
+}
+
+void Easy::ClearResolve() noexcept
+{
+	// cURL keeps the pointer, so unset it before freeing the list
+	SetOption(CURLoption::CURLOPT_RESOLVE, nullptr);
+	m_resolveList.reset();
+}
+
+bool Easy::AddConnectToStr(const char* connectToStr) noexcept
+{
+	const auto result = curl_slist_append(m_connectToList.get(), connectToStr);
+	if (result == nullptr)
+		return false;
+	m_connectToList.release();
+	m_connectToList.reset(result);
+	if (const auto res = SetOption(CURLoption::CURLOPT_CONNECT_TO,
+		m_connectToList.get()); res)
+		return false;
+	return true;
+}
+
+void Easy::ClearConnectTo() noexcept
+{
+	SetOption(CURLoption::CURLOPT_CONNECT_TO, nullptr);
+	m_connectToList.reset();
+}
+
 bool Easy::AddHeader(std::pair<std::string_view, std::string_view> header) noexcept
 {
 	std::string headerStr(header.first.data(), header.first.size());
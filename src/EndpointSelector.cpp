@@ -0,0 +1,188 @@
+#include <curl-multi-asio/EndpointSelector.h>
+
+#include <algorithm>
+
+using cma::EndpointSelector;
+using cma::EndpointStats;
+
+EndpointSelector::EndpointSelector(EndpointSelectorOptions options) :
+	m_options(options), m_random(std::random_device{}()) {}
+
+std::optional<asio::ip::address> EndpointSelector::Select(CURL* easy,
+	const std::string& host, const std::vector<asio::ip::address>& addresses)
+{
+	if (addresses.size() < 2)
+		return std::nullopt;
+	const auto now = clock::now();
+	std::lock_guard lock(m_mutex);
+	// an easy handle that is reused without finishing gives its pin back
+	Unpin(easy);
+	std::vector<std::pair<const asio::ip::address*, Endpoint*>> candidates;
+	candidates.reserve(addresses.size());
+	for (const auto& address : addresses)
+	{
+		auto& endpoint = m_endpoints[address.to_string()];
+		endpoint.host = host;
+		if (endpoint.ejectedUntil <= now)
+			candidates.emplace_back(&address, &endpoint);
+	}
+	// if everything is ejected, fail open instead of refusing to connect
+	if (candidates.empty() == true)
+		for (const auto& address : addresses)
+			candidates.emplace_back(&address, &m_endpoints[address.to_string()]);
+	// the power of two choices: two random picks, and the cheaper one wins.
+	// it avoids herding onto the single best endpoint
+	std::uniform_int_distribution<size_t> pick(0, candidates.size() - 1);
+	const size_t first = pick(m_random);
+	size_t second = pick(m_random);
+	if (candidates.size() > 1)
+		while (second == first)
+			second = pick(m_random);
+	const auto& chosen = (Cost(*candidates[second].second) <
+		Cost(*candidates[first].second)) ? candidates[second] : candidates[first];
+	++chosen.second->inFlight;
+	m_pins[easy] = *chosen.first;
+	return *chosen.first;
+}
+
+void EndpointSelector::Record(CURL* easy, CURLcode result) noexcept
+{
+	const auto now = clock::now();
+	std::lock_guard lock(m_mutex);
+	auto address = Unpin(easy);
+	if (address.has_value() == false)
+	{
+		// unpinned transfers only know where they went once connected
+		char* primaryIp = nullptr;
+		if (curl_easy_getinfo(easy, CURLINFO_PRIMARY_IP, &primaryIp) != CURLE_OK ||
+			primaryIp == nullptr || *primaryIp == '\0')
+			return;
+		asio::error_code ec;
+		address = asio::ip::make_address(primaryIp, ec);
+		if (ec)
+			return;
+	}
+	auto endpointIt = m_endpoints.find(address->to_string());
+	if (endpointIt == m_endpoints.end())
+		return;
+	auto& endpoint = endpointIt->second;
+	switch (result)
+	{
+	case CURLE_COULDNT_CONNECT:
+	case CURLE_OPERATION_TIMEDOUT:
+	case CURLE_SEND_ERROR:
+	case CURLE_RECV_ERROR:
+	case CURLE_GOT_NOTHING:
+		if (++endpoint.failures >= m_options.failuresToEject)
+			Eject(endpoint, now);
+		return;
+	default:
+		break;
+	}
+	endpoint.failures = 0;
+	curl_off_t connectTime = 0;
+	curl_off_t firstByteTime = 0;
+	long connects = 0;
+	curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME_T, &connectTime);
+	curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME_T, &firstByteTime);
+	curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+	if (firstByteTime <= 0)
+		return;
+	const auto blend = [this, &endpoint](double& average, double sample)
+	{
+		average = (endpoint.samples == 0) ? sample :
+			average + m_options.alpha * (sample - average);
+	};
+	// a reused connection says nothing about connecting, but its time to
+	// first byte still measures the server
+	if (connects > 0 || endpoint.samples == 0)
+		blend(endpoint.connectTime, static_cast<double>((connects > 0) ? connectTime : 0));
+	blend(endpoint.firstByteTime, static_cast<double>(firstByteTime - connectTime));
+	++endpoint.samples;
+	EjectOutliers(endpoint.host, now);
+}
+
+void EndpointSelector::Release(CURL* easy) noexcept
+{
+	std::lock_guard lock(m_mutex);
+	Unpin(easy);
+}
+
+std::vector<EndpointStats> EndpointSelector::GetStats() const
+{
+	const auto now = clock::now();
+	std::lock_guard lock(m_mutex);
+	std::vector<EndpointStats> stats;
+	stats.reserve(m_endpoints.size());
+	for (const auto& [address, endpoint] : m_endpoints)
+	{
+		EndpointStats snapshot;
+		snapshot.address = asio::ip::make_address(address);
+		snapshot.host = endpoint.host;
+		snapshot.connectTime = std::chrono::microseconds(
+			static_cast<int64_t>(endpoint.connectTime));
+		snapshot.firstByteTime = std::chrono::microseconds(
+			static_cast<int64_t>(endpoint.firstByteTime));
+		snapshot.samples = endpoint.samples;
+		snapshot.inFlight = endpoint.inFlight;
+		snapshot.ejected = endpoint.ejectedUntil > now;
+		stats.push_back(std::move(snapshot));
+	}
+	return stats;
+}
+
+double EndpointSelector::Cost(const Endpoint& endpoint) noexcept
+{
+	if (endpoint.samples == 0)
+		return 0.0;
+	// queueing behind the transfers already sent there
+	return (endpoint.connectTime + endpoint.firstByteTime) * (endpoint.inFlight + 1);
+}
+
+void EndpointSelector::EjectOutliers(const std::string& host, clock::time_point now) noexcept
+{
+	// every measured endpoint of the host is checked, because a slow one
+	// is rarely chosen, so it is rarely measured again. it takes three to
+	// tell which one is the outlier
+	std::vector<Endpoint*> peers;
+	std::vector<double> latencies;
+	for (auto& [address, endpoint] : m_endpoints)
+	{
+		if (endpoint.host != host || endpoint.samples == 0)
+			continue;
+		peers.push_back(&endpoint);
+		latencies.push_back(endpoint.connectTime + endpoint.firstByteTime);
+	}
+	if (peers.size() < 3)
+		return;
+	const auto median = latencies.begin() + latencies.size() / 2;
+	std::nth_element(latencies.begin(), median, latencies.end());
+	const double limit = std::max(*median * m_options.outlierFactor,
+		static_cast<double>(m_options.minOutlierLatency.count()));
+	for (auto endpoint : peers)
+		if (endpoint->connectTime + endpoint->firstByteTime > limit)
+			Eject(*endpoint, now);
+}
+
+void EndpointSelector::Eject(Endpoint& endpoint, clock::time_point now) noexcept
+{
+	// it starts over once the cooldown ends, so that it is measured again
+	endpoint.ejectedUntil = now + m_options.cooldown;
+	endpoint.connectTime = 0.0;
+	endpoint.firstByteTime = 0.0;
+	endpoint.samples = 0;
+	endpoint.failures = 0;
+}
+
+std::optional<asio::ip::address> EndpointSelector::Unpin(CURL* easy) noexcept
+{
+	auto pinIt = m_pins.find(easy);
+	if (pinIt == m_pins.end())
+		return std::nullopt;
+	const auto address = pinIt->second;
+	m_pins.erase(pinIt);
+	if (auto endpointIt = m_endpoints.find(address.to_string());
+		endpointIt != m_endpoints.end() && endpointIt->second.inFlight > 0)
+		--endpointIt->second.inFlight;
+	return address;
+}
\ No newline at end of file
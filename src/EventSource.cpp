@@ -0,0 +1,355 @@
+#include <curl-multi-asio/EventSource.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+
+using cma::BasicEventSource;
+using cma::EventStreamParser;
+
+EventStreamParser::EventStreamParser(Handler handler, size_t maxEventSize) :
+	m_handler(std::move(handler)), m_maxEventSize(maxEventSize) {}
+
+bool EventStreamParser::Consume(std::string_view chunk)
+{
+	if (m_failed == true)
+		return false;
+	if (m_eventStart == m_end)
+	{
+		// nothing is being framed, so the buffer starts over for free
+		m_eventStart = m_lineStart = m_end = 0;
+	}
+	else if (m_end + chunk.size() > m_buffer.size() && m_eventStart != 0)
+	{
+		// the events that were handed over make room, so only the one
+		// being framed moves
+		const size_t shift = m_eventStart;
+		std::memmove(m_buffer.data(), m_buffer.data() + shift, m_end - shift);
+		m_end -= shift;
+		m_lineStart -= shift;
+		m_eventStart = 0;
+		if (m_type.length != 0)
+			m_type.offset -= shift;
+		if (m_dataLines != 0)
+			m_data.offset -= shift;
+	}
+	if (m_end + chunk.size() > m_buffer.size())
+		m_buffer.resize(std::max(m_buffer.size() * 2, m_end + chunk.size()));
+	std::memcpy(m_buffer.data() + m_end, chunk.data(), chunk.size());
+	size_t pos = m_end;
+	m_end += chunk.size();
+	const char* data = m_buffer.data();
+	if (m_skipNewline == true && pos != m_end)
+	{
+		m_skipNewline = false;
+		if (data[pos] == '\n')
+			m_lineStart = ++pos;
+	}
+	// the scan picks up where the last one stopped, so each byte is
+	// only looked at once however the stream is split
+	while (pos != m_end)
+	{
+		while (pos != m_end && data[pos] != '\n' && data[pos] != '\r')
+			++pos;
+		if (pos == m_end)
+			break;
+		const char terminator = data[pos];
+		if (OnLine(m_lineStart, pos) == false)
+			return false;
+		++pos;
+		if (terminator == '\r')
+		{
+			if (pos == m_end)
+				m_skipNewline = true;
+			else if (data[pos] == '\n')
+				++pos;
+		}
+		m_lineStart = pos;
+		if (m_dataLines == 0 && m_type.length == 0)
+			m_eventStart = m_lineStart;
+	}
+	if (m_end - m_eventStart > m_maxEventSize)
+	{
+		m_failed = true;
+		return false;
+	}
+	return true;
+}
+
+void EventStreamParser::Reset() noexcept
+{
+	m_eventStart = m_lineStart = m_end = 0;
+	m_type = {};
+	m_data = {};
+	m_dataLines = 0;
+	m_joined.clear();
+	m_skipNewline = false;
+	m_failed = false;
+}
+
+bool EventStreamParser::OnLine(size_t begin, size_t end)
+{
+	if (begin == end)
+		return Dispatch();
+	const std::string_view line(m_buffer.data() + begin, end - begin);
+	// comments keep idle connections open
+	if (line.front() == ':')
+		return true;
+	const auto colon = line.find(':');
+	const auto name = line.substr(0, colon);
+	size_t valueStart = (colon == std::string_view::npos) ? line.size() : colon + 1;
+	if (valueStart < line.size() && line[valueStart] == ' ')
+		++valueStart;
+	const Span value{ begin + valueStart, line.size() - valueStart };
+	if (name == "data")
+	{
+		// only a second line makes a copy, to join them
+		if (m_dataLines == 1)
+			m_joined.assign(View(m_data));
+		if (m_dataLines == 0)
+			m_data = value;
+		else
+		{
+			m_joined += '\n';
+			m_joined.append(View(value));
+		}
+		++m_dataLines;
+	}
+	else if (name == "event")
+		m_type = value;
+	else if (name == "id")
+	{
+		if (View(value).find('\0') == std::string_view::npos)
+			m_lastEventId.assign(View(value));
+	}
+	else if (name == "retry")
+	{
+		const auto digits = View(value);
+		uint64_t retry = 0;
+		if (digits.empty() == false && std::all_of(digits.begin(), digits.end(),
+			[](char c) { return std::isdigit(static_cast<unsigned char>(c)); }) &&
+			std::from_chars(digits.data(), digits.data() + digits.size(), retry).ec == std::errc())
+			m_retry = std::chrono::milliseconds(retry);
+	}
+	return true;
+}
+
+bool EventStreamParser::Dispatch()
+{
+	const size_t dataLines = m_dataLines;
+	const ServerSentEvent event{ (m_type.length != 0) ? View(m_type) : "message",
+		(dataLines > 1) ? std::string_view(m_joined) : View(m_data), m_lastEventId };
+	m_type = {};
+	m_data = {};
+	m_dataLines = 0;
+	// an event without data is dropped, as with a browser
+	if (dataLines == 0)
+		return true;
+	++m_events;
+	if (m_handler(event) == false)
+	{
+		m_failed = true;
+		return false;
+	}
+	return true;
+}
+
+template<typename ThreadingPolicy>
+BasicEventSource<ThreadingPolicy>::BasicEventSource(BasicMulti<ThreadingPolicy>& multi,
+	EventStreamParser::Handler handler, EventSourceOptions options) :
+	m_state(std::make_shared<State>(multi, options, std::move(handler))) {}
+
+template<typename ThreadingPolicy>
+BasicEventSource<ThreadingPolicy>::~BasicEventSource() noexcept
+{
+	Stop();
+}
+
+template<typename ThreadingPolicy>
+void BasicEventSource<ThreadingPolicy>::Start(const std::string& url, std::string lastEventId)
+{
+	{
+		std::lock_guard lock(m_state->mutex);
+		if (m_state->started == true || m_state->done == true)
+			return;
+		m_state->started = true;
+	}
+	m_state->easy.SetURL(url.c_str());
+	if (lastEventId.empty() == false)
+		m_state->parser.SetLastEventId(std::move(lastEventId));
+	m_state->easy.SetOption(CURLoption::CURLOPT_WRITEFUNCTION, &BasicEventSource::WriteCb);
+	m_state->easy.SetOption(CURLoption::CURLOPT_WRITEDATA, m_state.get());
+	Connect(m_state);
+}
+
+template<typename ThreadingPolicy>
+void BasicEventSource<ThreadingPolicy>::Stop()
+{
+	std::unique_lock lock(m_state->mutex);
+	if (m_state->done == true)
+		return;
+	const bool started = m_state->started;
+	Finish(m_state, lock, asio::error::operation_aborted);
+	// the connection reports back once it's aborted, and is ignored. the
+	// state keeps the easy handle alive until then, so the cancel can't
+	// hit another transfer that reuses its address
+	if (started == true)
+		m_state->multi.Execute([state = m_state]
+			{
+				state->multi.Cancel(std::vector<CURL*>{ state->easy.GetNativeHandle() });
+			});
+}
+
+template<typename ThreadingPolicy>
+size_t BasicEventSource<ThreadingPolicy>::GetConnections() const noexcept
+{
+	std::lock_guard lock(m_state->mutex);
+	return m_state->connections;
+}
+
+template<typename ThreadingPolicy>
+void BasicEventSource<ThreadingPolicy>::Wait(Waiter waiter)
+{
+	std::unique_lock lock(m_state->mutex);
+	if (m_state->done == false)
+	{
+		m_state->waiter = std::move(waiter);
+		return;
+	}
+	const auto result = m_state->result;
+	lock.unlock();
+	waiter(result);
+}
+
+template<typename ThreadingPolicy>
+void BasicEventSource<ThreadingPolicy>::Connect(const std::shared_ptr<State>& state)
+{
+	state->multi.Execute([state]
+		{
+			{
+				std::lock_guard lock(state->mutex);
+				if (state->done == true)
+					return;
+				++state->connections;
+			}
+			// the caller's headers are kept, and ours are added to a copy of them
+			curl_slist* headers = nullptr;
+			for (auto node = state->easy.GetHeaderList(); node != nullptr; node = node->next)
+				headers = curl_slist_append(headers, node->data);
+			headers = curl_slist_append(headers, "Accept: text/event-stream");
+			headers = curl_slist_append(headers, "Cache-Control: no-cache");
+			// the server picks up after the last event this source saw
+			if (state->parser.GetLastEventId().empty() == false)
+				headers = curl_slist_append(headers, ("Last-Event-ID: " +
+					state->parser.GetLastEventId()).c_str());
+			state->headers.reset(headers);
+			state->easy.SetOption(CURLoption::CURLOPT_HTTPHEADER, headers);
+			state->parser.Reset();
+			state->accepted = false;
+			state->rejection.clear();
+			state->eventsBefore = state->parser.GetEvents();
+			state->multi.AsyncPerform(state->easy, [state](const error_code& ec)
+				{
+					OnDone(state, ec);
+				});
+		});
+}
+
+template<typename ThreadingPolicy>
+void BasicEventSource<ThreadingPolicy>::OnDone(const std::shared_ptr<State>& state, const error_code& ec)
+{
+	std::unique_lock lock(state->mutex);
+	// stopped, and this is the aborted connection reporting back
+	if (state->done == true)
+		return;
+	if (state->ended == true)
+		return Finish(state, lock, {});
+	if (state->rejection)
+		return Finish(state, lock, state->rejection);
+	if (!ec && state->accepted == false)
+	{
+		// a 204 is the server telling the source to stop, and has no body
+		long status = 0;
+		state->easy.GetInfo(CURLINFO_RESPONSE_CODE, status);
+		return Finish(state, lock, (status == 204) ? error_code{} : Inspect(state->easy.GetNativeHandle()));
+	}
+	// an event that is too large would be too large again
+	if (state->parser.Failed() == true)
+		return Finish(state, lock, ec);
+	// the stream ended, or the connection failed. it is resumed, and
+	// only connections that gave nothing back count against the limit
+	if (state->parser.GetEvents() != state->eventsBefore)
+		state->reconnects = 0;
+	if (state->reconnects >= state->options.maxReconnects)
+		return Finish(state, lock, ec ? ec : error_code(asio::error::eof));
+	auto delay = (state->parser.GetRetry().count() > 0) ? state->parser.GetRetry() : state->options.retry;
+	for (size_t i = 0; i < state->reconnects && delay < state->options.maxRetry; ++i)
+		delay *= 2;
+	++state->reconnects;
+	state->timer.expires_after(std::min(delay, state->options.maxRetry));
+	state->timer.async_wait([state](const asio::error_code& ec)
+		{
+			if (!ec)
+				Connect(state);
+		});
+}
+
+template<typename ThreadingPolicy>
+void BasicEventSource<ThreadingPolicy>::Finish(const std::shared_ptr<State>& state,
+	std::unique_lock<std::mutex>& lock, error_code ec)
+{
+	state->done = true;
+	state->result = ec;
+	state->timer.cancel();
+	auto waiter = std::move(state->waiter);
+	lock.unlock();
+	if (waiter)
+		waiter(ec);
+}
+
+template<typename ThreadingPolicy>
+cma::error_code BasicEventSource<ThreadingPolicy>::Inspect(CURL* easy) noexcept
+{
+	long status = 0;
+	curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+	if (status >= 400)
+		return CURLE_HTTP_RETURNED_ERROR;
+	char* type = nullptr;
+	curl_easy_getinfo(easy, CURLINFO_CONTENT_TYPE, &type);
+	constexpr std::string_view expected = "text/event-stream";
+	if (status != 200 || type == nullptr || std::strlen(type) < expected.size() ||
+		std::equal(expected.begin(), expected.end(), type, [](char a, char b)
+		{
+			return a == std::tolower(static_cast<unsigned char>(b));
+		}) == false)
+		return Errc::NotEventStream;
+	return {};
+}
+
+template<typename ThreadingPolicy>
+size_t BasicEventSource<ThreadingPolicy>::WriteCb(char* ptr, size_t, size_t nmemb,
+	State* userdata) noexcept
+{
+	try
+	{
+		if (userdata->accepted == false)
+		{
+			// the response is checked once, before its body is framed
+			if (auto ec = Inspect(userdata->easy.GetNativeHandle()); ec)
+			{
+				userdata->rejection = ec;
+				return 0;
+			}
+			userdata->accepted = true;
+		}
+		return (userdata->parser.Consume(std::string_view(ptr, nmemb)) == true) ? nmemb : 0;
+	}
+	catch (...)
+	{
+		return 0;
+	}
+}
+
+template class cma::BasicEventSource<cma::ThreadSafe>;
+template class cma::BasicEventSource<cma::SingleThreaded>;
\ No newline at end of file
@@ -0,0 +1,381 @@
+#include <curl-multi-asio/JsonTokenizer.h>
+
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CMA_JSON_SSE2 1
+#endif
+
+using cma::JsonToken;
+using cma::JsonTokenizer;
+
+namespace
+{
+	/// @return Whether or not a character is JSON whitespace
+	constexpr bool IsWhitespace(char c) noexcept
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+	}
+
+	/// @return Whether or not a character can be part of a number
+	constexpr bool IsNumberChar(char c) noexcept
+	{
+		return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+	}
+
+	/// @return Whether or not a character can be part of a literal
+	constexpr bool IsLiteralChar(char c) noexcept
+	{
+		return c >= 'a' && c <= 'z';
+	}
+
+	/// @return The first character past a number or a literal, or end
+	const char* ScalarEnd(const char* p, const char* end, bool number) noexcept
+	{
+		while (p != end && ((number == true) ? IsNumberChar(*p) : IsLiteralChar(*p)) == true)
+			++p;
+		return p;
+	}
+
+	/// @return The first character that isn't whitespace, or end
+	const char* SkipWhitespace(const char* p, const char* end) noexcept
+	{
+		// most documents are compact or indented by a few characters, so a
+		// block is only worth loading once the first one is whitespace
+		if (p != end && IsWhitespace(*p) == false)
+			return p;
+#ifdef CMA_JSON_SSE2
+		const __m128i space = _mm_set1_epi8(' ');
+		const __m128i newline = _mm_set1_epi8('\n');
+		const __m128i ret = _mm_set1_epi8('\r');
+		const __m128i tab = _mm_set1_epi8('\t');
+		for (; end - p >= 16; p += 16)
+		{
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			const __m128i whitespace = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, newline)),
+				_mm_or_si128(_mm_cmpeq_epi8(block, ret), _mm_cmpeq_epi8(block, tab)));
+			const auto other = static_cast<unsigned>(~_mm_movemask_epi8(whitespace)) & 0xFFFFu;
+			if (other != 0)
+				return p + std::countr_zero(other);
+		}
+#endif
+		while (p != end && IsWhitespace(*p) == true)
+			++p;
+		return p;
+	}
+
+	/// @return The first quote or backslash, or end
+	const char* FindQuoteOrEscape(const char* p, const char* end) noexcept
+	{
+#ifdef CMA_JSON_SSE2
+		const __m128i quote = _mm_set1_epi8('"');
+		const __m128i backslash = _mm_set1_epi8('\\');
+		for (; end - p >= 16; p += 16)
+		{
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			const auto special = static_cast<unsigned>(_mm_movemask_epi8(
+				_mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash))));
+			if (special != 0)
+				return p + std::countr_zero(special);
+		}
+#endif
+		while (p != end && *p != '"' && *p != '\\')
+			++p;
+		return p;
+	}
+}
+
+JsonTokenizer::JsonTokenizer(Handler handler, size_t maxTokenSize, size_t maxDepth) :
+	m_handler(std::move(handler)), m_maxTokenSize(maxTokenSize), m_maxDepth(maxDepth) {}
+
+bool JsonTokenizer::Consume(std::string_view chunk)
+{
+	if (m_failed == true)
+		return false;
+	const char* const begin = chunk.data();
+	const char* const end = begin + chunk.size();
+	const char* p = begin;
+	const char* next = p;
+	// the offset of a failure is the start of the token that failed
+	const auto fail = [&]
+	{
+		m_offset += p - begin;
+		return false;
+	};
+	if (m_partial != Partial::None)
+	{
+		if ((next = Resume(p, end)) == nullptr)
+			return fail();
+		p = next;
+	}
+	while ((p = SkipWhitespace(p, end)) != end)
+	{
+		const char c = *p;
+		next = nullptr;
+		switch (m_expect)
+		{
+		case Expect::Colon:
+			if (c == ':')
+			{
+				m_expect = Expect::Value;
+				next = p + 1;
+			}
+			else
+				Fail();
+			break;
+		case Expect::CommaOrEnd:
+			if (c == ',')
+			{
+				m_expect = (m_stack.back() == '{') ? Expect::Key : Expect::Value;
+				next = p + 1;
+			}
+			else if (Close(c) == true)
+				next = p + 1;
+			break;
+		case Expect::KeyOrEnd:
+			if (c == '}')
+			{
+				if (Close(c) == true)
+					next = p + 1;
+				break;
+			}
+			[[fallthrough]];
+		case Expect::Key:
+			if (c == '"')
+			{
+				m_key = true;
+				next = ReadString(p + 1, end);
+			}
+			else
+				Fail();
+			break;
+		case Expect::ValueOrEnd:
+			if (c == ']')
+			{
+				if (Close(c) == true)
+					next = p + 1;
+				break;
+			}
+			[[fallthrough]];
+		case Expect::Value:
+			if (c == '{' || c == '[')
+			{
+				if (Open(c) == true)
+					next = p + 1;
+			}
+			else if (c == '"')
+			{
+				m_key = false;
+				next = ReadString(p + 1, end);
+			}
+			else if (c == '-' || (c >= '0' && c <= '9'))
+				next = ReadScalar(p, end, Partial::Number);
+			else if (c == 't' || c == 'f' || c == 'n')
+				next = ReadScalar(p, end, Partial::Literal);
+			else
+				Fail();
+			break;
+		}
+		if (next == nullptr)
+			return fail();
+		p = next;
+	}
+	m_offset += chunk.size();
+	return true;
+}
+
+bool JsonTokenizer::Finish()
+{
+	if (m_failed == true)
+		return false;
+	// only a number or a literal ends with the body, the others end with
+	// their closing character
+	if (m_partial == Partial::Number || m_partial == Partial::Literal)
+	{
+		const auto kind = m_partial;
+		m_partial = Partial::None;
+		if (EmitScalar(kind, m_token) == false)
+			return false;
+		m_token.clear();
+	}
+	if (m_partial != Partial::None || m_stack.empty() == false)
+		return Fail();
+	return true;
+}
+
+void JsonTokenizer::Reset() noexcept
+{
+	m_stack.clear();
+	m_token.clear();
+	m_offset = 0;
+	m_expect = Expect::Value;
+	m_partial = Partial::None;
+	m_key = false;
+	m_escape = false;
+	m_failed = false;
+}
+
+const char* JsonTokenizer::Resume(const char* p, const char* end)
+{
+	if (m_partial == Partial::String)
+	{
+		const char* quote = FindStringEnd(p, end);
+		if (Buffer(p, quote) == false)
+			return nullptr;
+		if (quote == end)
+			return end;
+		m_partial = Partial::None;
+		if (EmitString(m_token) == false)
+			return nullptr;
+		m_token.clear();
+		return quote + 1;
+	}
+	const auto kind = m_partial;
+	const char* last = ScalarEnd(p, end, kind == Partial::Number);
+	if (Buffer(p, last) == false)
+		return nullptr;
+	if (last == end)
+		return end;
+	m_partial = Partial::None;
+	if (EmitScalar(kind, m_token) == false)
+		return nullptr;
+	m_token.clear();
+	return last;
+}
+
+const char* JsonTokenizer::ReadString(const char* p, const char* end)
+{
+	const char* quote = FindStringEnd(p, end);
+	if (quote == end)
+	{
+		// the rest of the string comes with a later chunk
+		m_partial = Partial::String;
+		return (Buffer(p, end) == true) ? end : nullptr;
+	}
+	if (static_cast<size_t>(quote - p) > m_maxTokenSize)
+	{
+		Fail();
+		return nullptr;
+	}
+	return (EmitString(std::string_view(p, quote - p)) == true) ? quote + 1 : nullptr;
+}
+
+const char* JsonTokenizer::ReadScalar(const char* p, const char* end, Partial kind)
+{
+	const char* last = ScalarEnd(p, end, kind == Partial::Number);
+	if (last == end)
+	{
+		// a number may go on in the next chunk, or end with the body
+		m_partial = kind;
+		return (Buffer(p, end) == true) ? end : nullptr;
+	}
+	if (static_cast<size_t>(last - p) > m_maxTokenSize)
+	{
+		Fail();
+		return nullptr;
+	}
+	return (EmitScalar(kind, std::string_view(p, last - p)) == true) ? last : nullptr;
+}
+
+const char* JsonTokenizer::FindStringEnd(const char* p, const char* end) noexcept
+{
+	if (m_escape == true)
+	{
+		if (p == end)
+			return end;
+		// the escaped character came with this chunk
+		++p;
+		m_escape = false;
+	}
+	while ((p = FindQuoteOrEscape(p, end)) != end)
+	{
+		if (*p == '"')
+			return p;
+		if (end - p == 1)
+		{
+			m_escape = true;
+			return end;
+		}
+		p += 2;
+	}
+	return end;
+}
+
+bool JsonTokenizer::EmitString(std::string_view text)
+{
+	if (m_key == true)
+	{
+		if (m_handler(JsonToken::Key, text) == false)
+			return Fail();
+		m_expect = Expect::Colon;
+		return true;
+	}
+	return Emit(JsonToken::String, text);
+}
+
+bool JsonTokenizer::EmitScalar(Partial kind, std::string_view text)
+{
+	if (kind == Partial::Number)
+	{
+		// the rest of the grammar is left to whoever converts the number
+		const char last = text.back();
+		if (last < '0' || last > '9')
+			return Fail();
+		return Emit(JsonToken::Number, text);
+	}
+	if (text == "true")
+		return Emit(JsonToken::True, text);
+	if (text == "false")
+		return Emit(JsonToken::False, text);
+	if (text == "null")
+		return Emit(JsonToken::Null, text);
+	return Fail();
+}
+
+bool JsonTokenizer::Open(char bracket)
+{
+	if (m_stack.size() >= m_maxDepth)
+		return Fail();
+	m_stack.push_back(bracket);
+	m_expect = (bracket == '{') ? Expect::KeyOrEnd : Expect::ValueOrEnd;
+	if (m_handler((bracket == '{') ? JsonToken::ObjectBegin : JsonToken::ArrayBegin,
+		(bracket == '{') ? "{" : "[") == false)
+		return Fail();
+	return true;
+}
+
+bool JsonTokenizer::Close(char bracket)
+{
+	if (m_stack.empty() == true || (bracket != '}' && bracket != ']') ||
+		m_stack.back() != ((bracket == '}') ? '{' : '['))
+		return Fail();
+	m_stack.pop_back();
+	return Emit((bracket == '}') ? JsonToken::ObjectEnd : JsonToken::ArrayEnd,
+		(bracket == '}') ? "}" : "]");
+}
+
+bool JsonTokenizer::Emit(JsonToken token, std::string_view text)
+{
+	// a value was finished, so a separator or the end of its container
+	// comes next, or another document at the top level
+	m_expect = (m_stack.empty() == true) ? Expect::Value : Expect::CommaOrEnd;
+	if (m_handler(token, text) == false)
+		return Fail();
+	return true;
+}
+
+bool JsonTokenizer::Buffer(const char* p, const char* end)
+{
+	if (m_token.size() + (end - p) > m_maxTokenSize)
+		return Fail();
+	m_token.append(p, end);
+	return true;
+}
+
+bool JsonTokenizer::Fail() noexcept
+{
+	m_failed = true;
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include <curl-multi-asio/MemoryBudget.h>
+
+#include <algorithm>
+
+using cma::MemoryBudget;
+
+MemoryBudget::MemoryBudget(MemoryBudgetOptions options) :
+	m_options(options)
+{
+	m_link->budget = this;
+}
+
+MemoryBudget::~MemoryBudget() noexcept
+{
+	std::lock_guard lock(m_link->mutex);
+	m_link->budget = nullptr;
+}
+
+void MemoryBudget::Prepare(Easy& easy, std::function<void()> resume)
+{
+	const auto& sink = easy.GetSink();
+	// cURL's default writes to a file, and a sink that neither keeps the
+	// body nor has a limit has nothing to account for
+	if (sink.function == nullptr || (sink.buffered == false && easy.GetMaxBodySize() < 0))
+		return;
+	auto watch = std::make_unique<Watch>();
+	watch->budget = this;
+	watch->easy = easy.GetNativeHandle();
+	watch->sink = sink;
+	watch->maxBodySize = easy.GetMaxBodySize();
+	watch->resume = std::move(resume);
+	// the charge is keyed by the native handle, so it must not outlive
+	// it and be inherited by the next handle at the same address
+	if (sink.buffered == true && easy.GetCharge() == nullptr)
+		easy.SetCharge(std::shared_ptr<void>(nullptr, [link = m_link,
+			handle = watch->easy](void*)
+			{
+				std::lock_guard lock(link->mutex);
+				if (link->budget != nullptr)
+					link->budget->Free(handle, SIZE_MAX);
+			}));
+	// straight to cURL, so the easy handle still remembers its own sink
+	curl_easy_setopt(watch->easy, CURLOPT_WRITEFUNCTION, &MemoryBudget::WriteCb);
+	curl_easy_setopt(watch->easy, CURLOPT_WRITEDATA, watch.get());
+	std::lock_guard lock(m_mutex);
+	m_watches[watch->easy] = std::move(watch);
+}
+
+CURLcode MemoryBudget::Record(CURL* easy, CURLcode result) noexcept
+{
+	auto watch = Unwatch(easy);
+	if (watch == nullptr || watch->tooLarge == false || result != CURLE_WRITE_ERROR)
+		return result;
+	std::lock_guard lock(m_mutex);
+	++m_stats.tooLarge;
+	return CURLE_FILESIZE_EXCEEDED;
+}
+
+void MemoryBudget::Release(CURL* easy) noexcept
+{
+	Unwatch(easy);
+}
+
+void MemoryBudget::Free(const Easy& easy, size_t bytes) noexcept
+{
+	Free(easy.GetNativeHandle(), bytes);
+}
+
+void MemoryBudget::Free(CURL* easy, size_t bytes) noexcept
+{
+	std::lock_guard lock(m_mutex);
+	auto it = m_held.find(easy);
+	if (it == m_held.end())
+		return;
+	const size_t freed = std::min(bytes, it->second);
+	it->second -= freed;
+	m_stats.used -= freed;
+	if (it->second == 0)
+		m_held.erase(it);
+	Wake();
+}
+
+size_t MemoryBudget::GetHeld(const Easy& easy) const noexcept
+{
+	std::lock_guard lock(m_mutex);
+	auto it = m_held.find(easy.GetNativeHandle());
+	return (it != m_held.end()) ? it->second : 0;
+}
+
+cma::MemoryBudgetStats MemoryBudget::GetStats() const noexcept
+{
+	std::lock_guard lock(m_mutex);
+	auto stats = m_stats;
+	stats.waiting = m_waiting.size();
+	return stats;
+}
+
+std::unique_ptr<MemoryBudget::Watch> MemoryBudget::Unwatch(CURL* easy) noexcept
+{
+	std::unique_ptr<Watch> watch;
+	{
+		std::lock_guard lock(m_mutex);
+		auto it = m_watches.find(easy);
+		if (it == m_watches.end())
+			return nullptr;
+		watch = std::move(it->second);
+		m_watches.erase(it);
+		if (watch->waiting == true)
+			m_waiting.erase(std::find(m_waiting.begin(), m_waiting.end(), watch.get()));
+		if (watch->granted == true)
+			--m_granted;
+		// one fewer transfer may leave only paused ones
+		Wake();
+	}
+	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, watch->sink.function);
+	curl_easy_setopt(easy, CURLOPT_WRITEDATA, watch->sink.data);
+	return watch;
+}
+
+bool MemoryBudget::Charge(Watch& watch, size_t bytes) noexcept
+{
+	// a transfer only goes ahead of those waiting once it is its turn
+	const bool turn = watch.overdraft == true || watch.granted == true || m_waiting.empty() == true;
+	if (turn == true && (watch.overdraft == true || m_stats.used + bytes <= m_options.limit))
+	{
+		if (watch.granted == true)
+		{
+			watch.granted = false;
+			--m_granted;
+		}
+		m_held[watch.easy] += bytes;
+		m_stats.used += bytes;
+		m_stats.peak = std::max(m_stats.peak, m_stats.used);
+		// the turn passes on while there is room
+		Wake();
+		return true;
+	}
+	if (watch.granted == true)
+	{
+		watch.granted = false;
+		--m_granted;
+	}
+	// cURL hands over the same write once resumed
+	watch.wanted = bytes;
+	if (watch.waiting == false)
+	{
+		watch.waiting = true;
+		m_waiting.push_back(&watch);
+	}
+	++m_stats.pauses;
+	Wake();
+	return false;
+}
+
+void MemoryBudget::Wake() noexcept
+{
+	// one transfer is resumed at a time, and passes the turn on once it wrote
+	if (m_waiting.empty() == true || m_granted != 0)
+		return;
+	Watch* next = m_waiting.front();
+	if (m_stats.used + next->wanted <= m_options.limit)
+	{
+		next->granted = true;
+		++m_granted;
+	}
+	else if (m_waiting.size() == m_watches.size())
+	{
+		// nothing else is running to finish and free its body
+		next->overdraft = true;
+		++m_stats.overdrafts;
+	}
+	else
+		return;
+	m_waiting.pop_front();
+	next->waiting = false;
+	++m_stats.resumes;
+	next->resume();
+}
+
+size_t MemoryBudget::WriteCb(char* ptr, size_t size, size_t nmemb, Watch* userdata) noexcept
+{
+	if (userdata->maxBodySize >= 0)
+	{
+		// a Content-Length over the limit is caught before the body when
+		// cURL checks it, so this is a body that announced no length
+		if (userdata->received + static_cast<curl_off_t>(nmemb) > userdata->maxBodySize)
+		{
+			userdata->tooLarge = true;
+			return 0;
+		}
+	}
+	auto& budget = *userdata->budget;
+	if (userdata->sink.buffered == true)
+	{
+		std::lock_guard lock(budget.m_mutex);
+		if (budget.Charge(*userdata, nmemb) == false)
+			return CURL_WRITEFUNC_PAUSE;
+	}
+	const size_t written = userdata->sink.function(ptr, size, nmemb, userdata->sink.data);
+	if (written == nmemb)
+		userdata->received += static_cast<curl_off_t>(nmemb);
+	else if (userdata->sink.buffered == true)
+	{
+		// the sink refused or paused the write, so it isn't held
+		std::lock_guard lock(budget.m_mutex);
+		if (auto it = budget.m_held.find(userdata->easy); it != budget.m_held.end())
+		{
+			it->second -= nmemb;
+			budget.m_stats.used -= nmemb;
+			if (it->second == 0)
+				budget.m_held.erase(it);
+		}
+	}
+	return written;
+}
\ No newline at end of file
@@ -2,48 +2,86 @@
 
 #include <chrono>
 #include <functional>
+#include <mutex>
 
-using cma::Multi;
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
-Multi::Multi(const asio::any_io_executor& executor) noexcept
-	: m_executor(executor), m_timer(executor), m_strand(executor),
+using cma::BasicMulti;
+
+template<typename ThreadingPolicy>
+BasicMulti<ThreadingPolicy>::BasicMulti(const asio::any_io_executor& executor) noexcept
+	: m_executor(executor), m_timer(executor), m_keepWarmTimer(executor),
+	m_serializer(ThreadingPolicy::MakeSerializer(executor)),
 	m_nativeHandle(curl_multi_init(), curl_multi_cleanup)
 {
 	// set the timer function and data
-	SetOption(CURLMoption::CURLMOPT_TIMERFUNCTION, &Multi::TimerCallback);
+	SetOption(CURLMoption::CURLMOPT_TIMERFUNCTION, &BasicMulti::TimerCallback);
 	SetOption(CURLMoption::CURLMOPT_TIMERDATA, this);
 	// also set the socket function and data
-	SetOption(CURLMoption::CURLMOPT_SOCKETFUNCTION, &Multi::SocketCallback);
+	SetOption(CURLMoption::CURLMOPT_SOCKETFUNCTION, &BasicMulti::SocketCallback);
 	SetOption(CURLMoption::CURLMOPT_SOCKETDATA, this);
 }
 
-size_t Multi::Cancel(asio::error_code& ec, CURLMcode error) noexcept
+template<typename ThreadingPolicy>
+size_t BasicMulti<ThreadingPolicy>::Cancel(asio::error_code& ec, CURLMcode error) noexcept
 {
 	// if there are no operations, there is no need for a timer.
 	m_timer.cancel(ec);
+	// abort the transfers waiting on DNS first, since a lookup that
+	// finishes in the meantime submits its transfer
+	std::unordered_map<CURL*, PerformHandlerBase*> lookups;
+	{
+		std::lock_guard lock(m_lookups->mutex);
+		lookups.swap(m_lookups->handlers);
+	}
+	for (auto& [easyHandle, handler] : lookups)
+	{
+		std::unique_ptr<PerformHandlerBase> performHandler(handler);
+		Release(*performHandler);
+		performHandler->Complete(asio::error::operation_aborted, true);
+	}
+	// abort the submissions that haven't been added yet
+	size_t submissions = 0;
+	for (auto handler = m_submissions.PopAll(); handler != nullptr; ++submissions)
+	{
+		std::unique_ptr<PerformHandlerBase> performHandler(handler);
+		handler = m_submissions.Next(handler);
+		Release(*performHandler);
+		performHandler->Complete(asio::error::operation_aborted, true);
+	}
+	// the handles are removed here, but each completion is posted
+	// in case the handler tries to cancel itself
 	for (auto& handler : m_easyHandlerMap)
 	{
-		// post each completion in case the handler tries to cancel itself
-		asio::post(m_executor, [handler = std::move(handler.second)]
-			{
-				handler->Complete(asio::error::operation_aborted);
-			});
+		Release(*handler.second);
+		handler.second->Complete(asio::error::operation_aborted, true);
 	}
+	const size_t canceled = lookups.size() + submissions + m_easyHandlerMap.size();
 	m_easyHandlerMap.clear();
-	return m_easyHandlerMap.size();
+	return canceled;
 }
 
-bool Multi::Cancel(const Easy& easy, CURLMcode error) noexcept
+template<typename ThreadingPolicy>
+bool BasicMulti<ThreadingPolicy>::Cancel(const Easy& easy, CURLMcode error) noexcept
 {
 	// ensure that the easy handle is already being handled
 	auto handlerIt = m_easyHandlerMap.find(easy.GetNativeHandle());
 	if (handlerIt == m_easyHandlerMap.end())
-		return false;
-	// post each completion in case the handler tries to cancel itself
-	asio::post(m_executor, [handler = std::move(handlerIt->second)]
-		{
-			handler->Complete(asio::error::operation_aborted);
-		});
+	{
+		// it may still be waiting on DNS
+		auto handler = TakeLookup(*m_lookups, easy.GetNativeHandle());
+		if (handler == nullptr)
+			return false;
+		Release(*handler);
+		handler->Complete(asio::error::operation_aborted, true);
+		return true;
+	}
+	// the handle is removed here, but the completion is posted
+	// in case the handler tries to cancel itself
+	Release(*handlerIt->second);
+	handlerIt->second->Complete(asio::error::operation_aborted, true);
 	// delete the handler
 	m_easyHandlerMap.erase(handlerIt);
 	// if there are no more operations, there is no need for a timer
@@ -55,71 +93,375 @@ bool Multi::Cancel(const Easy& easy, CURLMcode error) noexcept
 	return true;
 }
 
-int Multi::CloseSocketCb(Multi* userp, curl_socket_t item) noexcept
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::Cancel(std::vector<CURL*> easyHandles)
+{
+	asio::dispatch(m_executor, Serialized([this, alive = m_alive,
+		easyHandles = std::move(easyHandles)]
+		{
+			if (*alive == false)
+				return;
+			DrainSubmissions();
+			for (CURL* easyHandle : easyHandles)
+			{
+				// the handler is moved out first, in case it cancels others
+				std::unique_ptr<PerformHandlerBase> handler;
+				if (auto handlerIt = m_easyHandlerMap.find(easyHandle);
+					handlerIt != m_easyHandlerMap.end())
+				{
+					handler = std::move(handlerIt->second);
+					m_easyHandlerMap.erase(handlerIt);
+				}
+				else
+				{
+					// it may still be waiting on DNS
+					handler = TakeLookup(*m_lookups, easyHandle);
+					if (handler == nullptr)
+						continue;
+				}
+				Release(*handler);
+				// this is already a hop into the strand, so each handler
+				// doesn't need a post of its own
+				handler->Complete(asio::error::operation_aborted, false);
+			}
+			if (m_easyHandlerMap.empty() == true)
+			{
+				asio::error_code ignored;
+				m_timer.cancel(ignored);
+			}
+		}));
+}
+
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::Unpause(const Easy& easy)
+{
+	asio::post(m_executor, Serialized([this, alive = m_alive,
+		easyHandle = easy.GetNativeHandle()]
+		{
+			// it may have finished or been canceled in the meantime
+			if (*alive == false || m_easyHandlerMap.contains(easyHandle) == false)
+				return;
+			// buffered data may be written right away, from in here
+			curl_easy_pause(easyHandle, CURLPAUSE_CONT);
+		}));
+}
+
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::WaitConnection(const Easy& easy, asio::socket_base::wait_type type,
+	std::function<void(const error_code&)> handler)
+{
+	// the connection's socket was opened through us, so it can be waited on
+	curl_socket_t s = CURL_SOCKET_BAD;
+	auto socketIt = m_easySocketMap.end();
+	if (m_connections.contains(easy.GetNativeHandle()) == true && curl_easy_getinfo(
+		easy.GetNativeHandle(), CURLINFO_ACTIVESOCKET, &s) == CURLE_OK)
+		socketIt = m_easySocketMap.find(s);
+	if (socketIt == m_easySocketMap.end())
+		return asio::post(m_executor, Serialized([handler = std::move(handler)]
+			{
+				handler(asio::error::not_connected);
+			}));
+	socketIt->second.socket.async_wait(type, Serialized(std::move(handler)));
+}
+
+template<typename ThreadingPolicy>
+bool BasicMulti<ThreadingPolicy>::Disconnect(const Easy& easy) noexcept
+{
+	if (m_connections.erase(easy.GetNativeHandle()) == 0)
+		return false;
+	// cURL closes a connect only connection once its handle is removed,
+	// which closes the socket and aborts its waits
+	curl_multi_remove_handle(GetNativeHandle(), easy.GetNativeHandle());
+	return true;
+}
+
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::KeepWarm(std::vector<std::string> origins,
+	size_t minConnections, std::chrono::milliseconds interval)
+{
+	asio::dispatch(m_executor, Serialized([this, origins = std::move(origins),
+		minConnections, interval]() mutable
+		{
+			m_keepWarmOrigins = std::move(origins);
+			m_keepWarmConnections = minConnections;
+			m_keepWarmInterval = interval;
+			ArmKeepWarm();
+		}));
+}
+
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::StopKeepWarm()
+{
+	asio::dispatch(m_executor, Serialized([this]
+		{
+			m_keepWarmOrigins.clear();
+			m_keepWarmTimer.cancel();
+		}));
+}
+
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::ArmKeepWarm()
+{
+	if (m_keepWarmOrigins.empty() == true)
+		return;
+	m_keepWarmTimer.expires_after(m_keepWarmInterval);
+	m_keepWarmTimer.async_wait(Serialized([this, alive = m_alive](const asio::error_code& ec)
+		{
+			// canceled, or the multi handle is gone
+			if (ec || *alive == false || m_keepWarmOrigins.empty() == true)
+				return;
+			// the next interval starts once this round is done, so a slow
+			// origin never has two rounds open at once
+			StartPrewarm(m_keepWarmOrigins, m_keepWarmConnections, [this, alive]
+				(const error_code&, size_t)
+				{
+					if (*alive == true)
+						asio::dispatch(m_executor, Serialized([this, alive]
+							{
+								if (*alive == true)
+									ArmKeepWarm();
+							}));
+				});
+		}));
+}
+
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::StartPrewarm(const std::vector<std::string>& origins,
+	size_t connectionsPerHost, std::function<void(const error_code&, size_t)> handler)
+{
+	struct State
+	{
+		std::vector<Easy> easies;
+		std::mutex mutex;
+		size_t remaining = 0;
+		size_t connected = 0;
+		error_code error;
+		std::function<void(const error_code&, size_t)> handler;
+	};
+	auto state = std::make_shared<State>();
+	state->easies.resize(origins.size() * connectionsPerHost);
+	state->remaining = state->easies.size();
+	state->handler = std::move(handler);
+	if (state->remaining == 0)
+		return asio::post(m_executor, [state]
+			{
+				state->handler({}, 0);
+			});
+	for (size_t i = 0; i < state->easies.size(); ++i)
+	{
+		auto& easy = state->easies[i];
+		easy.SetURL(origins[i / connectionsPerHost].c_str());
+		easy.SetBuffer(Easy::NullBuffer{});
+		easy.SetOption(CURLoption::CURLOPT_NOSIGNAL, 1L);
+		if (m_prewarmPrototype)
+			m_prewarmPrototype(easy);
+		// a HEAD request is the cheapest transfer whose connection is
+		// put back in the cache
+		easy.SetOption(CURLoption::CURLOPT_NOBODY, 1L);
+		AsyncPerform(easy, [state, &easy](const error_code& ec)
+			{
+				long connects = 0;
+				easy.GetInfo(CURLINFO_NUM_CONNECTS, connects);
+				std::unique_lock lock(state->mutex);
+				state->connected += static_cast<size_t>(connects);
+				if (ec && !state->error)
+					state->error = ec;
+				if (--state->remaining != 0)
+					return;
+				lock.unlock();
+				state->handler(state->error, state->connected);
+			});
+	}
+}
+
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::Submit(PerformHandlerBase* handler)
+{
+	if constexpr (ThreadingPolicy::InlineSubmission == true)
+	{
+		// we're already on the only thread that touches cURL. a failure
+		// is posted, so the handler isn't called by the initiation
+		std::unique_ptr<PerformHandlerBase> performHandler(handler);
+		if (auto res = AddSubmission(performHandler); res != CURLM_OK)
+		{
+			Release(*performHandler);
+			performHandler->Complete(res, true);
+		}
+	}
+	else
+	{
+		// only the first submission of a batch needs to wake the strand.
+		// the rest are picked up by the same drain
+		if (m_submissions.Push(handler) == true)
+			asio::post(m_executor, Serialized([this, alive = m_alive]
+				{
+					// the multi handle may be gone by the time it runs
+					if (*alive == false)
+						return;
+					DrainSubmissions();
+				}));
+	}
+}
+
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::Resume(BasicMulti* multi,
+	std::shared_ptr<PendingLookups> lookups, asio::any_io_executor executor,
+	CURL* easyHandle, const std::function<void()>& pin)
+{
+	{
+		// once it's canceled, the easy handle may be gone. holding the
+		// lock keeps a cancel from slipping in while it's pinned
+		std::lock_guard lock(lookups->mutex);
+		if (lookups->handlers.contains(easyHandle) == false)
+			return;
+		pin();
+	}
+	// lookups finish on the resolver's thread, so hop back to the executor,
+	// which is the only place a single threaded multi can be submitted to
+	asio::dispatch(executor, [multi, lookups = std::move(lookups), easyHandle]
+		{
+			// the lock is held until it's queued, so the multi handle's
+			// destructor either cancels it here or finds it in the queue
+			std::lock_guard lock(lookups->mutex);
+			auto it = lookups->handlers.find(easyHandle);
+			if (it == lookups->handlers.end())
+				return;
+			auto handler = it->second;
+			lookups->handlers.erase(it);
+			multi->Submit(handler);
+		});
+}
+
+template<typename ThreadingPolicy>
+std::unique_ptr<cma::Detail::PerformHandlerBase> BasicMulti<ThreadingPolicy>::TakeLookup(
+	PendingLookups& lookups, CURL* easyHandle) noexcept
+{
+	std::lock_guard lock(lookups.mutex);
+	auto it = lookups.handlers.find(easyHandle);
+	if (it == lookups.handlers.end())
+		return nullptr;
+	std::unique_ptr<PerformHandlerBase> handler(it->second);
+	lookups.handlers.erase(it);
+	return handler;
+}
+
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::DrainSubmissions() noexcept
+{
+	for (auto handler = m_submissions.PopAll(); handler != nullptr;)
+	{
+		std::unique_ptr<PerformHandlerBase> performHandler(handler);
+		handler = m_submissions.Next(handler);
+		if (auto res = AddSubmission(performHandler); res != CURLM_OK)
+		{
+			Release(*performHandler);
+			performHandler->Complete(res, false);
+		}
+	}
+}
+
+template<typename ThreadingPolicy>
+CURLMcode BasicMulti<ThreadingPolicy>::AddSubmission(
+	std::unique_ptr<PerformHandlerBase>& performHandler) noexcept
+{
+	performHandler->Trace(TracePhase::StrandPost);
+	CURL* easy = performHandler->GetEasyHandle();
+	// set the open and close socket functions. this allows
+	// us to make them asio sockets for async functionality
+	curl_easy_setopt(easy, CURLOPT_OPENSOCKETFUNCTION, &BasicMulti::OpenSocketCb);
+	curl_easy_setopt(easy, CURLOPT_OPENSOCKETDATA, this);
+	curl_easy_setopt(easy, CURLOPT_CLOSESOCKETFUNCTION, &BasicMulti::CloseSocketCb);
+	curl_easy_setopt(easy, CURLOPT_CLOSESOCKETDATA, this);
+	// track the socket and initiate the transfer
+	if (auto res = curl_multi_add_handle(GetNativeHandle(), easy); res != CURLM_OK)
+		return res;
+	if (performHandler->Traced() == true)
+	{
+		performHandler->SetAddTime(Tracer::clock::now());
+		performHandler->Trace(TracePhase::AddHandle, performHandler->GetAddTime());
+	}
+	// track the handler
+	m_easyHandlerMap.emplace(easy, std::move(performHandler));
+	return CURLM_OK;
+}
+
+template<typename ThreadingPolicy>
+int BasicMulti<ThreadingPolicy>::CloseSocketCb(BasicMulti* userp, curl_socket_t item) noexcept
 {
 	auto socketIt = userp->m_easySocketMap.find(item);
 	asio::error_code ec;
 	// move the socket out so it doesn't get stuck if the close fails.
 	// delete the old iterator
-	auto socket = std::move(socketIt->second);
+	auto socket = std::move(socketIt->second.socket);
 	userp->m_easySocketMap.erase(socketIt);
-	socket.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+	socket.shutdown(asio::socket_base::shutdown_both, ec);
 	// close the socket
 	return (socket.close(ec)) ? 1 : 0;
 }
 
-curl_socket_t Multi::OpenSocketCb(Multi* userp, curlsocktype purpose,
+template<typename ThreadingPolicy>
+curl_socket_t BasicMulti<ThreadingPolicy>::OpenSocketCb(BasicMulti* userp, curlsocktype purpose,
 	curl_sockaddr* address) noexcept
 {
 	if (purpose != curlsocktype::CURLSOCKTYPE_IPCXN ||
-		address->family != AF_INET)
+		address->socktype != SOCK_STREAM)
 		return CURL_SOCKET_BAD;
 	// open the socket
 	auto sock = socket(address->family, address->socktype, address->protocol);
-	if (sock == -1)
+	if (sock == CURL_SOCKET_BAD)
 		return CURL_SOCKET_BAD;
-	// create and save the socket
-	userp->m_easySocketMap.emplace(sock, asio::ip::tcp::socket(
-		userp->m_executor, asio::ip::tcp::v4(), sock));
+	// create and save the socket. a generic socket lets us wait on
+	// IPv4, IPv6 and unix domain sockets alike
+	asio::error_code ec;
+	asio::generic::stream_protocol::socket asioSocket(userp->m_executor);
+	asioSocket.assign(asio::generic::stream_protocol(
+		address->family, address->protocol), sock, ec);
+	if (ec)
+	{
+#ifdef _WIN32
+		closesocket(sock);
+#else
+		close(sock);
+#endif
+		return CURL_SOCKET_BAD;
+	}
+	userp->m_easySocketMap.emplace(sock, EasySocket{ std::move(asioSocket) });
 	return sock;
 }
 
-int Multi::SocketCallback(CURL* easy, curl_socket_t s, int what,
-	Multi* userp, int* socketp) noexcept
+template<typename ThreadingPolicy>
+int BasicMulti<ThreadingPolicy>::SocketCallback(CURL* easy, curl_socket_t s, int what,
+	BasicMulti* userp, int*) noexcept
 {
-	// delete our last action
-	if (what == CURL_POLL_REMOVE)
-	{
-		delete socketp;
-		return 0;
-	}
-	if (socketp == nullptr)
-	{
-		// allocate our last action
-		socketp = new int(0);
-		curl_multi_assign(userp->GetNativeHandle(), s, socketp);
-	}
 	// find the socket
 	auto socketIt = userp->m_easySocketMap.find(s);
 	if (socketIt == userp->m_easySocketMap.end())
 		return 0;
-	int last = *socketp;
-	*socketp = what;
+	// the last action lives with the socket instead of in socketp,
+	// so waits that are still pending never see it freed
+	if (what == CURL_POLL_REMOVE)
+	{
+		socketIt->second.last = CURL_POLL_NONE;
+		return 0;
+	}
+	int last = socketIt->second.last;
+	socketIt->second.last = what;
 	// do what cURL wants, only if it changed
 	if ((what == CURL_POLL_IN || what == CURL_POLL_INOUT) &&
 		(last != CURL_POLL_IN && last != CURL_POLL_INOUT))
-		socketIt->second.async_read_some(asio::null_buffers(),
-			asio::bind_executor(userp->m_strand, std::bind(&Multi::EventCallback,
-				userp, std::placeholders::_1, s, CURL_POLL_IN, socketp)));
+		socketIt->second.socket.async_wait(asio::socket_base::wait_read,
+			userp->Serialized(std::bind(&BasicMulti::EventCallback,
+				userp, std::placeholders::_1, s, CURL_POLL_IN)));
 	if ((what == CURL_POLL_OUT || what == CURL_POLL_INOUT) &&
 		(last != CURL_POLL_OUT && last != CURL_POLL_INOUT))
-		socketIt->second.async_write_some(asio::null_buffers(),
-			asio::bind_executor(userp->m_strand, std::bind(&Multi::EventCallback,
-				userp, std::placeholders::_1, s, CURL_POLL_OUT, socketp)));
+		socketIt->second.socket.async_wait(asio::socket_base::wait_write,
+			userp->Serialized(std::bind(&BasicMulti::EventCallback,
+				userp, std::placeholders::_1, s, CURL_POLL_OUT)));
 	return 0;
 }
 
-int Multi::TimerCallback(CURLM* multi, long timeout_ms, Multi* userp) noexcept
+template<typename ThreadingPolicy>
+int BasicMulti<ThreadingPolicy>::TimerCallback(CURLM* multi, long timeout_ms, BasicMulti* userp) noexcept
 {
 	if (timeout_ms == -1)
 	{
@@ -131,8 +473,8 @@ int Multi::TimerCallback(CURLM* multi, long timeout_ms, Multi* userp) noexcept
 	{
 		// start the timer
 		userp->m_timer.expires_from_now(std::chrono::milliseconds(timeout_ms));
-		userp->m_timer.async_wait(asio::bind_executor(
-			userp->m_strand, [userp] (const asio::error_code& ec)
+		userp->m_timer.async_wait(userp->Serialized(
+			[userp] (const asio::error_code& ec)
 			{
 				if (ec)
 					return;
@@ -151,7 +493,40 @@ int Multi::TimerCallback(CURLM* multi, long timeout_ms, Multi* userp) noexcept
 	return 0;
 }
 
-void Multi::CheckTransfers() noexcept
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::Release(PerformHandlerBase& handler) noexcept
+{
+	if (m_endpointSelector != nullptr)
+		m_endpointSelector->Release(handler.GetEasyHandle());
+	if (m_circuitBreaker != nullptr)
+		m_circuitBreaker->Release(handler.GetEasyHandle());
+	if (m_redirectCache != nullptr)
+		m_redirectCache->Release(handler.GetEasyHandle());
+	if (m_memoryBudget != nullptr)
+		m_memoryBudget->Release(handler.GetEasyHandle());
+}
+
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::TraceDone(PerformHandlerBase& handler) noexcept
+{
+	const auto now = Tracer::clock::now();
+	// cURL measures these from the start of the transfer, which is
+	// as close to the time we added the handle as we can get
+	curl_off_t connectTime = 0;
+	curl_off_t firstByteTime = 0;
+	if (curl_easy_getinfo(handler.GetEasyHandle(), CURLINFO_CONNECT_TIME_T,
+		&connectTime) == CURLE_OK && connectTime > 0)
+		handler.Trace(TracePhase::Connect, handler.GetAddTime() +
+			std::chrono::microseconds(connectTime));
+	if (curl_easy_getinfo(handler.GetEasyHandle(), CURLINFO_STARTTRANSFER_TIME_T,
+		&firstByteTime) == CURLE_OK && firstByteTime > 0)
+		handler.Trace(TracePhase::FirstByte, handler.GetAddTime() +
+			std::chrono::microseconds(firstByteTime));
+	handler.Trace(TracePhase::Done, now);
+}
+
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::CheckTransfers() noexcept
 {
 	int msgs_in_queue = 0;
 	while (CURLMsg* msg = curl_multi_info_read(GetNativeHandle(), &msgs_in_queue))
@@ -168,19 +543,41 @@ void Multi::CheckTransfers() noexcept
 		// remove it from the handler map. the deleter
 		// will also remove the handle from multi
 		m_easyHandlerMap.erase(handlerIt);
+		if (handler->Traced() == true)
+			TraceDone(*handler);
+		// a body aborted by its limit is reported as too large rather
+		// than as a failed write
+		CURLcode result = msg->data.result;
+		if (m_memoryBudget != nullptr)
+			result = m_memoryBudget->Record(msg->easy_handle, result);
+		if (m_endpointSelector != nullptr)
+			m_endpointSelector->Record(msg->easy_handle, result);
+		if (m_circuitBreaker != nullptr)
+			m_circuitBreaker->Record(msg->easy_handle, result);
+		if (m_redirectCache != nullptr)
+			m_redirectCache->Record(msg->easy_handle, result);
+		// a connection is left in the multi handle until it is disconnected
+		if (handler->KeepsConnection() == true && result == CURLE_OK)
+			m_connections.insert(msg->easy_handle);
 		// a descriptor is done. call its handler
-		handler->Complete(msg->data.result);
+		handler->Complete(result, false);
 	}
 }
 
-void Multi::EventCallback(const asio::error_code& ec, curl_socket_t s,
-	int what, int* last) noexcept
+template<typename ThreadingPolicy>
+void BasicMulti<ThreadingPolicy>::EventCallback(const asio::error_code& ec, curl_socket_t s,
+	int what) noexcept
 {
+	// a closed socket aborts its waits. its descriptor may already be
+	// reused, and the multi handle may even be gone, so touch nothing
+	if (ec == asio::error::operation_aborted)
+		return;
 	// make sure it's a socket that hasn't bene closed
-	if (m_easySocketMap.find(s) == m_easySocketMap.end())
+	auto socketIt = m_easySocketMap.find(s);
+	if (socketIt == m_easySocketMap.end())
 		return;
 	// if the action changed, let curl handle it
-	if (what != *last && *last != CURL_POLL_INOUT)
+	if (what != socketIt->second.last && socketIt->second.last != CURL_POLL_INOUT)
 		return;
 	int still_running = 0;
 	asio::error_code ignored;
@@ -194,22 +591,26 @@ void Multi::EventCallback(const asio::error_code& ec, curl_socket_t s,
 	}
 	// check for completed transfers
 	CheckTransfers();
-	// we have no reason to continue if there are none running
-	if (still_running == 0)
+	// we have no reason to continue if there are none running. the
+	// handlers may have just added more, so still_running is stale
+	if (m_easyHandlerMap.empty() == true)
 		m_timer.cancel(ignored);
 	// if the socket still exists and the mission remainds
 	// unchanged, keep it up
-	auto socketIt = m_easySocketMap.find(s);	
+	socketIt = m_easySocketMap.find(s);
 	if (!ec && socketIt != m_easySocketMap.end() &&
-		(what == *last || *last == CURL_POLL_INOUT))
+		(what == socketIt->second.last || socketIt->second.last == CURL_POLL_INOUT))
 	{
 		if (what == CURL_POLL_IN)
-			socketIt->second.async_read_some(asio::null_buffers(),
-				asio::bind_executor(m_strand, std::bind(&Multi::EventCallback,
-					this, std::placeholders::_1, s, what, last)));
+			socketIt->second.socket.async_wait(asio::socket_base::wait_read,
+				Serialized(std::bind(&BasicMulti::EventCallback,
+					this, std::placeholders::_1, s, what)));
 		else if (what == CURL_POLL_OUT)
-			socketIt->second.async_write_some(asio::null_buffers(),
-				asio::bind_executor(m_strand, std::bind(&Multi::EventCallback,
-					this, std::placeholders::_1, s, what, last)));
+			socketIt->second.socket.async_wait(asio::socket_base::wait_write,
+				Serialized(std::bind(&BasicMulti::EventCallback,
+					this, std::placeholders::_1, s, what)));
 	}
-}
\ No newline at end of file
+}
+
+template class cma::BasicMulti<cma::ThreadSafe>;
+template class cma::BasicMulti<cma::SingleThreaded>;
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include <curl-multi-asio/NdjsonSplitter.h>
+
+#include <cstring>
+
+using cma::NdjsonSplitter;
+
+NdjsonSplitter::NdjsonSplitter(Handler handler, size_t maxRecordSize) :
+	m_handler(std::move(handler)), m_maxRecordSize(maxRecordSize) {}
+
+bool NdjsonSplitter::Consume(std::string_view chunk)
+{
+	if (m_failed == true)
+		return false;
+	while (chunk.empty() == false)
+	{
+		const auto newline = static_cast<const char*>(std::memchr(chunk.data(), '\n', chunk.size()));
+		const size_t length = (newline != nullptr) ? newline - chunk.data() : chunk.size();
+		if (m_pending.size() + length > m_maxRecordSize)
+		{
+			m_failed = true;
+			return false;
+		}
+		if (newline == nullptr)
+		{
+			// the rest of the record comes with a later chunk
+			m_pending.append(chunk);
+			return true;
+		}
+		if (m_pending.empty() == true)
+		{
+			if (Deliver(chunk.substr(0, length)) == false)
+				return false;
+		}
+		else
+		{
+			m_pending.append(chunk.data(), length);
+			const bool delivered = Deliver(m_pending);
+			m_pending.clear();
+			if (delivered == false)
+				return false;
+		}
+		chunk.remove_prefix(length + 1);
+	}
+	return true;
+}
+
+bool NdjsonSplitter::Finish()
+{
+	if (m_failed == true)
+		return false;
+	const bool delivered = Deliver(m_pending);
+	m_pending.clear();
+	return delivered;
+}
+
+void NdjsonSplitter::Reset() noexcept
+{
+	m_pending.clear();
+	m_records = 0;
+	m_failed = false;
+}
+
+bool NdjsonSplitter::Deliver(std::string_view record)
+{
+	if (record.empty() == false && record.back() == '\r')
+		record.remove_suffix(1);
+	if (record.empty() == true)
+		return true;
+	++m_records;
+	if (m_handler(record) == false)
+		m_failed = true;
+	return m_failed == false;
+}
\ No newline at end of file
@@ -0,0 +1,268 @@
+#include <curl-multi-asio/RedirectCache.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <string_view>
+
+using cma::RedirectCache;
+using cma::RedirectCacheStats;
+
+RedirectCache::RedirectCache(RedirectCacheOptions options) :
+	m_options(options) {}
+
+std::optional<std::string> RedirectCache::Lookup(const std::string& url)
+{
+	std::lock_guard lock(m_mutex);
+	return Resolve(url, clock::now());
+}
+
+void RedirectCache::Prepare(Easy& easy)
+{
+	// cURL would only have followed the redirect itself for a transfer
+	// that follows redirects, and would have kept the method only for one
+	// that is safe to repeat
+	const auto method = easy.GetMethod();
+	const bool follows = easy.GetFollowLocation() == true &&
+		(method == "GET" || method == "HEAD");
+	std::optional<std::string> target;
+	if (follows == true)
+	{
+		std::lock_guard lock(m_mutex);
+		target = Resolve(easy.GetURL(), clock::now());
+		// cURL drops credentials and custom headers on its way to another
+		// host, and a rewritten URL would take them along
+		if (target.has_value() == true && Origin(*target) != Origin(easy.GetURL()))
+			target.reset();
+		if (target.has_value() == true)
+			++m_stats.hits;
+		else
+			++m_stats.misses;
+	}
+	auto watch = std::make_unique<Watch>();
+	watch->learn = follows;
+	if (target.has_value() == true)
+	{
+		// the handle gets its own URL back once the transfer is done
+		watch->easy = &easy;
+		watch->original = easy.GetURL();
+		easy.SetURL(target->c_str());
+	}
+	watch->url = easy.GetURL();
+	watch->sink = easy.GetHeaderSink();
+	watch->forward = watch->sink.function;
+	// cURL hands the headers to the write callback if only their data
+	// is set, and that is fwrite by default
+	if (watch->forward == nullptr && watch->sink.data != nullptr)
+	{
+		watch->forward = easy.GetSink().function;
+		if (watch->forward == nullptr)
+			watch->forward = [](char* buffer, size_t size, size_t nitems, void* file)
+			{
+				return std::fwrite(buffer, size, nitems, static_cast<FILE*>(file));
+			};
+	}
+	// straight to cURL, so the easy handle still remembers its own callback
+	curl_easy_setopt(easy.GetNativeHandle(), CURLOPT_HEADERFUNCTION, &RedirectCache::HeaderCb);
+	curl_easy_setopt(easy.GetNativeHandle(), CURLOPT_HEADERDATA, watch.get());
+	std::lock_guard lock(m_mutex);
+	m_watches[easy.GetNativeHandle()] = std::move(watch);
+}
+
+void RedirectCache::Record(CURL* easy, CURLcode) noexcept
+{
+	auto watch = Unwatch(easy);
+	if (watch == nullptr || watch->learn == false)
+		return;
+	const auto now = clock::now();
+	// a redirect is learned even if the transfer failed after it, since
+	// the server already answered for the old URL
+	std::string current = watch->url;
+	for (const auto& hop : watch->hops)
+	{
+		if (hop.status < 300 || hop.status >= 400 || hop.location.empty() == true)
+			continue;
+		auto next = Join(current, hop.location);
+		if (next.empty() == true)
+			return;
+		// only the redirects that could be applied are kept
+		if ((hop.status == 301 || hop.status == 308) && Origin(current) == Origin(next))
+		{
+			std::lock_guard lock(m_mutex);
+			Store(current, next, now);
+		}
+		current = std::move(next);
+	}
+}
+
+void RedirectCache::Release(CURL* easy) noexcept
+{
+	Unwatch(easy);
+}
+
+void RedirectCache::Erase(const std::string& url)
+{
+	std::lock_guard lock(m_mutex);
+	auto it = m_entries.find(url);
+	if (it == m_entries.end())
+		return;
+	m_lru.erase(it->second.lru);
+	m_entries.erase(it);
+}
+
+void RedirectCache::Clear()
+{
+	std::lock_guard lock(m_mutex);
+	m_entries.clear();
+	m_lru.clear();
+}
+
+RedirectCacheStats RedirectCache::GetStats() const noexcept
+{
+	std::lock_guard lock(m_mutex);
+	auto stats = m_stats;
+	stats.entries = m_entries.size();
+	return stats;
+}
+
+std::optional<std::string> RedirectCache::Resolve(const std::string& url, clock::time_point now)
+{
+	const std::string* current = &url;
+	for (size_t hop = 0; hop < m_options.maxHops; ++hop)
+	{
+		auto it = m_entries.find(*current);
+		if (it == m_entries.end())
+			break;
+		if (it->second.expiresAt <= now)
+		{
+			m_lru.erase(it->second.lru);
+			m_entries.erase(it);
+			++m_stats.evictions;
+			break;
+		}
+		// the entry just got used
+		m_lru.splice(m_lru.end(), m_lru, it->second.lru);
+		current = &it->second.target;
+	}
+	if (current == &url)
+		return std::nullopt;
+	return *current;
+}
+
+void RedirectCache::Store(const std::string& url, std::string target, clock::time_point now)
+{
+	if (url == target || m_options.maxEntries == 0)
+		return;
+	++m_stats.learned;
+	if (auto it = m_entries.find(url); it != m_entries.end())
+	{
+		it->second.target = std::move(target);
+		it->second.expiresAt = now + m_options.ttl;
+		m_lru.splice(m_lru.end(), m_lru, it->second.lru);
+		return;
+	}
+	while (m_entries.size() >= m_options.maxEntries)
+	{
+		m_entries.erase(m_lru.front());
+		m_lru.pop_front();
+		++m_stats.evictions;
+	}
+	auto lru = m_lru.insert(m_lru.end(), url);
+	m_entries.emplace(url, Entry{ std::move(target), now + m_options.ttl, lru });
+}
+
+std::unique_ptr<RedirectCache::Watch> RedirectCache::Unwatch(CURL* easy) noexcept
+{
+	std::unique_ptr<Watch> watch;
+	{
+		std::lock_guard lock(m_mutex);
+		auto it = m_watches.find(easy);
+		if (it == m_watches.end())
+			return nullptr;
+		watch = std::move(it->second);
+		m_watches.erase(it);
+	}
+	// the easy handle may be reused without the cache
+	curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, watch->sink.function);
+	curl_easy_setopt(easy, CURLOPT_HEADERDATA, watch->sink.data);
+	if (watch->easy != nullptr)
+		watch->easy->SetURL(watch->original.c_str());
+	return watch;
+}
+
+std::string RedirectCache::Join(const std::string& base, const std::string& location)
+{
+	std::unique_ptr<CURLU, decltype(&curl_url_cleanup)> url(curl_url(), curl_url_cleanup);
+	// a relative location is resolved against the URL that is already set
+	if (url == nullptr || curl_url_set(url.get(), CURLUPART_URL, base.c_str(), 0) != CURLUE_OK ||
+		curl_url_set(url.get(), CURLUPART_URL, location.c_str(), 0) != CURLUE_OK)
+		return {};
+	char* joined = nullptr;
+	if (curl_url_get(url.get(), CURLUPART_URL, &joined, 0) != CURLUE_OK)
+		return {};
+	std::string result(joined);
+	curl_free(joined);
+	return result;
+}
+
+std::string RedirectCache::Origin(const std::string& url)
+{
+	std::unique_ptr<CURLU, decltype(&curl_url_cleanup)> parsed(curl_url(), curl_url_cleanup);
+	if (parsed == nullptr || curl_url_set(parsed.get(), CURLUPART_URL, url.c_str(), 0) != CURLUE_OK)
+		return {};
+	std::string result;
+	for (const auto part : { CURLUPART_SCHEME, CURLUPART_HOST, CURLUPART_PORT })
+	{
+		char* value = nullptr;
+		if (curl_url_get(parsed.get(), part, &value, CURLU_DEFAULT_PORT) != CURLUE_OK)
+			return {};
+		result += value;
+		result += '|';
+		curl_free(value);
+	}
+	std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c)
+	{
+		return static_cast<char>(std::tolower(c));
+	});
+	return result;
+}
+
+size_t RedirectCache::HeaderCb(char* buffer, size_t size, size_t nitems, Watch* userdata) noexcept
+{
+	const size_t length = size * nitems;
+	std::string_view line(buffer, length);
+	while (line.empty() == false && std::isspace(static_cast<unsigned char>(line.back())))
+		line.remove_suffix(1);
+	try
+	{
+		constexpr std::string_view name = "location:";
+		if (line.starts_with("HTTP/") == true)
+		{
+			// each response starts with a status line. informational ones
+			// are followed by the real response, so they aren't hops
+			const auto space = line.find(' ');
+			long status = 0;
+			if (space != std::string_view::npos)
+				std::from_chars(line.data() + space + 1, line.data() + line.size(), status);
+			if (status >= 200)
+				userdata->hops.push_back(Hop{ status, {} });
+		}
+		else if (userdata->hops.empty() == false && line.size() >= name.size() &&
+			std::equal(name.begin(), name.end(), line.begin(), [](char a, char b)
+			{
+				return a == std::tolower(static_cast<unsigned char>(b));
+			}) == true)
+		{
+			auto value = line.substr(name.size());
+			while (value.empty() == false && std::isspace(static_cast<unsigned char>(value.front())))
+				value.remove_prefix(1);
+			userdata->hops.back().location = value;
+		}
+	}
+	catch (...) {}
+	// the transfer's own callback still sees every header
+	if (userdata->forward != nullptr)
+		return userdata->forward(buffer, size, nitems, userdata->sink.data);
+	return length;
+}
\ No newline at end of file
@@ -0,0 +1,636 @@
+#include <curl-multi-asio/ResponseCache.h>
+#include <curl-multi-asio/Detail/BinaryIO.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using cma::ResponseCache;
+using cma::ResponseCacheStats;
+
+namespace
+{
+	// an entry file is a header, with the URL it belongs to in case two
+	// URLs hash alike, followed by the body
+	constexpr std::string_view s_magic = "CMAR1";
+	constexpr std::string_view s_extension = ".entry";
+
+	/// @brief A body that was transferred into memory
+	struct HeapBody
+	{
+		std::string data;
+		std::string_view view;
+	};
+	/// @brief A file mapped into memory, read only
+	class MappedFile
+	{
+	public:
+		/// @brief Maps a file
+		/// @param path The path
+		/// @return The mapping, or nullptr if it couldn't be mapped
+		static std::shared_ptr<MappedFile> Open(const std::string& path) noexcept
+		{
+#ifdef _WIN32
+			const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ,
+				FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+				return nullptr;
+			LARGE_INTEGER size{};
+			if (GetFileSizeEx(file, &size) == FALSE || size.QuadPart == 0)
+			{
+				CloseHandle(file);
+				return nullptr;
+			}
+			const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			CloseHandle(file);
+			if (mapping == nullptr)
+				return nullptr;
+			// the view keeps the mapping alive on its own
+			void* address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+			if (address == nullptr)
+				return nullptr;
+			return std::shared_ptr<MappedFile>(new MappedFile(address,
+				static_cast<size_t>(size.QuadPart)));
+#else
+			const int fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return nullptr;
+			struct stat info{};
+			if (fstat(fd, &info) != 0 || info.st_size == 0)
+			{
+				close(fd);
+				return nullptr;
+			}
+			// the mapping keeps the file alive on its own. files are only
+			// ever replaced, never truncated, so it can't shrink under it
+			void* address = mmap(nullptr, static_cast<size_t>(info.st_size),
+				PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if (address == MAP_FAILED)
+				return nullptr;
+			return std::shared_ptr<MappedFile>(new MappedFile(address,
+				static_cast<size_t>(info.st_size)));
+#endif
+		}
+		~MappedFile() noexcept
+		{
+#ifdef _WIN32
+			UnmapViewOfFile(m_address);
+#else
+			munmap(m_address, m_size);
+#endif
+		}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/// @brief The whole file
+		std::string_view contents;
+		/// @brief The part of it that is the body
+		std::string_view body;
+	private:
+		MappedFile(void* address, size_t size) noexcept :
+			contents(static_cast<const char*>(address), size),
+			m_address(address), m_size(size) {}
+
+		void* m_address;
+		size_t m_size;
+	};
+
+	/// @param value The value
+	/// @return The value without surrounding whitespace
+	std::string_view Trim(std::string_view value) noexcept
+	{
+		while (value.empty() == false && std::isspace(static_cast<unsigned char>(value.front())))
+			value.remove_prefix(1);
+		while (value.empty() == false && std::isspace(static_cast<unsigned char>(value.back())))
+			value.remove_suffix(1);
+		return value;
+	}
+	/// @param value The value
+	/// @param prefix The prefix, in lower case
+	/// @return Whether the value starts with the prefix, ignoring case
+	bool StartsWith(std::string_view value, std::string_view prefix) noexcept
+	{
+		if (value.size() < prefix.size())
+			return false;
+		for (size_t i = 0; i < prefix.size(); ++i)
+			if (std::tolower(static_cast<unsigned char>(value[i])) != prefix[i])
+				return false;
+		return true;
+	}
+	/// @param value The value
+	/// @return The value as seconds, or nothing if it isn't a number
+	std::optional<int64_t> ParseSeconds(std::string_view value) noexcept
+	{
+		value = Trim(value);
+		int64_t seconds = 0;
+		const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), seconds);
+		if (ec != std::errc{} || end == value.data())
+			return std::nullopt;
+		return std::max<int64_t>(seconds, 0);
+	}
+
+	/// @param easy The easy handle
+	/// @param name The header name
+	/// @return Every value of the header in the last response, joined the
+	/// way HTTP folds them, or empty if there is none
+	std::string GetHeader(CURL* easy, const char* name)
+	{
+		std::string value;
+#if LIBCURL_VERSION_NUM >= 0x075400
+		curl_header* header = nullptr;
+		for (size_t index = 0; curl_easy_header(easy, name, index,
+			CURLH_HEADER, -1, &header) == CURLHE_OK; ++index)
+		{
+			if (value.empty() == false)
+				value += ", ";
+			value += header->value;
+			if (index + 1 >= header->amount)
+				break;
+		}
+#endif
+		return value;
+	}
+
+	/// @brief What a response says about caching it
+	struct Policy
+	{
+		bool store = true;
+		// how much longer it is fresh, if it says
+		std::optional<std::chrono::seconds> lifetime;
+		std::string etag;
+		std::string lastModified;
+	};
+	/// @param easy The easy handle, after the transfer
+	/// @return What the last response says about caching it
+	Policy GetPolicy(CURL* easy)
+	{
+		Policy policy;
+		bool noCache = false;
+		std::optional<int64_t> maxAge;
+		const auto cacheControl = GetHeader(easy, "Cache-Control");
+		std::string_view directives(cacheControl);
+		while (directives.empty() == false)
+		{
+			const auto comma = directives.find(',');
+			const auto directive = Trim(directives.substr(0, comma));
+			directives.remove_prefix((comma == std::string_view::npos) ?
+				directives.size() : comma + 1);
+			if (StartsWith(directive, "no-store") == true)
+				policy.store = false;
+			else if (StartsWith(directive, "no-cache") == true)
+				noCache = true;
+			else if (StartsWith(directive, "max-age=") == true)
+				maxAge = ParseSeconds(directive.substr(8));
+		}
+		// no-cache may be stored, but must be revalidated every time
+		if (noCache == true)
+			policy.lifetime = std::chrono::seconds(0);
+		else if (maxAge.has_value() == true)
+		{
+			// the time it spent in caches on the way counts against it
+			const auto age = ParseSeconds(GetHeader(easy, "Age")).value_or(0);
+			policy.lifetime = std::chrono::seconds(std::max<int64_t>(*maxAge - age, 0));
+		}
+		else if (const auto expires = GetHeader(easy, "Expires"); expires.empty() == false)
+		{
+			// Expires is relative to the server's clock, so it is measured
+			// from Date. anything unparsable, like 0, is already expired
+			const auto expiresAt = curl_getdate(expires.c_str(), nullptr);
+			auto date = curl_getdate(GetHeader(easy, "Date").c_str(), nullptr);
+			if (date < 0)
+				date = std::time(nullptr);
+			policy.lifetime = std::chrono::seconds((expiresAt < 0) ? 0 :
+				std::max<int64_t>(expiresAt - date, 0));
+		}
+		if (GetHeader(easy, "Vary").find('*') != std::string::npos)
+			policy.store = false;
+		policy.etag = GetHeader(easy, "ETag");
+		policy.lastModified = GetHeader(easy, "Last-Modified");
+		return policy;
+	}
+}
+
+cma::ResponseBody cma::MakeResponseBody(std::string data)
+{
+	auto holder = std::make_shared<HeapBody>();
+	holder->data = std::move(data);
+	holder->view = holder->data;
+	return ResponseBody(holder, &holder->view);
+}
+
+ResponseCache::ResponseCache(ResponseCacheOptions options) :
+	m_options(std::move(options))
+{
+	m_shards.resize(std::max<size_t>(m_options.shards, 1));
+	for (auto& shard : m_shards)
+		shard = std::make_unique<Shard>();
+	if (m_options.diskPath.empty() == true)
+		return;
+	// a tier that can't be created is left out, rather than failing
+	std::error_code ec;
+	std::filesystem::create_directories(m_options.diskPath, ec);
+	if (ec)
+	{
+		m_options.diskPath.clear();
+		return;
+	}
+	std::lock_guard lock(m_diskMutex);
+	TrimDisk(0);
+}
+
+ResponseCache::~ResponseCache() noexcept
+{
+	*m_alive = false;
+}
+
+cma::ResponseBody ResponseCache::Find(const std::string& url)
+{
+	bool fromDisk = false;
+	const auto entry = Lookup(url, fromDisk);
+	if (entry == nullptr || clock::now() >= entry->expiresAt)
+		return nullptr;
+	return entry->body;
+}
+
+void ResponseCache::Erase(const std::string& url)
+{
+	auto& shard = GetShard(url);
+	{
+		std::lock_guard lock(shard.mutex);
+		if (auto it = shard.index.find(url); it != shard.index.end())
+		{
+			shard.bytes -= it->second->second->body->size();
+			shard.lru.erase(it->second);
+			shard.index.erase(it);
+		}
+	}
+	if (m_options.diskPath.empty() == false)
+	{
+		std::error_code ec;
+		std::filesystem::remove(GetDiskFile(url), ec);
+	}
+}
+
+void ResponseCache::Clear() noexcept
+{
+	for (auto& shard : m_shards)
+	{
+		std::lock_guard lock(shard->mutex);
+		shard->index.clear();
+		shard->lru.clear();
+		shard->bytes = 0;
+	}
+}
+
+ResponseCacheStats ResponseCache::GetStats() const noexcept
+{
+	ResponseCacheStats total;
+	for (const auto& shard : m_shards)
+	{
+		std::lock_guard lock(shard->mutex);
+		total.hits += shard->stats.hits;
+		total.diskHits += shard->stats.diskHits;
+		total.revalidations += shard->stats.revalidations;
+		total.misses += shard->stats.misses;
+		total.stores += shard->stats.stores;
+		total.evictions += shard->stats.evictions;
+		total.bytes += shard->bytes;
+	}
+	return total;
+}
+
+std::shared_ptr<ResponseCache::Fetch> ResponseCache::Begin(Easy& easy)
+{
+	auto fetch = std::make_shared<Fetch>();
+	fetch->url = easy.GetURL();
+	bool fromDisk = false;
+	auto entry = Lookup(fetch->url, fromDisk);
+	if (entry != nullptr && clock::now() < entry->expiresAt)
+	{
+		auto& shard = GetShard(fetch->url);
+		{
+			std::lock_guard lock(shard.mutex);
+			++shard.stats.hits;
+			if (fromDisk == true)
+				++shard.stats.diskHits;
+		}
+		fetch->response = CachedResponse{ 200, entry->body, true, false };
+		return fetch;
+	}
+	if (entry != nullptr && (entry->etag.empty() == false ||
+		entry->lastModified.empty() == false))
+	{
+		// the conditional headers go on a copy of the handle's own list, so
+		// they can be taken off again
+		auto append = [&fetch](const std::string& header)
+		{
+			const auto result = curl_slist_append(fetch->headers.get(), header.c_str());
+			if (result == nullptr)
+				return;
+			fetch->headers.release();
+			fetch->headers.reset(result);
+		};
+		for (auto node = easy.GetHeaderList(); node != nullptr; node = node->next)
+			append(node->data);
+		if (entry->etag.empty() == false)
+			append("If-None-Match: " + entry->etag);
+		if (entry->lastModified.empty() == false)
+			append("If-Modified-Since: " + entry->lastModified);
+		easy.SetOption(CURLoption::CURLOPT_HTTPHEADER, fetch->headers.get());
+		fetch->stale = std::move(entry);
+		fetch->fromDisk = fromDisk;
+	}
+	easy.SetBuffer(fetch->body);
+	return fetch;
+}
+
+cma::error_code ResponseCache::Finish(Easy& easy, Fetch& fetch, error_code ec, bool alive)
+{
+	// the handle gets its own headers back, and stops writing into the
+	// fetch, which is about to go away
+	if (fetch.headers != nullptr)
+		easy.SetOption(CURLoption::CURLOPT_HTTPHEADER, easy.GetHeaderList());
+	easy.SetBuffer(Easy::NullBuffer{});
+	// the body is moved into the response or dropped, so a memory budget
+	// gets it back
+	easy.ReleaseCharge();
+	if (ec)
+		return ec;
+	long status = 0;
+	easy.GetInfo(CURLINFO_RESPONSE_CODE, status);
+	const auto now = clock::now();
+	if (status == 304 && fetch.stale != nullptr)
+	{
+		fetch.response = CachedResponse{ 200, fetch.stale->body, false, true };
+		// the shards went away with the cache
+		if (alive == false)
+			return {};
+		auto& shard = GetShard(fetch.url);
+		{
+			std::lock_guard lock(shard.mutex);
+			++shard.stats.revalidations;
+			if (fetch.fromDisk == true)
+				++shard.stats.diskHits;
+		}
+		auto policy = GetPolicy(easy.GetNativeHandle());
+		if (policy.store == false)
+		{
+			Erase(fetch.url);
+			return {};
+		}
+		// the 304 refreshes what it confirmed, and what it doesn't say is
+		// kept from the original response
+		auto entry = std::make_shared<Entry>(*fetch.stale);
+		entry->lifetime = policy.lifetime.value_or(fetch.stale->lifetime);
+		entry->expiresAt = now + entry->lifetime;
+		if (policy.etag.empty() == false)
+			entry->etag = std::move(policy.etag);
+		if (policy.lastModified.empty() == false)
+			entry->lastModified = std::move(policy.lastModified);
+		// rewriting an entry that is revalidated every time gains nothing
+		const bool persist = entry->lifetime.count() > 0;
+		Store(fetch.url, std::move(entry), persist);
+		return {};
+	}
+	fetch.response = CachedResponse{ status, MakeResponseBody(std::move(fetch.body)), false, false };
+	if (alive == false)
+		return {};
+	auto& shard = GetShard(fetch.url);
+	{
+		std::lock_guard lock(shard.mutex);
+		++shard.stats.misses;
+	}
+	if (status != 200 || fetch.response.body->size() > m_options.maxEntryBytes)
+		return {};
+#if LIBCURL_VERSION_NUM >= 0x074800
+	// the cache is keyed by URL, so only GETs are stored
+	char* method = nullptr;
+	if (easy.GetInfo(CURLINFO_EFFECTIVE_METHOD, method) || method == nullptr ||
+		std::strcmp(method, "GET") != 0)
+		return {};
+#endif
+	auto policy = GetPolicy(easy.GetNativeHandle());
+	const auto lifetime = policy.lifetime.value_or(std::chrono::seconds(0));
+	// without a lifetime or a validator, it could never be used again
+	if (policy.store == false || (lifetime.count() == 0 &&
+		policy.etag.empty() == true && policy.lastModified.empty() == true))
+		return {};
+	auto entry = std::make_shared<Entry>();
+	entry->body = fetch.response.body;
+	entry->lifetime = lifetime;
+	entry->expiresAt = now + lifetime;
+	entry->etag = std::move(policy.etag);
+	entry->lastModified = std::move(policy.lastModified);
+	Store(fetch.url, std::move(entry), true);
+	std::lock_guard lock(shard.mutex);
+	++shard.stats.stores;
+	return {};
+}
+
+ResponseCache::Shard& ResponseCache::GetShard(const std::string& url) noexcept
+{
+	return *m_shards[std::hash<std::string>{}(url) % m_shards.size()];
+}
+
+std::shared_ptr<const ResponseCache::Entry> ResponseCache::Lookup(const std::string& url,
+	bool& fromDisk)
+{
+	auto& shard = GetShard(url);
+	{
+		std::lock_guard lock(shard.mutex);
+		if (auto it = shard.index.find(url); it != shard.index.end())
+		{
+			shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+			return it->second->second;
+		}
+	}
+	if (m_options.diskPath.empty() == true)
+		return nullptr;
+	auto entry = LoadFromDisk(url);
+	if (entry == nullptr)
+		return nullptr;
+	// it comes back into memory, still mapped
+	fromDisk = true;
+	Store(url, entry, false);
+	return entry;
+}
+
+void ResponseCache::Store(const std::string& url, std::shared_ptr<const Entry> entry,
+	bool persist)
+{
+	const size_t size = entry->body->size();
+	if (size > m_options.maxEntryBytes)
+		return;
+	if (persist == true && m_options.diskPath.empty() == false)
+		SaveToDisk(url, *entry);
+	auto& shard = GetShard(url);
+	std::lock_guard lock(shard.mutex);
+	if (auto it = shard.index.find(url); it != shard.index.end())
+	{
+		shard.bytes -= it->second->second->body->size();
+		shard.lru.erase(it->second);
+		shard.index.erase(it);
+	}
+	Evict(shard, size);
+	shard.lru.emplace_front(url, std::move(entry));
+	shard.index.emplace(shard.lru.front().first, shard.lru.begin());
+	shard.bytes += size;
+}
+
+void ResponseCache::Evict(Shard& shard, size_t incoming) noexcept
+{
+	const size_t budget = m_options.maxBytes / m_shards.size();
+	while (shard.lru.empty() == false && shard.bytes + incoming > budget)
+	{
+		auto& [url, entry] = shard.lru.back();
+		shard.bytes -= entry->body->size();
+		shard.index.erase(url);
+		shard.lru.pop_back();
+		++shard.stats.evictions;
+	}
+}
+
+std::string ResponseCache::GetDiskFile(const std::string& url) const
+{
+	// FNV-1a, which unlike std::hash names the file the same way in
+	// every build
+	uint64_t hash = 14695981039346656037ull;
+	for (const char c : url)
+	{
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ull;
+	}
+	char name[17]{};
+	std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+	return (std::filesystem::path(m_options.diskPath) /
+		(name + std::string(s_extension))).string();
+}
+
+std::shared_ptr<const ResponseCache::Entry> ResponseCache::LoadFromDisk(
+	const std::string& url) const
+{
+	auto file = MappedFile::Open(GetDiskFile(url));
+	if (file == nullptr)
+		return nullptr;
+	std::string_view in = file->contents;
+	std::string_view storedUrl;
+	std::string_view etag;
+	std::string_view lastModified;
+	int64_t expiresAt = 0;
+	int64_t lifetime = 0;
+	uint64_t size = 0;
+	if (in.substr(0, s_magic.size()) != s_magic)
+		return nullptr;
+	in.remove_prefix(s_magic.size());
+	if (Detail::ReadBytes<uint32_t>(in, storedUrl) == false || storedUrl != url ||
+		Detail::ReadValue(in, expiresAt) == false ||
+		Detail::ReadValue(in, lifetime) == false ||
+		Detail::ReadBytes<uint16_t>(in, etag) == false ||
+		Detail::ReadBytes<uint16_t>(in, lastModified) == false ||
+		Detail::ReadValue(in, size) == false || in.size() != size)
+		return nullptr;
+	file->body = in;
+	auto entry = std::make_shared<Entry>();
+	entry->body = ResponseBody(file, &file->body);
+	entry->expiresAt = clock::from_time_t(static_cast<std::time_t>(expiresAt));
+	entry->lifetime = std::chrono::seconds(lifetime);
+	entry->etag = etag;
+	entry->lastModified = lastModified;
+	return entry;
+}
+
+void ResponseCache::SaveToDisk(const std::string& url, const Entry& entry)
+{
+	std::string header(s_magic);
+	Detail::WriteBytes<uint32_t>(header, url.data(), url.size());
+	Detail::WriteValue(header, static_cast<int64_t>(clock::to_time_t(entry.expiresAt)));
+	Detail::WriteValue(header, static_cast<int64_t>(entry.lifetime.count()));
+	Detail::WriteBytes<uint16_t>(header, entry.etag.data(), entry.etag.size());
+	Detail::WriteBytes<uint16_t>(header, entry.lastModified.data(), entry.lastModified.size());
+	Detail::WriteValue(header, static_cast<uint64_t>(entry.body->size()));
+	const size_t size = header.size() + entry.body->size();
+	{
+		std::lock_guard lock(m_diskMutex);
+		if (m_diskBytes + size > m_options.maxDiskBytes)
+			TrimDisk(size);
+		if (size > m_options.maxDiskBytes)
+			return;
+		m_diskBytes += size;
+	}
+	// files are written beside their final name and swapped in, so a
+	// mapping of the old file, or a crash, never sees a partial one
+	const auto path = GetDiskFile(url);
+	const auto temporary = path + '.' + std::to_string(m_tempCounter++) + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (file.is_open() == false)
+			return;
+		file.write(header.data(), static_cast<std::streamsize>(header.size()));
+		file.write(entry.body->data(), static_cast<std::streamsize>(entry.body->size()));
+		if (file.good() == false)
+		{
+			file.close();
+			std::error_code ec;
+			std::filesystem::remove(temporary, ec);
+			return;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(temporary, path, ec);
+	if (ec)
+		std::filesystem::remove(temporary, ec);
+}
+
+void ResponseCache::TrimDisk(size_t incoming)
+{
+	struct File
+	{
+		std::filesystem::file_time_type written;
+		std::filesystem::path path;
+		size_t size;
+	};
+	std::vector<File> files;
+	size_t total = 0;
+	std::error_code ec;
+	for (const auto& item : std::filesystem::directory_iterator(m_options.diskPath, ec))
+	{
+		if (item.path().extension() != s_extension)
+			continue;
+		std::error_code itemEc;
+		const auto size = static_cast<size_t>(item.file_size(itemEc));
+		const auto written = item.last_write_time(itemEc);
+		if (itemEc)
+			continue;
+		files.push_back(File{ written, item.path(), size });
+		total += size;
+	}
+	// the oldest writes go first. mapped files stay readable until unmapped
+	std::sort(files.begin(), files.end(), [](const File& a, const File& b)
+		{
+			return a.written < b.written;
+		});
+	for (const auto& file : files)
+	{
+		if (total + incoming <= m_options.maxDiskBytes)
+			break;
+		if (std::filesystem::remove(file.path, ec) == true)
+			total -= file.size;
+	}
+	m_diskBytes = total;
+}
\ No newline at end of file
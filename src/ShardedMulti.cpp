@@ -0,0 +1,148 @@
+#include <curl-multi-asio/ShardedMulti.h>
+
+#include <algorithm>
+
+using cma::ShardedMulti;
+using cma::ShardMetrics;
+
+ShardedMulti::ShardedMulti(const std::vector<asio::any_io_executor>& executors,
+	size_t maxInFlight) : m_maxInFlight(std::max<size_t>(maxInFlight, 1))
+{
+	m_shards.reserve(executors.size());
+	for (const auto& executor : executors)
+		m_shards.emplace_back(std::make_unique<Shard>(executor, m_shards.size()));
+}
+
+ShardedMulti::~ShardedMulti() noexcept
+{
+	// completions aborted by the cancel may run on other threads right
+	// away, and must already see the shards as gone
+	*m_alive = false;
+	asio::error_code ignored;
+	Cancel(ignored);
+}
+
+size_t ShardedMulti::Cancel(asio::error_code& ec) noexcept
+{
+	ec.clear();
+	size_t canceled = 0;
+	for (auto& shard : m_shards)
+	{
+		std::deque<std::unique_ptr<TransferBase>> queue;
+		{
+			std::lock_guard lock(shard->mutex);
+			queue.swap(shard->queue);
+		}
+		for (auto& transfer : queue)
+			transfer->Abort(asio::error::operation_aborted, shard->multi.GetExecutor());
+		canceled += queue.size();
+		asio::error_code multiEc;
+		canceled += shard->multi.Cancel(multiEc);
+		if (multiEc)
+			ec = multiEc;
+	}
+	return canceled;
+}
+
+ShardMetrics ShardedMulti::GetMetrics(size_t shard) const noexcept
+{
+	auto& state = *m_shards[shard];
+	ShardMetrics metrics;
+	{
+		std::lock_guard lock(state.mutex);
+		metrics.queued = state.queue.size();
+		metrics.inFlight = state.inFlight;
+	}
+	metrics.submitted = state.submitted.load(std::memory_order_relaxed);
+	metrics.started = state.started.load(std::memory_order_relaxed);
+	metrics.completed = state.completed.load(std::memory_order_relaxed);
+	metrics.stolen = state.stolen.load(std::memory_order_relaxed);
+	metrics.stolenFrom = state.stolenFrom.load(std::memory_order_relaxed);
+	return metrics;
+}
+
+void ShardedMulti::Submit(Shard& shard, std::unique_ptr<TransferBase> transfer)
+{
+	bool full = false;
+	{
+		std::lock_guard lock(shard.mutex);
+		shard.queue.emplace_back(std::move(transfer));
+		full = shard.inFlight >= m_maxInFlight;
+	}
+	shard.submitted.fetch_add(1, std::memory_order_relaxed);
+	if (full == false)
+		return Pump(shard);
+	// the home shard is busy. wake up a shard that has room, which
+	// will steal the transfer
+	for (auto& other : m_shards)
+	{
+		bool idle = false;
+		{
+			std::lock_guard lock(other->mutex);
+			idle = other->inFlight < m_maxInFlight && other->queue.empty();
+		}
+		if (idle == true)
+			return Pump(*other);
+	}
+}
+
+void ShardedMulti::Pump(Shard& shard)
+{
+	while (true)
+	{
+		std::unique_ptr<TransferBase> transfer;
+		{
+			// reserve the capacity before looking for work, so that two
+			// threads pumping the same shard can't overfill it
+			std::lock_guard lock(shard.mutex);
+			if (shard.inFlight >= m_maxInFlight)
+				return;
+			++shard.inFlight;
+			if (shard.queue.empty() == false)
+			{
+				transfer = std::move(shard.queue.front());
+				shard.queue.pop_front();
+			}
+		}
+		if (transfer == nullptr)
+			transfer = Steal(shard);
+		if (transfer == nullptr)
+		{
+			std::lock_guard lock(shard.mutex);
+			--shard.inFlight;
+			return;
+		}
+		shard.started.fetch_add(1, std::memory_order_relaxed);
+		transfer->Start(*this, shard);
+	}
+}
+
+std::unique_ptr<ShardedMulti::TransferBase> ShardedMulti::Steal(Shard& thief)
+{
+	// start after the thief, so that every shard isn't robbed by
+	// the first one
+	for (size_t i = 1; i < m_shards.size(); ++i)
+	{
+		auto& victim = *m_shards[(thief.index + i) % m_shards.size()];
+		std::unique_ptr<TransferBase> transfer;
+		{
+			std::lock_guard lock(victim.mutex);
+			if (victim.queue.empty() == true)
+				continue;
+			// the owner takes from the front, so take from the back
+			transfer = std::move(victim.queue.back());
+			victim.queue.pop_back();
+		}
+		victim.stolenFrom.fetch_add(1, std::memory_order_relaxed);
+		thief.stolen.fetch_add(1, std::memory_order_relaxed);
+		return transfer;
+	}
+	return nullptr;
+}
+
+void ShardedMulti::Finish(Shard& shard) noexcept
+{
+	shard.completed.fetch_add(1, std::memory_order_relaxed);
+	std::lock_guard lock(shard.mutex);
+	--shard.inFlight;
+}
\ No newline at end of file
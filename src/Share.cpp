@@ -0,0 +1,235 @@
+#include <curl-multi-asio/Share.h>
+#include <curl-multi-asio/Detail/BinaryIO.h>
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+using cma::Share;
+
+namespace
+{
+	// the session file is a header followed by records of a key, a salted
+	// hash of the key, the session and its expiry
+	constexpr std::string_view s_magic = "CMAS1";
+}
+
+Share::Share(ShareOptions options) noexcept :
+	m_options(std::move(options)),
+	m_nativeHandle(curl_share_init(), curl_share_cleanup)
+{
+	if (m_nativeHandle == nullptr)
+		return;
+	curl_share_setopt(GetNativeHandle(), CURLSHOPT_LOCKFUNC, &Share::LockCb);
+	curl_share_setopt(GetNativeHandle(), CURLSHOPT_UNLOCKFUNC, &Share::UnlockCb);
+	curl_share_setopt(GetNativeHandle(), CURLSHOPT_USERDATA, this);
+	curl_share_setopt(GetNativeHandle(), CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(GetNativeHandle(), CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x075800
+	curl_share_setopt(GetNativeHandle(), CURLSHOPT_SHARE, CURL_LOCK_DATA_HSTS);
+#endif
+	// HSTS is read through the exporter, and sessions are imported
+	// through it
+	m_exporter = MakeExporter();
+	LoadHsts();
+	LoadSessions();
+}
+
+Share::Share(const asio::any_io_executor& executor, ShareOptions options) noexcept :
+	Share(std::move(options))
+{
+	if (m_options.saveInterval.count() <= 0 || m_options.path.empty() == true)
+		return;
+	m_saveTimer.emplace(executor);
+	std::lock_guard lock(m_saveGuard->mutex);
+	ArmSave();
+}
+
+Share::~Share() noexcept
+{
+	{
+		// timers aren't thread safe, so the timer is only touched under
+		// the guard, and a save in progress finishes first
+		std::lock_guard lock(m_saveGuard->mutex);
+		m_saveGuard->alive = false;
+		if (m_saveTimer.has_value() == true)
+			m_saveTimer->cancel();
+	}
+	Save();
+	// the exporter writes HSTS when it is destroyed, and it must be gone
+	// before the share is cleaned up
+	m_exporter.reset();
+}
+
+cma::error_code Share::Attach(Easy& easy) noexcept
+{
+	if (const auto res = easy.SetOption(CURLoption::CURLOPT_SHARE, GetNativeHandle()); res)
+		return res;
+#if LIBCURL_VERSION_NUM >= 0x074a00
+	return easy.SetOption(CURLoption::CURLOPT_HSTS_CTRL, static_cast<long>(CURLHSTS_ENABLE));
+#else
+	return {};
+#endif
+}
+
+cma::error_code Share::AttachAltSvc(Easy& easy) noexcept
+{
+#if LIBCURL_VERSION_NUM >= 0x074000
+	if (m_options.path.empty() == true)
+		return {};
+	if (const auto res = easy.SetOption(CURLoption::CURLOPT_ALTSVC_CTRL,
+		static_cast<long>(CURLALTSVC_H1 | CURLALTSVC_H2 | CURLALTSVC_H3)); res)
+		return res;
+	return easy.SetOption(CURLoption::CURLOPT_ALTSVC, (m_options.path + ".altsvc").c_str());
+#else
+	return {};
+#endif
+}
+
+cma::error_code Share::Save() noexcept
+{
+	if (m_nativeHandle == nullptr || m_options.path.empty() == true)
+		return {};
+	std::lock_guard lock(m_saveMutex);
+	// cURL only writes HSTS when an easy handle is destroyed, so the
+	// exporter is replaced
+	m_exporter.reset();
+	m_exporter = MakeExporter();
+	return SaveSessions();
+}
+
+void Share::LockCb(CURL*, curl_lock_data data, curl_lock_access, Share* userp) noexcept
+{
+	userp->m_locks[data].lock();
+}
+
+void Share::UnlockCb(CURL*, curl_lock_data data, Share* userp) noexcept
+{
+	userp->m_locks[data].unlock();
+}
+
+std::unique_ptr<cma::Easy> Share::MakeExporter() noexcept
+{
+	auto exporter = std::make_unique<Easy>();
+	// the share must come first, so that HSTS is loaded into it
+	exporter->SetOption(CURLoption::CURLOPT_SHARE, GetNativeHandle());
+#if LIBCURL_VERSION_NUM >= 0x074a00
+	if (m_options.path.empty() == false)
+		exporter->SetOption(CURLoption::CURLOPT_HSTS, (m_options.path + ".hsts").c_str());
+#endif
+	return exporter;
+}
+
+void Share::LoadHsts() noexcept
+{
+#if LIBCURL_VERSION_NUM >= 0x074a00
+	if (m_options.path.empty() == true)
+		return;
+	// cURL only reads the file when a transfer starts, so one is started
+	// that stops at the unknown scheme, before it touches the network
+	m_exporter->SetURL("cma-hsts-load://localhost/");
+	curl_easy_perform(m_exporter->GetNativeHandle());
+#endif
+}
+
+cma::error_code Share::LoadSessions() noexcept
+{
+	if (m_options.path.empty() == true)
+		return {};
+	std::ifstream file(m_options.path, std::ios::binary);
+	// a first start has nothing to load
+	if (file.is_open() == false)
+		return {};
+	const std::string contents((std::istreambuf_iterator<char>(file)),
+		std::istreambuf_iterator<char>());
+	std::string_view in(contents);
+	if (in.substr(0, s_magic.size()) != s_magic)
+		return asio::error::invalid_argument;
+	in.remove_prefix(s_magic.size());
+	size_t count = 0;
+	const auto now = static_cast<int64_t>(std::time(nullptr));
+	while (in.empty() == false)
+	{
+		std::string_view key;
+		std::string_view shmac;
+		std::string_view data;
+		int64_t validUntil = 0;
+		if (Detail::ReadBytes<uint16_t>(in, key) == false ||
+			Detail::ReadBytes<uint16_t>(in, shmac) == false ||
+			Detail::ReadBytes<uint32_t>(in, data) == false ||
+			Detail::ReadValue(in, validUntil) == false)
+			return asio::error::invalid_argument;
+		if (validUntil != 0 && validUntil <= now)
+			continue;
+#if LIBCURL_VERSION_NUM >= 0x080c00
+		const std::string keyString(key);
+		if (curl_easy_ssls_import(m_exporter->GetNativeHandle(),
+			key.empty() ? nullptr : keyString.c_str(),
+			reinterpret_cast<const unsigned char*>(shmac.data()), shmac.size(),
+			reinterpret_cast<const unsigned char*>(data.data()), data.size()) == CURLE_OK)
+			++count;
+#endif
+	}
+	m_sessionCount = count;
+	return {};
+}
+
+cma::error_code Share::SaveSessions() noexcept
+{
+	std::string out(s_magic);
+	size_t count = 0;
+#if LIBCURL_VERSION_NUM >= 0x080c00
+	struct Export
+	{
+		std::string& out;
+		size_t& count;
+	} state{ out, count };
+	// a cURL that can't export sessions still gets an empty file, so a
+	// stale one isn't loaded
+	curl_easy_ssls_export(m_exporter->GetNativeHandle(), [](CURL*, void* userptr,
+		const char* sessionKey, const unsigned char* shmac, size_t shmacLen,
+		const unsigned char* sdata, size_t sdataLen, curl_off_t validUntil,
+		int, const char*, size_t) -> CURLcode
+		{
+			auto& state = *static_cast<Export*>(userptr);
+			Detail::WriteBytes<uint16_t>(state.out, sessionKey,
+				(sessionKey != nullptr) ? std::char_traits<char>::length(sessionKey) : 0);
+			Detail::WriteBytes<uint16_t>(state.out, shmac, shmacLen);
+			Detail::WriteBytes<uint32_t>(state.out, sdata, sdataLen);
+			Detail::WriteValue(state.out, static_cast<int64_t>(validUntil));
+			++state.count;
+			return CURLE_OK;
+		}, &state);
+#endif
+	// write it next to the old file, and swap them, so that a crash
+	// mid-save never leaves a torn file behind
+	const auto temporary = m_options.path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (file.is_open() == false)
+			return asio::error::access_denied;
+		file.write(out.data(), static_cast<std::streamsize>(out.size()));
+		if (file.good() == false)
+			return asio::error::no_buffer_space;
+	}
+	if (std::rename(temporary.c_str(), m_options.path.c_str()) != 0)
+		return asio::error::access_denied;
+	m_sessionCount = count;
+	return {};
+}
+
+void Share::ArmSave()
+{
+	m_saveTimer->expires_after(m_options.saveInterval);
+	m_saveTimer->async_wait([this, guard = m_saveGuard](const asio::error_code& ec)
+		{
+			std::lock_guard lock(guard->mutex);
+			if (ec || guard->alive == false)
+				return;
+			Save();
+			ArmSave();
+		});
+}
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include <curl-multi-asio/SingleFlight.h>
+
+#include <algorithm>
+#include <cctype>
+
+using cma::SingleFlight;
+using cma::SingleFlightStats;
+
+SingleFlight::SingleFlight(SingleFlightOptions options) :
+	m_options(std::move(options)) {}
+
+SingleFlight::~SingleFlight() noexcept
+{
+	std::vector<Member> members;
+	{
+		std::lock_guard lock(m_state->mutex);
+		m_state->alive = false;
+		for (auto& [key, flight] : m_state->flights)
+			std::move(flight->members.begin(), flight->members.end(),
+				std::back_inserter(members));
+		m_state->flights.clear();
+		m_state->members.clear();
+	}
+	for (auto& member : members)
+		member.waiter(asio::error::operation_aborted, {});
+}
+
+bool SingleFlight::Cancel(const Easy& easy)
+{
+	Member member{};
+	{
+		std::lock_guard lock(m_state->mutex);
+		auto memberIt = m_state->members.find(&easy);
+		if (memberIt == m_state->members.end())
+			return false;
+		auto flight = std::move(memberIt->second);
+		m_state->members.erase(memberIt);
+		auto& members = flight->members;
+		auto it = std::find_if(members.begin(), members.end(), [&easy](const Member& member)
+			{
+				return member.easy == &easy;
+			});
+		member = std::move(*it);
+		members.erase(it);
+		++m_state->stats.abandoned;
+		// nobody wants the response anymore. a new request for the key
+		// starts over instead of joining a transfer that is going away
+		if (members.empty() == true)
+		{
+			m_state->flights.erase(flight->key);
+			flight->abandoned = true;
+		}
+	}
+	member.waiter(asio::error::operation_aborted, {});
+	return true;
+}
+
+SingleFlightStats SingleFlight::GetStats() const noexcept
+{
+	std::lock_guard lock(m_state->mutex);
+	auto stats = m_state->stats;
+	stats.inFlight = m_state->flights.size();
+	return stats;
+}
+
+std::string SingleFlight::MakeKey(std::string_view method, const Easy& easy) const
+{
+	std::string key(method);
+	key += ' ';
+	key += easy.GetURL();
+	for (auto node = easy.GetHeaderList(); node != nullptr; node = node->next)
+	{
+		const std::string_view header(node->data);
+		const auto name = header.substr(0, header.find(':'));
+		const bool keyed = std::any_of(m_options.keyHeaders.begin(), m_options.keyHeaders.end(),
+			[name](const std::string& keyHeader)
+			{
+				return std::equal(name.begin(), name.end(), keyHeader.begin(), keyHeader.end(),
+					[](char a, char b) { return std::tolower(a) == std::tolower(b); });
+			});
+		// a newline can't appear in a URL or a header, so keys can't run
+		// into each other
+		if (keyed == true)
+		{
+			key += '\n';
+			key += header;
+		}
+	}
+	return key;
+}
+
+std::shared_ptr<SingleFlight::Flight> SingleFlight::Join(std::string key,
+	const Easy& easy, Waiter waiter)
+{
+	std::lock_guard lock(m_state->mutex);
+	if (auto it = m_state->flights.find(key); it != m_state->flights.end())
+	{
+		it->second->members.push_back(Member{ &easy, std::move(waiter), false });
+		m_state->members[&easy] = it->second;
+		++m_state->stats.joined;
+		return nullptr;
+	}
+	auto flight = std::make_shared<Flight>();
+	flight->key = std::move(key);
+	// a copy, so that the request that started it can go away
+	flight->easy = std::make_unique<Easy>(easy);
+	flight->easy->SetBuffer(flight->body);
+	flight->easy->SetOption(CURLoption::CURLOPT_XFERINFOFUNCTION, &SingleFlight::ProgressCb);
+	flight->easy->SetOption(CURLoption::CURLOPT_XFERINFODATA, flight.get());
+	flight->easy->SetOption(CURLoption::CURLOPT_NOPROGRESS, 0L);
+	flight->members.push_back(Member{ &easy, std::move(waiter), true });
+	m_state->members[&easy] = flight;
+	m_state->flights.emplace(flight->key, flight);
+	++m_state->stats.flights;
+	return flight;
+}
+
+void SingleFlight::Land(State& state, Flight& flight, const error_code& ec)
+{
+	// nobody else can free the copy's charge with a memory budget, and
+	// its body is about to be moved into the response or dropped
+	flight.easy->ReleaseCharge();
+	std::vector<Member> members;
+	{
+		std::lock_guard lock(state.mutex);
+		// the destructor already aborted every request
+		if (state.alive == false)
+			return;
+		// an abandoned flight was already taken out
+		if (auto it = state.flights.find(flight.key); it != state.flights.end() &&
+			it->second.get() == &flight)
+			state.flights.erase(it);
+		members.swap(flight.members);
+		for (const auto& member : members)
+			state.members.erase(member.easy);
+		if (flight.abandoned == true && ec)
+			++state.stats.aborted;
+	}
+	if (members.empty() == true)
+		return;
+	FlightResponse response;
+	if (!ec)
+	{
+		flight.easy->GetInfo(CURLINFO_RESPONSE_CODE, response.status);
+		response.body = MakeResponseBody(std::move(flight.body));
+	}
+	for (auto& member : members)
+	{
+		response.joined = member.leader == false;
+		member.waiter(ec, response);
+	}
+}
+
+int SingleFlight::ProgressCb(Flight* clientp, curl_off_t, curl_off_t,
+	curl_off_t, curl_off_t) noexcept
+{
+	return (clientp->abandoned == true) ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include <curl-multi-asio/ThreadedMulti.h>
+
+using cma::ThreadedMulti;
+
+ThreadedMulti::ThreadedMulti(const asio::any_io_executor& executor)
+	: m_executor(executor), m_nativeHandle(curl_multi_init(), curl_multi_cleanup)
+{
+	if (m_nativeHandle != nullptr)
+		m_thread = std::thread(&ThreadedMulti::Run, this);
+}
+
+ThreadedMulti::~ThreadedMulti() noexcept
+{
+	if (m_thread.joinable() == true)
+	{
+		m_stopping = true;
+		curl_multi_wakeup(GetNativeHandle());
+		m_thread.join();
+	}
+	// the thread is gone, so we can finish off what it left behind
+	for (auto& [easy, operation] : m_easyHandlerMap)
+	{
+		curl_multi_remove_handle(GetNativeHandle(), easy);
+		operation->Complete(asio::error::operation_aborted);
+	}
+	m_easyHandlerMap.clear();
+	for (auto operation = m_submissions.PopAll(); operation != nullptr;)
+	{
+		std::unique_ptr<OperationBase> owned(operation);
+		operation = m_submissions.Next(operation);
+		owned->Complete(asio::error::operation_aborted);
+	}
+}
+
+size_t ThreadedMulti::Cancel(asio::error_code& ec, CURLMcode) noexcept
+{
+	ec.clear();
+	const size_t outstanding = m_outstanding;
+	Submit(new (std::nothrow) OperationBase(Command::CancelAll, nullptr));
+	return outstanding;
+}
+
+bool ThreadedMulti::Cancel(const Easy& easy, CURLMcode) noexcept
+{
+	auto operation = new (std::nothrow) OperationBase(Command::Cancel, easy.GetNativeHandle());
+	if (operation == nullptr)
+		return false;
+	Submit(operation);
+	return true;
+}
+
+void ThreadedMulti::Submit(OperationBase* operation) noexcept
+{
+	if (operation == nullptr)
+		return;
+	// only the first submission of a batch needs to wake the thread
+	if (m_submissions.Push(operation) == true)
+		curl_multi_wakeup(GetNativeHandle());
+}
+
+void ThreadedMulti::Run() noexcept
+{
+	while (m_stopping == false)
+	{
+		DrainSubmissions();
+		int still_running = 0;
+		if (auto err = curl_multi_perform(GetNativeHandle(), &still_running);
+			err != CURLMcode::CURLM_OK)
+		{
+			// the handle is broken. fail everything in flight
+			while (m_easyHandlerMap.empty() == false)
+				Finish(m_easyHandlerMap.begin()->first, err);
+		}
+		CheckTransfers();
+		// submissions can't be missed, because a push onto an empty
+		// queue always wakes the poll up
+		if (m_submissions.Empty() == true)
+			curl_multi_poll(GetNativeHandle(), nullptr, 0, 1000, nullptr);
+	}
+}
+
+void ThreadedMulti::DrainSubmissions() noexcept
+{
+	for (auto operation = m_submissions.PopAll(); operation != nullptr;)
+	{
+		std::unique_ptr<OperationBase> owned(operation);
+		operation = m_submissions.Next(operation);
+		switch (owned->GetCommand())
+		{
+		case Command::Perform:
+		{
+			auto easy = owned->GetEasyHandle();
+			// the easy handle may have been used with a Multi before,
+			// which takes over its sockets. we let cURL handle them here
+			curl_easy_setopt(easy, CURLOPT_OPENSOCKETFUNCTION, nullptr);
+			curl_easy_setopt(easy, CURLOPT_OPENSOCKETDATA, nullptr);
+			curl_easy_setopt(easy, CURLOPT_CLOSESOCKETFUNCTION, nullptr);
+			curl_easy_setopt(easy, CURLOPT_CLOSESOCKETDATA, nullptr);
+			if (auto res = curl_multi_add_handle(GetNativeHandle(), easy); res != CURLM_OK)
+			{
+				--m_outstanding;
+				owned->Complete(res);
+				break;
+			}
+			m_easyHandlerMap.emplace(easy, std::move(owned));
+			break;
+		}
+		case Command::Cancel:
+			Finish(owned->GetEasyHandle(), asio::error::operation_aborted);
+			break;
+		case Command::CancelAll:
+			while (m_easyHandlerMap.empty() == false)
+				Finish(m_easyHandlerMap.begin()->first, asio::error::operation_aborted);
+			break;
+		}
+	}
+}
+
+void ThreadedMulti::CheckTransfers() noexcept
+{
+	int msgs_in_queue = 0;
+	while (CURLMsg* msg = curl_multi_info_read(GetNativeHandle(), &msgs_in_queue))
+	{
+		// only pay attention to finished transfers
+		if (msg->msg != CURLMSG::CURLMSG_DONE)
+			continue;
+		Finish(msg->easy_handle, msg->data.result);
+	}
+}
+
+bool ThreadedMulti::Finish(CURL* easy, error_code ec) noexcept
+{
+	auto handlerIt = m_easyHandlerMap.find(easy);
+	if (handlerIt == m_easyHandlerMap.end())
+		return false;
+	auto operation = std::move(handlerIt->second);
+	m_easyHandlerMap.erase(handlerIt);
+	curl_multi_remove_handle(GetNativeHandle(), easy);
+	--m_outstanding;
+	operation->Complete(ec);
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include <curl-multi-asio/Tracer.h>
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+using cma::Tracer;
+
+namespace
+{
+	// names for each phase, and for the span that ends with each phase
+	constexpr const char* s_phaseNames[] = { "submit", "strand_post",
+		"add_handle", "connect", "first_byte", "done", "handler_invoke" };
+	constexpr const char* s_spanNames[] = { "", "queue", "add_handle",
+		"connect", "first_byte", "body", "dispatch" };
+
+	std::atomic<uint64_t> s_nextInstanceId = 1;
+	std::atomic<uint32_t> s_nextThreadId = 1;
+
+	/// @brief The cached ring of the last tracer used on this thread.
+	/// Looking it up is the only thing that isn't wait-free, and only
+	/// the first event on each thread takes the lock
+	struct ThreadCache
+	{
+		uint64_t instanceId = 0;
+		void* ring = nullptr;
+	};
+	thread_local ThreadCache t_cache;
+	thread_local uint32_t t_threadId = s_nextThreadId++;
+}
+
+Tracer::Tracer(double sampleRate, size_t eventsPerThread)
+	: m_sampleRate(sampleRate), m_eventsPerThread(std::max<size_t>(eventsPerThread, 1)),
+	m_instanceId(s_nextInstanceId++), m_epoch(clock::now()) {}
+
+uint64_t Tracer::Sample() noexcept
+{
+	const double rate = GetSampleRate();
+	if (rate <= 0.0)
+		return 0;
+	if (rate < 1.0)
+	{
+		thread_local std::minstd_rand s_rng(static_cast<uint32_t>(
+			std::hash<std::thread::id>{}(std::this_thread::get_id())));
+		if (std::uniform_real_distribution<double>(0.0, 1.0)(s_rng) >= rate)
+			return 0;
+	}
+	return m_nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Tracer::Record(uint64_t id, TracePhase phase, clock::time_point time) noexcept
+{
+	if (id == 0)
+		return;
+	auto ring = GetRing();
+	if (ring == nullptr)
+		return;
+	// we are the only writer, so a relaxed load is enough
+	const auto head = ring->head.load(std::memory_order_relaxed);
+	auto& event = ring->events[head % ring->events.size()];
+	event.id.store(id, std::memory_order_relaxed);
+	event.time.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		time - m_epoch).count(), std::memory_order_relaxed);
+	event.phase.store(static_cast<uint8_t>(phase), std::memory_order_relaxed);
+	// publish the event
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::WriteChromeTrace(std::ostream& os) const
+{
+	struct Snapshot
+	{
+		int64_t time;
+		uint32_t threadId;
+		TracePhase phase;
+	};
+	std::unordered_map<uint64_t, std::vector<Snapshot>> transfers;
+	{
+		std::lock_guard lock(m_ringMutex);
+		for (const auto& ring : m_rings)
+		{
+			const auto head = ring->head.load(std::memory_order_acquire);
+			const auto capacity = ring->events.size();
+			// only the last capacity events are still in the ring
+			const auto first = std::max<uint64_t>(ring->floor.load(std::memory_order_acquire),
+				(head > capacity) ? head - capacity : 0);
+			for (auto i = first; i < head; ++i)
+			{
+				const auto& event = ring->events[i % capacity];
+				transfers[event.id.load(std::memory_order_relaxed)].push_back({
+					event.time.load(std::memory_order_relaxed), ring->threadId,
+					static_cast<TracePhase>(event.phase.load(std::memory_order_relaxed)) });
+			}
+		}
+	}
+	os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	auto writeEvent = [&](const char* name, char type, uint64_t id, const Snapshot& snapshot)
+	{
+		if (first == false)
+			os << ',';
+		first = false;
+		os << "{\"name\":\"" << name << "\",\"cat\":\"transfer\",\"ph\":\"" << type <<
+			"\",\"id\":" << id << ",\"pid\":1,\"tid\":" << snapshot.threadId <<
+			",\"ts\":" << static_cast<double>(snapshot.time) / 1000.0 << '}';
+	};
+	for (auto& [id, events] : transfers)
+	{
+		// the phases may have been recorded on different threads
+		std::sort(events.begin(), events.end(), [](const auto& a, const auto& b)
+			{
+				return a.phase < b.phase;
+			});
+		writeEvent("transfer", 'b', id, events.front());
+		for (size_t i = 1; i < events.size(); ++i)
+		{
+			const auto spanName = s_spanNames[static_cast<size_t>(events[i].phase)];
+			writeEvent(spanName, 'b', id, events[i - 1]);
+			writeEvent(spanName, 'e', id, events[i]);
+		}
+		for (const auto& event : events)
+			writeEvent(s_phaseNames[static_cast<size_t>(event.phase)], 'n', id, event);
+		writeEvent("transfer", 'e', id, events.back());
+	}
+	os << "]}";
+}
+
+void Tracer::Clear() noexcept
+{
+	std::lock_guard lock(m_ringMutex);
+	// the rings are still owned by their threads, which may be writing
+	// to them, so the events are skipped rather than reset
+	for (auto& ring : m_rings)
+		ring->floor.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+Tracer::Ring* Tracer::GetRing() noexcept
+{
+	if (t_cache.instanceId == m_instanceId)
+		return static_cast<Ring*>(t_cache.ring);
+	std::lock_guard lock(m_ringMutex);
+	// this thread may have used a different tracer in the meantime
+	auto ringIt = std::find_if(m_rings.begin(), m_rings.end(), [](const auto& ring)
+		{
+			return ring->threadId == t_threadId;
+		});
+	Ring* ring = nullptr;
+	if (ringIt != m_rings.end())
+		ring = ringIt->get();
+	else
+	{
+		try
+		{
+			ring = m_rings.emplace_back(std::make_unique<Ring>(
+				m_eventsPerThread, t_threadId)).get();
+		}
+		catch (...)
+		{
+			return nullptr;
+		}
+	}
+	t_cache = { m_instanceId, ring };
+	return ring;
+}
\ No newline at end of file
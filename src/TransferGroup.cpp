@@ -0,0 +1,121 @@
+#include <curl-multi-asio/TransferGroup.h>
+
+using cma::BasicTransferGroup;
+
+template<typename ThreadingPolicy>
+BasicTransferGroup<ThreadingPolicy>::BasicTransferGroup(BasicMulti<ThreadingPolicy>& multi,
+	TransferGroupOptions options) :
+	m_state(std::make_shared<State>(multi))
+{
+	m_state->options = options;
+	if (options.deadline.count() <= 0)
+		return;
+	m_state->timer.expires_after(options.deadline);
+	m_state->timer.async_wait([state = m_state](const asio::error_code& ec)
+		{
+			if (ec)
+				return;
+			std::unique_lock lock(state->mutex);
+			state->expired = true;
+			Evaluate(state, lock);
+		});
+}
+
+template<typename ThreadingPolicy>
+BasicTransferGroup<ThreadingPolicy>::~BasicTransferGroup() noexcept
+{
+	std::unique_lock lock(m_state->mutex);
+	if (m_state->done == false)
+		Complete(m_state, lock, asio::error::operation_aborted);
+}
+
+template<typename ThreadingPolicy>
+void BasicTransferGroup<ThreadingPolicy>::Add(Easy& easy)
+{
+	size_t index = 0;
+	{
+		std::lock_guard lock(m_state->mutex);
+		index = m_state->results.size();
+		m_state->results.push_back(TransferResult{ &easy, {}, false });
+	}
+	m_state->multi.AsyncPerform(easy, [state = m_state, index](const error_code& ec)
+		{
+			std::unique_lock lock(state->mutex);
+			// the group already completed, and canceled or gave up on it
+			if (state->done == true)
+				return;
+			auto& result = state->results[index];
+			result.ec = ec;
+			result.finished = true;
+			if (ec)
+			{
+				++state->failed;
+				state->lastError = ec;
+			}
+			else
+				++state->succeeded;
+			Evaluate(state, lock);
+		});
+}
+
+template<typename ThreadingPolicy>
+void BasicTransferGroup<ThreadingPolicy>::Seal(Waiter waiter)
+{
+	std::unique_lock lock(m_state->mutex);
+	m_state->sealed = true;
+	m_state->waiter = std::move(waiter);
+	if (m_state->done == true)
+	{
+		// destroyed groups can't be waited on, so this is a second wait
+		lock.unlock();
+		m_state->waiter(asio::error::already_started, {});
+		return;
+	}
+	Evaluate(m_state, lock);
+}
+
+template<typename ThreadingPolicy>
+void BasicTransferGroup<ThreadingPolicy>::Evaluate(const std::shared_ptr<State>& state,
+	std::unique_lock<std::mutex>& lock)
+{
+	// the outcome isn't known until every transfer has been added
+	if (state->sealed == false)
+		return;
+	const size_t total = state->results.size();
+	const size_t quorum = (state->options.quorum == 0) ? total :
+		std::min(state->options.quorum, total);
+	if (state->succeeded >= quorum)
+		Complete(state, lock, {});
+	else if (state->failed > total - quorum)
+		Complete(state, lock, state->lastError);
+	else if (state->expired == true)
+		Complete(state, lock, asio::error::timed_out);
+}
+
+template<typename ThreadingPolicy>
+void BasicTransferGroup<ThreadingPolicy>::Complete(const std::shared_ptr<State>& state,
+	std::unique_lock<std::mutex>& lock, error_code ec)
+{
+	state->done = true;
+	std::vector<CURL*> stragglers;
+	for (auto& result : state->results)
+	{
+		if (result.finished == true)
+			continue;
+		result.ec = asio::error::operation_aborted;
+		stragglers.push_back(result.easy->GetNativeHandle());
+	}
+	auto results = state->results;
+	auto waiter = std::move(state->waiter);
+	lock.unlock();
+	asio::error_code ignored;
+	state->timer.cancel(ignored);
+	// one hop into the strand for all of them, instead of one each
+	if (stragglers.empty() == false)
+		state->multi.Cancel(std::move(stragglers));
+	if (waiter)
+		waiter(ec, std::move(results));
+}
+
+template class cma::BasicTransferGroup<cma::ThreadSafe>;
+template class cma::BasicTransferGroup<cma::SingleThreaded>;
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include <curl-multi-asio/WebSocket.h>
+
+using cma::BasicWebSocket;
+
+namespace
+{
+	/// @brief The frame type curl_ws_recv hands out, which is only const
+	/// since cURL 8
+	template<typename Function>
+	struct ReceivedFrame;
+	template<typename Frame>
+	struct ReceivedFrame<CURLcode(*)(CURL*, void*, size_t, size_t*, Frame**)>
+	{
+		using type = Frame;
+	};
+}
+
+template<typename ThreadingPolicy>
+BasicWebSocket<ThreadingPolicy>::BasicWebSocket(BasicMulti<ThreadingPolicy>& multi) :
+	m_state(std::make_shared<State>(multi)) {}
+
+template<typename ThreadingPolicy>
+BasicWebSocket<ThreadingPolicy>::~BasicWebSocket() noexcept
+{
+	Close();
+}
+
+template<typename ThreadingPolicy>
+void BasicWebSocket<ThreadingPolicy>::Close()
+{
+	m_state->multi.Execute([state = m_state]
+		{
+			if (state->closed == true)
+				return;
+			state->closed = true;
+			if (state->open == false)
+			{
+				// a handshake that is still running is canceled, and one
+				// that already finished is disconnected once it reports
+				state->multi.Cancel(std::vector<CURL*>{ state->easy.GetNativeHandle() });
+				return;
+			}
+			state->open = false;
+			// the close frame is only a courtesy, so it isn't waited for
+			size_t sent = 0;
+			curl_ws_send(state->easy.GetNativeHandle(), "", 0, &sent, 0, CURLWS_CLOSE);
+			state->multi.Disconnect(state->easy);
+		});
+}
+
+template<typename ThreadingPolicy>
+void BasicWebSocket<ThreadingPolicy>::Read(const std::shared_ptr<State>& state,
+	asio::mutable_buffer buffer, ReadHandler handler)
+{
+	if (state->open == false)
+		return handler(asio::error::not_connected, 0, {});
+	size_t read = 0;
+	typename ReceivedFrame<decltype(&curl_ws_recv)>::type* meta = nullptr;
+	// cURL may already hold data that came in with an earlier read, so
+	// it is asked before the socket is waited on
+	const auto res = curl_ws_recv(state->easy.GetNativeHandle(), buffer.data(),
+		buffer.size(), &read, &meta);
+	if (res == CURLE_AGAIN)
+		return state->multi.WaitConnection(state->easy, asio::socket_base::wait_read,
+			[state, buffer, handler = std::move(handler)](const error_code& ec) mutable
+			{
+				if (ec)
+					return handler(ec, 0, {});
+				Read(state, buffer, std::move(handler));
+			});
+	WebSocketFrame frame;
+	if (res == CURLE_OK && meta != nullptr)
+		frame = WebSocketFrame{ meta->flags, meta->offset, meta->bytesleft };
+	handler(res, read, frame);
+}
+
+template<typename ThreadingPolicy>
+void BasicWebSocket<ThreadingPolicy>::Write(const std::shared_ptr<State>& state,
+	asio::const_buffer buffer, size_t written, unsigned int flags, WriteHandler handler)
+{
+	if (state->open == false)
+		return handler(asio::error::not_connected, written);
+	size_t sent = 0;
+	auto res = curl_ws_send(state->easy.GetNativeHandle(),
+		static_cast<const char*>(buffer.data()) + written, buffer.size() - written, &sent, 0, flags);
+	written += sent;
+	// a frame that only partly fit in the socket is continued once it
+	// drains, with the same flags
+	if (res == CURLE_AGAIN || (res == CURLE_OK && written < buffer.size()))
+		return state->multi.WaitConnection(state->easy, asio::socket_base::wait_write,
+			[state, buffer, written, flags, handler = std::move(handler)](const error_code& ec) mutable
+			{
+				if (ec)
+					return handler(ec, written);
+				Write(state, buffer, written, flags, std::move(handler));
+			});
+	handler(res, written);
+}
+
+template class cma::BasicWebSocket<cma::ThreadSafe>;
+template class cma::BasicWebSocket<cma::SingleThreaded>;
\ No newline at end of file